@@ -0,0 +1,546 @@
+/**
+ * Ether Benchmark Suite
+ *
+ * Drives etherd with reproducible workloads and reports throughput and
+ * latency percentiles, one JSON object (or CSV row) per operation type.
+ *
+ * Workloads:
+ *   churn       ether_rmalloc/ether_rfree over a working set of blocks
+ *   latency     small ether_rwrite + ether_rread on one block
+ *   throughput  sequential ether_rwrite then ether_rread of large blocks
+ *   mixed       random reads/writes over a working set (--read-ratio)
+ *   local       ether_alloc/ether_free in this process (no server)
+ *
+ * Every client runs on its own thread with its own connection. Random
+ * choices come from a per-client xorshift generator seeded from --seed,
+ * so the same arguments replay the same sequence of requests.
+ *
+ * Usage:
+ *   1. Start the server: ./etherd
+ *   2. Run a workload:   ./ether_bench --workload mixed --clients 4
+ *
+ * Copyright (C) 2024 - Licensed under GPL-3.0
+ */
+
+#include "ether/client.h"
+#include "ether/ether.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// =============================================================================
+// CONFIGURATION
+// =============================================================================
+
+#define MAX_CLIENTS 256
+
+typedef enum {
+    WORKLOAD_CHURN,
+    WORKLOAD_LATENCY,
+    WORKLOAD_THROUGHPUT,
+    WORKLOAD_MIXED,
+    WORKLOAD_LOCAL,
+    NUM_WORKLOADS,
+} workload_t;
+
+static const char *const g_workload_names[NUM_WORKLOADS] = {
+    "churn", "latency", "throughput", "mixed", "local",
+};
+
+/**
+ * Operation types a workload reports on
+ */
+typedef enum {
+    OP_ALLOC,
+    OP_FREE,
+    OP_WRITE,
+    OP_READ,
+    NUM_OPS,
+} op_t;
+
+static const char *const g_op_names[NUM_OPS] = { "alloc", "free", "write", "read" };
+
+typedef struct {
+    const char *host;
+    int         port;
+    workload_t  workload;
+    int         clients;
+    size_t      ops;          // Measured operations per client
+    size_t      warmup;       // Unmeasured operations per client first
+    size_t      size;         // Block / transfer size
+    size_t      blocks;       // Working set per client (churn, mixed, local)
+    double      read_ratio;   // mixed: fraction of reads
+    uint64_t    seed;
+    int         csv;
+} config_t;
+
+static config_t g_config = {
+    .host = "localhost",
+    .port = 9999,
+    .workload = WORKLOAD_LATENCY,
+    .clients = 1,
+    .ops = 10000,
+    .warmup = 1000,
+    .size = 0,                // Per-workload default, see default_size()
+    .blocks = 64,
+    .read_ratio = 0.9,
+    .seed = 1,
+    .csv = 0,
+};
+
+static size_t default_size(workload_t workload) {
+    switch (workload) {
+        case WORKLOAD_THROUGHPUT: return 16 * 1024 * 1024;
+        case WORKLOAD_MIXED:      return 4096;
+        case WORKLOAD_LOCAL:      return 256;
+        default:                  return 64;
+    }
+}
+
+// =============================================================================
+// UTILITIES
+// =============================================================================
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * xorshift64*: small, fast and identical on every platform
+ */
+static inline uint64_t rng_next(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static inline size_t rng_below(uint64_t *state, size_t n) {
+    return (size_t) (rng_next(state) % n);
+}
+
+static inline double rng_unit(uint64_t *state) {
+    return (double) (rng_next(state) >> 11) / (double) (1ull << 53);
+}
+
+static int parse_size(const char *text, size_t *out) {
+    char *end;
+    unsigned long long value = strtoull(text, &end, 10);
+    switch (*end) {
+        case 'G': case 'g': value <<= 10; // fall through
+        case 'M': case 'm': value <<= 10; // fall through
+        case 'K': case 'k': value <<= 10; end++; break;
+        default: break;
+    }
+    if (end == text || *end != '\0') return -1;
+    *out = (size_t) value;
+    return 0;
+}
+
+// =============================================================================
+// SAMPLES
+// =============================================================================
+
+/**
+ * Latencies of one operation type on one client
+ */
+typedef struct {
+    uint64_t *ns;
+    size_t    count;
+    size_t    cap;
+    uint64_t  bytes;
+    int       errors;
+    uint64_t  first_ns;          // Start of the first measured op
+    uint64_t  last_ns;           // End of the last measured op
+} samples_t;
+
+static int samples_reserve(samples_t *s, size_t cap) {
+    s->ns = malloc(cap * sizeof(uint64_t));
+    s->cap = s->ns ? cap : 0;
+    return s->ns ? 0 : -1;
+}
+
+static inline void samples_add(samples_t *s, uint64_t start, uint64_t end,
+                               size_t bytes, int failed) {
+    if (s->first_ns == 0) s->first_ns = start;
+    s->last_ns = end;
+    if (s->count < s->cap) s->ns[s->count++] = end - start;
+    s->bytes += bytes;
+    if (failed) s->errors++;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t percentile(const uint64_t *sorted, size_t n, double q) {
+    if (n == 0) return 0;
+    size_t rank = (size_t) (q * (double) n + 0.5);
+    if (rank == 0) rank = 1;
+    if (rank > n) rank = n;
+    return sorted[rank - 1];
+}
+
+// =============================================================================
+// CLIENTS
+// =============================================================================
+
+typedef struct {
+    int               id;
+    pthread_t         thread;
+    pthread_barrier_t *start;
+    uint64_t          rng;
+    samples_t         ops[NUM_OPS];
+    const char       *error;     // Setup failure
+} client_t;
+
+/**
+ * Time one remote call; measured is 0 during warm-up
+ */
+#define TIMED(client, op, bytes, measured, expr) \
+    do { \
+        uint64_t t0_ = now_ns(); \
+        int failed_ = !(expr); \
+        uint64_t t1_ = now_ns(); \
+        if (measured) samples_add(&(client)->ops[op], t0_, t1_, (bytes), failed_); \
+    } while (0)
+
+static void run_churn(client_t *c, ether_conn_t *conn) {
+    size_t n = g_config.blocks;
+    void **live = calloc(n, sizeof(void *));
+    if (!live) { c->error = "out of memory"; return; }
+
+    for (size_t i = 0; i < g_config.warmup + g_config.ops; i++) {
+        int measured = i >= g_config.warmup;
+        size_t slot = rng_below(&c->rng, n);
+        if (live[slot]) {
+            void *ptr = live[slot];
+            TIMED(c, OP_FREE, 0, measured, (ether_rfree(conn, ptr), 1));
+            live[slot] = NULL;
+        }
+        size_t size = 1 + rng_below(&c->rng, g_config.size);
+        TIMED(c, OP_ALLOC, size, measured, (live[slot] = ether_rmalloc(conn, size)) != NULL);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        if (live[i]) ether_rfree(conn, live[i]);
+    }
+    free(live);
+}
+
+static void run_latency(client_t *c, ether_conn_t *conn) {
+    size_t size = g_config.size;
+    void *block = ether_rmalloc(conn, size);
+    uint8_t *buf = malloc(size);
+    if (!block || !buf) { c->error = "allocation failed"; free(buf); return; }
+    memset(buf, c->id, size);
+
+    for (size_t i = 0; i < g_config.warmup + g_config.ops; i++) {
+        int measured = i >= g_config.warmup;
+        TIMED(c, OP_WRITE, size, measured, ether_rwrite(conn, block, buf, size) == ETHER_OK);
+        TIMED(c, OP_READ, size, measured, ether_rread(conn, block, buf, size) == ETHER_OK);
+    }
+
+    ether_rfree(conn, block);
+    free(buf);
+}
+
+static void run_throughput(client_t *c, ether_conn_t *conn) {
+    size_t size = g_config.size;
+    void *block = ether_rmalloc(conn, size);
+    uint8_t *buf = malloc(size);
+    if (!block || !buf) { c->error = "allocation failed"; free(buf); return; }
+    for (size_t i = 0; i < size; i++) {
+        buf[i] = (uint8_t) rng_next(&c->rng);
+    }
+
+    // Each op is one whole-block transfer (streamed in 1 MB chunks)
+    for (size_t i = 0; i < g_config.warmup + g_config.ops; i++) {
+        int measured = i >= g_config.warmup;
+        TIMED(c, OP_WRITE, size, measured, ether_rwrite(conn, block, buf, size) == ETHER_OK);
+    }
+    for (size_t i = 0; i < g_config.ops; i++) {
+        TIMED(c, OP_READ, size, 1, ether_rread(conn, block, buf, size) == ETHER_OK);
+    }
+
+    ether_rfree(conn, block);
+    free(buf);
+}
+
+static void run_mixed(client_t *c, ether_conn_t *conn) {
+    size_t n = g_config.blocks;
+    size_t size = g_config.size;
+    void **blocks = calloc(n, sizeof(void *));
+    uint8_t *buf = malloc(size);
+    if (!blocks || !buf) { c->error = "out of memory"; free(blocks); free(buf); return; }
+
+    for (size_t i = 0; i < n; i++) {
+        blocks[i] = ether_rmalloc(conn, size);
+        if (!blocks[i]) { c->error = "allocation failed"; goto out; }
+    }
+    memset(buf, c->id, size);
+
+    for (size_t i = 0; i < g_config.warmup + g_config.ops; i++) {
+        int measured = i >= g_config.warmup;
+        void *block = blocks[rng_below(&c->rng, n)];
+        if (rng_unit(&c->rng) < g_config.read_ratio) {
+            TIMED(c, OP_READ, size, measured, ether_rread(conn, block, buf, size) == ETHER_OK);
+        } else {
+            TIMED(c, OP_WRITE, size, measured, ether_rwrite(conn, block, buf, size) == ETHER_OK);
+        }
+    }
+
+out:
+    for (size_t i = 0; i < n; i++) {
+        if (blocks[i]) ether_rfree(conn, blocks[i]);
+    }
+    free(blocks);
+    free(buf);
+}
+
+/**
+ * Local allocator microbenchmark: same churn pattern, no network
+ */
+static void run_local(client_t *c) {
+    size_t n = g_config.blocks;
+    void **live = calloc(n, sizeof(void *));
+    if (!live) { c->error = "out of memory"; return; }
+
+    for (size_t i = 0; i < g_config.warmup + g_config.ops; i++) {
+        int measured = i >= g_config.warmup;
+        size_t slot = rng_below(&c->rng, n);
+        if (live[slot]) {
+            void *ptr = live[slot];
+            TIMED(c, OP_FREE, 0, measured, (ether_free(ptr), 1));
+            live[slot] = NULL;
+        }
+        size_t size = 1 + rng_below(&c->rng, g_config.size);
+        TIMED(c, OP_ALLOC, size, measured, (live[slot] = ether_alloc(size)) != NULL);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        ether_free(live[i]);
+    }
+    free(live);
+}
+
+static void *client_main(void *arg) {
+    client_t *c = arg;
+    ether_conn_t *conn = NULL;
+
+    if (g_config.workload != WORKLOAD_LOCAL) {
+        conn = ether_connect(g_config.host, g_config.port);
+        if (!conn) c->error = "connect failed";
+    }
+
+    // Everyone starts together, connected or not (the barrier must be met)
+    pthread_barrier_wait(c->start);
+    if (c->error) return NULL;
+
+    switch (g_config.workload) {
+        case WORKLOAD_CHURN:      run_churn(c, conn); break;
+        case WORKLOAD_LATENCY:    run_latency(c, conn); break;
+        case WORKLOAD_THROUGHPUT: run_throughput(c, conn); break;
+        case WORKLOAD_MIXED:      run_mixed(c, conn); break;
+        case WORKLOAD_LOCAL:      run_local(c); break;
+        default: break;
+    }
+
+    ether_disconnect(conn);
+    return NULL;
+}
+
+// =============================================================================
+// REPORT
+// =============================================================================
+
+/**
+ * One line per operation type. Rates are over that operation's own window
+ * (first measured start to last measured end across all clients), so the
+ * write and read phases of the throughput workload are reported separately.
+ */
+static void report(client_t *clients, int num_clients) {
+    if (g_config.csv) {
+        printf("workload,op,clients,size,ops,errors,seconds,ops_per_sec,gb_per_sec,"
+               "min_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n");
+    }
+
+    for (int op = 0; op < NUM_OPS; op++) {
+        size_t total = 0;
+        uint64_t bytes = 0;
+        int errors = 0;
+        uint64_t start = UINT64_MAX, end = 0;
+        for (int i = 0; i < num_clients; i++) {
+            const samples_t *s = &clients[i].ops[op];
+            total += s->count;
+            bytes += s->bytes;
+            errors += s->errors;
+            if (s->count == 0) continue;
+            if (s->first_ns < start) start = s->first_ns;
+            if (s->last_ns > end) end = s->last_ns;
+        }
+        if (total == 0) continue;
+        double seconds = (double) (end - start) / 1e9;
+
+        uint64_t *all = malloc(total * sizeof(uint64_t));
+        if (!all) continue;
+        size_t pos = 0;
+        for (int i = 0; i < num_clients; i++) {
+            memcpy(all + pos, clients[i].ops[op].ns, clients[i].ops[op].count * sizeof(uint64_t));
+            pos += clients[i].ops[op].count;
+        }
+        qsort(all, total, sizeof(uint64_t), cmp_u64);
+
+        double ops_per_sec = seconds > 0 ? (double) total / seconds : 0;
+        double gb_per_sec = seconds > 0 ? (double) bytes / seconds / 1e9 : 0;
+        const char *fmt = g_config.csv
+            ? "%s,%s,%d,%zu,%zu,%d,%.6f,%.1f,%.4f,%llu,%llu,%llu,%llu,%llu,%llu\n"
+            : "{\"workload\":\"%s\",\"op\":\"%s\",\"clients\":%d,\"size\":%zu,\"ops\":%zu,"
+              "\"errors\":%d,\"seconds\":%.6f,\"ops_per_sec\":%.1f,\"gb_per_sec\":%.4f,"
+              "\"min_ns\":%llu,\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,"
+              "\"p999_ns\":%llu,\"max_ns\":%llu}\n";
+        printf(fmt, g_workload_names[g_config.workload], g_op_names[op], num_clients,
+               g_config.size, total, errors, seconds, ops_per_sec, gb_per_sec,
+               (unsigned long long) all[0],
+               (unsigned long long) percentile(all, total, 0.50),
+               (unsigned long long) percentile(all, total, 0.90),
+               (unsigned long long) percentile(all, total, 0.99),
+               (unsigned long long) percentile(all, total, 0.999),
+               (unsigned long long) all[total - 1]);
+        free(all);
+    }
+}
+
+// =============================================================================
+// MAIN
+// =============================================================================
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --workload churn|latency|throughput|mixed|local  (default: latency)\n"
+            "  --host HOST          Server host (default: localhost)\n"
+            "  --port PORT          Server port (default: 9999)\n"
+            "  --clients N          Concurrent connections, one thread each (default: 1)\n"
+            "  --ops N              Measured operations per client (default: 10000)\n"
+            "  --warmup N           Unmeasured operations per client first (default: 1000)\n"
+            "  --size BYTES[K|M|G]  Block size (churn/local: max size)\n"
+            "  --blocks N           Working set per client (default: 64)\n"
+            "  --read-ratio R       mixed: fraction of reads, 0..1 (default: 0.9)\n"
+            "  --seed S             Random seed (default: 1)\n"
+            "  --format json|csv    Output format (default: json)\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        int ok = value != NULL;
+
+        if (strcmp(arg, "--workload") == 0 && value) {
+            int found = -1;
+            for (int w = 0; w < NUM_WORKLOADS; w++) {
+                if (strcmp(value, g_workload_names[w]) == 0) found = w;
+            }
+            ok = found >= 0;
+            g_config.workload = (workload_t) found;
+        } else if (strcmp(arg, "--host") == 0 && value) {
+            g_config.host = value;
+        } else if (strcmp(arg, "--port") == 0 && value) {
+            g_config.port = atoi(value);
+        } else if (strcmp(arg, "--clients") == 0 && value) {
+            g_config.clients = atoi(value);
+            ok = g_config.clients >= 1 && g_config.clients <= MAX_CLIENTS;
+        } else if (strcmp(arg, "--ops") == 0 && value) {
+            g_config.ops = strtoull(value, NULL, 10);
+            ok = g_config.ops > 0;
+        } else if (strcmp(arg, "--warmup") == 0 && value) {
+            g_config.warmup = strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--size") == 0 && value) {
+            ok = parse_size(value, &g_config.size) == 0 && g_config.size > 0;
+        } else if (strcmp(arg, "--blocks") == 0 && value) {
+            g_config.blocks = strtoull(value, NULL, 10);
+            ok = g_config.blocks > 0;
+        } else if (strcmp(arg, "--read-ratio") == 0 && value) {
+            g_config.read_ratio = atof(value);
+            ok = g_config.read_ratio >= 0 && g_config.read_ratio <= 1;
+        } else if (strcmp(arg, "--seed") == 0 && value) {
+            g_config.seed = strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--format") == 0 && value) {
+            ok = strcmp(value, "json") == 0 || strcmp(value, "csv") == 0;
+            g_config.csv = strcmp(value, "csv") == 0;
+        } else {
+            ok = 0;
+        }
+
+        if (!ok) {
+            usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+
+    if (g_config.size == 0) {
+        g_config.size = default_size(g_config.workload);
+    }
+
+    client_t *clients = calloc((size_t) g_config.clients, sizeof(client_t));
+    if (!clients) return 1;
+
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, (unsigned) g_config.clients);
+
+    for (int i = 0; i < g_config.clients; i++) {
+        client_t *c = &clients[i];
+        c->id = i;
+        c->start = &start;
+        // Distinct, non-zero stream per client
+        c->rng = (g_config.seed + 1) * 0x9E3779B97F4A7C15ull + (uint64_t) i;
+        if (c->rng == 0) c->rng = 1;
+
+        for (int op = 0; op < NUM_OPS; op++) {
+            if (samples_reserve(&c->ops[op], g_config.ops) != 0) {
+                fprintf(stderr, "ether_bench: out of memory\n");
+                return 1;
+            }
+        }
+    }
+
+    for (int i = 0; i < g_config.clients; i++) {
+        if (pthread_create(&clients[i].thread, NULL, client_main, &clients[i]) != 0) {
+            fprintf(stderr, "ether_bench: pthread_create failed\n");
+            return 1;
+        }
+    }
+
+    int failed = 0;
+    for (int i = 0; i < g_config.clients; i++) {
+        pthread_join(clients[i].thread, NULL);
+        if (clients[i].error) {
+            fprintf(stderr, "ether_bench: client %d: %s\n", i, clients[i].error);
+            failed = 1;
+        }
+    }
+
+    if (!failed) {
+        report(clients, g_config.clients);
+    }
+
+    for (int i = 0; i < g_config.clients; i++) {
+        for (int op = 0; op < NUM_OPS; op++) {
+            free(clients[i].ops[op].ns);
+        }
+    }
+    free(clients);
+    pthread_barrier_destroy(&start);
+    return failed;
+}
@@ -2,6 +2,7 @@
  * Ether Client Library
  *
  * Remote memory operations: rmalloc, rfree, rwrite, rread
+ * (blocking, or pipelined through futures)
  *
  * Copyright (C) 2024 - Licensed under GPL-3.0
  */
@@ -28,7 +29,12 @@ typedef struct ether_conn ether_conn_t;
 /**
  * Connect to an Ether server
  *
- * @param host  Hostname or IP address (e.g., "localhost", "192.168.1.1")
+ * A host of the form "unix:/path" connects to the Unix domain socket of
+ * an etherd started with --unix /path (port is ignored). Such connections
+ * skip the TCP stack and may use ETHER_SHADOW_SHARED.
+ *
+ * @param host  Hostname or IP address (e.g., "localhost", "192.168.1.1"),
+ *              or "unix:" followed by a socket path
  * @param port  Port number (default: 9999)
  * @return      Connection handle, NULL on failure
  */
@@ -49,6 +55,186 @@ void ether_disconnect(ether_conn_t* conn);
  */
 int ether_ping(ether_conn_t* conn);
 
+/**
+ * Server-side metrics of one command, since the server started
+ */
+typedef struct {
+    uint8_t  command;     // ether_cmd_t covered (0 = unknown commands)
+    uint64_t count;       // Requests handled
+    uint64_t errors;      // Requests answered with ERROR
+    uint64_t bytes_in;    // Request payload bytes
+    uint64_t bytes_out;   // Response payload bytes
+    uint64_t p50_ns;      // Latency percentiles (header received ->
+    uint64_t p99_ns;      // response queued, all workers merged)
+    uint64_t p999_ns;
+} ether_server_stats_t;
+
+/**
+ * Fetch per-command metrics from the server (STATS)
+ *
+ * @param conn   Connection handle
+ * @param stats  Output array
+ * @param max    Entries in stats
+ * @return       Number of entries filled, or error code (< 0)
+ */
+int ether_server_stats(ether_conn_t* conn, ether_server_stats_t* stats, size_t max);
+
+/**
+ * Server memory figures, sampled when the request is handled
+ */
+typedef struct {
+    uint64_t used;        // Bytes in live blocks
+    uint64_t peak;        // Highest used since the server started
+    uint64_t available;   // Host memory available for new blocks
+    uint64_t blocks;      // Live blocks
+} ether_server_meminfo_t;
+
+/**
+ * Fetch the server's memory usage and headroom (MEMINFO)
+ *
+ * @param conn  Connection handle
+ * @param info  Output
+ * @return      ETHER_OK or error code
+ */
+int ether_server_meminfo(ether_conn_t* conn, ether_server_meminfo_t* info);
+
+/**
+ * How the local buffer behind an ether_rmalloc() pointer is backed
+ */
+typedef enum {
+    ETHER_SHADOW_FULL   = 0,   // Full local copy, kept in sync by rwrite (default)
+    ETHER_SHADOW_LAZY   = 1,   // Reserved address range only (PROT_NONE), no copy
+    ETHER_SHADOW_SHARED = 2,   // The server's block itself, mapped (unix: only)
+} ether_shadow_mode_t;
+
+/**
+ * Select how subsequent allocations on this connection are shadowed
+ *
+ * With ETHER_SHADOW_LAZY the returned pointer is a token: it reserves
+ * address space for the block but commits no memory beyond one header
+ * page, so client RSS does not grow with remote allocations. The token
+ * must not be dereferenced (it faults); use ether_rread()/ether_rwrite().
+ * Existing blocks keep the mode they were allocated with.
+ *
+ * With ETHER_SHADOW_SHARED (Unix domain socket connections only) the
+ * server keeps the block in a memfd and passes it over the socket; the
+ * returned pointer maps the block itself. Loads and stores through it,
+ * and ether_rread()/ether_rwrite() on it, are plain memory accesses with
+ * no system call, and other clients see them at once. Allocation, resize
+ * and free still go through the server. Shared blocks are never cached
+ * (there is nothing to cache), and blocks allocated by a batch get a
+ * full local copy instead.
+ *
+ * @param conn  Connection handle
+ * @param mode  Shadow mode for new blocks
+ * @return      ETHER_OK, or ETHER_ERR_INVALID (unknown mode, or
+ *              ETHER_SHADOW_SHARED over TCP)
+ */
+int ether_set_shadow_mode(ether_conn_t* conn, ether_shadow_mode_t mode);
+
+/**
+ * Client-side caching of block contents
+ */
+typedef enum {
+    ETHER_CACHE_NONE      = 0,   // Every read/write goes to the server (default)
+    ETHER_CACHE_WRITEBACK = 1,   // 4 KB page cache in the local buffer
+} ether_cache_mode_t;
+
+/**
+ * Select whether subsequent allocations on this connection are cached
+ *
+ * With ETHER_CACHE_WRITEBACK, ether_rread() is served from the local
+ * buffer for pages already read or written, and ether_rwrite() only marks
+ * pages dirty. Dirty pages reach the server on ether_rflush(),
+ * ether_rsync() or ether_disconnect(). The cache is not coherent with
+ * other clients: use ether_rinvalidate() to see their writes. Blocks in
+ * ETHER_SHADOW_LAZY mode have no local buffer and are never cached.
+ *
+ * @param conn  Connection handle
+ * @param mode  Cache mode for new blocks
+ * @return      ETHER_OK, or ETHER_ERR_INVALID
+ */
+int ether_set_cache_mode(ether_conn_t* conn, ether_cache_mode_t mode);
+
+/**
+ * Negotiate payload compression with the server (PING/PONG handshake)
+ *
+ * Once enabled, WRITE data of ETHER_COMPRESS_MIN bytes or more is sent
+ * LZ4-compressed when that makes it at least 1/16 smaller, and the server
+ * does the same for READ responses. Worth it on slow links with sparse or
+ * repetitive data; on a fast local network it mostly costs CPU.
+ *
+ * @param conn    Connection handle
+ * @param enable  1 to offer compression, 0 to turn it off
+ * @return        ETHER_OK, ETHER_ERR_INVALID if the server declined (the
+ *                connection stays uncompressed), or error code
+ */
+int ether_set_compression(ether_conn_t* conn, int enable);
+
+// =============================================================================
+// CONNECTION POOL
+// =============================================================================
+
+/**
+ * Opaque pool of persistent connections to one server
+ *
+ * An ether_conn_t is not thread-safe: it belongs to one thread at a time.
+ * A pool lets many threads share a few connections by checking one out
+ * for the duration of a call sequence. Acquiring an idle connection is a
+ * single atomic operation, and each thread starts at its own slot, so
+ * threads only contend when there are more of them than connections.
+ *
+ * Pooled TCP connections set TCP_NODELAY and TCP keepalive. A connection
+ * that fails is handed back to the pool by ether_pool_release() and
+ * reopened by a background thread with exponential backoff; the other
+ * connections keep serving in the meantime. Blocks survive a reconnect
+ * (they live on the server), and a pointer allocated through one pooled
+ * connection may be used with any other connection of the same pool.
+ *
+ * Pooled connections do not support ETHER_CACHE_WRITEBACK, and regions
+ * from ether_rmap() stay tied to the connection that mapped them.
+ */
+typedef struct ether_pool ether_pool_t;
+
+/**
+ * Open a pool of connections to an Ether server
+ *
+ * @param host  As for ether_connect()
+ * @param port  As for ether_connect()
+ * @param size  Number of connections (1 - 256)
+ * @return      Pool, NULL if no connection could be opened
+ */
+ether_pool_t* ether_pool_create(const char* host, int port, size_t size);
+
+/**
+ * Close every connection of a pool (none may be checked out)
+ */
+void ether_pool_destroy(ether_pool_t* pool);
+
+/**
+ * Check out a connection for the calling thread
+ *
+ * Blocks while every live connection is checked out by other threads.
+ *
+ * @param pool  Pool
+ * @return      Connection, NULL if no connection is live (the server is
+ *              unreachable and reconnecting has not succeeded yet)
+ */
+ether_conn_t* ether_pool_acquire(ether_pool_t* pool);
+
+/**
+ * Return a connection to its pool
+ *
+ * A connection whose calls failed with ETHER_ERR_NETWORK is reconnected
+ * in the background. Never pass a pooled connection to ether_disconnect().
+ */
+void ether_pool_release(ether_pool_t* pool, ether_conn_t* conn);
+
+/**
+ * Number of connections currently open (not waiting to reconnect)
+ */
+size_t ether_pool_live(ether_pool_t* pool);
+
 // =============================================================================
 // REMOTE MEMORY API
 // =============================================================================
@@ -65,6 +251,22 @@ int ether_ping(ether_conn_t* conn);
  */
 void* ether_rmalloc(ether_conn_t* conn, size_t size);
 
+#define ETHER_RMALLOC_HUGE  0x01   // Huge pages on the owning worker's NUMA node
+
+/**
+ * Allocate remote memory with placement hints
+ *
+ * ETHER_RMALLOC_HUGE asks the server to back the block with huge pages
+ * even below its huge-page threshold. It is only a hint: the server
+ * falls back to regular pages.
+ *
+ * @param conn   Active connection
+ * @param size   Bytes to allocate
+ * @param flags  0 or ETHER_RMALLOC_HUGE
+ * @return       Handle (local pointer), NULL on failure
+ */
+void* ether_rmalloc_ex(ether_conn_t* conn, size_t size, unsigned flags);
+
 /**
  * Free remote memory (rfree)
  *
@@ -73,6 +275,44 @@ void* ether_rmalloc(ether_conn_t* conn, size_t size);
  */
 void ether_rfree(ether_conn_t* conn, void* ptr);
 
+/**
+ * Resize remote memory (rrealloc)
+ *
+ * The server resizes the block in place or moves it itself, so no data
+ * crosses the network and the remote handle stays the same. Growth
+ * reserves spare capacity on the server, so growing a block step by
+ * step costs amortized O(1). Like realloc(), the local pointer may
+ * change; with ETHER_CACHE_WRITEBACK cached and dirty pages are kept.
+ * No async operation or ether_rmap() mapping may be active on the block.
+ *
+ * - rrealloc(conn, NULL, size) = rmalloc(conn, size)
+ * - rrealloc(conn, ptr, 0) = rfree(conn, ptr), returns NULL
+ *
+ * @param conn  Active connection
+ * @param ptr   Handle returned by ether_rmalloc() (can be NULL)
+ * @param size  New size in bytes
+ * @return      Handle (local pointer) to use from now on, NULL on
+ *              failure (ptr is still valid; the remote block may have
+ *              grown already if only the local buffer could not)
+ */
+void* ether_rrealloc(ether_conn_t* conn, void* ptr, size_t size);
+
+/**
+ * Why the last ether_rmalloc(), ether_rmalloc_ex() or ether_rrealloc()
+ * on this connection that reached the server returned NULL
+ *
+ * An etherd with admission control refuses an ALLOC or a growing REALLOC
+ * with ETHER_ERR_QUOTA (this host's byte or handle quota is used up:
+ * free something first) or ETHER_ERR_BUSY (the server is past its
+ * memory watermark: back off and retry). ETHER_ERR_NOMEM is the server
+ * (or the local buffer) running out of memory, ETHER_ERR_NETWORK a lost
+ * connection.
+ *
+ * @param conn  Connection
+ * @return      ETHER_OK if that call succeeded, else its error
+ */
+int ether_last_error(ether_conn_t* conn);
+
 /**
  * Write data to remote memory (rwrite)
  *
@@ -95,6 +335,37 @@ int ether_rwrite(ether_conn_t* conn, void* ptr, const void* data, size_t len);
  */
 int ether_rread(ether_conn_t* conn, void* ptr, void* buffer, size_t len);
 
+/**
+ * Write data at an offset inside remote memory
+ *
+ * Only [offset, offset + len) travels over the network, so small updates
+ * of large blocks stay cheap.
+ *
+ * @param conn    Active connection
+ * @param ptr     Memory handle
+ * @param offset  Byte offset inside the block
+ * @param data    Data to write
+ * @param len     Data length in bytes
+ * @return        ETHER_OK, or ETHER_ERR_OVERFLOW if the range does not
+ *                fit in the block
+ */
+int ether_rwrite_at(ether_conn_t* conn, void* ptr, size_t offset, const void* data, size_t len);
+
+/**
+ * Read from an offset inside remote memory
+ *
+ * len is capped to the end of the block.
+ *
+ * @param conn    Active connection
+ * @param ptr     Memory handle
+ * @param offset  Byte offset inside the block
+ * @param buffer  Destination buffer
+ * @param len     Bytes to read
+ * @return        ETHER_OK, or ETHER_ERR_OVERFLOW if offset is past the
+ *                end of the block
+ */
+int ether_rread_at(ether_conn_t* conn, void* ptr, size_t offset, void* buffer, size_t len);
+
 /**
  * Get size of remote memory block
  *
@@ -104,6 +375,449 @@ int ether_rread(ether_conn_t* conn, void* ptr, void* buffer, size_t len);
  */
 size_t ether_rsize(ether_conn_t* conn, void* ptr);
 
+/**
+ * Write the dirty pages of one cached block back to the server
+ *
+ * All dirty ranges go out in a single BATCH request.
+ *
+ * @param conn  Active connection
+ * @param ptr   Memory handle
+ * @return      ETHER_OK (also for uncached or clean blocks) or error code
+ */
+int ether_rflush(ether_conn_t* conn, void* ptr);
+
+/**
+ * Write the dirty pages of every cached block of the connection back
+ *
+ * @param conn  Active connection
+ * @return      ETHER_OK or the first error seen
+ */
+int ether_rsync(ether_conn_t* conn);
+
+/**
+ * Forget the clean cached pages of a block, so the next read fetches
+ * them from the server again (dirty pages are kept)
+ *
+ * @param conn  Active connection
+ * @param ptr   Memory handle
+ * @return      ETHER_OK or error code
+ */
+int ether_rinvalidate(ether_conn_t* conn, void* ptr);
+
+// =============================================================================
+// BULK OPERATIONS
+// =============================================================================
+
+// Run by the server against its copy of the blocks: no data crosses the
+// network, whatever the range length. Dirty cached pages of every block
+// involved are flushed first. Ranges must lie inside their blocks
+// (ETHER_ERR_OVERFLOW otherwise).
+
+/**
+ * Copy a range from one remote block to another (or within one block;
+ * overlapping ranges are handled like memmove())
+ *
+ * @param conn        Active connection
+ * @param dst         Destination block
+ * @param dst_offset  Range start in dst
+ * @param src         Source block
+ * @param src_offset  Range start in src
+ * @param len         Bytes to copy
+ * @return            ETHER_OK or error code
+ */
+int ether_rcopy(ether_conn_t* conn, void* dst, size_t dst_offset,
+                void* src, size_t src_offset, size_t len);
+
+/**
+ * Fill a range of a remote block with a repeated pattern
+ *
+ * @param conn         Active connection
+ * @param ptr          Memory handle
+ * @param offset       Range start
+ * @param len          Bytes to fill
+ * @param pattern      Pattern (memset() for a 1-byte pattern)
+ * @param pattern_len  1..ETHER_FILL_PATTERN_MAX bytes
+ * @return             ETHER_OK or error code
+ */
+int ether_rfill(ether_conn_t* conn, void* ptr, size_t offset, size_t len,
+                const void* pattern, size_t pattern_len);
+
+/**
+ * Compare ranges of two remote blocks
+ *
+ * @param conn      Active connection
+ * @param a         First block
+ * @param a_offset  Range start in a
+ * @param b         Second block
+ * @param b_offset  Range start in b
+ * @param len       Bytes to compare
+ * @param order     Output: <0, 0 or >0, like memcmp()
+ * @param mismatch  Output: offset of the first differing byte, len if
+ *                  equal (can be NULL)
+ * @return          ETHER_OK or error code
+ */
+int ether_rcmp(ether_conn_t* conn, void* a, size_t a_offset, void* b, size_t b_offset,
+               size_t len, int* order, size_t* mismatch);
+
+/**
+ * Checksum a range of a remote block; equals ether_checksum() of the
+ * same bytes, so a local copy can be verified without reading it back
+ *
+ * @param conn    Active connection
+ * @param ptr     Memory handle
+ * @param offset  Range start
+ * @param len     Bytes to hash
+ * @param sum     Output: checksum
+ * @return        ETHER_OK or error code
+ */
+int ether_rchecksum(ether_conn_t* conn, void* ptr, size_t offset, size_t len, uint64_t* sum);
+
+// =============================================================================
+// ASYNC API
+// =============================================================================
+
+/**
+ * Opaque handle to a request in flight
+ *
+ * Every request carries an ID (the header's reserved field) that the
+ * server echoes back, so many requests can be outstanding on one
+ * connection and responses are matched by ID rather than by order.
+ * Blocking calls made while futures are pending are routed the same way.
+ */
+typedef struct ether_future ether_future_t;
+
+#define ETHER_MAX_INFLIGHT 1024   // Requests in flight per connection
+
+/**
+ * Start a write without waiting for the server
+ *
+ * data must stay valid until the future completes. Argument errors are
+ * reported through the future, not here.
+ *
+ * @param conn  Active connection
+ * @param ptr   Memory handle
+ * @param data  Data to write
+ * @param len   Data length in bytes
+ * @return      Future (release with ether_wait()), NULL if out of memory
+ */
+ether_future_t* ether_rwrite_async(ether_conn_t* conn, void* ptr, const void* data, size_t len);
+
+/**
+ * Start a read without waiting for the server
+ *
+ * buffer is filled when the future completes and must stay valid until then.
+ *
+ * @param conn    Active connection
+ * @param ptr     Memory handle
+ * @param buffer  Destination buffer
+ * @param len     Bytes to read
+ * @return        Future (release with ether_wait()), NULL if out of memory
+ */
+ether_future_t* ether_rread_async(ether_conn_t* conn, void* ptr, void* buffer, size_t len);
+
+/**
+ * Ranged variants of ether_rwrite_async() / ether_rread_async()
+ * (see ether_rwrite_at() / ether_rread_at())
+ */
+ether_future_t* ether_rwrite_at_async(ether_conn_t* conn, void* ptr, size_t offset,
+                                      const void* data, size_t len);
+ether_future_t* ether_rread_at_async(ether_conn_t* conn, void* ptr, size_t offset,
+                                     void* buffer, size_t len);
+
+/**
+ * Check whether a request has completed, without blocking
+ *
+ * Processes any responses that have already arrived on the connection.
+ *
+ * @param future  Future to check
+ * @return        1 if complete, 0 if still pending, -1 if future is NULL
+ */
+int ether_poll(ether_future_t* future);
+
+/**
+ * Wait for a request to complete and release the future
+ *
+ * @param future  Future returned by an *_async() call
+ * @return        ETHER_OK or error code of the request
+ */
+int ether_wait(ether_future_t* future);
+
+// =============================================================================
+// MAPPING API
+// =============================================================================
+
+/**
+ * Map a remote block into the address space (userfaultfd)
+ *
+ * The returned range can be used like ordinary memory: the first touch of
+ * a page fetches it from the server (sequential access reads ahead up
+ * to 2 MB), so only touched pages cost a transfer. Modified pages are
+ * written back by ether_rmsync() and ether_runmap(). The mapping is a
+ * separate view of the block: ether_rwrite() by this or other clients
+ * is not reflected in pages already fetched.
+ *
+ * @param conn  Active connection
+ * @param ptr   Memory handle
+ * @return      Start of the mapping, NULL on failure (e.g. userfaultfd
+ *              not permitted: see vm.unprivileged_userfaultfd)
+ */
+void* ether_rmap(ether_conn_t* conn, void* ptr);
+
+/**
+ * Write modified pages of a mapping back to the server
+ *
+ * @param conn  Connection the block was mapped through
+ * @param addr  Any address inside the mapping
+ * @return      ETHER_OK, ETHER_ERR_NOTFOUND if addr is not mapped, or
+ *              the error of a failed fetch/write
+ */
+int ether_rmsync(ether_conn_t* conn, void* addr);
+
+/**
+ * Write back and remove a mapping (must precede ether_rfree() of the block)
+ *
+ * @param conn  Connection the block was mapped through
+ * @param addr  Any address inside the mapping
+ * @return      Result of the write-back; the mapping is removed regardless
+ */
+int ether_runmap(ether_conn_t* conn, void* addr);
+
+// =============================================================================
+// BATCH API
+// =============================================================================
+
+/**
+ * Builder for a BATCH request: queue sub-operations, then run them all
+ * with a single message and a single round trip.
+ *
+ *   ether_batch_t* b = ether_batch_create(conn);
+ *   int a = ether_batch_alloc(b, 64);
+ *   ether_batch_write_new(b, a, "hello", 6);
+ *   ether_batch_exec(b);
+ *   void* ptr = ether_batch_ptr(b, a);   // as if from ether_rmalloc()
+ *   ether_batch_destroy(b);
+ *
+ * Ops run in order on the server. Buffers passed to the builder must
+ * stay valid until ether_batch_exec() returns. A batch runs once.
+ */
+typedef struct ether_batch ether_batch_t;
+
+/**
+ * Start an empty batch
+ *
+ * @param conn  Active connection
+ * @return      Batch, NULL on failure
+ */
+ether_batch_t* ether_batch_create(ether_conn_t* conn);
+
+/**
+ * Release a batch (local pointers from its ALLOCs stay valid)
+ *
+ * @param batch  Batch (can be NULL)
+ */
+void ether_batch_destroy(ether_batch_t* batch);
+
+/**
+ * Queue an allocation
+ *
+ * @return  Op index (>= 0), or error code
+ */
+int ether_batch_alloc(ether_batch_t* batch, size_t size);
+
+/**
+ * Queue a free of a block from ether_rmalloc()/ether_batch_ptr()
+ *
+ * @return  Op index (>= 0), or error code
+ */
+int ether_batch_free(ether_batch_t* batch, void* ptr);
+
+/**
+ * Queue a write to an existing block
+ *
+ * @return  Op index (>= 0), or error code
+ */
+int ether_batch_write(ether_batch_t* batch, void* ptr, const void* data, size_t len);
+
+/**
+ * Queue a write to a block allocated earlier in the same batch
+ *
+ * @param alloc_op  Index returned by ether_batch_alloc()
+ * @return          Op index (>= 0), or error code
+ */
+int ether_batch_write_new(ether_batch_t* batch, int alloc_op, const void* data, size_t len);
+
+/**
+ * Queue a write at an offset inside an existing block
+ *
+ * @return  Op index (>= 0), or error code
+ */
+int ether_batch_write_at(ether_batch_t* batch, void* ptr, size_t offset,
+                         const void* data, size_t len);
+
+/**
+ * Queue a read from an existing block (buffer is filled by exec)
+ *
+ * @return  Op index (>= 0), or error code
+ */
+int ether_batch_read(ether_batch_t* batch, void* ptr, void* buffer, size_t len);
+
+/**
+ * Queue a read from an offset inside an existing block
+ *
+ * @return  Op index (>= 0), or error code
+ */
+int ether_batch_read_at(ether_batch_t* batch, void* ptr, size_t offset,
+                        void* buffer, size_t len);
+
+/**
+ * Send the batch and wait for all results
+ *
+ * @param batch  Batch to run
+ * @return       ETHER_OK if the batch ran (check each op with
+ *               ether_batch_result()), error code otherwise
+ */
+int ether_batch_exec(ether_batch_t* batch);
+
+/**
+ * Result of one op after ether_batch_exec()
+ *
+ * @return  ETHER_OK or error code
+ */
+int ether_batch_result(const ether_batch_t* batch, int op);
+
+/**
+ * Local pointer created by a successful ALLOC op
+ *
+ * @return  Pointer usable with every ether_r*() call, NULL if the op failed
+ */
+void* ether_batch_ptr(const ether_batch_t* batch, int op);
+
+// =============================================================================
+// CLUSTER
+// =============================================================================
+
+/**
+ * Opaque set of Ether servers used as one memory pool
+ *
+ * Each block lives on one node, chosen by the client when it is
+ * allocated, or is striped over all of them. The pointer returned records
+ * its node(s), so every later call goes straight there: there is no
+ * coordinator, and capacity and bandwidth add up over the nodes. Blocks
+ * are never moved between nodes.
+ *
+ * A block's node is ether_cluster_node(cluster, ptr); the whole ether_r*()
+ * API works on that connection. ether_cluster_rwrite() and friends are
+ * shorthands for the common calls. Like ether_conn_t, a cluster belongs
+ * to one thread at a time.
+ */
+typedef struct ether_cluster ether_cluster_t;
+
+/**
+ * Connect to every node of a cluster
+ *
+ * @param hosts  Node endpoints, as for ether_connect()
+ * @param ports  Node ports
+ * @param count  Number of nodes (1 - 256)
+ * @return       Cluster, NULL if a node could not be reached
+ */
+ether_cluster_t* ether_cluster_create(const char* const* hosts, const int* ports, size_t count);
+
+/**
+ * Disconnect from every node (blocks still live are not freed)
+ */
+void ether_cluster_destroy(ether_cluster_t* cluster);
+
+/**
+ * Fetch every node's memory figures now (they are refreshed every second
+ * anyway as ether_cluster_rmalloc() is called)
+ *
+ * @param cluster  Cluster
+ * @param total    Sum over the live nodes (may be NULL)
+ * @return         Number of nodes that answered, or error code
+ */
+int ether_cluster_refresh(ether_cluster_t* cluster, ether_server_meminfo_t* total);
+
+/**
+ * Number of nodes
+ */
+size_t ether_cluster_size(const ether_cluster_t* cluster);
+
+/**
+ * Connection to a node, by node ID (0 - size-1, in ether_cluster_create()
+ * order), e.g. to set its shadow, cache or compression mode
+ *
+ * @return  Connection, NULL if node is out of range
+ */
+ether_conn_t* ether_cluster_conn(ether_cluster_t* cluster, size_t node);
+
+/**
+ * Connection to the node a block lives on
+ *
+ * @return  Connection, NULL if ptr was not allocated through this cluster
+ */
+ether_conn_t* ether_cluster_node(ether_cluster_t* cluster, void* ptr);
+
+/**
+ * Allocate on the node with the most available memory
+ *
+ * @param cluster  Cluster
+ * @param size     Bytes to allocate
+ * @return         Handle (local pointer), NULL on failure
+ */
+void* ether_cluster_rmalloc(ether_cluster_t* cluster, size_t size);
+
+/**
+ * Allocate on the node a key hashes to (consistent hashing)
+ *
+ * The same key maps to the same node as long as the node set is the
+ * same; adding or removing a node only remaps about 1/N of the keys. If
+ * the key's node is down, the next node on the ring is used.
+ *
+ * @param cluster  Cluster
+ * @param key      Key bytes
+ * @param key_len  Key length
+ * @param size     Bytes to allocate
+ * @return         Handle (local pointer), NULL on failure
+ */
+void* ether_cluster_rmalloc_key(ether_cluster_t* cluster, const void* key, size_t key_len,
+                                size_t size);
+
+#define ETHER_STRIPE_UNIT  (1024 * 1024)   // Default stripe unit (1 MB)
+
+/**
+ * Allocate a block striped over every live node (RAID-0)
+ *
+ * Consecutive stripe units go to consecutive nodes, so a large transfer
+ * through ether_cluster_rwrite() / ether_cluster_rread() keeps every
+ * node busy at once and runs at the sum of their links. The block may be
+ * larger than 4 GB and than any one node's memory.
+ *
+ * The pointer is not backed by local memory (touching it faults, like an
+ * ETHER_SHADOW_LAZY buffer) and belongs to no single node:
+ * ether_cluster_node() returns NULL for it, and only the ether_cluster_*()
+ * calls accept it.
+ *
+ * @param cluster  Cluster
+ * @param size     Bytes to allocate
+ * @param unit     Stripe unit in bytes (at most 64 MB), 0 for ETHER_STRIPE_UNIT
+ * @return         Handle (local pointer), NULL on failure
+ */
+void* ether_cluster_rmalloc_striped(ether_cluster_t* cluster, size_t size, size_t unit);
+
+/**
+ * ether_rfree() / ether_rwrite() / ether_rread() / ether_rsize() on the
+ * block's node, or on every node of a striped block (ETHER_ERR_NOTFOUND
+ * or 0 if ptr was not allocated through this cluster)
+ */
+void ether_cluster_rfree(ether_cluster_t* cluster, void* ptr);
+int ether_cluster_rwrite(ether_cluster_t* cluster, void* ptr, const void* data, size_t len);
+int ether_cluster_rread(ether_cluster_t* cluster, void* ptr, void* buffer, size_t len);
+int ether_cluster_rwrite_at(ether_cluster_t* cluster, void* ptr, size_t offset,
+                            const void* data, size_t len);
+int ether_cluster_rread_at(ether_cluster_t* cluster, void* ptr, size_t offset,
+                           void* buffer, size_t len);
+size_t ether_cluster_rsize(ether_cluster_t* cluster, void* ptr);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,109 @@
+/**
+ * Ether - Payload Compression
+ *
+ * LZ4 block format codec shared by libether clients and etherd, used for
+ * WRITE / READ payloads on connections that negotiated
+ * ETHER_FLAG_COMPRESSED (see protocol.h).
+ *
+ * The compressor is the greedy single-pass LZ4 scheme: a 4096-entry hash
+ * table of 4-byte sequences, matches extended 8 bytes at a time, and a
+ * search step that grows on misses so incompressible data is skipped at
+ * memory speed. Output is standard LZ4 block format, so any LZ4 decoder
+ * can read it. The decoder checks every length and offset against both
+ * buffers: malformed input fails instead of reading or writing outside.
+ *
+ * A compressed payload is framed as:
+ *
+ * Offset  Size  Field
+ * ------  ----  -----
+ * 0       4     raw_size   - Decompressed length (network byte order)
+ * 4       n     block      - LZ4 block
+ *
+ * Copyright (C) 2024 - Licensed under GPL-3.0
+ */
+
+#ifndef ETHER_COMPRESS_H
+#define ETHER_COMPRESS_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ETHER_COMPRESS_HEADER  4    // raw_size prefix of a compressed payload
+
+/**
+ * Largest LZ4 block len bytes can compress to (incompressible input)
+ */
+static inline size_t ether_lz4_bound(size_t len) {
+    return len + len / 255 + 16;
+}
+
+/**
+ * Compress into an LZ4 block
+ *
+ * @param src  Input
+ * @param len  Input length
+ * @param dst  Output
+ * @param cap  Output capacity
+ * @return     Block length, 0 if it does not fit in cap
+ */
+size_t ether_lz4_compress(const void* src, size_t len, void* dst, size_t cap);
+
+/**
+ * Decompress an LZ4 block
+ *
+ * @param src  Block
+ * @param len  Block length
+ * @param dst  Output
+ * @param cap  Output capacity
+ * @return     Decompressed length, -1 if the block is malformed or does
+ *             not fit in cap
+ */
+ssize_t ether_lz4_decompress(const void* src, size_t len, void* dst, size_t cap);
+
+/**
+ * Output capacity ether_compress_payload() needs for len bytes
+ */
+static inline size_t ether_compress_bound(size_t len) {
+    return ETHER_COMPRESS_HEADER + ether_lz4_bound(len);
+}
+
+/**
+ * Frame len bytes as a compressed payload, unless compression does not
+ * pay for itself: the result must save at least 1/16 of the input
+ *
+ * @param src  Raw data
+ * @param len  Raw length
+ * @param dst  Output
+ * @param cap  Output capacity
+ * @return     Payload length, 0 to send the data raw
+ */
+size_t ether_compress_payload(const void* src, size_t len, void* dst, size_t cap);
+
+/**
+ * Decompressed length announced by a compressed payload
+ *
+ * @return  raw_size, 0 if len is shorter than the frame header
+ */
+size_t ether_compressed_size(const void* src, size_t len);
+
+/**
+ * Decompress a payload framed by ether_compress_payload()
+ *
+ * @param src  Payload
+ * @param len  Payload length
+ * @param dst  Output
+ * @param cap  Output capacity
+ * @return     Raw length, -1 if the payload is malformed, does not
+ *             fit in cap or decodes to a length other than raw_size
+ */
+ssize_t ether_decompress_payload(const void* src, size_t len, void* dst, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ETHER_COMPRESS_H
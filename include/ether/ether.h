@@ -39,6 +39,8 @@ typedef enum {
     ETHER_ERR_NETWORK = -5,   // Network error
     ETHER_ERR_TIMEOUT = -6,   // Operation timeout
     ETHER_ERR_NOTFOUND= -7,   // Handle not found
+    ETHER_ERR_QUOTA   = -8,   // Client quota reached (bytes or handles)
+    ETHER_ERR_BUSY    = -9,   // Server memory watermark reached: retry later
 } ether_error_t;
 
 /**
@@ -56,7 +58,8 @@ const char* ether_strerror(ether_error_t err);
 /**
  * Allocate a memory block
  *
- * Memory is zero-initialized for security.
+ * Memory is zero-initialized for security (unless the default wipe
+ * policy says otherwise, see ether_set_wipe()).
  * Each block has a hidden header for metadata tracking.
  *
  * @param size  Size in bytes (must be > 0)
@@ -67,7 +70,7 @@ void* ether_alloc(size_t size);
 /**
  * Free a memory block
  *
- * Performs secure wipe before freeing.
+ * Performs secure wipe before freeing (per the block's wipe policy).
  * Safe to call with NULL pointer.
  *
  * @param ptr   Pointer to free (can be NULL)
@@ -80,12 +83,30 @@ void ether_free(void* ptr);
  * - realloc(NULL, size) = alloc(size)
  * - realloc(ptr, 0) = free(ptr), returns NULL
  *
+ * Shrinking and growing within the block's capacity happen in place.
+ * Growing past it reserves at least twice the old capacity, so a block
+ * grown step by step costs amortized O(1) per byte. Blocks with their own
+ * mapping (LAZY, huge pages) are extended with mremap() and never copied.
+ *
  * @param ptr       Existing pointer (can be NULL)
  * @param new_size  New size in bytes
  * @return          New pointer, NULL on failure (original unchanged)
  */
 void* ether_realloc(void* ptr, size_t new_size);
 
+/**
+ * Resize a memory block without moving it
+ *
+ * Like ether_realloc(), but fails instead of moving the block: for memory
+ * that is still referenced by address (e.g. I/O in flight).
+ *
+ * @param ptr       Pointer to block
+ * @param new_size  New size in bytes (must be > 0)
+ * @return          ETHER_OK, ETHER_ERR_NOMEM if the block would have to
+ *                  move, ETHER_ERR_INVALID or ETHER_ERR_CORRUPT
+ */
+int ether_resize(void* ptr, size_t new_size);
+
 /**
  * Write data to an allocated block
  *
@@ -114,10 +135,233 @@ int ether_read(void* ptr, void* buffer, size_t len);
  */
 size_t ether_size(void* ptr);
 
+// =============================================================================
+// ALLOCATOR BACKEND
+// =============================================================================
+
+typedef enum {
+    ETHER_BACKEND_MALLOC = 0,   // One malloc() per block (default)
+    ETHER_BACKEND_SLAB   = 1,   // Size classes carved from mmap'd arenas
+    ETHER_BACKEND_STORE  = 2,   // Chunks of the persistent store (ether_store_open())
+} ether_backend_t;
+
+/**
+ * Select the backend used by subsequent allocations
+ *
+ * Can be changed at any time: every block remembers which backend it
+ * came from, so ether_free()/ether_realloc() work across a switch.
+ * Blocks larger than ETHER_SLAB_MAX_BLOCK always use malloc().
+ *
+ * @param backend  Backend to use
+ * @return         ETHER_OK, or ETHER_ERR_INVALID for an unknown backend
+ *                 (or ETHER_BACKEND_STORE while no store is open)
+ */
+int ether_set_backend(ether_backend_t backend);
+
+/**
+ * Currently selected backend
+ */
+ether_backend_t ether_get_backend(void);
+
+#define ETHER_SLAB_MAX_BLOCK  (64 * 1024)   // Largest slab size class (incl. header)
+
+// =============================================================================
+// WIPE POLICY
+// =============================================================================
+
+/**
+ * How a block is cleared on allocation and on free
+ *
+ * Zeroing and wiping touch every byte of the block, which is pure memory
+ * bandwidth for large blocks that do not hold sensitive data.
+ */
+typedef enum {
+    ETHER_WIPE_FULL = 0,   // Zero on alloc, wipe on free (default)
+    ETHER_WIPE_FREE = 1,   // Wipe on free only, new blocks are not zeroed
+    ETHER_WIPE_LAZY = 2,   // Blocks >= ETHER_MMAP_THRESHOLD get fresh kernel-zeroed
+                           // pages and are unmapped on free; smaller ones as FULL
+    ETHER_WIPE_NONE = 3,   // Neither: contents of new blocks are unspecified
+} ether_wipe_t;
+
+#define ETHER_ALLOC_WIPE_MASK  0x03          // ether_wipe_t bits of ether_alloc_ex() flags
+#define ETHER_ALLOC_HUGE       0x04          // Huge pages on the caller's NUMA node
+#define ETHER_ALLOC_SHARED     0x08          // Data in a memfd another process can map
+#define ETHER_MMAP_THRESHOLD   (128 * 1024)  // Smallest block (incl. header) mmap'd by LAZY
+#define ETHER_HUGE_PAGE_SIZE   (2 * 1024 * 1024)
+
+/**
+ * Allocate a memory block with explicit flags
+ *
+ * With ETHER_ALLOC_HUGE (or at or above the huge-page threshold) the block
+ * gets its own mapping, rounded up to ETHER_HUGE_PAGE_SIZE: reserved
+ * hugetlb pages if the system has any, transparent huge pages otherwise.
+ * Its pages prefer the NUMA node of the allocating thread.
+ *
+ * With ETHER_ALLOC_SHARED the data lives in a memfd of its own, rounded up
+ * to the page size, mapped MAP_SHARED at the returned pointer (the header
+ * stays in private memory in front of it). ether_block_fd() returns the
+ * fd, so another process can map the same pages. Takes precedence over
+ * ETHER_ALLOC_HUGE and the huge-page threshold.
+ *
+ * @param size   Size in bytes (must be > 0)
+ * @param flags  Wipe policy (ether_wipe_t) in ETHER_ALLOC_WIPE_MASK,
+ *               optionally | ETHER_ALLOC_HUGE or ETHER_ALLOC_SHARED
+ * @return       Pointer to allocated memory, NULL on failure or unknown flags
+ */
+void* ether_alloc_ex(size_t size, unsigned flags);
+
+/**
+ * memfd behind a block allocated with ETHER_ALLOC_SHARED
+ *
+ * The block's data starts at offset 0 of the file, and the file is at
+ * least ether_size() bytes long. It is sealed against shrinking, so a
+ * process mapping it can never make the owner fault. The fd stays owned
+ * by the block: ether_free() punches out its pages and closes it, and
+ * ether_realloc() may replace it (dup() it to keep it past either).
+ *
+ * @param ptr  Block pointer
+ * @return     File descriptor, -1 if ptr is not a live shared block
+ */
+int ether_block_fd(void* ptr);
+
+/**
+ * Select the wipe policy used by ether_alloc()
+ *
+ * Every block remembers its own policy, so ether_free() and
+ * ether_realloc() honor the one it was allocated with.
+ *
+ * @param policy  Policy for subsequent ether_alloc() calls
+ * @return        ETHER_OK, or ETHER_ERR_INVALID for an unknown policy
+ */
+int ether_set_wipe(ether_wipe_t policy);
+
+/**
+ * Currently selected default wipe policy
+ */
+ether_wipe_t ether_get_wipe(void);
+
+/**
+ * Place every block of at least bytes (incl. header) as if it had been
+ * allocated with ETHER_ALLOC_HUGE
+ *
+ * @param bytes  Threshold, 0 disables (the default)
+ */
+void ether_set_huge_threshold(size_t bytes);
+
+/**
+ * Current huge-page threshold, 0 if disabled
+ */
+size_t ether_get_huge_threshold(void);
+
+// =============================================================================
+// PERSISTENT STORE
+// =============================================================================
+
+/**
+ * Called by ether_store_recover() for each block found in the store
+ *
+ * @param ptr   Block pointer, valid and readable right away
+ * @param size  Block size
+ * @param tag   Tag given with ether_store_tag() (never 0)
+ * @param arg   As passed to ether_store_recover()
+ */
+typedef void (*ether_store_visit_t)(void* ptr, size_t size, uint64_t tag, void* arg);
+
+/**
+ * Open (or create) a persistent store and allocate out of it
+ *
+ * The store is one file, or a DAX/pmem device, mapped MAP_SHARED (with
+ * MAP_SYNC where supported): block data lives in the file itself, so it
+ * survives the process. An empty file, or a device whose first page is
+ * zero, is formatted; anything else must be a store written before.
+ * Opening walks the block headers, one per block, to find the live ones
+ * and rebuild the free space: it costs the same whatever the blocks hold.
+ *
+ * Selects ETHER_BACKEND_STORE until ether_store_close(). Shared and huge
+ * blocks still get their own memory and do not persist; the huge-page
+ * threshold is not applied to store allocations.
+ *
+ * Only tagged blocks (ether_store_tag()) are kept by the next open;
+ * untagged ones are reclaimed as free space.
+ *
+ * @param path  File or device
+ * @param size  Size of a new file (an existing file is never shrunk, and
+ *              grown to size if smaller); required for devices
+ * @return      ETHER_OK, ETHER_ERR_INVALID (path, size, already open),
+ *              ETHER_ERR_CORRUPT (not a store) or ETHER_ERR_NOMEM
+ */
+int ether_store_open(const char* path, size_t size);
+
+/**
+ * Visit every block of the store that survived from a previous run
+ *
+ * Meant to be called right after ether_store_open(), before other threads
+ * allocate. visit may free the block it is given.
+ *
+ * @param visit  Callback (can be NULL to just count)
+ * @param arg    Passed to visit
+ * @return       Number of blocks
+ */
+size_t ether_store_recover(ether_store_visit_t visit, void* arg);
+
+/**
+ * Record an identifier with a store block: it is what ether_store_recover()
+ * hands back after a restart (etherd uses the block's handle). Moved along
+ * by ether_realloc().
+ *
+ * @param ptr  Block pointer
+ * @param tag  Non-zero tag (0 makes the block temporary again)
+ * @return     ETHER_OK, or ETHER_ERR_INVALID if ptr is not a store block
+ */
+int ether_store_tag(void* ptr, uint64_t tag);
+
+/**
+ * Raise the store's high-water mark to at least mark (never lowered).
+ * The mark is kept in the superblock across runs, so the owner of the
+ * tags can remember how far identifiers of blocks already freed went:
+ * etherd records the highest handle generation it retired. Safe to call
+ * from several threads. No-op if no store is open.
+ *
+ * @param mark  Value to raise the mark to
+ */
+void ether_store_raise_mark(uint64_t mark);
+
+/**
+ * Current high-water mark (0 for a new store, or if no store is open)
+ */
+uint64_t ether_store_mark(void);
+
+/**
+ * Whether a store is open
+ */
+bool ether_store_is_open(void);
+
+/**
+ * Flush the store to the device (msync). A crashed process loses nothing
+ * without it; a crashed machine loses what was written since.
+ *
+ * @return  ETHER_OK, ETHER_ERR_INVALID if no store is open, ETHER_ERR_NOMEM on I/O error
+ */
+int ether_store_sync(void);
+
+/**
+ * Flush and unmap the store, marking it cleanly closed. Every store block
+ * pointer becomes invalid; the backend in use before ether_store_open()
+ * is selected again. No store blocks may be in use by other threads.
+ */
+void ether_store_close(void);
+
 // =============================================================================
 // STATISTICS
 // =============================================================================
 
+#define ETHER_STATS_SIZE_BUCKETS     40   // Bucket i: sizes in [2^i, 2^(i+1)) bytes
+#define ETHER_STATS_LATENCY_BUCKETS  32   // Bucket i: latencies in [2^i, 2^(i+1)) ns
+
+/**
+ * Histograms are log2-bucketed (bucket 0 also holds 0, the last bucket
+ * everything above its lower bound).
+ */
 typedef struct {
     size_t total_allocated;   // Total bytes ever allocated
     size_t total_freed;       // Total bytes ever freed
@@ -125,11 +369,20 @@ typedef struct {
     size_t peak_usage;        // Peak memory usage
     size_t num_allocs;        // Number of allocations
     size_t num_frees;         // Number of frees
+    size_t arena_mapped;      // Bytes mmap'd for slab arenas
+    size_t resident;          // Process RSS in bytes (sampled on read)
+
+    size_t alloc_sizes[ETHER_STATS_SIZE_BUCKETS];        // Allocations by requested size
+    size_t alloc_latency[ETHER_STATS_LATENCY_BUCKETS];   // ether_alloc*() duration
+    size_t free_latency[ETHER_STATS_LATENCY_BUCKETS];    // ether_free() duration
 } ether_stats_t;
 
 /**
  * Get allocator statistics
  *
+ * Every thread counts into its own counters; this sums them. peak_usage
+ * may lag the true peak by up to 64 KB per allocating thread.
+ *
  * @return  Copy of current statistics
  */
 ether_stats_t ether_get_stats(void);
@@ -139,6 +392,14 @@ ether_stats_t ether_get_stats(void);
  */
 void ether_reset_stats(void);
 
+/**
+ * Enable/disable timing of allocations and frees for the latency
+ * histograms (enabled by default; costs two clock reads per call)
+ *
+ * @param enabled   true to enable, false to disable
+ */
+void ether_set_latency_stats(bool enabled);
+
 // =============================================================================
 // DEBUG
 // =============================================================================
@@ -146,6 +407,9 @@ void ether_reset_stats(void);
 /**
  * Enable/disable debug output
  *
+ * Shorthand for ether_log_set_level(ETHER_LOG_DEBUG / ETHER_LOG_INFO),
+ * see ether/log.h.
+ *
  * @param enabled   true to enable, false to disable
  */
 void ether_set_debug(bool enabled);
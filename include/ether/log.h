@@ -0,0 +1,123 @@
+/**
+ * Ether - Logging
+ *
+ * Leveled logger shared by libether and etherd.
+ *
+ * A log call below the runtime level costs one relaxed load and a branch;
+ * calls below ETHER_LOG_COMPILE_LEVEL are removed by the compiler. Enabled
+ * messages are formatted by the calling thread into its own single-producer
+ * ring buffer and written out by a background thread, so the caller never
+ * blocks on stderr. When a ring is full the message is dropped and counted.
+ *
+ * Until ether_log_start() (and after ether_log_stop()) each message is
+ * written synchronously with a single write(2).
+ *
+ * Copyright (C) 2024 - Licensed under GPL-3.0
+ */
+
+#ifndef ETHER_LOG_H
+#define ETHER_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =============================================================================
+// LEVELS
+// =============================================================================
+
+typedef enum {
+    ETHER_LOG_DEBUG = 0,   // Per-request events
+    ETHER_LOG_INFO  = 1,   // Connections, lifecycle (default)
+    ETHER_LOG_WARN  = 2,   // Recoverable failures, protocol violations
+    ETHER_LOG_ERROR = 3,   // Failures of the server itself
+    ETHER_LOG_OFF   = 4,
+} ether_log_level_t;
+
+/**
+ * Lowest level compiled in. Build with e.g.
+ * -DETHER_LOG_COMPILE_LEVEL=ETHER_LOG_INFO to strip debug logging entirely.
+ */
+#ifndef ETHER_LOG_COMPILE_LEVEL
+#define ETHER_LOG_COMPILE_LEVEL ETHER_LOG_DEBUG
+#endif
+
+#define ETHER_LOG_MSG_MAX 224      // Longer messages are truncated
+
+// Runtime level; use ether_log_set_level() to change it
+extern int g_ether_log_level;
+
+/**
+ * Whether a message at this level would be logged
+ */
+static inline bool ether_log_enabled(ether_log_level_t level) {
+    return level >= ETHER_LOG_COMPILE_LEVEL &&
+           (int) level >= __atomic_load_n(&g_ether_log_level, __ATOMIC_RELAXED);
+}
+
+#define ETHER_LOG(level, tag, ...) \
+    do { \
+        if (ether_log_enabled(level)) ether_log_write(level, tag, __VA_ARGS__); \
+    } while (0)
+
+#define ether_log_debug(tag, ...) ETHER_LOG(ETHER_LOG_DEBUG, tag, __VA_ARGS__)
+#define ether_log_info(tag, ...)  ETHER_LOG(ETHER_LOG_INFO, tag, __VA_ARGS__)
+#define ether_log_warn(tag, ...)  ETHER_LOG(ETHER_LOG_WARN, tag, __VA_ARGS__)
+#define ether_log_error(tag, ...) ETHER_LOG(ETHER_LOG_ERROR, tag, __VA_ARGS__)
+
+// =============================================================================
+// API
+// =============================================================================
+
+/**
+ * Set the runtime level (default ETHER_LOG_INFO)
+ */
+void ether_log_set_level(ether_log_level_t level);
+
+/**
+ * Get the runtime level
+ */
+ether_log_level_t ether_log_get_level(void);
+
+/**
+ * Parse "debug", "info", "warn", "error" or "off"
+ *
+ * @return  Level, or -1 if the name is unknown
+ */
+int ether_log_parse_level(const char* name);
+
+/**
+ * Log one message (use the ETHER_LOG macros, which skip disabled levels)
+ *
+ * @param level  Message level
+ * @param tag    Subsystem, printed as "[tag]" (static string)
+ * @param fmt    printf-style format, no trailing newline
+ */
+void ether_log_write(ether_log_level_t level, const char* tag, const char* fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/**
+ * Start the background writer thread
+ *
+ * @return  0 on success (or already running), -1 on failure
+ */
+int ether_log_start(void);
+
+/**
+ * Write out everything queued and stop the background writer
+ */
+void ether_log_stop(void);
+
+/**
+ * Messages dropped because a ring buffer was full
+ */
+size_t ether_log_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ETHER_LOG_H
@@ -25,6 +25,58 @@ extern "C" {
 #define ETHER_DEFAULT_PORT  9999                 // Default server port
 #define ETHER_MAX_PAYLOAD   (16 * 1024 * 1024)   // 16 MB max payload
 
+// =============================================================================
+// HEADER FLAGS
+// =============================================================================
+
+/**
+ * WRITE/READ: the payload starts with an 8-byte block offset (network
+ * byte order). For WRITE, size = 8 + data length; for READ, size stays
+ * the number of bytes to read and the offset is the only payload.
+ */
+#define ETHER_FLAG_OFFSET   0x0001
+#define ETHER_OFFSET_SIZE   8
+
+/**
+ * WRITE/READ: more chunks of the same streamed transfer follow.
+ *
+ * A transfer larger than ETHER_STREAM_CHUNK is sent as consecutive ranged
+ * messages sharing one request ID, all but the last flagged MORE.
+ * WRITE chunks flagged MORE get no response; the last chunk is answered
+ * with OK only if every chunk succeeded. Each READ chunk is answered on
+ * its own, and the response echoes the MORE flag.
+ */
+#define ETHER_FLAG_MORE     0x0002
+#define ETHER_STREAM_CHUNK  (1024 * 1024)        // 1 MB per streamed chunk
+
+/**
+ * ALLOC: back the block with huge pages on the NUMA node of the worker
+ * that owns it, whatever its size (otherwise only blocks above the
+ * server's huge-page threshold are placed this way). A hint: the server
+ * falls back to regular pages when none are available.
+ */
+#define ETHER_FLAG_HUGE     0x0004
+
+/**
+ * PING/PONG: compression negotiation. A client offers compression by
+ * setting the flag on PING; the server echoes it on PONG if it accepts,
+ * and from then on both sides may compress payloads on this connection
+ * (a PING without the flag turns it off again).
+ *
+ * WRITE / READ response: the data (after a WRITE's offset prefix) is a
+ * compressed payload, see ether/compress.h. header.size counts the bytes
+ * on the wire; a READ request's size still counts raw bytes. Only data of
+ * at least ETHER_COMPRESS_MIN bytes that shrinks is sent compressed.
+ */
+#define ETHER_FLAG_COMPRESSED  0x0008
+#define ETHER_COMPRESS_MIN     4096
+
+/**
+ * ALLOC: keep the block's data in a memfd the client can map (see
+ * ETHER_CMD_SHARE). Only accepted on Unix domain socket connections.
+ */
+#define ETHER_FLAG_SHARED      0x0010
+
 // =============================================================================
 // COMMANDS
 // =============================================================================
@@ -38,10 +90,22 @@ typedef enum {
     ETHER_CMD_ALLOC     = 0x10,   // Allocate memory
     ETHER_CMD_FREE      = 0x11,   // Free memory
     ETHER_CMD_REALLOC   = 0x12,   // Reallocate memory
+    ETHER_CMD_SHARE     = 0x13,   // Pass a shared block's memfd (SCM_RIGHTS)
 
     // Data operations
     ETHER_CMD_WRITE     = 0x20,   // Write to block
     ETHER_CMD_READ      = 0x21,   // Read from block
+    ETHER_CMD_COPY      = 0x22,   // Copy a range between blocks
+    ETHER_CMD_FILL      = 0x23,   // Fill a range with a pattern
+    ETHER_CMD_CMP       = 0x24,   // Compare ranges of two blocks
+    ETHER_CMD_CHECKSUM  = 0x25,   // Checksum a range
+
+    // Batching
+    ETHER_CMD_BATCH     = 0x50,   // Several sub-operations in one message
+
+    // Introspection
+    ETHER_CMD_STATS     = 0x60,   // Per-command server metrics
+    ETHER_CMD_MEMINFO   = 0x61,   // Server memory usage and headroom
 
     // Responses
     ETHER_CMD_OK        = 0xF0,   // Success response
@@ -62,23 +126,163 @@ typedef enum {
  * 0       4     magic      - 0xE7E7E7E7
  * 4       1     version    - Protocol version (1)
  * 5       1     command    - Command type (ether_cmd_t)
- * 6       2     flags      - Reserved flags
+ * 6       2     flags      - ETHER_FLAG_* bits
  * 8       8     handle     - Block handle (64-bit)
  * 16      4     size       - Payload size
- * 20      4     reserved   - Future use
+ * 20      4     reserved   - Request ID, echoed in the response
  */
 typedef struct __attribute__((packed)) {
     uint32_t magic;       // ETHER_MAGIC
     uint8_t  version;     // Protocol version
     uint8_t  command;     // ether_cmd_t
-    uint16_t flags;       // Reserved
+    uint16_t flags;       // ETHER_FLAG_* bits
     uint64_t handle;      // Block handle
     uint32_t size;        // Payload size
-    uint32_t reserved;    // Padding/future use
+    uint32_t reserved;    // Request ID (echoed back by the server)
 } ether_msg_header_t;
 
 #define ETHER_HEADER_SIZE sizeof(ether_msg_header_t)
 
+/**
+ * SHARE response: OK with an 8-byte payload, the length of the memfd
+ * (network byte order), and the fd itself as SCM_RIGHTS ancillary data on
+ * the response's first byte. The block's data starts at file offset 0.
+ */
+#define ETHER_SHARE_SIZE  8
+
+// =============================================================================
+// BATCH
+// =============================================================================
+
+/**
+ * BATCH payload: a sequence of sub-operations, each a 16-byte record
+ * optionally followed by an 8-byte block offset (WRITE/READ with
+ * ETHER_BATCH_OFFSET) and data (WRITE only). header.handle = op count.
+ *
+ * Offset  Size  Field
+ * ------  ----  -----
+ * 0       1     command    - ALLOC, FREE, WRITE or READ
+ * 1       1     flags      - ETHER_BATCH_REF, ETHER_BATCH_OFFSET, ETHER_BATCH_HUGE
+ * 2       2     reserved
+ * 4       4     size       - Alloc size / write length / read length
+ * 8       8     handle     - Target handle, or op index if ETHER_BATCH_REF
+ *
+ * The response (OK, header.handle = op count) carries one 16-byte result
+ * per op, in order, each followed by the data of a successful READ.
+ *
+ * Offset  Size  Field
+ * ------  ----  -----
+ * 0       1     status     - ETHER_CMD_OK or ETHER_CMD_ERROR
+ * 1       3     reserved
+ * 4       4     size       - Bytes of READ data that follow (else 0)
+ * 8       8     handle     - Resulting handle (ALLOC) or target handle
+ */
+#define ETHER_BATCH_RECORD_SIZE  16
+
+#define ETHER_BATCH_REF     0x01   // handle = index of an earlier op in the batch
+#define ETHER_BATCH_OFFSET  0x02   // WRITE/READ: 8-byte offset follows the record
+#define ETHER_BATCH_HUGE    0x04   // ALLOC: same as ETHER_FLAG_HUGE
+
+typedef struct {
+    uint8_t  command;     // Sub-operation (or status, in a result)
+    uint8_t  flags;       // ETHER_BATCH_REF, ETHER_BATCH_OFFSET, ETHER_BATCH_HUGE
+    uint32_t size;        // Size parameter / data length
+    uint64_t handle;      // Handle or op index
+} ether_batch_record_t;
+
+// =============================================================================
+// STATS
+// =============================================================================
+
+/**
+ * STATS response (OK, header.handle = record count): one 64-byte record
+ * per command, all counters since the server started.
+ *
+ * Offset  Size  Field
+ * ------  ----  -----
+ * 0       1     command    - Command covered (0 = unknown commands)
+ * 1       7     reserved
+ * 8       8     count      - Requests handled
+ * 16      8     errors     - Requests answered with ERROR
+ * 24      8     bytes_in   - Request payload bytes
+ * 32      8     bytes_out  - Response payload bytes
+ * 40      8     p50_ns     - Latency percentiles, header received ->
+ * 48      8     p99_ns       response queued, in nanoseconds
+ * 56      8     p999_ns
+ */
+#define ETHER_STATS_RECORD_SIZE  64
+
+typedef struct {
+    uint8_t  command;
+    uint64_t count;
+    uint64_t errors;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+} ether_stats_record_t;
+
+// =============================================================================
+// MEMINFO
+// =============================================================================
+
+/**
+ * MEMINFO response (OK): one 32-byte record, sampled when the request
+ * is handled. Clients spreading blocks over several servers place them
+ * by available.
+ *
+ * Offset  Size  Field
+ * ------  ----  -----
+ * 0       8     used       - Bytes in live blocks
+ * 8       8     peak       - Highest used since the server started
+ * 16      8     available  - Host memory available for new blocks
+ * 24      8     blocks     - Live blocks
+ */
+#define ETHER_MEMINFO_RECORD_SIZE  32
+
+typedef struct {
+    uint64_t used;
+    uint64_t peak;
+    uint64_t available;
+    uint64_t blocks;
+} ether_meminfo_record_t;
+
+// =============================================================================
+// BULK OPERATIONS
+// =============================================================================
+
+/**
+ * COPY, FILL, CMP and CHECKSUM payload: a 32-byte range record, run by
+ * the server without the data crossing the network. header.handle is the
+ * target block (destination of COPY / FILL, first block of CMP).
+ *
+ * Offset  Size  Field
+ * ------  ----  -----
+ * 0       8     offset     - Range start in the target block
+ * 8       8     length     - Range length in bytes
+ * 16      8     handle     - COPY: source block, CMP: second block (else 0)
+ * 24      8     offset2    - Range start in that block (else 0)
+ *
+ * FILL appends the pattern (1..ETHER_FILL_PATTERN_MAX bytes), repeated
+ * over the range. COPY ranges may overlap (same block).
+ *
+ * Responses are OK / ERROR with header.handle = target. OK to CMP and
+ * CHECKSUM carries one 8-byte value (network byte order):
+ *   CMP       0 if equal, else +/-(1 + offset of the first differing
+ *             byte) as a two's complement int64, sign as memcmp()
+ *   CHECKSUM  ether_checksum() of the range
+ */
+#define ETHER_BULK_RECORD_SIZE   32
+#define ETHER_FILL_PATTERN_MAX   256
+
+typedef struct {
+    uint64_t offset;      // Target range start
+    uint64_t length;      // Range length
+    uint64_t handle;      // Second block (COPY source, CMP operand)
+    uint64_t offset2;     // Range start in the second block
+} ether_bulk_record_t;
+
 /**
  * Complete message (header + variable payload)
  */
@@ -87,6 +291,34 @@ typedef struct {
     uint8_t payload[];   // Flexible array member
 } ether_msg_t;
 
+// =============================================================================
+// BUFFER POOL
+// =============================================================================
+
+/**
+ * Recycles payload buffers so that steady-state request handling does not
+ * go to the heap. Buffers are grouped in power-of-two classes from
+ * ETHER_POOL_MIN_BUFFER to ETHER_POOL_MAX_BUFFER; each class keeps up to
+ * ETHER_POOL_DEPTH released buffers. Larger requests are plain malloc/free.
+ *
+ * A pool is not thread-safe: use one per thread (etherd: per worker) or
+ * per connection (client). Headers never need a pool: serialize them into
+ * a uint8_t[ETHER_HEADER_SIZE] on the stack.
+ */
+#define ETHER_POOL_MIN_SHIFT  6                          // 64 B
+#define ETHER_POOL_MAX_SHIFT  20                         // 1 MB
+#define ETHER_POOL_MIN_BUFFER ((size_t) 1 << ETHER_POOL_MIN_SHIFT)
+#define ETHER_POOL_MAX_BUFFER ((size_t) 1 << ETHER_POOL_MAX_SHIFT)
+#define ETHER_POOL_CLASSES    (ETHER_POOL_MAX_SHIFT - ETHER_POOL_MIN_SHIFT + 1)
+#define ETHER_POOL_DEPTH      4
+
+typedef struct {
+    void*    free[ETHER_POOL_CLASSES][ETHER_POOL_DEPTH];
+    uint8_t  count[ETHER_POOL_CLASSES];
+    uint64_t hits;        // Gets served from the pool
+    uint64_t misses;      // Gets that went to malloc
+} ether_buf_pool_t;
+
 // =============================================================================
 // API
 // =============================================================================
@@ -115,6 +347,19 @@ void ether_msg_free(ether_msg_t* msg);
  */
 int ether_msg_validate(const ether_msg_header_t* header);
 
+/**
+ * Number of payload bytes that follow a header on the wire
+ *
+ * For ALLOC, REALLOC and READ requests the size field is a parameter
+ * (bytes to allocate / read) and no payload follows, except the offset
+ * of a READ with ETHER_FLAG_OFFSET; for every other message it is the
+ * payload length.
+ *
+ * @param header  Message header
+ * @return        Payload bytes to receive after the header
+ */
+size_t ether_msg_payload_size(const ether_msg_header_t* header);
+
 /**
  * Get total message size (header + payload)
  *
@@ -139,6 +384,124 @@ void ether_msg_serialize_header(const ether_msg_header_t* header, uint8_t* buffe
  */
 void ether_msg_deserialize_header(const uint8_t* buffer, ether_msg_header_t* header);
 
+/**
+ * Encode / decode the 8-byte offset prefix of ETHER_FLAG_OFFSET messages
+ *
+ * @param offset  Block offset
+ * @param buffer  ETHER_OFFSET_SIZE bytes
+ */
+void ether_msg_serialize_offset(uint64_t offset, uint8_t* buffer);
+uint64_t ether_msg_deserialize_offset(const uint8_t* buffer);
+
+/**
+ * Serialize a batch op / result record to network byte order
+ *
+ * @param record  Record to serialize
+ * @param buffer  Output buffer (must be ETHER_BATCH_RECORD_SIZE bytes)
+ */
+void ether_batch_record_serialize(const ether_batch_record_t* record, uint8_t* buffer);
+
+/**
+ * Deserialize a batch op / result record from network byte order
+ *
+ * @param buffer  Input buffer (ETHER_BATCH_RECORD_SIZE bytes)
+ * @param record  Output record
+ */
+void ether_batch_record_deserialize(const uint8_t* buffer, ether_batch_record_t* record);
+
+/**
+ * Serialize a STATS record to network byte order
+ *
+ * @param record  Record to serialize
+ * @param buffer  Output buffer (must be ETHER_STATS_RECORD_SIZE bytes)
+ */
+void ether_stats_record_serialize(const ether_stats_record_t* record, uint8_t* buffer);
+
+/**
+ * Deserialize a STATS record from network byte order
+ *
+ * @param buffer  Input buffer (ETHER_STATS_RECORD_SIZE bytes)
+ * @param record  Output record
+ */
+void ether_stats_record_deserialize(const uint8_t* buffer, ether_stats_record_t* record);
+
+/**
+ * Serialize a MEMINFO record to network byte order
+ *
+ * @param record  Record to serialize
+ * @param buffer  Output buffer (must be ETHER_MEMINFO_RECORD_SIZE bytes)
+ */
+void ether_meminfo_record_serialize(const ether_meminfo_record_t* record, uint8_t* buffer);
+
+/**
+ * Deserialize a MEMINFO record from network byte order
+ *
+ * @param buffer  Input buffer (ETHER_MEMINFO_RECORD_SIZE bytes)
+ * @param record  Output record
+ */
+void ether_meminfo_record_deserialize(const uint8_t* buffer, ether_meminfo_record_t* record);
+
+/**
+ * Serialize a bulk operation record to network byte order
+ *
+ * @param record  Record to serialize
+ * @param buffer  Output buffer (must be ETHER_BULK_RECORD_SIZE bytes)
+ */
+void ether_bulk_record_serialize(const ether_bulk_record_t* record, uint8_t* buffer);
+
+/**
+ * Deserialize a bulk operation record from network byte order
+ *
+ * @param buffer  Input buffer (ETHER_BULK_RECORD_SIZE bytes)
+ * @param record  Output record
+ */
+void ether_bulk_record_deserialize(const uint8_t* buffer, ether_bulk_record_t* record);
+
+/**
+ * 64-bit checksum of a byte range, as returned by CHECKSUM
+ *
+ * Not cryptographic: meant to tell whether a remote range matches a
+ * local copy without reading it back.
+ *
+ * @param data  Bytes to hash (can be NULL if len is 0)
+ * @param len   Byte count
+ * @return      Checksum
+ */
+uint64_t ether_checksum(const void* data, size_t len);
+
+/**
+ * Initialize an empty buffer pool
+ */
+void ether_buf_pool_init(ether_buf_pool_t* pool);
+
+/**
+ * Free every buffer held by a pool
+ */
+void ether_buf_pool_destroy(ether_buf_pool_t* pool);
+
+/**
+ * Usable size of a buffer obtained for size bytes
+ */
+size_t ether_buf_capacity(size_t size);
+
+/**
+ * Get a buffer of at least size bytes (contents undefined)
+ *
+ * @param pool  Buffer pool (NULL: plain malloc)
+ * @param size  Bytes needed
+ * @return      Buffer of ether_buf_capacity(size) bytes, NULL on failure
+ */
+void* ether_buf_get(ether_buf_pool_t* pool, size_t size);
+
+/**
+ * Return a buffer to its pool
+ *
+ * @param pool  Pool it was obtained from (NULL: plain free)
+ * @param buf   Buffer (can be NULL)
+ * @param size  Size it was requested with
+ */
+void ether_buf_put(ether_buf_pool_t* pool, void* buf, size_t size);
+
 /**
  * Get command name as string (for debugging)
  *
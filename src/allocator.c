@@ -7,14 +7,41 @@
  *   [block_header_t][user_data...]
  *                   ^-- pointer returned to user
  *
+ * Backends:
+ *   malloc - one malloc() per block
+ *   slab   - blocks up to ETHER_SLAB_MAX_BLOCK come from size classes
+ *            carved out of large mmap'd arenas, with a free list per class
+ *
+ *   store  - chunks of a persistent file opened by ether_store_open()
+ *
+ * Large blocks under ETHER_WIPE_LAZY, and huge-page blocks, bypass all
+ * three and get their own mmap. Shared blocks keep their data in a memfd:
+ *
+ *   [ ...page 0 (private)... |block_header_t][memfd, MAP_SHARED...]
+ *                                            ^-- pointer returned to user
+ *
  * Copyright (C) 2024 - Licensed under GPL-3.0
  */
 
+#define _GNU_SOURCE
 #include "ether/ether.h"
+#include "ether/log.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include <stdarg.h>
+#include <stdatomic.h>
+#include <time.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 // =============================================================================
 // INTERNAL STRUCTURES
@@ -26,6 +53,17 @@
 // Block flags
 #define FLAG_ALLOCATED  0x01
 #define FLAG_ENCRYPTED  0x02    // Reserved for future encryption support
+#define FLAG_SLAB       0x04    // Block lives in a slab arena, not the malloc heap
+#define FLAG_MMAP       0x08    // Block is its own mapping (LAZY), munmap'd on free
+#define FLAG_DIRTY      0x40    // Freed slab/store block that was not wiped (NONE/FREE policy)
+#define FLAG_HUGE       0x80    // Mapping is huge-page backed (always with FLAG_MMAP)
+#define FLAG_SHARED     0x100   // Data is a memfd mapping, fd in front of the header
+#define FLAG_STORE      0x200   // Block is a chunk of the persistent store
+
+// Bits 4-5: the block's ether_wipe_t
+#define FLAG_WIPE_SHIFT 4
+#define FLAG_WIPE(policy) ((uint32_t) (policy) << FLAG_WIPE_SHIFT)
+#define BLOCK_WIPE(header) ((ether_wipe_t) (((header)->flags >> FLAG_WIPE_SHIFT) & ETHER_ALLOC_WIPE_MASK))
 
 /**
  * Header preceding each allocated block in memory.
@@ -44,8 +82,10 @@ typedef struct block_header {
 // GLOBAL STATE
 // =============================================================================
 
-static ether_stats_t g_stats = {0};
-static bool g_debug = false;
+static atomic_int g_backend = ETHER_BACKEND_MALLOC;
+static atomic_int g_wipe = ETHER_WIPE_FULL;
+static atomic_size_t g_huge_threshold = 0;
+static atomic_bool g_latency = true;
 
 // =============================================================================
 // HELPER FUNCTIONS
@@ -83,18 +123,952 @@ static inline int is_valid_block(block_header_t* header) {
            (header->flags & FLAG_ALLOCATED);
 }
 
+// =============================================================================
+// STATISTICS
+// =============================================================================
+
+/**
+ * Every thread counts into its own cache-line-aligned block, so allocs and
+ * frees on different etherd workers never share a line. Counters are only
+ * written by their owner (relaxed load + store, no locked RMW); readers
+ * sum every registered block. A thread that exits folds its counts into
+ * g_retired.
+ *
+ * Peak usage cannot be derived from the sums after the fact, so each
+ * thread also folds its net usage change into the shared g_usage once it
+ * exceeds STATS_FLUSH bytes and the peak is tracked from that. Peak is
+ * therefore exact to within STATS_FLUSH per thread.
+ *
+ * Reset does not touch the per-thread blocks (their owners may be writing
+ * them): it snapshots the sums into g_baseline, which reads subtract.
+ */
+#define STATS_FLUSH  (64 * 1024)
+
+typedef struct thread_stats {
+    atomic_size_t total_allocated;
+    atomic_size_t total_freed;
+    atomic_size_t num_allocs;
+    atomic_size_t num_frees;
+    atomic_size_t alloc_sizes[ETHER_STATS_SIZE_BUCKETS];
+    atomic_size_t alloc_latency[ETHER_STATS_LATENCY_BUCKETS];
+    atomic_size_t free_latency[ETHER_STATS_LATENCY_BUCKETS];
+
+    long long            unflushed;   // Usage change not yet in g_usage (owner only)
+    bool                 shared;      // g_fallback_stats: use atomic RMW
+    struct thread_stats* next;        // Registry link (g_stats_lock)
+} __attribute__((aligned(64))) thread_stats_t;
+
+static pthread_mutex_t  g_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static thread_stats_t*  g_stats_threads;   // Registered live threads
+static ether_stats_t    g_retired;         // Counts of exited threads
+static ether_stats_t    g_baseline;        // Sums at the last reset
+static size_t           g_baseline_usage;  // Absolute usage at the last reset
+static atomic_llong     g_usage;           // Absolute usage, flushed in STATS_FLUSH steps
+static atomic_llong     g_peak;            // Highest g_usage since the last reset
+
+static pthread_key_t    g_stats_key;
+static pthread_once_t   g_stats_once = PTHREAD_ONCE_INIT;
+static _Thread_local thread_stats_t* t_stats;
+
+// Used when a thread's block cannot be allocated; shared, so RMW updates
+static thread_stats_t   g_fallback_stats = { .shared = true };
+
+static inline void counter_add(thread_stats_t* ts, atomic_size_t* counter, size_t n) {
+    if (ts->shared) {
+        atomic_fetch_add_explicit(counter, n, memory_order_relaxed);
+    } else {
+        atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n,
+                              memory_order_relaxed);
+    }
+}
+
+static inline size_t counter_load(const atomic_size_t* counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+/**
+ * Add one thread's counters to a snapshot (registry lock held)
+ */
+static void stats_accumulate(ether_stats_t* out, thread_stats_t* ts) {
+    out->total_allocated += counter_load(&ts->total_allocated);
+    out->total_freed += counter_load(&ts->total_freed);
+    out->num_allocs += counter_load(&ts->num_allocs);
+    out->num_frees += counter_load(&ts->num_frees);
+    for (int i = 0; i < ETHER_STATS_SIZE_BUCKETS; i++) {
+        out->alloc_sizes[i] += counter_load(&ts->alloc_sizes[i]);
+    }
+    for (int i = 0; i < ETHER_STATS_LATENCY_BUCKETS; i++) {
+        out->alloc_latency[i] += counter_load(&ts->alloc_latency[i]);
+        out->free_latency[i] += counter_load(&ts->free_latency[i]);
+    }
+}
+
+static void stats_flush_usage(thread_stats_t* ts) {
+    long long usage = atomic_fetch_add_explicit(&g_usage, ts->unflushed, memory_order_relaxed) +
+                      ts->unflushed;
+    ts->unflushed = 0;
+
+    long long peak = atomic_load_explicit(&g_peak, memory_order_relaxed);
+    while (usage > peak &&
+           !atomic_compare_exchange_weak_explicit(&g_peak, &peak, usage,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+        // peak reloaded by the failed CAS
+    }
+}
+
+/**
+ * Thread exit: fold the block into g_retired and drop it
+ */
+static void stats_thread_exit(void* arg) {
+    thread_stats_t* ts = arg;
+
+    pthread_mutex_lock(&g_stats_lock);
+    for (thread_stats_t** link = &g_stats_threads; *link; link = &(*link)->next) {
+        if (*link == ts) {
+            *link = ts->next;
+            break;
+        }
+    }
+    stats_accumulate(&g_retired, ts);
+    stats_flush_usage(ts);
+    pthread_mutex_unlock(&g_stats_lock);
+
+    t_stats = NULL;
+    free(ts);
+}
+
+static void stats_key_init(void) {
+    pthread_key_create(&g_stats_key, stats_thread_exit);
+}
+
+static thread_stats_t* thread_stats(void) {
+    thread_stats_t* ts = t_stats;
+    if (ts) {
+        return ts;
+    }
+
+    pthread_once(&g_stats_once, stats_key_init);
+    ts = aligned_alloc(64, sizeof(thread_stats_t));
+    if (!ts) {
+        return &g_fallback_stats;
+    }
+    memset(ts, 0, sizeof(*ts));
+
+    pthread_mutex_lock(&g_stats_lock);
+    ts->next = g_stats_threads;
+    g_stats_threads = ts;
+    pthread_mutex_unlock(&g_stats_lock);
+
+    pthread_setspecific(g_stats_key, ts);
+    t_stats = ts;
+    return ts;
+}
+
+/**
+ * Histogram bucket of v: floor(log2(v)), bucket 0 also holding 0
+ */
+static inline unsigned log2_bucket(uint64_t v, unsigned buckets) {
+    unsigned b = 63 - (unsigned) __builtin_clzll(v | 1);
+    return b < buckets ? b : buckets - 1;
+}
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * Start timestamp for the latency histograms, 0 if they are disabled
+ */
+static inline uint64_t stats_clock(void) {
+    return atomic_load_explicit(&g_latency, memory_order_relaxed) ? now_ns() : 0;
+}
+
+static void stats_on_usage(thread_stats_t* ts, long long delta) {
+    ts->unflushed += delta;
+    if (ts->shared || ts->unflushed >= STATS_FLUSH || ts->unflushed <= -STATS_FLUSH) {
+        if (ts->shared) pthread_mutex_lock(&g_stats_lock);
+        stats_flush_usage(ts);
+        if (ts->shared) pthread_mutex_unlock(&g_stats_lock);
+    }
+}
+
+static void stats_on_alloc(size_t size, uint64_t start) {
+    thread_stats_t* ts = thread_stats();
+
+    counter_add(ts, &ts->total_allocated, size);
+    counter_add(ts, &ts->num_allocs, 1);
+    counter_add(ts, &ts->alloc_sizes[log2_bucket(size, ETHER_STATS_SIZE_BUCKETS)], 1);
+    if (start) {
+        unsigned b = log2_bucket(now_ns() - start, ETHER_STATS_LATENCY_BUCKETS);
+        counter_add(ts, &ts->alloc_latency[b], 1);
+    }
+    stats_on_usage(ts, (long long) size);
+}
+
+static void stats_on_free(size_t size, uint64_t start) {
+    thread_stats_t* ts = thread_stats();
+
+    counter_add(ts, &ts->total_freed, size);
+    counter_add(ts, &ts->num_frees, 1);
+    if (start) {
+        unsigned b = log2_bucket(now_ns() - start, ETHER_STATS_LATENCY_BUCKETS);
+        counter_add(ts, &ts->free_latency[b], 1);
+    }
+    stats_on_usage(ts, -(long long) size);
+}
+
+/**
+ * A block changed size without being reallocated: count the difference
+ * as allocated or freed bytes, so usage stays total_allocated - total_freed
+ */
+static void stats_on_resize(size_t old_size, size_t new_size) {
+    thread_stats_t* ts = thread_stats();
+
+    if (new_size > old_size) {
+        counter_add(ts, &ts->total_allocated, new_size - old_size);
+    } else {
+        counter_add(ts, &ts->total_freed, old_size - new_size);
+    }
+    stats_on_usage(ts, (long long) new_size - (long long) old_size);
+}
+
+/**
+ * Zero on alloc / wipe on free, per policy. LAZY mappings need neither,
+ * LAZY blocks too small to be mapped behave like FULL.
+ */
+static inline int policy_zeroes(ether_wipe_t policy) {
+    return policy == ETHER_WIPE_FULL || policy == ETHER_WIPE_LAZY;
+}
+
+static inline int block_wipes(const block_header_t* header) {
+    ether_wipe_t policy = BLOCK_WIPE(header);
+    if (header->flags & FLAG_SHARED) {
+        return 0;   // Punched out of the memfd instead (shared_release)
+    }
+    if (policy == ETHER_WIPE_LAZY) {
+        return !(header->flags & FLAG_MMAP);
+    }
+    return policy == ETHER_WIPE_FULL || policy == ETHER_WIPE_FREE;
+}
+
+/**
+ * Below this a plain memset is faster: the block is likely cached anyway
+ */
+#define WIPE_STREAM_MIN  (256 * 1024)
+
+/**
+ * Zero memory in a way the compiler cannot drop as a dead store, even
+ * when free() follows. Large ranges use non-temporal stores so wiping a
+ * 100 MB block does not evict the data etherd is serving from the cache.
+ */
+static void secure_wipe(void* ptr, size_t len) {
+    uint8_t* p = ptr;
+
+#if defined(__SSE2__)
+    if (len >= WIPE_STREAM_MIN) {
+        size_t head = (16 - ((uintptr_t) p & 15)) & 15;
+        memset(p, 0, head);
+        p += head;
+        len -= head;
+
+        const __m128i zero = _mm_setzero_si128();
+        for (; len >= 64; p += 64, len -= 64) {
+            _mm_stream_si128((__m128i*) p, zero);
+            _mm_stream_si128((__m128i*) (p + 16), zero);
+            _mm_stream_si128((__m128i*) (p + 32), zero);
+            _mm_stream_si128((__m128i*) (p + 48), zero);
+        }
+        // Streaming stores are weakly ordered: drain them before the
+        // memory can be handed to anyone else
+        _mm_sfence();
+    }
+#endif
+
+    memset(p, 0, len);
+    __asm__ __volatile__("" : : "r"(ptr) : "memory");
+}
+
+static size_t page_size(void) {
+    static size_t cached;
+    if (!cached) {
+        cached = (size_t) sysconf(_SC_PAGESIZE);
+    }
+    return cached;
+}
+
+// =============================================================================
+// SLAB BACKEND
+// =============================================================================
+
+/**
+ * Size classes cover header + user data. Up to 128 bytes they are spaced
+ * 16 bytes apart, then every power-of-two range is split into 4 classes
+ * (160, 192, 224, 256, 320, ...), jemalloc style, so rounding wastes at
+ * most 25%.
+ *
+ * Each class carves blocks out of slabs (SLAB_SIZE), and slabs are
+ * carved out of arenas (ARENA_SIZE) that are mmap'd on demand and never
+ * returned to the system. Freed blocks go onto their class's free list;
+ * the link lives in the (already wiped) user area, so the header keeps
+ * its BLOCK_FREED magic and double frees are still caught.
+ *
+ *   arena (4 MB, mmap)
+ *   ┌──────────────┬──────────────┬─────
+ *   │ slab: 48 B   │ slab: 320 B  │ ...
+ *   │ [hdr|data].. │ [hdr|data].. │
+ *   └──────────────┴──────────────┴─────
+ */
+#define SLAB_MIN_BLOCK   32
+#define SLAB_NUM_CLASSES 43                 // 32 .. ETHER_SLAB_MAX_BLOCK
+#define SLAB_SIZE        (256 * 1024)
+#define ARENA_SIZE       (4 * 1024 * 1024)
+
+typedef struct {
+    pthread_mutex_t lock;
+    block_header_t* free_list;   // Freed blocks (linked through user data)
+    uint8_t*        bump;        // Next never-used block in current slab
+    uint8_t*        bump_end;    // End of current slab
+} slab_class_t;
+
+typedef struct {
+    slab_class_t    classes[SLAB_NUM_CLASSES];
+    pthread_mutex_t arena_lock;
+    uint8_t*        arena_pos;   // Next free byte in current arena
+    uint8_t*        arena_end;
+    atomic_size_t   mapped;      // Total bytes mmap'd for arenas
+} slab_state_t;
+
+static slab_state_t g_slab;
+static pthread_once_t g_slab_once = PTHREAD_ONCE_INIT;
+
+static void slab_init(void) {
+    for (int i = 0; i < SLAB_NUM_CLASSES; i++) {
+        pthread_mutex_init(&g_slab.classes[i].lock, NULL);
+    }
+    pthread_mutex_init(&g_slab.arena_lock, NULL);
+}
+
+/**
+ * Smallest class holding total bytes (total <= ETHER_SLAB_MAX_BLOCK)
+ */
+static inline unsigned slab_class_index(size_t total) {
+    if (total <= 128) {
+        return total <= SLAB_MIN_BLOCK ? 0 : (unsigned) ((total + 15) / 16) - 2;
+    }
+
+    // total in (2^lg, 2^(lg+1)]: four classes 2^lg + k * 2^(lg-2), k = 1..4
+    unsigned lg = 63 - (unsigned) __builtin_clzll((unsigned long long) (total - 1));
+    unsigned k = (unsigned) ((total - 1) >> (lg - 2)) - 3;
+    return 6 + (lg - 7) * 4 + k;
+}
+
+static inline size_t slab_class_size(unsigned index) {
+    if (index <= 6) {
+        return (size_t) (index + 2) * 16;
+    }
+
+    unsigned lg = 7 + (index - 7) / 4;
+    unsigned k = (index - 7) % 4 + 1;
+    return ((size_t) 1 << lg) + k * ((size_t) 1 << (lg - 2));
+}
+
+static inline block_header_t** slab_link(block_header_t* header) {
+    return (block_header_t**) get_user_ptr(header);
+}
+
+/**
+ * Hand a fresh slab to a class (class lock held)
+ */
+static int slab_refill(slab_class_t* cls) {
+    pthread_mutex_lock(&g_slab.arena_lock);
+
+    if (!g_slab.arena_pos || g_slab.arena_pos + SLAB_SIZE > g_slab.arena_end) {
+        // MAP_NORESERVE: pages only become resident once a block is touched
+        void* arena = mmap(NULL, ARENA_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (arena == MAP_FAILED) {
+            pthread_mutex_unlock(&g_slab.arena_lock);
+            return -1;
+        }
+        g_slab.arena_pos = arena;
+        g_slab.arena_end = (uint8_t*) arena + ARENA_SIZE;
+        atomic_fetch_add_explicit(&g_slab.mapped, ARENA_SIZE, memory_order_relaxed);
+        ether_log_debug("ether", "slab: mapped arena %p (%d bytes)", arena, ARENA_SIZE);
+    }
+
+    cls->bump = g_slab.arena_pos;
+    cls->bump_end = g_slab.arena_pos + SLAB_SIZE;
+    g_slab.arena_pos += SLAB_SIZE;
+
+    pthread_mutex_unlock(&g_slab.arena_lock);
+    return 0;
+}
+
+/**
+ * Take a block of at least total bytes, capacity already set. It is zero
+ * unless FLAG_DIRTY is left in its flags (freed without a wipe).
+ */
+static block_header_t* slab_alloc(size_t total) {
+    pthread_once(&g_slab_once, slab_init);
+
+    unsigned index = slab_class_index(total);
+    size_t block_size = slab_class_size(index);
+    slab_class_t* cls = &g_slab.classes[index];
+
+    pthread_mutex_lock(&cls->lock);
+
+    block_header_t* header = cls->free_list;
+    if (header) {
+        cls->free_list = *slab_link(header);
+    } else {
+        if ((!cls->bump || cls->bump + block_size > cls->bump_end) && slab_refill(cls) != 0) {
+            pthread_mutex_unlock(&cls->lock);
+            return NULL;
+        }
+        header = (block_header_t*) cls->bump;
+        cls->bump += block_size;
+    }
+
+    pthread_mutex_unlock(&cls->lock);
+
+    // Wiped blocks only have the free-list link left in them
+    *slab_link(header) = NULL;
+    header->capacity = block_size - HEADER_SIZE;
+    return header;
+}
+
 /**
- * Debug print helper
+ * Return a block to its class free list (wiped, or marked FLAG_DIRTY)
  */
-static void debug_print(const char* fmt, ...) {
-    if (!g_debug) return;
+static void slab_free(block_header_t* header) {
+    slab_class_t* cls = &g_slab.classes[slab_class_index(header->capacity + HEADER_SIZE)];
 
-    va_list args;
-    va_start(args, fmt);
-    fprintf(stderr, "[ETHER] ");
-    vfprintf(stderr, fmt, args);
-    fprintf(stderr, "\n");
-    va_end(args);
+    pthread_mutex_lock(&cls->lock);
+    *slab_link(header) = cls->free_list;
+    cls->free_list = header;
+    pthread_mutex_unlock(&cls->lock);
+}
+
+int ether_set_backend(ether_backend_t backend) {
+    if (backend != ETHER_BACKEND_MALLOC && backend != ETHER_BACKEND_SLAB &&
+        (backend != ETHER_BACKEND_STORE || !ether_store_is_open())) {
+        return ETHER_ERR_INVALID;
+    }
+
+    atomic_store(&g_backend, (int) backend);
+    return ETHER_OK;
+}
+
+ether_backend_t ether_get_backend(void) {
+    return (ether_backend_t) atomic_load(&g_backend);
+}
+
+int ether_set_wipe(ether_wipe_t policy) {
+    if ((unsigned) policy > ETHER_WIPE_NONE) {
+        return ETHER_ERR_INVALID;
+    }
+
+    atomic_store(&g_wipe, (int) policy);
+    return ETHER_OK;
+}
+
+ether_wipe_t ether_get_wipe(void) {
+    return (ether_wipe_t) atomic_load(&g_wipe);
+}
+
+void ether_set_huge_threshold(size_t bytes) {
+    atomic_store(&g_huge_threshold, bytes);
+}
+
+size_t ether_get_huge_threshold(void) {
+    return atomic_load(&g_huge_threshold);
+}
+
+/**
+ * Map a block of its own; the kernel hands out zeroed pages, and munmap
+ * returns them without anyone having to wipe them (LAZY policy)
+ */
+static block_header_t* mmap_alloc(size_t total) {
+    size_t mapped = (total + page_size() - 1) & ~(page_size() - 1);
+    void* base = mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    block_header_t* header = base;
+    header->capacity = mapped - HEADER_SIZE;
+    return header;
+}
+
+/**
+ * Make the pages of a fresh mapping prefer the calling thread's NUMA node.
+ * In etherd that is the worker that owns the handle and serves its I/O.
+ * MPOL_PREFERRED rather than MPOL_BIND: a full node spills over instead
+ * of failing the allocation. Best effort, a no-op on single-node machines.
+ */
+static void prefer_local_node(void* addr, size_t len) {
+    unsigned cpu, node;
+    if (getcpu(&cpu, &node) != 0 || node >= sizeof(unsigned long) * 8) {
+        return;
+    }
+
+    unsigned long mask = 1UL << node;
+    syscall(SYS_mbind, addr, len, MPOL_PREFERRED, &mask, sizeof(mask) * 8, 0);
+}
+
+/**
+ * Map a block of its own backed by huge pages: hugetlb pages if some are
+ * reserved, else a ETHER_HUGE_PAGE_SIZE-aligned range advised for THP.
+ * Fewer TLB misses for the big memcpys of READ/WRITE.
+ */
+static block_header_t* huge_alloc(size_t total) {
+    size_t mapped = (total + ETHER_HUGE_PAGE_SIZE - 1) & ~((size_t) ETHER_HUGE_PAGE_SIZE - 1);
+    if (mapped < total) {
+        return NULL;
+    }
+
+    // No MAP_NORESERVE: run out of hugetlb pages here, not with a SIGBUS later
+    void* base = mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (base == MAP_FAILED) {
+        // Over-map, then trim to an aligned range THP can back entirely
+        size_t span = mapped + ETHER_HUGE_PAGE_SIZE;
+        uint8_t* raw = mmap(NULL, span, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (raw == MAP_FAILED) {
+            return NULL;
+        }
+
+        uint8_t* aligned = (uint8_t*) (((uintptr_t) raw + ETHER_HUGE_PAGE_SIZE - 1) &
+                                       ~((uintptr_t) ETHER_HUGE_PAGE_SIZE - 1));
+        if (aligned > raw) {
+            munmap(raw, (size_t) (aligned - raw));
+        }
+        if (raw + span > aligned + mapped) {
+            munmap(aligned + mapped, (size_t) (raw + span - (aligned + mapped)));
+        }
+
+        base = aligned;
+        madvise(base, mapped, MADV_HUGEPAGE);
+    }
+
+    prefer_local_node(base, mapped);
+    ether_log_debug("ether", "huge: mapped %p (%zu bytes)", base, mapped);
+
+    block_header_t* header = base;
+    header->capacity = mapped - HEADER_SIZE;
+    return header;
+}
+
+/**
+ * Where a shared block keeps its memfd: the start of the private page
+ * that ends with the header
+ */
+static inline int* shared_fd_slot(block_header_t* header) {
+    return (int*) ((uint8_t*) header + HEADER_SIZE - page_size());
+}
+
+/**
+ * Create a block whose data is a memfd mapped MAP_SHARED, preceded by a
+ * private page holding the fd and the header. Only the data is in the
+ * file: whoever maps it cannot reach the header. F_SEAL_SHRINK keeps them
+ * from truncating the file under us (a SIGBUS on the next access).
+ */
+static block_header_t* shared_alloc(size_t reserve) {
+    size_t page = page_size();
+    size_t mapped = (reserve + page - 1) & ~(page - 1);
+    if (mapped < reserve || mapped > SIZE_MAX - page) {
+        return NULL;
+    }
+
+    int fd = memfd_create("ether-block", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t) mapped) != 0 || fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    // Reserve header page + data, then put the file over the data part
+    uint8_t* base = mmap(NULL, page + mapped, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    if (mmap(base + page, mapped, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+             fd, 0) == MAP_FAILED) {
+        munmap(base, page + mapped);
+        close(fd);
+        return NULL;
+    }
+
+    block_header_t* header = (block_header_t*) (base + page - HEADER_SIZE);
+    *shared_fd_slot(header) = fd;
+    header->capacity = mapped;
+    return header;
+}
+
+/**
+ * Unmap a shared block and close its memfd. The pages are punched out
+ * first: a process that still maps the file sees zeros, not the data,
+ * and the memory is returned now rather than when the last mapping goes.
+ */
+static void shared_release(block_header_t* header) {
+    int fd = *shared_fd_slot(header);
+    size_t capacity = header->capacity;
+
+    fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, (off_t) capacity);
+    close(fd);
+    munmap((uint8_t*) header + HEADER_SIZE - page_size(), page_size() + capacity);
+}
+
+/**
+ * Grow a shared block's data mapping where it is (the private header page
+ * and the file mapping cannot be moved together). The file may be left
+ * longer than the mapping if that fails: it is sealed against shrinking,
+ * and pages never touched cost nothing.
+ *
+ * @return  0 on success, -1 on failure
+ */
+static int shared_grow(block_header_t* header, size_t reserve) {
+    size_t page = page_size();
+    size_t mapped = (reserve + page - 1) & ~(page - 1);
+    if (mapped < reserve || mapped > SIZE_MAX - page) {
+        return -1;
+    }
+
+    int fd = *shared_fd_slot(header);
+    if (ftruncate(fd, (off_t) mapped) != 0 ||
+        mremap((uint8_t*) header + HEADER_SIZE, header->capacity, mapped, 0) == MAP_FAILED) {
+        return -1;
+    }
+
+    header->capacity = mapped;
+    return 0;
+}
+
+/**
+ * Resident set size of the process, 0 if unavailable
+ */
+static size_t read_resident_bytes(void) {
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f) {
+        return 0;
+    }
+
+    unsigned long pages_total = 0, pages_resident = 0;
+    int n = fscanf(f, "%lu %lu", &pages_total, &pages_resident);
+    fclose(f);
+
+    if (n != 2) {
+        return 0;
+    }
+    return (size_t) pages_resident * (size_t) sysconf(_SC_PAGESIZE);
+}
+
+// =============================================================================
+// PERSISTENT STORE
+// =============================================================================
+//
+// Blocks carved out of one MAP_SHARED file or DAX device, so they outlive
+// the process:
+//
+//   [store_super_t...4 KB][chunk][chunk]...[chunk]            (unused)
+//                                                 ^-- heap_end
+//   chunk = [store_chunk_t][block_header_t][data...]
+//
+// Chunks are contiguous, so opening the store walks them from the first
+// one. A chunk is live if its block header has BLOCK_MAGIC and its tag is
+// set (etherd tags every block with its handle); anything else is free
+// space and is coalesced with its free neighbors. The walk reads one
+// header per block and copies nothing, whatever the blocks hold.
+//
+// A chunk's headers are written before heap_end moves past it, and a block
+// only counts once it is tagged, so a process dying at any point leaks
+// nothing and never resurrects a half-made block. Free space is tracked in
+// memory only (rebuilt by the walk), one list per power-of-two size.
+
+#define STORE_MAGIC      0x4F54535245485445ull   // "ETHERSTO"
+#define STORE_VERSION    1
+#define STORE_HEAP       4096                    // Offset of the first chunk
+#define STORE_ALIGN      64                      // Chunk offsets and sizes
+#define STORE_MIN_CHUNK  128                     // Smaller remainders stay with the block
+#define STORE_CLASSES    64
+#define STORE_PUNCH_MIN  (64 * 1024)             // Freed data at least this big is hole-punched
+
+typedef struct {
+    uint64_t magic;      // STORE_MAGIC
+    uint32_t version;    // STORE_VERSION
+    uint32_t clean;      // Set by ether_store_close(), cleared while open
+    uint64_t size;       // Usable length of the file
+    uint64_t heap_end;   // Offset past the last chunk
+    uint64_t mark;       // Owner's high-water mark (ether_store_raise_mark())
+} store_super_t;
+
+typedef struct {
+    uint64_t size;   // Chunk length, headers included
+    uint64_t tag;    // Owner's tag, 0 = not claimed
+    uint64_t next;   // Free chunks: offset of the next one in its list, 0 = end
+} store_chunk_t;
+
+#define STORE_PREFIX  (sizeof(store_chunk_t) + HEADER_SIZE)   // Data offset in a chunk
+
+typedef struct {
+    pthread_mutex_t lock;
+    int             fd;
+    uint8_t*        base;           // Mapping, NULL while no store is open
+    store_super_t*  super;
+    int             fresh_zero;     // Never-used space reads as zeros (regular file)
+    int             prev_backend;   // Restored by ether_store_close()
+    uint64_t        free_lists[STORE_CLASSES];   // Heads, by log2 of chunk size
+} store_state_t;
+
+static store_state_t g_store = { .lock = PTHREAD_MUTEX_INITIALIZER, .fd = -1 };
+
+static inline store_chunk_t* store_chunk(uint64_t offset) {
+    return (store_chunk_t*) (g_store.base + offset);
+}
+
+static inline uint64_t store_offset(const store_chunk_t* chunk) {
+    return (uint64_t) ((const uint8_t*) chunk - g_store.base);
+}
+
+static inline block_header_t* chunk_header(store_chunk_t* chunk) {
+    return (block_header_t*) (chunk + 1);
+}
+
+static inline store_chunk_t* header_chunk(block_header_t* header) {
+    return (store_chunk_t*) header - 1;
+}
+
+/**
+ * Turn a chunk into free space and put it on its list (store lock held)
+ */
+static void store_push_free(store_chunk_t* chunk, int dirty) {
+    unsigned index = 63 - (unsigned) __builtin_clzll(chunk->size);
+    block_header_t* header = chunk_header(chunk);
+
+    header->magic = BLOCK_FREED;
+    header->flags = dirty ? FLAG_DIRTY : 0;
+    header->size = 0;
+    header->capacity = chunk->size - STORE_PREFIX;
+    chunk->tag = 0;
+    chunk->next = g_store.free_lists[index];
+    g_store.free_lists[index] = store_offset(chunk);
+}
+
+/**
+ * Take a free chunk of at least need bytes: first fit within need's own
+ * class, else the head of any larger class (store lock held)
+ */
+static store_chunk_t* store_take_free(uint64_t need) {
+    unsigned index = 63 - (unsigned) __builtin_clzll(need);
+
+    for (uint64_t* link = &g_store.free_lists[index]; *link; ) {
+        store_chunk_t* chunk = store_chunk(*link);
+        if (chunk->size >= need) {
+            *link = chunk->next;
+            return chunk;
+        }
+        link = &chunk->next;
+    }
+    for (unsigned i = index + 1; i < STORE_CLASSES; i++) {
+        if (g_store.free_lists[i]) {
+            store_chunk_t* chunk = store_chunk(g_store.free_lists[i]);
+            g_store.free_lists[i] = chunk->next;
+            return chunk;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Allocate a chunk with room for reserve bytes of data. Like slab blocks,
+ * it comes back with FLAG_DIRTY unless its data is known to be zero.
+ */
+static block_header_t* store_alloc(size_t reserve) {
+    if (reserve > SIZE_MAX - STORE_PREFIX - STORE_ALIGN) {
+        return NULL;
+    }
+    uint64_t need = (STORE_PREFIX + reserve + STORE_ALIGN - 1) & ~(uint64_t) (STORE_ALIGN - 1);
+
+    pthread_mutex_lock(&g_store.lock);
+    if (!g_store.base) {
+        pthread_mutex_unlock(&g_store.lock);
+        return NULL;
+    }
+
+    store_chunk_t* chunk = store_take_free(need);
+    block_header_t* header;
+    if (chunk) {
+        header = chunk_header(chunk);
+
+        // Split off the tail; wiped data stays zero on both sides
+        uint64_t rest = chunk->size - need;
+        if (rest >= STORE_MIN_CHUNK) {
+            store_chunk_t* tail = (store_chunk_t*) ((uint8_t*) chunk + need);
+            tail->size = rest;
+            store_push_free(tail, header->flags & FLAG_DIRTY);
+            chunk->size = need;
+        }
+    } else {
+        store_super_t* super = g_store.super;
+        if (need > super->size - super->heap_end) {
+            pthread_mutex_unlock(&g_store.lock);
+            return NULL;
+        }
+
+        chunk = store_chunk(super->heap_end);
+        chunk->size = need;
+        chunk->tag = 0;
+        header = chunk_header(chunk);
+        header->magic = BLOCK_FREED;
+        header->flags = g_store.fresh_zero ? 0 : FLAG_DIRTY;
+        super->heap_end += need;
+    }
+
+    header->capacity = chunk->size - STORE_PREFIX;
+    pthread_mutex_unlock(&g_store.lock);
+    return header;
+}
+
+/**
+ * Return a freed chunk to the store. Large ones get their pages punched
+ * out of the file first: the disk space is released, and data the wipe
+ * policy left behind does not linger on disk.
+ */
+static void store_release(block_header_t* header) {
+    store_chunk_t* chunk = header_chunk(header);
+    int dirty = (header->flags & FLAG_DIRTY) != 0;
+
+    if (header->capacity >= STORE_PUNCH_MIN) {
+        uint64_t page = page_size();
+        uint64_t start = (store_offset(chunk) + STORE_PREFIX + page - 1) & ~(page - 1);
+        uint64_t end = (store_offset(chunk) + chunk->size) & ~(page - 1);
+        if (end > start) {
+            fallocate(g_store.fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                      (off_t) start, (off_t) (end - start));
+        }
+    }
+
+    pthread_mutex_lock(&g_store.lock);
+    store_push_free(chunk, dirty);
+    pthread_mutex_unlock(&g_store.lock);
+}
+
+/**
+ * Grow a store block in place. Only the last chunk can: it extends into
+ * space that has never been used, which reads as zeros.
+ *
+ * @return  0 on success, -1 on failure
+ */
+static int store_grow(block_header_t* header, size_t reserve) {
+    store_chunk_t* chunk = header_chunk(header);
+    if (reserve > SIZE_MAX - STORE_PREFIX - STORE_ALIGN) {
+        return -1;
+    }
+    uint64_t need = (STORE_PREFIX + reserve + STORE_ALIGN - 1) & ~(uint64_t) (STORE_ALIGN - 1);
+
+    pthread_mutex_lock(&g_store.lock);
+    store_super_t* super = g_store.super;
+    int ok = g_store.fresh_zero &&
+             store_offset(chunk) + chunk->size == super->heap_end &&
+             need - chunk->size <= super->size - super->heap_end;
+    if (ok) {
+        super->heap_end += need - chunk->size;
+        chunk->size = need;
+        header->capacity = need - STORE_PREFIX;
+    }
+    pthread_mutex_unlock(&g_store.lock);
+    return ok ? 0 : -1;
+}
+
+/**
+ * Whether a chunk found by the walk holds a block to keep
+ */
+static int store_chunk_live(store_chunk_t* chunk) {
+    block_header_t* header = chunk_header(chunk);
+    return header->magic == BLOCK_MAGIC &&
+           (header->flags & (FLAG_ALLOCATED | FLAG_STORE)) == (FLAG_ALLOCATED | FLAG_STORE) &&
+           chunk->tag != 0 &&
+           header->capacity == chunk->size - STORE_PREFIX &&
+           header->size <= header->capacity;
+}
+
+/**
+ * Walk every chunk after open: count the live blocks, coalesce the free
+ * space between them into single chunks. A chunk whose size cannot be
+ * right ends the heap there, since nothing after it can be found.
+ *
+ * @return  Live blocks
+ */
+static size_t store_scan(void) {
+    store_super_t* super = g_store.super;
+    uint64_t offset = STORE_HEAP;
+    uint64_t run = 0, run_size = 0;
+    int run_dirty = 0;
+    size_t live = 0;
+
+    memset(g_store.free_lists, 0, sizeof(g_store.free_lists));
+
+    while (offset < super->heap_end) {
+        store_chunk_t* chunk = store_chunk(offset);
+        if (chunk->size < STORE_PREFIX || chunk->size % STORE_ALIGN ||
+            chunk->size > super->heap_end - offset) {
+            ether_log_error("ether", "store: bad chunk at offset %llu, heap truncated",
+                            (unsigned long long) offset);
+            super->heap_end = offset;
+            break;
+        }
+
+        if (store_chunk_live(chunk)) {
+            if (run_size) {
+                store_chunk(run)->size = run_size;
+                store_push_free(store_chunk(run), run_dirty);
+                run_size = 0;
+            }
+            stats_on_alloc(chunk_header(chunk)->size, 0);
+            live++;
+        } else {
+            block_header_t* header = chunk_header(chunk);
+            int dirty = header->magic != BLOCK_FREED || (header->flags & FLAG_DIRTY);
+            if (run_size) {
+                run_dirty = 1;   // Absorbed headers are in the data now
+            } else {
+                run = offset;
+                run_dirty = dirty;
+            }
+            run_size += chunk->size;
+        }
+        offset += chunk->size;
+    }
+
+    if (run_size) {
+        store_chunk(run)->size = run_size;
+        store_push_free(store_chunk(run), run_dirty);
+    }
+    return live;
+}
+
+/**
+ * Map the store file, trying MAP_SYNC first: on a DAX file system it
+ * maps the persistent memory itself, with no page cache in between
+ */
+static void* store_map(int fd, size_t size) {
+#ifdef MAP_SYNC
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED_VALIDATE | MAP_SYNC, fd, 0);
+    if (base != MAP_FAILED) {
+        return base;
+    }
+#endif
+    return mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
 }
 
 // =============================================================================
@@ -111,6 +1085,8 @@ const char* ether_strerror(ether_error_t err) {
         case ETHER_ERR_NETWORK: return "Network error";
         case ETHER_ERR_TIMEOUT: return "Operation timeout";
         case ETHER_ERR_NOTFOUND:return "Handle not found";
+        case ETHER_ERR_QUOTA:   return "Quota exceeded";
+        case ETHER_ERR_BUSY:    return "Server memory watermark reached";
         default:                return "Unknown error";
     }
 }
@@ -120,41 +1096,94 @@ const char* ether_strerror(ether_error_t err) {
 // =============================================================================
 
 void* ether_alloc(size_t size) {
-    if (size == 0) {
+    return ether_alloc_ex(size, (unsigned) atomic_load_explicit(&g_wipe, memory_order_relaxed));
+}
+
+#define ALLOC_STORE  0x80000000u   // Internal: in the store whatever the backend (realloc)
+
+/**
+ * Allocate a block of size bytes with room for at least reserve
+ * (>= size); ether_realloc() reserves extra capacity to grow into
+ */
+static void* block_alloc(size_t size, size_t reserve, unsigned flags_in) {
+    if (size == 0 || reserve < size || reserve > SIZE_MAX - HEADER_SIZE ||
+        (flags_in & ~(ETHER_ALLOC_WIPE_MASK | ETHER_ALLOC_HUGE | ETHER_ALLOC_SHARED | ALLOC_STORE))) {
         return NULL;
     }
 
     // Allocate header + user data
-    size_t total = HEADER_SIZE + size;
-    block_header_t* header = (block_header_t*)malloc(total);
+    uint64_t start = stats_clock();
+    size_t total = HEADER_SIZE + reserve;
+    ether_wipe_t policy = (ether_wipe_t) (flags_in & ETHER_ALLOC_WIPE_MASK);
+    block_header_t* header;
+    uint32_t flags = FLAG_ALLOCATED | FLAG_WIPE(policy);
+    size_t huge_threshold = atomic_load_explicit(&g_huge_threshold, memory_order_relaxed);
+    int backend = atomic_load_explicit(&g_backend, memory_order_relaxed);
+    int in_store = (flags_in & ALLOC_STORE) || backend == ETHER_BACKEND_STORE;
+
+    if (flags_in & ETHER_ALLOC_SHARED) {
+        // Fresh file pages: zero already, whatever the policy
+        header = shared_alloc(reserve);
+        flags |= FLAG_SHARED;
+    } else if ((flags_in & ETHER_ALLOC_HUGE) ||
+               (!in_store && huge_threshold && total >= huge_threshold)) {
+        // Fresh pages: zero already, whatever the policy
+        header = huge_alloc(total);
+        flags |= FLAG_MMAP | FLAG_HUGE;
+    } else if (in_store) {
+        // No fallback to memory that would not survive a restart
+        header = store_alloc(reserve);
+        if (header && (header->flags & FLAG_DIRTY) && policy_zeroes(policy)) {
+            memset(get_user_ptr(header), 0, size);
+        }
+        flags |= FLAG_STORE;
+    } else if (policy == ETHER_WIPE_LAZY && total >= ETHER_MMAP_THRESHOLD) {
+        header = mmap_alloc(total);
+        flags |= FLAG_MMAP;
+    } else if (backend == ETHER_BACKEND_SLAB && total <= ETHER_SLAB_MAX_BLOCK) {
+        // Slab blocks are already zero (fresh pages, or wiped on free)
+        // unless the previous owner skipped the wipe
+        header = slab_alloc(total);
+        if (header && (header->flags & FLAG_DIRTY) && policy_zeroes(policy)) {
+            memset(get_user_ptr(header), 0, size);
+        }
+        flags |= FLAG_SLAB;
+    } else if (policy_zeroes(policy)) {
+        // Zero user memory (security best practice). calloc skips the
+        // memset for chunks that come straight from fresh mmap pages.
+        header = (block_header_t*)calloc(1, total);
+        if (header) header->capacity = reserve;
+    } else {
+        header = (block_header_t*)malloc(total);
+        if (header) header->capacity = reserve;
+    }
 
     if (!header) {
-        debug_print("alloc FAILED: size=%zu", size);
+        ether_log_debug("ether", "alloc FAILED: size=%zu", size);
         return NULL;
     }
 
     // Initialize header
     header->magic = BLOCK_MAGIC;
-    header->flags = FLAG_ALLOCATED;
+    header->flags = flags;
     header->size = size;
-    header->capacity = size;
 
-    // Zero user memory (security best practice)
     void* user_ptr = get_user_ptr(header);
-    memset(user_ptr, 0, size);
 
     // Update statistics
-    g_stats.total_allocated += size;
-    g_stats.current_usage += size;
-    g_stats.num_allocs++;
-    if (g_stats.current_usage > g_stats.peak_usage) {
-        g_stats.peak_usage = g_stats.current_usage;
-    }
+    stats_on_alloc(size, start);
 
-    debug_print("alloc OK: ptr=%p size=%zu", user_ptr, size);
+    ether_log_debug("ether", "alloc OK: ptr=%p size=%zu", user_ptr, size);
     return user_ptr;
 }
 
+void* ether_alloc_ex(size_t size, unsigned flags_in) {
+    if (flags_in & ALLOC_STORE) {
+        return NULL;
+    }
+    return block_alloc(size, size, flags_in);
+}
+
 void ether_free(void* ptr) {
     if (!ptr) {
         return;  // free(NULL) is always safe
@@ -164,35 +1193,102 @@ void ether_free(void* ptr) {
 
     // Validate block
     if (!is_valid_block(header)) {
-        fprintf(stderr, "[ETHER] ERROR: invalid free at %p (magic=0x%X)\n",
-                ptr, header->magic);
+        ether_log_error("ether", "invalid free at %p (magic=0x%X)", ptr, header->magic);
         return;  // Don't abort, but report error
     }
 
     // Detect double-free
     if (header->magic == BLOCK_FREED) {
-        fprintf(stderr, "[ETHER] ERROR: double free at %p\n", ptr);
+        ether_log_error("ether", "double free at %p", ptr);
         return;
     }
 
+    uint64_t start = stats_clock();
     size_t size = header->size;
-
-    // Secure wipe: zero data before freeing (prevents data leakage)
-    memset(ptr, 0, size);
+    uint32_t flags = header->flags;
+    int wipe = block_wipes(header);
+
+    // Secure wipe: zero data before freeing (prevents data leakage).
+    // The whole capacity is wiped, so a shrunk block leaves nothing behind
+    // and slab blocks can be handed out again without another memset.
+    if (wipe) {
+        secure_wipe(ptr, header->capacity);
+    }
 
     // Mark as freed (helps detect double-free and use-after-free in debug)
     header->magic = BLOCK_FREED;
-    header->flags = 0;
+    header->flags = (flags & (FLAG_SLAB | FLAG_STORE)) && !wipe ? FLAG_DIRTY : 0;
+
+    ether_log_debug("ether", "free OK: ptr=%p size=%zu", ptr, size);
+
+    // Return memory to its class, or to the system
+    if (flags & FLAG_SLAB) {
+        slab_free(header);
+    } else if (flags & FLAG_STORE) {
+        store_release(header);
+    } else if (flags & FLAG_SHARED) {
+        shared_release(header);
+    } else if (flags & FLAG_MMAP) {
+        munmap(header, HEADER_SIZE + header->capacity);
+    } else {
+        free(header);
+    }
 
     // Update statistics
-    g_stats.total_freed += size;
-    g_stats.current_usage -= size;
-    g_stats.num_frees++;
+    stats_on_free(size, start);
+}
+
+/**
+ * Capacity to reserve when a block outgrows its current one: at least
+ * double, so a block grown step by step is moved O(log n) times and
+ * every byte is copied O(1) times on average
+ */
+static size_t grow_capacity(size_t capacity, size_t new_size) {
+    size_t doubled = capacity <= (SIZE_MAX - HEADER_SIZE) / 2 ? capacity * 2 : SIZE_MAX - HEADER_SIZE;
+    return doubled > new_size ? doubled : new_size;
+}
+
+/**
+ * Set the size of a block within its capacity. Newly exposed bytes below
+ * zero_end are zeroed per policy; past zero_end they are fresh pages.
+ */
+static void set_size(block_header_t* header, size_t new_size, size_t zero_end) {
+    size_t old_size = header->size;
+    header->size = new_size;
+
+    if (new_size > old_size && old_size < zero_end && policy_zeroes(BLOCK_WIPE(header))) {
+        size_t end = new_size < zero_end ? new_size : zero_end;
+        memset((uint8_t*)get_user_ptr(header) + old_size, 0, end - old_size);
+    }
+    stats_on_resize(old_size, new_size);
+}
+
+/**
+ * Grow a block's own mapping (FLAG_MMAP) to hold reserve bytes. mremap
+ * moves page table entries instead of copying data, and the added pages
+ * come from the kernel zeroed.
+ *
+ * @param may_move  Let the mapping move to a new address
+ * @return          Header at its (possibly new) address, NULL on failure
+ */
+static block_header_t* mmap_grow(block_header_t* header, size_t reserve, int may_move) {
+    size_t unit = (header->flags & FLAG_HUGE) ? ETHER_HUGE_PAGE_SIZE : page_size();
+    size_t total = HEADER_SIZE + reserve;
+    size_t mapped = (total + unit - 1) & ~(unit - 1);
+    if (mapped < total) {
+        return NULL;
+    }
 
-    debug_print("free OK: ptr=%p size=%zu", ptr, size);
+    void* base = mremap(header, HEADER_SIZE + header->capacity, mapped,
+                        may_move ? MREMAP_MAYMOVE : 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
 
-    // Return memory to system
-    free(header);
+    header = base;
+    header->capacity = mapped - HEADER_SIZE;
+    ether_log_debug("ether", "mremap: %p now %zu bytes", base, mapped);
+    return header;
 }
 
 void* ether_realloc(void* ptr, size_t new_size) {
@@ -210,42 +1306,295 @@ void* ether_realloc(void* ptr, size_t new_size) {
     block_header_t* old_header = get_header(ptr);
 
     if (!is_valid_block(old_header)) {
-        fprintf(stderr, "[ETHER] ERROR: invalid realloc at %p\n", ptr);
+        ether_log_error("ether", "invalid realloc at %p", ptr);
         return NULL;
     }
 
     size_t old_size = old_header->size;
+    size_t old_capacity = old_header->capacity;
 
     // If new size fits in existing capacity, reuse block
-    if (new_size <= old_header->capacity) {
-        old_header->size = new_size;
+    if (new_size <= old_capacity) {
+        set_size(old_header, new_size, old_capacity);
+        return ptr;
+    }
 
-        // Zero any newly exposed memory
-        if (new_size > old_size) {
-            memset((uint8_t*)ptr + old_size, 0, new_size - old_size);
+    if (new_size > SIZE_MAX - HEADER_SIZE) {
+        return NULL;
+    }
+    size_t reserve = grow_capacity(old_capacity, new_size);
+
+    // Own mapping: let the kernel extend or move it, no copy
+    if (old_header->flags & FLAG_MMAP) {
+        block_header_t* header = mmap_grow(old_header, reserve, 1);
+        if (!header && reserve > new_size) {
+            header = mmap_grow(old_header, new_size, 1);
+        }
+        if (header) {
+            set_size(header, new_size, old_capacity);
+            return get_user_ptr(header);
         }
+    }
+
+    // A shared block can only grow in place; moving it means a new memfd
+    if ((old_header->flags & FLAG_SHARED) &&
+        (shared_grow(old_header, reserve) == 0 || shared_grow(old_header, new_size) == 0)) {
+        set_size(old_header, new_size, old_capacity);
         return ptr;
     }
 
-    // Otherwise, allocate new block
-    void* new_ptr = ether_alloc(new_size);
+    // The last chunk of the store can take more of the file
+    if ((old_header->flags & FLAG_STORE) &&
+        (store_grow(old_header, reserve) == 0 || store_grow(old_header, new_size) == 0)) {
+        set_size(old_header, new_size, old_capacity);
+        return ptr;
+    }
+
+    // Otherwise, allocate new block with the same policy and placement
+    unsigned flags = (unsigned) BLOCK_WIPE(old_header);
+    if (old_header->flags & FLAG_HUGE) {
+        flags |= ETHER_ALLOC_HUGE;
+    }
+    if (old_header->flags & FLAG_SHARED) {
+        flags |= ETHER_ALLOC_SHARED;
+    }
+    if (old_header->flags & FLAG_STORE) {
+        flags |= ALLOC_STORE;
+    }
+    void* new_ptr = block_alloc(new_size, reserve, flags);
+    if (!new_ptr && reserve > new_size) {
+        new_ptr = block_alloc(new_size, new_size, flags);
+    }
     if (!new_ptr) {
         return NULL;  // Original block unchanged
     }
 
-    // Copy existing data
-    size_t copy_size = (old_size < new_size) ? old_size : new_size;
-    memcpy(new_ptr, ptr, copy_size);
+    // Copy existing data, and the tag that lets the store find it again
+    memcpy(new_ptr, ptr, old_size);
+    if (old_header->flags & FLAG_STORE) {
+        header_chunk(get_header(new_ptr))->tag = header_chunk(old_header)->tag;
+    }
 
     // Free old block
     ether_free(ptr);
 
-    debug_print("realloc OK: old=%p new=%p old_size=%zu new_size=%zu",
+    ether_log_debug("ether", "realloc OK: old=%p new=%p old_size=%zu new_size=%zu",
                 ptr, new_ptr, old_size, new_size);
 
     return new_ptr;
 }
 
+int ether_resize(void* ptr, size_t new_size) {
+    if (!ptr || new_size == 0) {
+        return ETHER_ERR_INVALID;
+    }
+
+    block_header_t* header = get_header(ptr);
+
+    if (!is_valid_block(header)) {
+        return ETHER_ERR_CORRUPT;
+    }
+
+    size_t old_capacity = header->capacity;
+    if (new_size <= old_capacity) {
+        set_size(header, new_size, old_capacity);
+        return ETHER_OK;
+    }
+
+    // A mapping may still be extendable where it is
+    if ((header->flags & FLAG_MMAP) && new_size <= SIZE_MAX - HEADER_SIZE &&
+        (mmap_grow(header, grow_capacity(old_capacity, new_size), 0) ||
+         mmap_grow(header, new_size, 0))) {
+        set_size(header, new_size, old_capacity);
+        return ETHER_OK;
+    }
+    if ((header->flags & FLAG_SHARED) && new_size <= SIZE_MAX - HEADER_SIZE &&
+        (shared_grow(header, grow_capacity(old_capacity, new_size)) == 0 ||
+         shared_grow(header, new_size) == 0)) {
+        set_size(header, new_size, old_capacity);
+        return ETHER_OK;
+    }
+    if ((header->flags & FLAG_STORE) && new_size <= SIZE_MAX - HEADER_SIZE &&
+        (store_grow(header, grow_capacity(old_capacity, new_size)) == 0 ||
+         store_grow(header, new_size) == 0)) {
+        set_size(header, new_size, old_capacity);
+        return ETHER_OK;
+    }
+    return ETHER_ERR_NOMEM;
+}
+
+// =============================================================================
+// PUBLIC API - PERSISTENT STORE
+// =============================================================================
+
+int ether_store_open(const char* path, size_t size) {
+    if (!path) {
+        return ETHER_ERR_INVALID;
+    }
+
+    pthread_mutex_lock(&g_store.lock);
+    if (g_store.base) {
+        pthread_mutex_unlock(&g_store.lock);
+        return ETHER_ERR_INVALID;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        ether_log_error("ether", "store: cannot open %s", path);
+        if (fd >= 0) close(fd);
+        pthread_mutex_unlock(&g_store.lock);
+        return ETHER_ERR_INVALID;
+    }
+
+    // A file is never shrunk, and grows with zeros; a device has its size
+    int regular = S_ISREG(st.st_mode);
+    int fresh = regular && st.st_size == 0;
+    if (regular && (size_t) st.st_size > size) {
+        size = (size_t) st.st_size;
+    }
+    if (size < STORE_HEAP + STORE_MIN_CHUNK ||
+        (regular && (size_t) st.st_size < size && ftruncate(fd, (off_t) size) != 0)) {
+        ether_log_error("ether", "store: cannot size %s to %zu bytes", path, size);
+        close(fd);
+        pthread_mutex_unlock(&g_store.lock);
+        return ETHER_ERR_INVALID;
+    }
+
+    uint8_t* base = store_map(fd, size);
+    if (base == MAP_FAILED) {
+        ether_log_error("ether", "store: cannot map %s", path);
+        close(fd);
+        pthread_mutex_unlock(&g_store.lock);
+        return ETHER_ERR_NOMEM;
+    }
+
+    // Format an empty file (or a device whose first page was zeroed);
+    // anything else must already be a store
+    store_super_t* super = (store_super_t*) base;
+    if (fresh || super->magic == 0) {
+        super->magic = STORE_MAGIC;
+        super->version = STORE_VERSION;
+        super->heap_end = STORE_HEAP;
+    } else if (super->magic != STORE_MAGIC || super->version != STORE_VERSION ||
+               super->heap_end < STORE_HEAP || super->heap_end > size) {
+        ether_log_error("ether", "store: %s is not an ether store (or is damaged)", path);
+        munmap(base, size);
+        close(fd);
+        pthread_mutex_unlock(&g_store.lock);
+        return ETHER_ERR_CORRUPT;
+    } else if (!super->clean) {
+        ether_log_warn("ether", "store: %s was not closed cleanly", path);
+    }
+    super->size = size;
+    super->clean = 0;
+
+    g_store.fd = fd;
+    g_store.base = base;
+    g_store.super = super;
+    g_store.fresh_zero = regular;
+    size_t live = store_scan();
+
+    g_store.prev_backend = atomic_exchange(&g_backend, ETHER_BACKEND_STORE);
+    pthread_mutex_unlock(&g_store.lock);
+
+    ether_log_info("ether", "store: %s, %zu blocks, %llu of %zu bytes used", path, live,
+                   (unsigned long long) super->heap_end, size);
+    return ETHER_OK;
+}
+
+size_t ether_store_recover(ether_store_visit_t visit, void* arg) {
+    if (!g_store.base) {
+        return 0;
+    }
+
+    size_t count = 0;
+    for (uint64_t offset = STORE_HEAP; offset < g_store.super->heap_end; ) {
+        store_chunk_t* chunk = store_chunk(offset);
+        offset += chunk->size;   // Before visit() frees the block
+
+        block_header_t* header = chunk_header(chunk);
+        if (header->magic == BLOCK_MAGIC && chunk->tag != 0) {
+            count++;
+            if (visit) {
+                visit(get_user_ptr(header), header->size, chunk->tag, arg);
+            }
+        }
+    }
+    return count;
+}
+
+int ether_store_tag(void* ptr, uint64_t tag) {
+    if (!ptr) {
+        return ETHER_ERR_INVALID;
+    }
+
+    block_header_t* header = get_header(ptr);
+    if (!is_valid_block(header) || !(header->flags & FLAG_STORE)) {
+        return ETHER_ERR_INVALID;
+    }
+
+    header_chunk(header)->tag = tag;
+    return ETHER_OK;
+}
+
+void ether_store_raise_mark(uint64_t mark) {
+    store_super_t* super = g_store.super;
+    if (!super) {
+        return;
+    }
+
+    // Only ever raised, from any thread; stays put once past mark
+    uint64_t current = __atomic_load_n(&super->mark, __ATOMIC_RELAXED);
+    while (current < mark &&
+           !__atomic_compare_exchange_n(&super->mark, &current, mark, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+uint64_t ether_store_mark(void) {
+    store_super_t* super = g_store.super;
+    return super ? __atomic_load_n(&super->mark, __ATOMIC_RELAXED) : 0;
+}
+
+bool ether_store_is_open(void) {
+    return g_store.base != NULL;
+}
+
+int ether_store_sync(void) {
+    pthread_mutex_lock(&g_store.lock);
+    int rc = ETHER_ERR_INVALID;
+    if (g_store.base) {
+        rc = msync(g_store.base, g_store.super->heap_end, MS_SYNC) == 0 ? ETHER_OK
+                                                                        : ETHER_ERR_NOMEM;
+    }
+    pthread_mutex_unlock(&g_store.lock);
+    return rc;
+}
+
+void ether_store_close(void) {
+    pthread_mutex_lock(&g_store.lock);
+    if (!g_store.base) {
+        pthread_mutex_unlock(&g_store.lock);
+        return;
+    }
+
+    // Data first, then the clean mark that says it is all there
+    size_t size = g_store.super->size;
+    msync(g_store.base, g_store.super->heap_end, MS_SYNC);
+    g_store.super->clean = 1;
+    msync(g_store.base, STORE_HEAP, MS_SYNC);
+    munmap(g_store.base, size);
+    close(g_store.fd);
+
+    g_store.base = NULL;
+    g_store.super = NULL;
+    g_store.fd = -1;
+    int expected = ETHER_BACKEND_STORE;
+    atomic_compare_exchange_strong(&g_backend, &expected, g_store.prev_backend);
+    pthread_mutex_unlock(&g_store.lock);
+}
+
 // =============================================================================
 // PUBLIC API - DATA OPERATIONS
 // =============================================================================
@@ -267,7 +1616,7 @@ int ether_write(void* ptr, const void* data, size_t len) {
 
     memcpy(ptr, data, len);
 
-    debug_print("write OK: ptr=%p len=%zu", ptr, len);
+    ether_log_debug("ether", "write OK: ptr=%p len=%zu", ptr, len);
     return ETHER_OK;
 }
 
@@ -288,7 +1637,7 @@ int ether_read(void* ptr, void* buffer, size_t len) {
 
     memcpy(buffer, ptr, len);
 
-    debug_print("read OK: ptr=%p len=%zu", ptr, len);
+    ether_log_debug("ether", "read OK: ptr=%p len=%zu", ptr, len);
     return ETHER_OK;
 }
 
@@ -306,16 +1655,92 @@ size_t ether_size(void* ptr) {
     return header->size;
 }
 
+int ether_block_fd(void* ptr) {
+    if (!ptr) {
+        return -1;
+    }
+
+    block_header_t* header = get_header(ptr);
+
+    if (!is_valid_block(header) || !(header->flags & FLAG_SHARED)) {
+        return -1;
+    }
+
+    return *shared_fd_slot(header);
+}
+
 // =============================================================================
 // STATISTICS
 // =============================================================================
 
+/**
+ * Sum of every thread's counters since startup (registry lock held)
+ */
+static ether_stats_t stats_sum(void) {
+    ether_stats_t sum = g_retired;
+    for (thread_stats_t* ts = g_stats_threads; ts; ts = ts->next) {
+        stats_accumulate(&sum, ts);
+    }
+    stats_accumulate(&sum, &g_fallback_stats);
+    return sum;
+}
+
 ether_stats_t ether_get_stats(void) {
-    return g_stats;
+    pthread_mutex_lock(&g_stats_lock);
+    ether_stats_t stats = stats_sum();
+    size_t peak = (size_t) atomic_load_explicit(&g_peak, memory_order_relaxed);
+    pthread_mutex_unlock(&g_stats_lock);
+
+    // Usage from the exact sums; the flushed peak may lag behind it
+    size_t usage = stats.total_allocated - stats.total_freed;
+    if (usage > peak) peak = usage;
+
+    // Everything is relative to the last reset
+    stats.total_allocated -= g_baseline.total_allocated;
+    stats.total_freed -= g_baseline.total_freed;
+    stats.num_allocs -= g_baseline.num_allocs;
+    stats.num_frees -= g_baseline.num_frees;
+    for (int i = 0; i < ETHER_STATS_SIZE_BUCKETS; i++) {
+        stats.alloc_sizes[i] -= g_baseline.alloc_sizes[i];
+    }
+    for (int i = 0; i < ETHER_STATS_LATENCY_BUCKETS; i++) {
+        stats.alloc_latency[i] -= g_baseline.alloc_latency[i];
+        stats.free_latency[i] -= g_baseline.free_latency[i];
+    }
+    stats.current_usage = usage - g_baseline_usage;
+    stats.peak_usage = peak - g_baseline_usage;
+
+    stats.arena_mapped = atomic_load_explicit(&g_slab.mapped, memory_order_relaxed);
+    stats.resident = read_resident_bytes();
+    return stats;
 }
 
 void ether_reset_stats(void) {
-    memset(&g_stats, 0, sizeof(g_stats));
+    pthread_mutex_lock(&g_stats_lock);
+    g_baseline = stats_sum();
+    g_baseline_usage = g_baseline.total_allocated - g_baseline.total_freed;
+    atomic_store_explicit(&g_peak, (long long) g_baseline_usage, memory_order_relaxed);
+    pthread_mutex_unlock(&g_stats_lock);
+}
+
+void ether_set_latency_stats(bool enabled) {
+    atomic_store(&g_latency, enabled);
+}
+
+/**
+ * Print the non-empty buckets of a log2 histogram
+ */
+static void dump_histogram(const char* title, const char* unit,
+                           const size_t* buckets, int count) {
+    printf("%s\n", title);
+    for (int i = 0; i < count; i++) {
+        if (buckets[i] == 0) continue;
+        if (i == count - 1) {
+            printf("  >= 2^%-2d %-5s %zu\n", i, unit, buckets[i]);
+        } else {
+            printf("  2^%-2d..2^%-2d %-5s %zu\n", i, i + 1, unit, buckets[i]);
+        }
+    }
 }
 
 // =============================================================================
@@ -323,16 +1748,35 @@ void ether_reset_stats(void) {
 // =============================================================================
 
 void ether_set_debug(bool enabled) {
-    g_debug = enabled;
+    ether_log_set_level(enabled ? ETHER_LOG_DEBUG : ETHER_LOG_INFO);
 }
 
 void ether_dump_state(void) {
+    ether_stats_t stats = ether_get_stats();
+
     printf("=== Ether Allocator State ===\n");
-    printf("Total allocated: %zu bytes\n", g_stats.total_allocated);
-    printf("Total freed:     %zu bytes\n", g_stats.total_freed);
-    printf("Current usage:   %zu bytes\n", g_stats.current_usage);
-    printf("Peak usage:      %zu bytes\n", g_stats.peak_usage);
-    printf("Allocations:     %zu\n", g_stats.num_allocs);
-    printf("Frees:           %zu\n", g_stats.num_frees);
+    printf("Total allocated: %zu bytes\n", stats.total_allocated);
+    printf("Total freed:     %zu bytes\n", stats.total_freed);
+    printf("Current usage:   %zu bytes\n", stats.current_usage);
+    printf("Peak usage:      %zu bytes\n", stats.peak_usage);
+    printf("Allocations:     %zu\n", stats.num_allocs);
+    printf("Frees:           %zu\n", stats.num_frees);
+    static const char* const backend_names[] = { "malloc", "slab", "store" };
+    printf("Backend:         %s\n", backend_names[ether_get_backend()]);
+    static const char* const wipe_names[] = { "full", "free", "lazy", "none" };
+    printf("Wipe policy:     %s\n", wipe_names[ether_get_wipe()]);
+    printf("Huge threshold:  %zu bytes\n", ether_get_huge_threshold());
+    pthread_mutex_lock(&g_store.lock);
+    if (g_store.base) {
+        printf("Store:           %llu of %llu bytes\n",
+               (unsigned long long) g_store.super->heap_end,
+               (unsigned long long) g_store.super->size);
+    }
+    pthread_mutex_unlock(&g_store.lock);
+    printf("Arena mapped:    %zu bytes\n", stats.arena_mapped);
+    printf("Resident (RSS):  %zu bytes\n", stats.resident);
+    dump_histogram("Allocation sizes:", "bytes", stats.alloc_sizes, ETHER_STATS_SIZE_BUCKETS);
+    dump_histogram("Alloc latency:", "ns", stats.alloc_latency, ETHER_STATS_LATENCY_BUCKETS);
+    dump_histogram("Free latency:", "ns", stats.free_latency, ETHER_STATS_LATENCY_BUCKETS);
     printf("=============================\n");
 }
\ No newline at end of file
@@ -7,7 +7,10 @@
  * Copyright (C) 2024 - Licensed under GPL-3.0
  */
 
+#define _GNU_SOURCE
+
 #include "ether/protocol.h"
+#include "ether/compress.h"
 #include "ether/client.h"
 #include "ether/ether.h"
 
@@ -16,9 +19,22 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
-
+#include <stdatomic.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <linux/userfaultfd.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 
@@ -27,10 +43,55 @@
 // =============================================================================
 
 struct ether_conn {
-    int  socket;        // TCP socket file descriptor
-    char host[256];     // Server hostname
+    int  socket;        // TCP or Unix domain socket file descriptor
+    char host[256];     // Server hostname, or "unix:" + socket path
     int  port;          // Server port
     int  connected;     // Connection status flag
+    int  local;         // Unix domain socket: shared blocks available
+    ether_pool_t*       owner;         // Pool this connection belongs to (NULL if none)
+    ether_cluster_t*    cluster;       // Cluster this connection is a node of (NULL if none)
+    size_t              slot;          // Index in the pool / node ID in the cluster
+    ether_shadow_mode_t shadow_mode;   // How new local buffers are backed
+    int  compress;      // Payload compression negotiated (ether_set_compression())
+    ether_cache_mode_t  cache_mode;    // Page cache for new blocks
+    int  last_error;    // Result of the last rmalloc/rrealloc (ether_last_error())
+
+    // Cached blocks with dirty pages (see ether_rsync())
+    struct shadow_header** dirty;
+    size_t                 num_dirty;
+    size_t                 dirty_cap;
+
+    struct rmapper*        mapper;     // Fault handler for ether_rmap() (NULL until used)
+
+    // Requests in flight, indexed by request ID % ETHER_MAX_INFLIGHT.
+    // Responses are matched by ID, so they may arrive in any order.
+    ether_future_t* inflight[ETHER_MAX_INFLIGHT];
+    uint32_t        num_inflight;
+    uint32_t        next_request_id;   // Last ID handed out (0 is never used)
+
+    ether_buf_pool_t pool;             // BATCH and STATS payload buffers
+};
+
+/**
+ * One request in flight. Synchronous calls keep theirs on the stack;
+ * the *_async() calls allocate one that ether_wait() releases.
+ */
+struct ether_future {
+    ether_conn_t* conn;         // Owning connection (NULL once complete)
+    uint32_t      request_id;   // Echoed back in the response's reserved field
+    uint8_t       command;      // Request command
+    int           done;         // Response received (or request failed)
+    int           result;       // ETHER_OK or error code, once done
+    uint64_t      handle;       // Handle carried by the response
+    uint16_t      flags;        // Flags carried by the response
+    void*         buffer;       // READ: destination for the payload
+    size_t        len;          // READ: buffer size / WRITE: bytes written
+    size_t        received;     // READ: payload bytes stored in buffer
+    int           failed;       // Streamed transfer: an earlier chunk was rejected
+    void*         mirror;       // WRITE: local buffer updated on success
+    const void*   data;         // WRITE: data that was sent
+    int           fd;           // SHARE: descriptor passed with the response (-1 = none)
+    int           error;        // ALLOC/REALLOC: reason carried by an ERROR (0 = none)
 };
 
 // =============================================================================
@@ -38,361 +99,3496 @@ struct ether_conn {
 // =============================================================================
 
 /**
- * Local cache mapping local pointers to remote handles.
+ * Local pointers map to remote handles through a header hidden in front
+ * of the local (shadow) buffer, the same way block_header_t works in the
+ * allocator:
+ *
+ *   [shadow_header_t][local buffer...]
+ *                    ^-- pointer returned by ether_rmalloc()
+ *
+ * Lookups are O(1) and there is no limit on the number of blocks. The
+ * header records its connection, so a pointer is only accepted by the
+ * connection that allocated it, or by another connection of its pool.
  *
- * When client calls rmalloc(), we:
- * 1. Ask server to allocate memory, get back a handle
- * 2. Allocate a local buffer for convenience
- * 3. Store mapping: local_ptr -> remote_handle
+ * In ETHER_SHADOW_LAZY mode the local buffer is only an address range
+ * reserved with PROT_NONE; just the page holding the header is committed:
+ *
+ *   [ ...page 0... |shadow_header_t][PROT_NONE reservation...]
+ *                                   ^-- pointer returned by ether_rmalloc()
+ *
+ * ETHER_SHADOW_SHARED uses the same layout, with the server's memfd of
+ * the block mapped over the reservation: the local buffer is the block.
  */
-typedef struct {
-    void*    local_ptr;      // Local buffer (what user sees)
-    uint64_t remote_handle;  // Server-side handle
-    size_t   size;           // Allocation size
-    int      valid;          // Is this entry in use?
-} handle_cache_entry_t;
+#define SHADOW_MAGIC  0xF6237985  // CRC32("SHADOWED") - mapping is live
+#define SHADOW_FREED  0x589CC8E7  // CRC32("UNSHADOW") - mapping was removed
+
+#define SHADOW_LAZY   0x01        // Buffer is an mmap() reservation, not calloc()
+#define SHADOW_SHARED 0x02        // ...with the block's memfd mapped over it (and LAZY)
+
+typedef struct shadow_header {
+    uint32_t      magic;          // SHADOW_MAGIC or SHADOW_FREED
+    uint32_t      flags;          // SHADOW_* flags
+    ether_conn_t* conn;           // Connection that owns the remote block
+    uint64_t      remote_handle;  // Server-side handle
+    size_t        size;           // Allocation size
+    uint64_t*     pages;          // Page cache: valid bitmap, then dirty bitmap
+                                  // (NULL if the block is not cached)
+    size_t        dirty_slot;     // 1 + index in conn->dirty, 0 if not listed
+} shadow_header_t;                // 48 bytes: local buffer stays 16-byte aligned
+
+static inline shadow_header_t* shadow_header(void* local) {
+    return ((shadow_header_t*)local) - 1;
+}
 
-#define MAX_HANDLES 4096
-static handle_cache_entry_t g_cache[MAX_HANDLES];
+static inline size_t page_size(void) {
+    static size_t page;
+    if (page == 0) {
+        page = (size_t)sysconf(_SC_PAGESIZE);
+    }
+    return page;
+}
 
 /**
- * Store a mapping in the cache
+ * Length of the reservation behind a lazy buffer (header page + data)
  */
-static int cache_store(void* local, uint64_t remote, size_t size) {
-    for (int i = 0; i < MAX_HANDLES; i++) {
-        if (!g_cache[i].valid) {
-            g_cache[i].local_ptr = local;
-            g_cache[i].remote_handle = remote;
-            g_cache[i].size = size;
-            g_cache[i].valid = 1;
-            return 0;
-        }
-    }
-    return -1;  // Cache full
+static inline size_t lazy_map_len(size_t size) {
+    size_t page = page_size();
+    return page + ((size + page - 1) & ~(page - 1));
 }
 
 /**
- * Look up remote handle by local pointer
+ * Reserve address space for a lazy buffer; only the header page is
+ * accessible (and gets committed when the header is written)
  */
-static uint64_t cache_lookup(void* local, size_t* size) {
-    for (int i = 0; i < MAX_HANDLES; i++) {
-        if (g_cache[i].valid && g_cache[i].local_ptr == local) {
-            if (size) *size = g_cache[i].size;
-            return g_cache[i].remote_handle;
-        }
+static shadow_header_t* lazy_reserve(size_t size) {
+    uint8_t* base = mmap(NULL, lazy_map_len(size), PROT_NONE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (mprotect(base, page_size(), PROT_READ | PROT_WRITE) != 0) {
+        munmap(base, lazy_map_len(size));
+        return NULL;
     }
-    return 0;  // Not found
+
+    shadow_header_t* header = (shadow_header_t*)(base + page_size()) - 1;
+    header->flags = SHADOW_LAZY;
+    return header;
+}
+
+// Page cache granularity. Every cached block has two bitmaps with one
+// bit per page: valid (local copy is current) and dirty (local copy is
+// newer than the server's). A dirty page is always valid.
+#define CACHE_PAGE_SIZE  4096
+
+static inline size_t cache_num_pages(size_t size) {
+    return (size + CACHE_PAGE_SIZE - 1) / CACHE_PAGE_SIZE;
+}
+
+static inline size_t cache_words(size_t size) {
+    return (cache_num_pages(size) + 63) / 64;
+}
+
+static inline uint64_t* cache_valid(shadow_header_t* header) {
+    return header->pages;
+}
+
+static inline uint64_t* cache_dirty(shadow_header_t* header) {
+    return header->pages + cache_words(header->size);
+}
+
+static inline int bit_test(const uint64_t* bits, size_t i) {
+    return (bits[i / 64] >> (i % 64)) & 1;
+}
+
+static inline void bit_set(uint64_t* bits, size_t i) {
+    bits[i / 64] |= (uint64_t)1 << (i % 64);
+}
+
+static inline void bit_clear(uint64_t* bits, size_t i) {
+    bits[i / 64] &= ~((uint64_t)1 << (i % 64));
 }
 
 /**
- * Remove entry from cache
+ * Queue a block on its connection's dirty list (no-op if already there)
+ *
+ * @return  0 on success, -1 if out of memory
  */
-static int cache_remove(void* local) {
-    for (int i = 0; i < MAX_HANDLES; i++) {
-        if (g_cache[i].valid && g_cache[i].local_ptr == local) {
-            g_cache[i].valid = 0;
-            return 0;
-        }
+static int dirty_add(ether_conn_t* conn, shadow_header_t* header) {
+    if (header->dirty_slot) return 0;
+
+    if (conn->num_dirty == conn->dirty_cap) {
+        size_t cap = conn->dirty_cap ? conn->dirty_cap * 2 : 16;
+        shadow_header_t** dirty = realloc(conn->dirty, cap * sizeof(*dirty));
+        if (!dirty) return -1;
+        conn->dirty = dirty;
+        conn->dirty_cap = cap;
     }
-    return -1;  // Not found
-}
 
-// =============================================================================
-// INTERNAL HELPERS
-// =============================================================================
+    conn->dirty[conn->num_dirty++] = header;
+    header->dirty_slot = conn->num_dirty;
+    return 0;
+}
 
 /**
- * Send a message to the server
+ * Take a block off the dirty list (swap with the last entry)
  */
-static int send_message(ether_conn_t* conn, ether_msg_t* msg) {
-    uint8_t header_buf[ETHER_HEADER_SIZE];
-    ether_msg_serialize_header(&msg->header, header_buf);
+static void dirty_remove(ether_conn_t* conn, shadow_header_t* header) {
+    if (!header->dirty_slot) return;
+
+    size_t index = header->dirty_slot - 1;
+    shadow_header_t* last = conn->dirty[--conn->num_dirty];
+    conn->dirty[index] = last;
+    last->dirty_slot = index + 1;
+    header->dirty_slot = 0;
+}
 
-    // Send header
-    if (send(conn->socket, header_buf, ETHER_HEADER_SIZE, 0) != ETHER_HEADER_SIZE) {
-        return -1;
+/**
+ * Create the local buffer for a remote block
+ *
+ * @return  Local buffer (what user sees): zeroed, or a PROT_NONE token in
+ *          lazy mode; NULL if out of memory
+ */
+static void* cache_store(ether_conn_t* conn, uint64_t remote, size_t size) {
+    shadow_header_t* header;
+    if (conn->shadow_mode == ETHER_SHADOW_LAZY) {
+        header = lazy_reserve(size);
+    } else {
+        header = calloc(1, sizeof(shadow_header_t) + size);
+    }
+    if (!header) {
+        return NULL;
     }
 
-    // Send payload if present
-    if (msg->header.size > 0) {
-        if (send(conn->socket, msg->payload, msg->header.size, 0) != (ssize_t)msg->header.size) {
-            return -1;
+    header->magic = SHADOW_MAGIC;
+    header->conn = conn;
+    header->remote_handle = remote;
+    header->size = size;
+
+    // The page cache lives in the local buffer, so lazy tokens are never cached
+    if (conn->cache_mode == ETHER_CACHE_WRITEBACK && !(header->flags & SHADOW_LAZY)) {
+        header->pages = calloc(2 * cache_words(size), sizeof(uint64_t));
+        if (!header->pages) {
+            free(header);
+            return NULL;
         }
     }
+    return header + 1;
+}
+
+/**
+ * Look up remote handle by local pointer
+ *
+ * @return  Remote handle, 0 if local is not a live block of this connection
+ */
+static uint64_t cache_lookup(ether_conn_t* conn, void* local, size_t* size) {
+    shadow_header_t* header = shadow_header(local);
+    if (header->magic != SHADOW_MAGIC ||
+        (header->conn != conn && (!conn->owner || header->conn->owner != conn->owner))) {
+        return 0;  // Not found
+    }
 
-    return 0;
+    if (size) *size = header->size;
+    return header->remote_handle;
 }
 
 /**
- * Receive a response from the server
+ * Local copy to keep in sync with the remote block, NULL if the buffer
+ * is a lazy token with no backing
  */
-static int recv_response(ether_conn_t* conn, ether_msg_header_t* header,
-                         void* payload_buf, size_t payload_max) {
-    uint8_t header_buf[ETHER_HEADER_SIZE];
+static inline void* cache_mirror(void* local) {
+    return (shadow_header(local)->flags & SHADOW_LAZY) ? NULL : local;
+}
 
-    // Receive header (blocking until complete)
-    ssize_t n = recv(conn->socket, header_buf, ETHER_HEADER_SIZE, MSG_WAITALL);
-    if (n != ETHER_HEADER_SIZE) {
-        return -1;
+/**
+ * Page cache bitmaps laid out for a new block size, keeping the state of
+ * the pages both sizes share. Shrinking reuses the old array.
+ *
+ * @return  Bitmaps for size, NULL if out of memory (old ones unchanged)
+ */
+static uint64_t* cache_resize_pages(uint64_t* old, size_t old_size, size_t size) {
+    size_t old_words = cache_words(old_size);
+    size_t words = cache_words(size);
+
+    uint64_t* pages = old;
+    if (words > old_words) {
+        pages = calloc(2 * words, sizeof(uint64_t));
+        if (!pages) return NULL;
+        memcpy(pages, old, old_words * sizeof(uint64_t));
+        memcpy(pages + words, old + old_words, old_words * sizeof(uint64_t));
+        return pages;
     }
 
-    ether_msg_deserialize_header(header_buf, header);
+    // Dirty bitmap moves down behind the shorter valid bitmap
+    memmove(pages + words, old + old_words, words * sizeof(uint64_t));
 
-    // Validate response
-    if (!ether_msg_validate(header)) {
-        return -1;
+    // Pages past the new end are gone, whatever their state
+    size_t tail = cache_num_pages(size) % 64;
+    if (tail) {
+        uint64_t mask = ((uint64_t)1 << tail) - 1;
+        pages[words - 1] &= mask;
+        pages[2 * words - 1] &= mask;
     }
+    return pages;
+}
 
-    // Receive payload if expected
-    if (header->size > 0 && payload_buf) {
-        size_t to_recv = (header->size < payload_max) ? header->size : payload_max;
-        n = recv(conn->socket, payload_buf, to_recv, MSG_WAITALL);
-        if (n != (ssize_t)to_recv) {
-            return -1;
-        }
+/**
+ * Resize the local buffer of a block the server has already resized
+ *
+ * @return  Local buffer at its (possibly new) address, NULL if growing it
+ *          ran out of memory (the buffer then keeps its old size)
+ */
+static void* cache_resize(void* local, size_t size) {
+    shadow_header_t* header = shadow_header(local);
+    size_t old_size = header->size;
+    int grow = size > old_size;
+
+    uint64_t* pages = NULL;
+    if (header->pages) {
+        pages = cache_resize_pages(header->pages, old_size, size);
+        if (!pages) return NULL;
     }
 
-    return 0;
-}
+    // A shrink that cannot release memory keeps the larger buffer
+    shadow_header_t* moved = header;
+    if (header->flags & SHADOW_LAZY) {
+        // Nothing is committed behind a token: reserve anew, carry the header
+        if (lazy_map_len(size) != lazy_map_len(old_size)) {
+            moved = lazy_reserve(size);
+            if (moved) {
+                *moved = *header;
+                munmap((uint8_t*)local - page_size(), lazy_map_len(old_size));
+            } else if (!grow) {
+                moved = header;
+            }
+        }
+    } else {
+        moved = realloc(header, sizeof(shadow_header_t) + size);
+        if (!moved && !grow) {
+            moved = header;
+        }
+    }
 
-// =============================================================================
-// PUBLIC API - CONNECTION
-// =============================================================================
+    if (!moved) {
+        if (pages != header->pages) free(pages);
+        return NULL;
+    }
 
-ether_conn_t* ether_connect(const char* host, int port) {
-    ether_conn_t* conn = calloc(1, sizeof(ether_conn_t));
-    if (!conn) return NULL;
+    header = moved;
+    if (pages && pages != header->pages) {
+        free(header->pages);
+        header->pages = pages;
+    }
+    if (grow && !(header->flags & SHADOW_LAZY)) {
+        memset((uint8_t*)(header + 1) + old_size, 0, size - old_size);
+    }
 
-    strncpy(conn->host, host, sizeof(conn->host) - 1);
-    conn->port = port;
+    header->size = size;
+    if (header->dirty_slot) {
+        header->conn->dirty[header->dirty_slot - 1] = header;
+    }
+    return header + 1;
+}
 
-    // Resolve hostname to IP address
-    struct hostent* he = gethostbyname(host);
-    if (!he) {
-        free(conn);
-        return NULL;
+/**
+ * Drop a mapping and release its local buffer
+ */
+static void cache_remove(void* local) {
+    shadow_header_t* header = shadow_header(local);
+    header->magic = SHADOW_FREED;
+
+    // Unflushed writes die with the block
+    if (header->pages) {
+        dirty_remove(header->conn, header);
+        free(header->pages);
     }
 
-    // Create TCP socket
-    conn->socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (conn->socket < 0) {
-        free(conn);
-        return NULL;
+    if (header->flags & SHADOW_LAZY) {
+        munmap((uint8_t*)local - page_size(), lazy_map_len(header->size));
+    } else {
+        free(header);
     }
+}
 
-    // Connect to server
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
-    memcpy(&addr.sin_addr, he->h_addr, he->h_length);
+// =============================================================================
+// INTERNAL HELPERS
+// =============================================================================
 
-    if (connect(conn->socket, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-        close(conn->socket);
-        free(conn);
-        return NULL;
-    }
+static void init_header(ether_msg_header_t* header, ether_cmd_t cmd,
+                        uint64_t handle, uint32_t size) {
+    memset(header, 0, sizeof(*header));
+    header->magic = ETHER_MAGIC;
+    header->version = ETHER_PROTOCOL_VER;
+    header->command = cmd;
+    header->handle = handle;
+    header->size = size;
+}
 
-    conn->connected = 1;
-    return conn;
+/**
+ * Complete a future without a response (served from the page cache, or
+ * failed validation / network)
+ */
+static void future_finish(ether_future_t* future, int result) {
+    future->conn = NULL;
+    future->done = 1;
+    future->result = result;
 }
 
-void ether_disconnect(ether_conn_t* conn) {
-    if (!conn) return;
+/**
+ * The connection is unusable: fail everything still in flight
+ */
+static void conn_fail(ether_conn_t* conn) {
+    for (uint32_t i = 0; i < ETHER_MAX_INFLIGHT && conn->num_inflight > 0; i++) {
+        if (conn->inflight[i]) {
+            future_finish(conn->inflight[i], ETHER_ERR_NETWORK);
+            conn->inflight[i] = NULL;
+            conn->num_inflight--;
+        }
+    }
 
     if (conn->connected) {
         close(conn->socket);
+        conn->connected = 0;
     }
-    free(conn);
 }
 
-int ether_ping(ether_conn_t* conn) {
-    if (!conn || !conn->connected) return -1;
-
-    // Send PING
-    ether_msg_t* msg = ether_msg_create(ETHER_CMD_PING, 0);
-    if (!msg) return -1;
-
-    if (send_message(conn, msg) != 0) {
-        ether_msg_free(msg);
-        return -1;
+/**
+ * Apply a response to the future it answers
+ */
+static void future_complete(ether_future_t* future, const ether_msg_header_t* response) {
+    if (future->command == ETHER_CMD_PING) {
+        future->result = (response->command == ETHER_CMD_PONG) ? ETHER_OK : ETHER_ERR_INVALID;
+    } else if (response->command == ETHER_CMD_ERROR &&
+               future->error >= ETHER_ERR_BUSY && future->error < 0) {
+        future->result = future->error;
+    } else {
+        future->result = (response->command == ETHER_CMD_OK && !future->failed)
+                             ? ETHER_OK : ETHER_ERR_INVALID;
     }
-    ether_msg_free(msg);
 
-    // Wait for PONG
-    ether_msg_header_t response;
-    if (recv_response(conn, &response, NULL, 0) != 0) {
-        return -1;
+    // Update local cache with written data (nothing to do when the caller
+    // wrote from the local buffer itself)
+    if (future->result == ETHER_OK && future->command == ETHER_CMD_WRITE &&
+        future->mirror && future->data != future->mirror) {
+        memmove(future->mirror, future->data, future->len);
     }
 
-    return (response.command == ETHER_CMD_PONG) ? 0 : -1;
+    future->handle = response->handle;
+    future->flags = response->flags;
+    future->conn = NULL;
+    future->done = 1;
 }
 
-// =============================================================================
-// PUBLIC API - REMOTE MEMORY
-// =============================================================================
+/**
+ * Receive exactly len bytes. On a Unix domain socket a descriptor may come
+ * along (SHARE response): it is stored in *fd, or closed if fd is NULL.
+ */
+static int recv_exact_fd(ether_conn_t* conn, void* buf, size_t len, int* fd) {
+    size_t got = 0;
+    while (got < len) {
+        struct iovec iov = { .iov_base = (uint8_t*)buf + got, .iov_len = len - got };
+        union {
+            struct cmsghdr hdr;
+            char           buf[CMSG_SPACE(sizeof(int))];
+        } control;
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        if (conn->local) {
+            msg.msg_control = control.buf;
+            msg.msg_controllen = sizeof(control.buf);
+        }
 
-void* ether_rmalloc(ether_conn_t* conn, size_t size) {
-    if (!conn || !conn->connected || size == 0) return NULL;
+        ssize_t n = recvmsg(conn->socket, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            return -1;
+        }
+        got += (size_t)n;
+
+        for (struct cmsghdr* cmsg = conn->local ? CMSG_FIRSTHDR(&msg) : NULL; cmsg;
+             cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+
+            int passed;
+            memcpy(&passed, CMSG_DATA(cmsg), sizeof(passed));
+            if (fd && *fd < 0) {
+                *fd = passed;
+            } else {
+                close(passed);
+            }
+        }
+    }
+    return 0;
+}
 
-    // 1. Create ALLOC request
-    ether_msg_t* msg = ether_msg_create(ETHER_CMD_ALLOC, 0);
-    if (!msg) return NULL;
+static int recv_exact(ether_conn_t* conn, void* buf, size_t len) {
+    return recv_exact_fd(conn, buf, len, NULL);
+}
 
-    msg->header.size = size;  // Request size in header
+/**
+ * Receive one response and complete the request it belongs to
+ *
+ * Blocks until the whole response (header + payload) has arrived. A
+ * response flagged ETHER_FLAG_MORE is one chunk of a streamed READ: its
+ * payload is appended to the buffer and the request stays in flight.
+ */
+static int recv_response(ether_conn_t* conn) {
+    uint8_t header_buf[ETHER_HEADER_SIZE];
+    ether_msg_header_t header;
 
-    // 2. Send request
-    if (send_message(conn, msg) != 0) {
-        ether_msg_free(msg);
-        return NULL;
+    // A passed descriptor rides on the first byte of its response
+    int fd = -1;
+    if (recv_exact_fd(conn, header_buf, ETHER_HEADER_SIZE, &fd) != 0) {
+        if (fd >= 0) close(fd);
+        return -1;
     }
-    ether_msg_free(msg);
 
-    // 3. Receive response
-    ether_msg_header_t response;
-    if (recv_response(conn, &response, NULL, 0) != 0) {
-        return NULL;
-    }
+    ether_msg_deserialize_header(header_buf, &header);
 
-    if (response.command != ETHER_CMD_OK) {
-        return NULL;
+    // Validate response
+    if (!ether_msg_validate(&header)) {
+        if (fd >= 0) close(fd);
+        return -1;
     }
 
-    // 4. Allocate local buffer for user convenience
-    void* local_ptr = calloc(1, size);
-    if (!local_ptr) {
-        // TODO: Send FREE to server to clean up
-        return NULL;
+    // Match the response to its request (unknown IDs are dropped)
+    uint32_t slot = header.reserved % ETHER_MAX_INFLIGHT;
+    ether_future_t* future = conn->inflight[slot];
+    if (future && future->request_id != header.reserved) {
+        future = NULL;
     }
 
-    // 5. Cache the mapping: local_ptr -> remote_handle
-    if (cache_store(local_ptr, response.handle, size) != 0) {
-        free(local_ptr);
-        // TODO: Send FREE to server
-        return NULL;
+    if (fd >= 0) {
+        if (future && future->command == ETHER_CMD_SHARE && future->fd < 0) {
+            future->fd = fd;
+        } else {
+            close(fd);
+        }
     }
 
-    return local_ptr;
-}
-
-void ether_rfree(ether_conn_t* conn, void* ptr) {
-    if (!conn || !conn->connected || !ptr) return;
-
-    // Look up remote handle
-    uint64_t handle = cache_lookup(ptr, NULL);
-    if (handle == 0) return;
-
-    // Send FREE request
-    ether_msg_t* msg = ether_msg_create(ETHER_CMD_FREE, 0);
-    if (!msg) return;
-
-    msg->header.handle = handle;
+    // ALLOC and REALLOC say why they failed: a big-endian ether_error_t
+    size_t to_recv = 0;
+    if (future && header.command == ETHER_CMD_ERROR && header.size == sizeof(uint32_t) &&
+        (future->command == ETHER_CMD_ALLOC || future->command == ETHER_CMD_REALLOC)) {
+        uint32_t code;
+        if (recv_exact(conn, &code, sizeof(code)) != 0) {
+            return -1;
+        }
+        to_recv = sizeof(code);
+        future->error = (int32_t)ntohl(code);
+    } else if (future && future->buffer && header.size > 0 &&
+               (header.flags & ETHER_FLAG_COMPRESSED)) {
+        // Compressed payload: inflate into the caller's buffer
+        uint8_t* packed = ether_buf_get(&conn->pool, header.size);
+        if (!packed || recv_exact(conn, packed, header.size) != 0) {
+            ether_buf_put(&conn->pool, packed, header.size);
+            return -1;
+        }
+        to_recv = header.size;
+
+        ssize_t n = ether_decompress_payload(packed, header.size,
+                                             (uint8_t*)future->buffer + future->received,
+                                             future->len - future->received);
+        if (n < 0) {
+            future->failed = 1;   // Corrupt or larger than requested
+        } else {
+            future->received += (size_t)n;
+        }
+        ether_buf_put(&conn->pool, packed, header.size);
+    } else if (future && future->buffer && header.size > 0) {
+        // Receive payload straight into the caller's buffer
+        size_t room = future->len - future->received;
+        to_recv = (header.size < room) ? header.size : room;
+        if (recv_exact(conn, (uint8_t*)future->buffer + future->received, to_recv) != 0) {
+            return -1;
+        }
+        future->received += to_recv;
+    }
 
-    send_message(conn, msg);
-    ether_msg_free(msg);
+    // Drop whatever does not fit, so the stream stays in sync
+    size_t excess = header.size - to_recv;
+    while (excess > 0) {
+        uint8_t scratch[4096];
+        size_t chunk = excess < sizeof(scratch) ? excess : sizeof(scratch);
+        if (recv_exact(conn, scratch, chunk) != 0) {
+            return -1;
+        }
+        excess -= chunk;
+    }
 
-    // Wait for confirmation (ignore errors)
-    ether_msg_header_t response;
-    recv_response(conn, &response, NULL, 0);
+    if (future && (header.flags & ETHER_FLAG_MORE)) {
+        if (header.command != ETHER_CMD_OK) {
+            future->failed = 1;
+        }
+    } else if (future) {
+        conn->inflight[slot] = NULL;
+        conn->num_inflight--;
+        future_complete(future, &header);
+    }
 
-    // Clean up local resources
-    cache_remove(ptr);
-    free(ptr);
+    return 0;
 }
 
-int ether_rwrite(ether_conn_t* conn, void* ptr, const void* data, size_t len) {
-    if (!conn || !conn->connected || !ptr || !data) {
-        return ETHER_ERR_INVALID;
+/**
+ * Send a request header, an optional prefix (e.g. the offset of a ranged
+ * WRITE/READ) and a caller-owned payload in one sendmsg() (no
+ * intermediate message buffer)
+ *
+ * If the socket is full, responses are drained while waiting: the server
+ * stops reading from clients that do not read their responses, so
+ * blocking in send() with requests in flight could deadlock.
+ */
+static int send_request(ether_conn_t* conn, const ether_msg_header_t* header,
+                        const void* prefix, size_t prefix_len,
+                        const void* payload, size_t payload_len) {
+    uint8_t header_buf[ETHER_HEADER_SIZE];
+    ether_msg_serialize_header(header, header_buf);
+
+    struct iovec iov[3];
+    size_t iovcnt = 0;
+    iov[iovcnt].iov_base = header_buf;
+    iov[iovcnt++].iov_len = ETHER_HEADER_SIZE;
+    if (prefix_len > 0) {
+        iov[iovcnt].iov_base = (void*)prefix;
+        iov[iovcnt++].iov_len = prefix_len;
+    }
+    if (payload_len > 0) {
+        iov[iovcnt].iov_base = (void*)payload;
+        iov[iovcnt++].iov_len = payload_len;
     }
 
-    // Look up remote handle
-    size_t block_size;
-    uint64_t handle = cache_lookup(ptr, &block_size);
-    if (handle == 0) return ETHER_ERR_NOTFOUND;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+
+    // Large payloads may go out in several pieces
+    while (msg.msg_iovlen > 0) {
+        ssize_t n = sendmsg(conn->socket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return -1;
+
+            struct pollfd pfd = { .fd = conn->socket, .events = POLLIN | POLLOUT };
+            if (poll(&pfd, 1, -1) < 0 && errno != EINTR) return -1;
+            if ((pfd.revents & POLLIN) && recv_response(conn) != 0) return -1;
+            continue;
+        }
 
-    // Bounds check
-    if (len > block_size) {
-        return ETHER_ERR_OVERFLOW;
+        size_t sent = (size_t)n;
+        while (msg.msg_iovlen > 0 && sent >= msg.msg_iov[0].iov_len) {
+            sent -= msg.msg_iov[0].iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov[0].iov_base = (uint8_t*)msg.msg_iov[0].iov_base + sent;
+            msg.msg_iov[0].iov_len -= sent;
+        }
     }
 
-    // Create WRITE request with payload
-    ether_msg_t* msg = ether_msg_create(ETHER_CMD_WRITE, len);
-    if (!msg) return ETHER_ERR_NOMEM;
-
-    msg->header.handle = handle;
-    memcpy(msg->payload, data, len);
+    return 0;
+}
 
-    // Send request
-    if (send_message(conn, msg) != 0) {
-        ether_msg_free(msg);
-        return ETHER_ERR_NETWORK;
+/**
+ * Give a request an ID and register it; header->reserved is set to the ID
+ *
+ * @return  ETHER_OK, or ETHER_ERR_NETWORK (future is then completed)
+ */
+static int submit_begin(ether_conn_t* conn, ether_future_t* future, ether_msg_header_t* header) {
+    uint32_t id = ++conn->next_request_id;
+    if (id == 0) {
+        id = ++conn->next_request_id;
     }
-    ether_msg_free(msg);
 
-    // Wait for confirmation
-    ether_msg_header_t response;
-    if (recv_response(conn, &response, NULL, 0) != 0) {
-        return ETHER_ERR_NETWORK;
+    // The slot is still taken by a request ETHER_MAX_INFLIGHT IDs older:
+    // wait for it before reusing the slot
+    uint32_t slot = id % ETHER_MAX_INFLIGHT;
+    while (conn->connected && conn->inflight[slot]) {
+        if (recv_response(conn) != 0) {
+            conn_fail(conn);
+        }
     }
 
-    if (response.command != ETHER_CMD_OK) {
-        return ETHER_ERR_INVALID;
+    if (!conn->connected) {
+        future_finish(future, ETHER_ERR_NETWORK);
+        return ETHER_ERR_NETWORK;
     }
 
-    // Update local cache with written data
-    memcpy(ptr, data, len);
+    future->conn = conn;
+    future->request_id = id;
+    future->command = header->command;
+    future->done = 0;
+    conn->inflight[slot] = future;
+    conn->num_inflight++;
 
+    header->reserved = id;
     return ETHER_OK;
 }
 
-int ether_rread(ether_conn_t* conn, void* ptr, void* buffer, size_t len) {
-    if (!conn || !conn->connected || !ptr || !buffer) {
-        return ETHER_ERR_INVALID;
+/**
+ * Send one message of a registered request
+ *
+ * @return  ETHER_OK, or ETHER_ERR_NETWORK (the connection is then failed)
+ */
+static int submit_send(ether_conn_t* conn, const ether_msg_header_t* header,
+                       const void* prefix, size_t prefix_len,
+                       const void* payload, size_t payload_len) {
+    if (send_request(conn, header, prefix, prefix_len, payload, payload_len) != 0) {
+        conn_fail(conn);
+        return ETHER_ERR_NETWORK;
     }
+    return ETHER_OK;
+}
 
-    // Look up remote handle
-    size_t block_size;
-    uint64_t handle = cache_lookup(ptr, &block_size);
-    if (handle == 0) return ETHER_ERR_NOTFOUND;
-
-    // Cap length to block size
-    if (len > block_size) {
-        len = block_size;
+/**
+ * Give a request an ID, register it and send it
+ *
+ * @return  ETHER_OK, or ETHER_ERR_NETWORK (future is then completed)
+ */
+static int submit(ether_conn_t* conn, ether_future_t* future, ether_msg_header_t* header,
+                  const void* prefix, size_t prefix_len,
+                  const void* payload, size_t payload_len) {
+    if (submit_begin(conn, future, header) != ETHER_OK) {
+        return ETHER_ERR_NETWORK;
     }
+    return submit_send(conn, header, prefix, prefix_len, payload, payload_len);
+}
 
-    // Create READ request
-    ether_msg_t* msg = ether_msg_create(ETHER_CMD_READ, 0);
-    if (!msg) return ETHER_ERR_NOMEM;
+/**
+ * Compress the data of a WRITE, if the connection negotiated compression
+ * and the data shrinks enough
+ *
+ * @param packed  Output: compressed payload, to be released with
+ *                ether_buf_put(&conn->pool, *packed, *cap) once sent
+ * @return        Payload length, 0 to send the data raw
+ */
+static size_t pack_write(ether_conn_t* conn, const void* data, size_t len,
+                         uint8_t** packed, size_t* cap) {
+    if (!conn->compress || len < ETHER_COMPRESS_MIN) return 0;
 
-    msg->header.handle = handle;
-    msg->header.size = len;  // How many bytes to read
+    *cap = ether_compress_bound(len);
+    *packed = ether_buf_get(&conn->pool, *cap);
+    if (!*packed) return 0;
 
-    // Send request
-    if (send_message(conn, msg) != 0) {
-        ether_msg_free(msg);
-        return ETHER_ERR_NETWORK;
+    size_t n = ether_compress_payload(data, len, *packed, *cap);
+    if (n == 0) {
+        ether_buf_put(&conn->pool, *packed, *cap);
     }
-    ether_msg_free(msg);
+    return n;
+}
 
-    // Receive response with data
-    ether_msg_header_t response;
-    if (recv_response(conn, &response, buffer, len) != 0) {
+/**
+ * Send a WRITE or READ larger than ETHER_STREAM_CHUNK as a stream of
+ * ranged chunks sharing one request ID (see ETHER_FLAG_MORE)
+ *
+ * WRITE chunks are taken from data in place; READ chunks only carry
+ * their offset and the responses are appended to future->buffer.
+ */
+static int submit_stream(ether_conn_t* conn, ether_future_t* future, ether_cmd_t cmd,
+                         uint64_t handle, size_t offset, const void* data, size_t len) {
+    ether_msg_header_t header;
+    init_header(&header, cmd, handle, 0);
+    if (submit_begin(conn, future, &header) != ETHER_OK) {
         return ETHER_ERR_NETWORK;
     }
 
-    if (response.command != ETHER_CMD_OK) {
-        return ETHER_ERR_INVALID;
+    for (size_t pos = 0; pos < len; pos += ETHER_STREAM_CHUNK) {
+        size_t chunk = len - pos < ETHER_STREAM_CHUNK ? len - pos : ETHER_STREAM_CHUNK;
+
+        header.flags = ETHER_FLAG_OFFSET;
+        if (pos + chunk < len) {
+            header.flags |= ETHER_FLAG_MORE;
+        }
+
+        uint8_t prefix[ETHER_OFFSET_SIZE];
+        ether_msg_serialize_offset(offset + pos, prefix);
+
+        int ret;
+        if (cmd == ETHER_CMD_WRITE) {
+            uint8_t* packed;
+            size_t cap;
+            size_t n = pack_write(conn, (const uint8_t*)data + pos, chunk, &packed, &cap);
+            if (n > 0) {
+                header.flags |= ETHER_FLAG_COMPRESSED;
+                header.size = (uint32_t)(ETHER_OFFSET_SIZE + n);
+                ret = submit_send(conn, &header, prefix, sizeof(prefix), packed, n);
+                ether_buf_put(&conn->pool, packed, cap);
+            } else {
+                header.size = (uint32_t)(ETHER_OFFSET_SIZE + chunk);
+                ret = submit_send(conn, &header, prefix, sizeof(prefix),
+                                  (const uint8_t*)data + pos, chunk);
+            }
+        } else {
+            header.size = (uint32_t)chunk;
+            ret = submit_send(conn, &header, prefix, sizeof(prefix), NULL, 0);
+        }
+        if (ret != ETHER_OK) {
+            return ret;
+        }
     }
 
     return ETHER_OK;
 }
 
-size_t ether_rsize(ether_conn_t* conn, void* ptr) {
-    if (!conn || !ptr) return 0;
+/**
+ * Block until a future is complete
+ */
+static int future_wait(ether_future_t* future) {
+    while (!future->done) {
+        if (recv_response(future->conn) != 0) {
+            conn_fail(future->conn);
+        }
+    }
+    return future->result;
+}
+
+/**
+ * Send a request that carries no payload and wait for its response
+ */
+static int call(ether_conn_t* conn, ether_future_t* future, ether_cmd_t cmd,
+                uint64_t handle, uint32_t size) {
+    ether_msg_header_t header;
+    init_header(&header, cmd, handle, size);
+
+    memset(future, 0, sizeof(*future));
+    if (submit(conn, future, &header, NULL, 0, NULL, 0) != ETHER_OK) {
+        return ETHER_ERR_NETWORK;
+    }
+    return future_wait(future);
+}
+
+/**
+ * Send a READ of [offset, offset + len) of a block (already validated);
+ * the payload lands in buffer on completion
+ */
+static int remote_read(ether_conn_t* conn, ether_future_t* future, uint64_t handle,
+                       size_t offset, void* buffer, size_t len) {
+    future->buffer = buffer;
+    future->len = len;
+
+    if (len > ETHER_STREAM_CHUNK) {
+        return submit_stream(conn, future, ETHER_CMD_READ, handle, offset, NULL, len);
+    }
+
+    ether_msg_header_t header;
+    init_header(&header, ETHER_CMD_READ, handle, (uint32_t)len);  // How many bytes to read
+
+    uint8_t prefix[ETHER_OFFSET_SIZE];
+    size_t prefix_len = 0;
+    if (offset > 0) {
+        header.flags |= ETHER_FLAG_OFFSET;
+        ether_msg_serialize_offset(offset, prefix);
+        prefix_len = ETHER_OFFSET_SIZE;
+    }
+    return submit(conn, future, &header, prefix, prefix_len, NULL, 0);
+}
+
+// =============================================================================
+// PAGE CACHE
+// =============================================================================
+
+#define CACHE_FILL_DEPTH  16   // Page-run READs kept in flight by cache_fill()
+
+/**
+ * Byte range of pages [first, last] inside a block
+ */
+static inline void cache_span(const shadow_header_t* header, size_t first, size_t last,
+                              size_t* offset, size_t* len) {
+    size_t end = (last + 1) * CACHE_PAGE_SIZE;
+    *offset = first * CACHE_PAGE_SIZE;
+    *len = (end < header->size ? end : header->size) - *offset;
+}
+
+/**
+ * Fetch every invalid page in [first, last] into the local buffer
+ *
+ * Each run of consecutive invalid pages is one ranged READ; up to
+ * CACHE_FILL_DEPTH runs are pipelined. Valid (and so dirty) pages are
+ * never overwritten.
+ */
+static int cache_fill(ether_conn_t* conn, shadow_header_t* header, size_t first, size_t last) {
+    uint8_t* local = (uint8_t*)(header + 1);
+    uint64_t* valid = cache_valid(header);
+
+    ether_future_t futures[CACHE_FILL_DEPTH];
+    size_t runs[CACHE_FILL_DEPTH][2];
+    int pending = 0;
+    int ret = ETHER_OK;
+
+    size_t page = first;
+    while (page <= last || pending > 0) {
+        // Queue the next run of invalid pages
+        if (page <= last && pending < CACHE_FILL_DEPTH) {
+            if (bit_test(valid, page)) {
+                page++;
+                continue;
+            }
+
+            size_t end = page;
+            while (end < last && !bit_test(valid, end + 1)) end++;
+
+            size_t offset, len;
+            cache_span(header, page, end, &offset, &len);
+            memset(&futures[pending], 0, sizeof(futures[pending]));
+            remote_read(conn, &futures[pending], header->remote_handle, offset, local + offset, len);
+            runs[pending][0] = page;
+            runs[pending][1] = end;
+            pending++;
+
+            page = end + 1;
+            continue;
+        }
+
+        // Window full (or nothing left to queue): complete the runs
+        for (int i = 0; i < pending; i++) {
+            size_t offset, len;
+            cache_span(header, runs[i][0], runs[i][1], &offset, &len);
+
+            int r = future_wait(&futures[i]);
+            if (r == ETHER_OK && futures[i].received != len) {
+                r = ETHER_ERR_CORRUPT;
+            }
+            if (r != ETHER_OK) {
+                ret = r;
+                continue;
+            }
+            for (size_t p = runs[i][0]; p <= runs[i][1]; p++) {
+                bit_set(valid, p);
+            }
+        }
+        pending = 0;
+    }
+
+    return ret;
+}
+
+/**
+ * Serve a READ from the cache, fetching the pages that are missing
+ */
+static int cache_read(ether_conn_t* conn, shadow_header_t* header, size_t offset,
+                      void* buffer, size_t len) {
+    if (len == 0) return ETHER_OK;
+
+    int ret = cache_fill(conn, header, offset / CACHE_PAGE_SIZE,
+                         (offset + len - 1) / CACHE_PAGE_SIZE);
+    if (ret != ETHER_OK) return ret;
+
+    memcpy(buffer, (uint8_t*)(header + 1) + offset, len);
+    return ETHER_OK;
+}
+
+/**
+ * Whether [offset, offset + len) covers a whole page
+ */
+static inline int cache_covers(const shadow_header_t* header, size_t page,
+                               size_t offset, size_t len) {
+    size_t start, span;
+    cache_span(header, page, page, &start, &span);
+    return offset <= start && offset + len >= start + span;
+}
+
+/**
+ * Buffer a WRITE in the cache; it reaches the server on the next flush
+ *
+ * Partially written pages that are not cached yet are fetched first, so
+ * every dirty page can be flushed whole.
+ */
+static int cache_write(ether_conn_t* conn, shadow_header_t* header, size_t offset,
+                       const void* data, size_t len) {
+    if (len == 0) return ETHER_OK;
+
+    size_t first = offset / CACHE_PAGE_SIZE;
+    size_t last = (offset + len - 1) / CACHE_PAGE_SIZE;
+    uint64_t* valid = cache_valid(header);
+    uint64_t* dirty = cache_dirty(header);
+
+    int ret = ETHER_OK;
+    if (!bit_test(valid, first) && !cache_covers(header, first, offset, len)) {
+        ret = cache_fill(conn, header, first, first);
+    }
+    if (ret == ETHER_OK && last != first &&
+        !bit_test(valid, last) && !cache_covers(header, last, offset, len)) {
+        ret = cache_fill(conn, header, last, last);
+    }
+    if (ret != ETHER_OK) return ret;
+
+    if (dirty_add(conn, header) != 0) return ETHER_ERR_NOMEM;
+
+    memmove((uint8_t*)(header + 1) + offset, data, len);
+    for (size_t p = first; p <= last; p++) {
+        bit_set(valid, p);
+        bit_set(dirty, p);
+    }
+    return ETHER_OK;
+}
+
+/**
+ * Dirty ranges collected into BATCH requests by cache_flush()
+ */
+typedef struct {
+    shadow_header_t* header;
+    size_t           first;    // Pages covered by the op
+    size_t           last;
+} flush_op_t;
+
+typedef struct {
+    ether_conn_t*  conn;
+    ether_batch_t* batch;
+    flush_op_t*    ops;        // Indexed like the batch's ops
+    int            num_ops;
+    int            cap_ops;
+    int            result;     // First error seen
+} flush_t;
+
+/**
+ * Send the pending batch; pages of every op that succeeded become clean
+ */
+static void flush_exec(flush_t* flush) {
+    if (!flush->batch) return;
+
+    int ret = ether_batch_exec(flush->batch);
+    for (int i = 0; i < flush->num_ops; i++) {
+        flush_op_t* op = &flush->ops[i];
+        if (ret != ETHER_OK || ether_batch_result(flush->batch, i) != ETHER_OK) {
+            if (flush->result == ETHER_OK) {
+                flush->result = (ret != ETHER_OK) ? ret : ether_batch_result(flush->batch, i);
+            }
+            continue;
+        }
+        for (size_t p = op->first; p <= op->last; p++) {
+            bit_clear(cache_dirty(op->header), p);
+        }
+    }
+
+    ether_batch_destroy(flush->batch);
+    flush->batch = NULL;
+    flush->num_ops = 0;
+}
+
+/**
+ * Add one range of dirty pages to the pending batch, starting a new
+ * batch when the current one is full
+ */
+static int flush_add(flush_t* flush, shadow_header_t* header, size_t first, size_t last) {
+    uint8_t* local = (uint8_t*)(header + 1);
+    size_t offset, len;
+    cache_span(header, first, last, &offset, &len);
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (!flush->batch) {
+            flush->batch = ether_batch_create(flush->conn);
+            if (!flush->batch) return ETHER_ERR_NOMEM;
+        }
+
+        int op = ether_batch_write_at(flush->batch, local, offset, local + offset, len);
+        if (op == ETHER_ERR_OVERFLOW && flush->num_ops > 0) {
+            flush_exec(flush);  // Batch is full: send it and retry
+            continue;
+        }
+        if (op < 0) return op;
+
+        if (flush->num_ops == flush->cap_ops) {
+            int cap = flush->cap_ops ? flush->cap_ops * 2 : 16;
+            flush_op_t* ops = realloc(flush->ops, (size_t)cap * sizeof(flush_op_t));
+            if (!ops) return ETHER_ERR_NOMEM;
+            flush->ops = ops;
+            flush->cap_ops = cap;
+        }
+        flush->ops[flush->num_ops++] = (flush_op_t){ header, first, last };
+        return ETHER_OK;
+    }
+    return ETHER_ERR_OVERFLOW;
+}
+
+/**
+ * Queue every dirty range of a block, split so that each fits a batch
+ */
+static int flush_block(flush_t* flush, shadow_header_t* header) {
+    const uint64_t* dirty = cache_dirty(header);
+    size_t num_pages = cache_num_pages(header->size);
+    size_t max_pages = ETHER_STREAM_CHUNK / CACHE_PAGE_SIZE;
+
+    size_t page = 0;
+    while (page < num_pages) {
+        if (!bit_test(dirty, page)) {
+            page++;
+            continue;
+        }
+
+        size_t end = page;
+        while (end + 1 < num_pages && end - page + 1 < max_pages && bit_test(dirty, end + 1)) {
+            end++;
+        }
+
+        int ret = flush_add(flush, header, page, end);
+        if (ret != ETHER_OK) return ret;
+        page = end + 1;
+    }
+    return ETHER_OK;
+}
+
+/**
+ * Write dirty pages of the given blocks back in as few BATCH requests
+ * as possible (one, unless they exceed ETHER_MAX_PAYLOAD)
+ */
+static int cache_flush(ether_conn_t* conn, shadow_header_t** headers, size_t count) {
+    flush_t flush = { .conn = conn };
+
+    for (size_t i = 0; i < count && flush.result == ETHER_OK; i++) {
+        int ret = flush_block(&flush, headers[i]);
+        if (ret != ETHER_OK && flush.result == ETHER_OK) {
+            flush.result = ret;
+        }
+    }
+    flush_exec(&flush);
+    free(flush.ops);
+
+    return flush.result;
+}
+
+/**
+ * Drop blocks without dirty pages from the dirty list
+ */
+static void dirty_prune(ether_conn_t* conn) {
+    for (size_t i = conn->num_dirty; i-- > 0;) {
+        shadow_header_t* header = conn->dirty[i];
+        const uint64_t* dirty = cache_dirty(header);
+
+        int clean = 1;
+        for (size_t w = 0; w < cache_words(header->size) && clean; w++) {
+            clean = (dirty[w] == 0);
+        }
+        if (clean) {
+            dirty_remove(conn, header);
+        }
+    }
+}
+
+// =============================================================================
+// REMOTE MAPPINGS (userfaultfd)
+// =============================================================================
+
+/**
+ * ether_rmap() gives a block an address range of its own, registered
+ * with userfaultfd in MISSING mode. Nothing is fetched up front: the
+ * first touch of a page blocks the touching thread, and the connection's
+ * fault thread copies the page in from etherd (UFFDIO_COPY).
+ *
+ * The fault thread uses a second connection to the same server, because
+ * a fault can hit while the application is inside a call on its own
+ * connection (e.g. ether_rwrite() from a mapped buffer).
+ *
+ * Dirty pages are found without write-protect support: every page copied
+ * in also goes to a twin (a pristine copy, as in page-based DSM), and
+ * write-back sends the pages that no longer memcmp() equal to their twin.
+ * Twins live in a NORESERVE reservation, so only fetched pages use memory.
+ */
+#define RMAP_PAGE_SIZE      4096
+#define RMAP_MAX_READAHEAD  (2 * 1024 * 1024 / RMAP_PAGE_SIZE)   // 2 MB window
+
+typedef struct rmap_region {
+    uint8_t*            addr;        // Start of the mapping
+    size_t              map_len;     // Mapped bytes (page multiple)
+    size_t              size;        // Block size
+    uint64_t            handle;      // Remote handle
+    void*               ptr;         // Local pointer of the block
+    uint64_t*           populated;   // One bit per page copied in
+    uint64_t*           unsynced;    // One bit per page whose write-back failed
+    uint8_t*            twins;       // Page contents at copy-in / last write-back
+    size_t              next_page;   // Page after the last fetched run
+    size_t              window;      // Current read-ahead, in pages
+    int                 error;       // A fetch failed: zeros were mapped
+    struct rmap_region* next;
+} rmap_region_t;
+
+typedef struct rmapper {
+    ether_conn_t*   fetch;           // Connection used by the fault thread
+    int             uffd;
+    int             wake_fd;         // eventfd: stops the fault thread
+    pthread_t       thread;
+    pthread_mutex_t lock;            // Guards regions and their bitmaps
+    rmap_region_t*  regions;
+    uint8_t*        staging;         // RMAP_MAX_READAHEAD pages
+} rmapper_t;
+
+static rmap_region_t* rmap_find(rmapper_t* mapper, const void* addr) {
+    for (rmap_region_t* region = mapper->regions; region; region = region->next) {
+        const uint8_t* p = addr;
+        if (p >= region->addr && p < region->addr + region->map_len) {
+            return region;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Bytes of the block behind pages [page, page + count)
+ */
+static inline size_t rmap_span(const rmap_region_t* region, size_t page, size_t count) {
+    size_t start = page * RMAP_PAGE_SIZE;
+    size_t end = (page + count) * RMAP_PAGE_SIZE;
+    if (start >= region->size) return 0;
+    return (end < region->size ? end : region->size) - start;
+}
+
+/**
+ * Resolve one fault: fetch the faulting page (plus read-ahead when the
+ * access pattern is sequential) and copy it into the mapping
+ */
+static void rmap_fault(rmapper_t* mapper, uint64_t address) {
+    pthread_mutex_lock(&mapper->lock);
+
+    rmap_region_t* region = rmap_find(mapper, (const void*)(uintptr_t)address);
+    if (!region) {
+        pthread_mutex_unlock(&mapper->lock);
+        return;
+    }
+
+    size_t num_pages = region->map_len / RMAP_PAGE_SIZE;
+    size_t page = ((uint8_t*)(uintptr_t)address - region->addr) / RMAP_PAGE_SIZE;
+    uint64_t page_addr = (uintptr_t)(region->addr + page * RMAP_PAGE_SIZE);
+
+    // Duplicate fault (another thread hit the page before it was mapped):
+    // the page is in, just make sure the faulting thread runs again
+    if (bit_test(region->populated, page)) {
+        struct uffdio_range range = { .start = page_addr, .len = RMAP_PAGE_SIZE };
+        ioctl(mapper->uffd, UFFDIO_WAKE, &range);
+        pthread_mutex_unlock(&mapper->lock);
+        return;
+    }
+
+    // Sequential access doubles the window, anything else resets it
+    if (page == region->next_page) {
+        region->window = region->window * 2 < RMAP_MAX_READAHEAD
+                             ? region->window * 2 : RMAP_MAX_READAHEAD;
+    } else {
+        region->window = 1;
+    }
+
+    size_t count = 1;
+    while (count < region->window && page + count < num_pages &&
+           !bit_test(region->populated, page + count)) {
+        count++;
+    }
+
+    size_t len = rmap_span(region, page, count);
+    memset(mapper->staging, 0, count * RMAP_PAGE_SIZE);
+
+    ether_future_t future;
+    memset(&future, 0, sizeof(future));
+    int ret = ETHER_OK;
+    if (len > 0) {
+        remote_read(mapper->fetch, &future, region->handle, page * RMAP_PAGE_SIZE,
+                    mapper->staging, len);
+        ret = future_wait(&future);
+        if (ret == ETHER_OK && future.received != len) ret = ETHER_ERR_CORRUPT;
+    }
+    if (ret != ETHER_OK) {
+        // The faulting thread cannot be failed: map zeros, refuse write-back
+        memset(mapper->staging, 0, count * RMAP_PAGE_SIZE);
+        region->error = ret;
+    }
+
+    // The copy may stop short (EAGAIN while the address space changes,
+    // EEXIST on a page mapped meanwhile): only pages actually mapped count
+    // as populated, or write-back would fault on them under the lock
+    size_t total = count * RMAP_PAGE_SIZE;
+    size_t copied = 0;
+    while (copied < total) {
+        struct uffdio_copy copy = {
+            .dst = page_addr + copied,
+            .src = (uintptr_t)(mapper->staging + copied),
+            .len = total - copied,
+        };
+        int rc = ioctl(mapper->uffd, UFFDIO_COPY, &copy);
+        if (copy.copy > 0) copied += (size_t)copy.copy;
+        if (rc == 0 || errno != EAGAIN) break;
+    }
+
+    size_t mapped = copied / RMAP_PAGE_SIZE;
+    memcpy(region->twins + page * RMAP_PAGE_SIZE, mapper->staging, mapped * RMAP_PAGE_SIZE);
+    for (size_t i = 0; i < mapped; i++) {
+        bit_set(region->populated, page + i);
+    }
+    region->next_page = page + mapped;
+
+    if (mapped == 0) {
+        // Nothing mapped: wake the thread anyway, its retry faults again
+        struct uffdio_range range = { .start = page_addr, .len = RMAP_PAGE_SIZE };
+        ioctl(mapper->uffd, UFFDIO_WAKE, &range);
+    }
+
+    pthread_mutex_unlock(&mapper->lock);
+}
+
+static void* rmap_thread(void* arg) {
+    rmapper_t* mapper = arg;
+
+    for (;;) {
+        struct pollfd pfd[2] = {
+            { .fd = mapper->uffd, .events = POLLIN },
+            { .fd = mapper->wake_fd, .events = POLLIN },
+        };
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (pfd[1].revents & POLLIN) break;
+        if (!(pfd[0].revents & POLLIN)) continue;
+
+        struct uffd_msg msg;
+        ssize_t n = read(mapper->uffd, &msg, sizeof(msg));
+        if (n != (ssize_t)sizeof(msg)) continue;
+
+        if (msg.event == UFFD_EVENT_PAGEFAULT) {
+            rmap_fault(mapper, msg.arg.pagefault.address);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Create the connection's fault handler on first use
+ */
+static rmapper_t* rmapper_get(ether_conn_t* conn) {
+    if (conn->mapper) return conn->mapper;
+
+    rmapper_t* mapper = calloc(1, sizeof(rmapper_t));
+    if (!mapper) return NULL;
+    mapper->uffd = -1;
+    mapper->wake_fd = -1;
+
+    mapper->staging = mmap(NULL, RMAP_MAX_READAHEAD * RMAP_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapper->staging == MAP_FAILED) {
+        free(mapper);
+        return NULL;
+    }
+
+    struct uffdio_api api = { .api = UFFD_API };
+    mapper->uffd = (int)syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK);
+    mapper->wake_fd = eventfd(0, EFD_CLOEXEC);
+    mapper->fetch = ether_connect(conn->host, conn->port);
+
+    if (mapper->uffd < 0 || ioctl(mapper->uffd, UFFDIO_API, &api) != 0 ||
+        mapper->wake_fd < 0 || !mapper->fetch) {
+        goto fail;
+    }
+    if (conn->compress) {
+        ether_set_compression(mapper->fetch, 1);
+    }
+
+    pthread_mutex_init(&mapper->lock, NULL);
+    if (pthread_create(&mapper->thread, NULL, rmap_thread, mapper) != 0) {
+        pthread_mutex_destroy(&mapper->lock);
+        goto fail;
+    }
+
+    conn->mapper = mapper;
+    return mapper;
+
+fail:
+    if (mapper->uffd >= 0) close(mapper->uffd);
+    if (mapper->wake_fd >= 0) close(mapper->wake_fd);
+    ether_disconnect(mapper->fetch);
+    munmap(mapper->staging, RMAP_MAX_READAHEAD * RMAP_PAGE_SIZE);
+    free(mapper);
+    return NULL;
+}
+
+typedef struct {
+    size_t first;   // First page of a run written back
+    size_t count;
+} rmap_run_t;
+
+/**
+ * Whether a page was modified since it was copied in (or last written
+ * back), or its last write-back failed
+ */
+static int rmap_changed(const rmap_region_t* region, size_t page) {
+    if (!bit_test(region->populated, page)) return 0;
+    if (bit_test(region->unsynced, page)) return 1;
+
+    size_t offset = page * RMAP_PAGE_SIZE;
+    return memcmp(region->addr + offset, region->twins + offset, RMAP_PAGE_SIZE) != 0;
+}
+
+/**
+ * Run a write-back batch. Runs are sent from their twins, refreshed when
+ * the run was queued, so a store racing with the write-back shows up as
+ * a difference next time; pages of a run that failed stay unsynced.
+ */
+static int rmap_send(ether_batch_t* batch, rmap_region_t* region, const rmap_run_t* runs,
+                     int num_runs) {
+    int ret = ether_batch_exec(batch);
+    int first_error = ETHER_OK;
+
+    for (int i = 0; i < num_runs; i++) {
+        int result = (ret == ETHER_OK) ? ether_batch_result(batch, i) : ret;
+        if (result != ETHER_OK) {
+            if (first_error == ETHER_OK) first_error = result;
+            continue;
+        }
+        for (size_t p = runs[i].first; p < runs[i].first + runs[i].count; p++) {
+            bit_clear(region->unsynced, p);
+        }
+    }
+
+    ether_batch_destroy(batch);
+    return first_error;
+}
+
+/**
+ * Send every copied-in page that changed, in as few BATCH
+ * requests as possible (one unless they exceed ETHER_MAX_PAYLOAD)
+ *
+ * Called with the mapper lock held, so no page is copied in meanwhile.
+ */
+static int rmap_writeback(ether_conn_t* conn, rmap_region_t* region) {
+    if (region->error != ETHER_OK) return region->error;
+
+    size_t num_pages = region->map_len / RMAP_PAGE_SIZE;
+    size_t max_run = ETHER_STREAM_CHUNK / RMAP_PAGE_SIZE;
+
+    ether_batch_t* batch = NULL;
+    rmap_run_t* runs = NULL;
+    int num_runs = 0;
+    int cap_runs = 0;
+    int ret = ETHER_OK;
+
+    size_t page = 0;
+    while (ret == ETHER_OK) {
+        while (page < num_pages && !rmap_changed(region, page)) page++;
+        if (page == num_pages) break;
+
+        size_t end = page + 1;
+        while (end < num_pages && end - page < max_run && rmap_changed(region, end)) {
+            end++;
+        }
+
+        // Snapshot the run: the twin is what gets sent, and what the
+        // server holds once it is acknowledged
+        size_t offset = page * RMAP_PAGE_SIZE;
+        memcpy(region->twins + offset, region->addr + offset, (end - page) * RMAP_PAGE_SIZE);
+        for (size_t p = page; p < end; p++) {
+            bit_set(region->unsynced, p);
+        }
+
+        if (!batch && !(batch = ether_batch_create(conn))) {
+            ret = ETHER_ERR_NOMEM;
+            break;
+        }
+
+        int op = ether_batch_write_at(batch, region->ptr, offset, region->twins + offset,
+                                      rmap_span(region, page, end - page));
+        if (op == ETHER_ERR_OVERFLOW && num_runs > 0) {
+            // Batch is full: send it, then retry this run in a new one
+            ret = rmap_send(batch, region, runs, num_runs);
+            batch = NULL;
+            num_runs = 0;
+            continue;
+        }
+        if (op < 0) {
+            ret = op;
+            break;
+        }
+
+        if (num_runs == cap_runs) {
+            int cap = cap_runs ? cap_runs * 2 : 16;
+            rmap_run_t* grown = realloc(runs, (size_t)cap * sizeof(rmap_run_t));
+            if (!grown) {
+                ret = ETHER_ERR_NOMEM;
+                break;
+            }
+            runs = grown;
+            cap_runs = cap;
+        }
+        runs[num_runs++] = (rmap_run_t){ page, end - page };
+        page = end;
+    }
+
+    if (batch) {
+        if (ret == ETHER_OK) {
+            ret = rmap_send(batch, region, runs, num_runs);
+        } else {
+            ether_batch_destroy(batch);
+        }
+    }
+
+    free(runs);
+    return ret;
+}
+
+/**
+ * Write back, unregister and unmap one region (lock held)
+ */
+static int rmap_release(ether_conn_t* conn, rmapper_t* mapper, rmap_region_t* region) {
+    int ret = rmap_writeback(conn, region);
+
+    struct uffdio_range range = { .start = (uintptr_t)region->addr, .len = region->map_len };
+    ioctl(mapper->uffd, UFFDIO_UNREGISTER, &range);
+    munmap(region->addr, region->map_len);
+
+    for (rmap_region_t** link = &mapper->regions; *link; link = &(*link)->next) {
+        if (*link == region) {
+            *link = region->next;
+            break;
+        }
+    }
+    munmap(region->twins, region->map_len);
+    free(region->populated);
+    free(region->unsynced);
+    free(region);
+    return ret;
+}
+
+/**
+ * Unmap everything (writing it back) and stop the fault thread
+ */
+static void rmapper_destroy(ether_conn_t* conn) {
+    rmapper_t* mapper = conn->mapper;
+
+    pthread_mutex_lock(&mapper->lock);
+    while (mapper->regions) {
+        rmap_release(conn, mapper, mapper->regions);
+    }
+    pthread_mutex_unlock(&mapper->lock);
+
+    uint64_t one = 1;
+    if (write(mapper->wake_fd, &one, sizeof(one)) == sizeof(one)) {
+        pthread_join(mapper->thread, NULL);
+    }
+
+    pthread_mutex_destroy(&mapper->lock);
+    close(mapper->uffd);
+    close(mapper->wake_fd);
+    ether_disconnect(mapper->fetch);
+    munmap(mapper->staging, RMAP_MAX_READAHEAD * RMAP_PAGE_SIZE);
+    free(mapper);
+    conn->mapper = NULL;
+}
+
+// =============================================================================
+// PUBLIC API - CONNECTION
+// =============================================================================
+
+#define UNIX_PREFIX      "unix:"
+#define UNIX_PREFIX_LEN  (sizeof(UNIX_PREFIX) - 1)
+
+/**
+ * Open a TCP connection to host:port
+ *
+ * @return  Socket, -1 on failure
+ */
+static int connect_tcp(const char* host, int port) {
+    // Resolve hostname to IP address
+    struct hostent* he = gethostbyname(host);
+    if (!he) {
+        return -1;
+    }
+
+    // Create TCP socket
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    // Connect to server
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    memcpy(&addr.sin_addr, he->h_addr, he->h_length);
+
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Open a connection to the Unix domain socket at path (etherd --unix)
+ *
+ * @return  Socket, -1 on failure
+ */
+static int connect_unix(const char* path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Open the socket of a connection to conn->host / conn->port
+ *
+ * @return  0 on success, -1 on failure
+ */
+static int conn_open(ether_conn_t* conn) {
+    if (strncmp(conn->host, UNIX_PREFIX, UNIX_PREFIX_LEN) == 0) {
+        conn->socket = connect_unix(conn->host + UNIX_PREFIX_LEN);
+        conn->local = 1;
+    } else {
+        conn->socket = connect_tcp(conn->host, conn->port);
+    }
+    return conn->socket < 0 ? -1 : 0;
+}
+
+ether_conn_t* ether_connect(const char* host, int port) {
+    if (!host) return NULL;
+
+    ether_conn_t* conn = calloc(1, sizeof(ether_conn_t));
+    if (!conn) return NULL;
+
+    // The full endpoint is kept: ether_rmap() opens a second connection to
+    // it, and a pool reconnects with it
+    strncpy(conn->host, host, sizeof(conn->host) - 1);
+    conn->port = port;
+
+    if (conn_open(conn) != 0) {
+        free(conn);
+        return NULL;
+    }
+
+    ether_buf_pool_init(&conn->pool);
+    conn->connected = 1;
+    return conn;
+}
+
+void ether_disconnect(ether_conn_t* conn) {
+    if (!conn) return;
+
+    // Write-back cache: push what is still dirty (best effort)
+    if (conn->connected && conn->num_dirty > 0) {
+        ether_rsync(conn);
+    }
+
+    // Mapped blocks are written back and unmapped first
+    if (conn->mapper) {
+        rmapper_destroy(conn);
+    }
+
+    // Outstanding futures complete with ETHER_ERR_NETWORK
+    conn_fail(conn);
+    for (size_t i = 0; i < conn->num_dirty; i++) {
+        conn->dirty[i]->dirty_slot = 0;
+    }
+    free(conn->dirty);
+    ether_buf_pool_destroy(&conn->pool);
+    free(conn);
+}
+
+/**
+ * PING the server, offering compression or not; the PONG says whether
+ * the server accepted
+ */
+static int ping(ether_conn_t* conn, int compress, int* accepted) {
+    ether_msg_header_t header;
+    init_header(&header, ETHER_CMD_PING, 0, 0);
+    if (compress) header.flags = ETHER_FLAG_COMPRESSED;
+
+    ether_future_t future;
+    memset(&future, 0, sizeof(future));
+    submit(conn, &future, &header, NULL, 0, NULL, 0);
+    int ret = future_wait(&future);
+
+    *accepted = ret == ETHER_OK && (future.flags & ETHER_FLAG_COMPRESSED);
+    return ret;
+}
+
+int ether_ping(ether_conn_t* conn) {
+    if (!conn || !conn->connected) return -1;
+
+    // Send PING, wait for PONG (keeping the negotiated compression)
+    int accepted;
+    if (ping(conn, conn->compress, &accepted) != ETHER_OK) return -1;
+    conn->compress = accepted;
+    return 0;
+}
+
+int ether_set_compression(ether_conn_t* conn, int enable) {
+    if (!conn) return ETHER_ERR_INVALID;
+    if (!conn->connected) return ETHER_ERR_NETWORK;
+
+    int accepted;
+    int ret = ping(conn, enable != 0, &accepted);
+    if (ret != ETHER_OK) return ret;
+
+    conn->compress = accepted;
+    return (enable && !accepted) ? ETHER_ERR_INVALID : ETHER_OK;
+}
+
+int ether_server_stats(ether_conn_t* conn, ether_server_stats_t* stats, size_t max) {
+    if (!conn || !stats || max == 0) return ETHER_ERR_INVALID;
+    if (!conn->connected) return ETHER_ERR_NETWORK;
+
+    if (max > ETHER_MAX_PAYLOAD / ETHER_STATS_RECORD_SIZE) {
+        max = ETHER_MAX_PAYLOAD / ETHER_STATS_RECORD_SIZE;
+    }
+    size_t records_size = max * ETHER_STATS_RECORD_SIZE;
+    uint8_t* records = ether_buf_get(&conn->pool, records_size);
+    if (!records) return ETHER_ERR_NOMEM;
+
+    ether_future_t future;
+    memset(&future, 0, sizeof(future));
+    future.buffer = records;
+    future.len = max * ETHER_STATS_RECORD_SIZE;
+
+    ether_msg_header_t header;
+    init_header(&header, ETHER_CMD_STATS, 0, 0);
+    submit(conn, &future, &header, NULL, 0, NULL, 0);
+    int ret = future_wait(&future);
+
+    if (ret == ETHER_OK) {
+        size_t count = future.received / ETHER_STATS_RECORD_SIZE;
+        for (size_t i = 0; i < count; i++) {
+            ether_stats_record_t rec;
+            ether_stats_record_deserialize(records + i * ETHER_STATS_RECORD_SIZE, &rec);
+            stats[i].command = rec.command;
+            stats[i].count = rec.count;
+            stats[i].errors = rec.errors;
+            stats[i].bytes_in = rec.bytes_in;
+            stats[i].bytes_out = rec.bytes_out;
+            stats[i].p50_ns = rec.p50_ns;
+            stats[i].p99_ns = rec.p99_ns;
+            stats[i].p999_ns = rec.p999_ns;
+        }
+        ret = (int) count;
+    }
+
+    ether_buf_put(&conn->pool, records, records_size);
+    return ret;
+}
+
+int ether_server_meminfo(ether_conn_t* conn, ether_server_meminfo_t* info) {
+    if (!conn || !info) return ETHER_ERR_INVALID;
+    if (!conn->connected) return ETHER_ERR_NETWORK;
+
+    uint8_t record[ETHER_MEMINFO_RECORD_SIZE];
+    ether_future_t future;
+    memset(&future, 0, sizeof(future));
+    future.buffer = record;
+    future.len = sizeof(record);
+
+    ether_msg_header_t header;
+    init_header(&header, ETHER_CMD_MEMINFO, 0, 0);
+    submit(conn, &future, &header, NULL, 0, NULL, 0);
+    int ret = future_wait(&future);
+
+    if (ret == ETHER_OK) {
+        if (future.received != sizeof(record)) return ETHER_ERR_CORRUPT;
+
+        ether_meminfo_record_t rec;
+        ether_meminfo_record_deserialize(record, &rec);
+        info->used = rec.used;
+        info->peak = rec.peak;
+        info->available = rec.available;
+        info->blocks = rec.blocks;
+    }
+    return ret;
+}
+
+int ether_set_shadow_mode(ether_conn_t* conn, ether_shadow_mode_t mode) {
+    if (!conn || (mode != ETHER_SHADOW_FULL && mode != ETHER_SHADOW_LAZY &&
+                  mode != ETHER_SHADOW_SHARED)) {
+        return ETHER_ERR_INVALID;
+    }
+
+    // The memfd can only be passed over a Unix domain socket
+    if (mode == ETHER_SHADOW_SHARED && !conn->local) {
+        return ETHER_ERR_INVALID;
+    }
+
+    conn->shadow_mode = mode;
+    return ETHER_OK;
+}
+
+int ether_set_cache_mode(ether_conn_t* conn, ether_cache_mode_t mode) {
+    if (!conn || (mode != ETHER_CACHE_NONE && mode != ETHER_CACHE_WRITEBACK)) {
+        return ETHER_ERR_INVALID;
+    }
+
+    // The dirty list belongs to one connection, pooled blocks to all of them
+    if (mode == ETHER_CACHE_WRITEBACK && conn->owner) {
+        return ETHER_ERR_INVALID;
+    }
+
+    conn->cache_mode = mode;
+    return ETHER_OK;
+}
+
+// =============================================================================
+// PUBLIC API - CONNECTION POOL
+// =============================================================================
+
+/**
+ * A connection is checked out by one thread at a time, so ether_conn_t
+ * itself needs no lock: acquire/release is the only synchronization, and
+ * on the fast path it is a single compare-and-swap on the slot state.
+ *
+ *   IDLE --acquire--> BUSY --release--> IDLE
+ *                      |
+ *                      +--release, connection failed--> DEAD --reconnected--> IDLE
+ *
+ * DEAD slots belong to the pool's reconnect thread, which reopens them in
+ * the background with exponential backoff. The ether_conn_t is reopened
+ * in place, so pointers to blocks it allocated stay valid: shadow headers
+ * point at it, and handles live on the server, not in the socket.
+ */
+#define POOL_MAX_SIZE      256
+#define POOL_RETRY_MIN_MS  10
+#define POOL_RETRY_MAX_MS  1000
+
+// TCP keepalive: probe after 30 s idle, every 10 s, give up after 3
+#define POOL_KEEPIDLE   30
+#define POOL_KEEPINTVL  10
+#define POOL_KEEPCNT    3
+
+enum {
+    SLOT_IDLE,     // Live, free to acquire
+    SLOT_BUSY,     // Checked out by a thread
+    SLOT_DEAD,     // Failed, waiting for the reconnect thread
+};
+
+struct ether_pool {
+    ether_conn_t**  conns;
+    atomic_int*     states;          // SLOT_* of each connection
+    size_t          size;
+    atomic_size_t   live;            // Slots not DEAD
+    atomic_int      waiters;         // Threads blocked in ether_pool_acquire()
+
+    pthread_mutex_t lock;
+    pthread_cond_t  freed;           // A slot became IDLE, or one died
+    pthread_cond_t  failed;          // A slot became DEAD (reconnect thread)
+    int             running;
+    pthread_t       thread;
+};
+
+/**
+ * Slot a thread tries first: threads are spread round-robin, and a thread
+ * keeps getting the same connection while nobody else holds it
+ */
+static atomic_uint g_pool_threads;
+static _Thread_local unsigned t_pool_hint;
+
+static inline unsigned pool_hint(void) {
+    if (t_pool_hint == 0) {
+        t_pool_hint = atomic_fetch_add(&g_pool_threads, 1) + 1;
+    }
+    return t_pool_hint - 1;
+}
+
+/**
+ * Latency and liveness settings of a pooled TCP connection: requests are
+ * written whole, so Nagle only delays them, and keepalive notices a dead
+ * peer on an idle connection
+ */
+static void pool_tune(ether_conn_t* conn) {
+    if (conn->local) return;
+
+    int on = 1, idle = POOL_KEEPIDLE, intvl = POOL_KEEPINTVL, cnt = POOL_KEEPCNT;
+    setsockopt(conn->socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    setsockopt(conn->socket, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+    setsockopt(conn->socket, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+    setsockopt(conn->socket, IPPROTO_TCP, TCP_KEEPINTVL, &intvl, sizeof(intvl));
+    setsockopt(conn->socket, IPPROTO_TCP, TCP_KEEPCNT, &cnt, sizeof(cnt));
+}
+
+/**
+ * Reopen a failed connection in place, renegotiating compression
+ *
+ * @return  0 on success, -1 on failure (still disconnected)
+ */
+static int conn_reopen(ether_conn_t* conn) {
+    if (conn_open(conn) != 0) {
+        return -1;
+    }
+    conn->connected = 1;
+    pool_tune(conn);
+
+    int accepted;
+    if (conn->compress && ping(conn, 1, &accepted) != ETHER_OK) {
+        conn_fail(conn);
+        return -1;
+    }
+    if (conn->compress) conn->compress = accepted;
+    return 0;
+}
+
+/**
+ * Check out an IDLE slot, starting at the caller's preferred one
+ */
+static ether_conn_t* pool_try(ether_pool_t* pool) {
+    size_t first = pool_hint() % pool->size;
+    for (size_t i = 0; i < pool->size; i++) {
+        size_t slot = (first + i) % pool->size;
+        int idle = SLOT_IDLE;
+        if (atomic_load_explicit(&pool->states[slot], memory_order_relaxed) == SLOT_IDLE &&
+            atomic_compare_exchange_strong(&pool->states[slot], &idle, SLOT_BUSY)) {
+            return pool->conns[slot];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Wake threads waiting for a slot (the lock orders this against a waiter
+ * that is about to sleep)
+ */
+static void pool_wake(ether_pool_t* pool) {
+    if (atomic_load(&pool->waiters) > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->freed);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+static void* pool_thread(void* arg) {
+    ether_pool_t* pool = arg;
+    long backoff_ms = POOL_RETRY_MIN_MS;
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running) {
+        int dead = 0;
+        for (size_t i = 0; i < pool->size; i++) {
+            if (atomic_load(&pool->states[i]) != SLOT_DEAD) continue;
+
+            // Connecting may block: not under the lock
+            pthread_mutex_unlock(&pool->lock);
+            int ok = conn_reopen(pool->conns[i]) == 0;
+            if (ok) {
+                atomic_fetch_add(&pool->live, 1);
+                atomic_store(&pool->states[i], SLOT_IDLE);
+                pool_wake(pool);
+            }
+            pthread_mutex_lock(&pool->lock);
+            dead += !ok;
+        }
+
+        if (!pool->running) break;
+        if (!dead) {
+            backoff_ms = POOL_RETRY_MIN_MS;
+            pthread_cond_wait(&pool->failed, &pool->lock);
+            continue;
+        }
+
+        // Server still unreachable: retry later, or as soon as another dies
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += backoff_ms / 1000;
+        deadline.tv_nsec += (backoff_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&pool->failed, &pool->lock, &deadline);
+        backoff_ms = backoff_ms * 2 < POOL_RETRY_MAX_MS ? backoff_ms * 2 : POOL_RETRY_MAX_MS;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+ether_pool_t* ether_pool_create(const char* host, int port, size_t size) {
+    if (!host || size == 0 || size > POOL_MAX_SIZE) return NULL;
+
+    ether_pool_t* pool = calloc(1, sizeof(ether_pool_t));
+    if (!pool) return NULL;
+    pool->conns = calloc(size, sizeof(ether_conn_t*));
+    pool->states = calloc(size, sizeof(atomic_int));
+    if (!pool->conns || !pool->states) {
+        free(pool->conns);
+        free(pool->states);
+        free(pool);
+        return NULL;
+    }
+    pool->size = size;
+
+    // A connection that cannot be opened now starts DEAD and is retried
+    // in the background; the server must be reachable for at least one
+    size_t live = 0;
+    for (size_t i = 0; i < size; i++) {
+        ether_conn_t* conn = ether_connect(host, port);
+        if (!conn) {
+            conn = calloc(1, sizeof(ether_conn_t));
+            if (conn) {
+                strncpy(conn->host, host, sizeof(conn->host) - 1);
+                conn->port = port;
+                conn->socket = -1;
+                ether_buf_pool_init(&conn->pool);
+            }
+        }
+        if (!conn) {
+            for (size_t j = 0; j < i; j++) ether_disconnect(pool->conns[j]);
+            free(pool->conns);
+            free(pool->states);
+            free(pool);
+            return NULL;
+        }
+
+        conn->owner = pool;
+        conn->slot = i;
+        pool->conns[i] = conn;
+        if (conn->connected) {
+            pool_tune(conn);
+            atomic_init(&pool->states[i], SLOT_IDLE);
+            live++;
+        } else {
+            atomic_init(&pool->states[i], SLOT_DEAD);
+        }
+    }
+    atomic_init(&pool->live, live);
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->freed, NULL);
+    pthread_cond_init(&pool->failed, NULL);
+    pool->running = 1;
+
+    if (live == 0 || pthread_create(&pool->thread, NULL, pool_thread, pool) != 0) {
+        pool->running = 0;
+        for (size_t i = 0; i < size; i++) ether_disconnect(pool->conns[i]);
+        pthread_cond_destroy(&pool->failed);
+        pthread_cond_destroy(&pool->freed);
+        pthread_mutex_destroy(&pool->lock);
+        free(pool->conns);
+        free(pool->states);
+        free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void ether_pool_destroy(ether_pool_t* pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->running = 0;
+    pthread_cond_signal(&pool->failed);
+    pthread_mutex_unlock(&pool->lock);
+    pthread_join(pool->thread, NULL);
+
+    for (size_t i = 0; i < pool->size; i++) {
+        ether_disconnect(pool->conns[i]);
+    }
+    pthread_cond_destroy(&pool->failed);
+    pthread_cond_destroy(&pool->freed);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->conns);
+    free(pool->states);
+    free(pool);
+}
+
+ether_conn_t* ether_pool_acquire(ether_pool_t* pool) {
+    if (!pool) return NULL;
+
+    ether_conn_t* conn = pool_try(pool);
+    if (conn) return conn;
+
+    // Every connection is busy: wait for a release, unless none is live
+    // (then fail now rather than stall until the server is back)
+    pthread_mutex_lock(&pool->lock);
+    atomic_fetch_add(&pool->waiters, 1);
+    while (!(conn = pool_try(pool)) && atomic_load(&pool->live) > 0) {
+        pthread_cond_wait(&pool->freed, &pool->lock);
+    }
+    atomic_fetch_sub(&pool->waiters, 1);
+    pthread_mutex_unlock(&pool->lock);
+    return conn;
+}
+
+void ether_pool_release(ether_pool_t* pool, ether_conn_t* conn) {
+    if (!pool || !conn || conn->owner != pool) return;
+
+    if (conn->connected) {
+        atomic_store(&pool->states[conn->slot], SLOT_IDLE);
+        pool_wake(pool);
+        return;
+    }
+
+    // Failed while checked out: hand it to the reconnect thread
+    atomic_store(&pool->states[conn->slot], SLOT_DEAD);
+    atomic_fetch_sub(&pool->live, 1);
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->failed);
+    pthread_cond_broadcast(&pool->freed);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+size_t ether_pool_live(ether_pool_t* pool) {
+    return pool ? atomic_load(&pool->live) : 0;
+}
+
+// =============================================================================
+// SHARED BLOCKS
+// =============================================================================
+
+/**
+ * Map a shared block: SHARE passes its memfd, which is mapped over a lazy
+ * reservation in place of a local copy. The mapping keeps the file alive,
+ * so the fd is closed right away.
+ *
+ * @return  Local buffer (the block itself), NULL on failure
+ */
+static void* share_map(ether_conn_t* conn, uint64_t handle, size_t size) {
+    uint8_t reply[ETHER_SHARE_SIZE];
+    ether_future_t future;
+    memset(&future, 0, sizeof(future));
+    future.fd = -1;
+    future.buffer = reply;
+    future.len = sizeof(reply);
+
+    ether_msg_header_t header;
+    init_header(&header, ETHER_CMD_SHARE, handle, 0);
+    int ret = submit(conn, &future, &header, NULL, 0, NULL, 0);
+    if (ret == ETHER_OK) {
+        ret = future_wait(&future);
+    }
+
+    // The server may have grown the file past the block, never short of it
+    size_t data_len = lazy_map_len(size) - page_size();
+    shadow_header_t* shadow = NULL;
+    if (ret == ETHER_OK && future.fd >= 0 && future.received == ETHER_SHARE_SIZE &&
+        ether_msg_deserialize_offset(reply) >= data_len) {
+        shadow = lazy_reserve(size);
+        if (shadow && mmap(shadow + 1, data_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+                           future.fd, 0) == MAP_FAILED) {
+            munmap((uint8_t*)(shadow + 1) - page_size(), lazy_map_len(size));
+            shadow = NULL;
+        }
+    }
+    if (future.fd >= 0) {
+        close(future.fd);
+    }
+    if (!shadow) {
+        return NULL;
+    }
+
+    shadow->magic = SHADOW_MAGIC;
+    shadow->flags = SHADOW_LAZY | SHADOW_SHARED;
+    shadow->conn = conn;
+    shadow->remote_handle = handle;
+    shadow->size = size;
+    return shadow + 1;
+}
+
+// =============================================================================
+// PUBLIC API - REMOTE MEMORY
+// =============================================================================
+
+void* ether_rmalloc(ether_conn_t* conn, size_t size) {
+    return ether_rmalloc_ex(conn, size, 0);
+}
+
+void* ether_rmalloc_ex(ether_conn_t* conn, size_t size, unsigned flags) {
+    if (!conn || !conn->connected || size == 0 || size > UINT32_MAX ||
+        (flags & ~ETHER_RMALLOC_HUGE)) {
+        return NULL;
+    }
+
+    // 1. Send ALLOC request (size in header) and wait for the handle
+    ether_msg_header_t header;
+    init_header(&header, ETHER_CMD_ALLOC, 0, (uint32_t)size);
+    if (flags & ETHER_RMALLOC_HUGE) {
+        header.flags = ETHER_FLAG_HUGE;
+    }
+    if (conn->shadow_mode == ETHER_SHADOW_SHARED) {
+        header.flags |= ETHER_FLAG_SHARED;
+    }
+
+    ether_future_t future;
+    memset(&future, 0, sizeof(future));
+    conn->last_error = submit(conn, &future, &header, NULL, 0, NULL, 0);
+    if (conn->last_error == ETHER_OK) {
+        conn->last_error = future_wait(&future);
+    }
+    if (conn->last_error != ETHER_OK) {
+        return NULL;
+    }
+
+    // 2. Allocate local buffer for user convenience (or map the block
+    //    itself); its hidden header maps local_ptr -> remote_handle
+    void* local_ptr = (conn->shadow_mode == ETHER_SHADOW_SHARED)
+                          ? share_map(conn, future.handle, size)
+                          : cache_store(conn, future.handle, size);
+    if (!local_ptr) {
+        // Nothing will ever name this block again: give it back
+        ether_future_t freed;
+        call(conn, &freed, ETHER_CMD_FREE, future.handle, 0);
+        conn->last_error = ETHER_ERR_NOMEM;
+        return NULL;
+    }
+
+    return local_ptr;
+}
+
+void ether_rfree(ether_conn_t* conn, void* ptr) {
+    if (!conn || !conn->connected || !ptr) return;
+
+    // Look up remote handle
+    uint64_t handle = cache_lookup(conn, ptr, NULL);
+    if (handle == 0) return;
+
+    // Send FREE request, wait for confirmation (ignore errors)
+    ether_future_t future;
+    call(conn, &future, ETHER_CMD_FREE, handle, 0);
+
+    // Clean up local resources
+    cache_remove(ptr);
+}
+
+void* ether_rrealloc(ether_conn_t* conn, void* ptr, size_t size) {
+    if (!ptr) {
+        return ether_rmalloc(conn, size);
+    }
+    if (size == 0) {
+        ether_rfree(conn, ptr);
+        return NULL;
+    }
+    if (!conn || !conn->connected || size > UINT32_MAX) {
+        return NULL;
+    }
+
+    uint64_t handle = cache_lookup(conn, ptr, NULL);
+    if (handle == 0) return NULL;
+
+    // The server resizes (or moves) the block itself; the handle stays
+    ether_future_t future;
+    conn->last_error = call(conn, &future, ETHER_CMD_REALLOC, handle, (uint32_t)size);
+    if (conn->last_error != ETHER_OK) {
+        return NULL;
+    }
+
+    // A moved shared block is a new memfd: map it anew. If that fails the
+    // old mapping stays, reading zeros.
+    shadow_header_t* shadow = shadow_header(ptr);
+    if (shadow->flags & SHADOW_SHARED) {
+        void* mapped = share_map(conn, handle, size);
+        if (!mapped) {
+            conn->last_error = ETHER_ERR_NOMEM;
+            return NULL;
+        }
+        cache_remove(ptr);
+        return mapped;
+    }
+
+    void* resized = cache_resize(ptr, size);
+    if (!resized) conn->last_error = ETHER_ERR_NOMEM;
+    return resized;
+}
+
+int ether_last_error(ether_conn_t* conn) {
+    return conn ? conn->last_error : ETHER_ERR_INVALID;
+}
+
+/**
+ * Validate and send a WRITE; the future completes when the server answers
+ */
+static int rwrite_submit(ether_conn_t* conn, ether_future_t* future, void* ptr,
+                         size_t offset, const void* data, size_t len) {
+    memset(future, 0, sizeof(*future));
+
+    if (!conn || !conn->connected || !ptr || !data) {
+        future_finish(future, ETHER_ERR_INVALID);
+        return ETHER_ERR_INVALID;
+    }
+
+    // Look up remote handle
+    size_t block_size;
+    uint64_t handle = cache_lookup(conn, ptr, &block_size);
+    if (handle == 0) {
+        future_finish(future, ETHER_ERR_NOTFOUND);
+        return ETHER_ERR_NOTFOUND;
+    }
+
+    // Bounds check
+    if (offset > block_size || len > block_size - offset) {
+        future_finish(future, ETHER_ERR_OVERFLOW);
+        return ETHER_ERR_OVERFLOW;
+    }
+
+    // Shared blocks are written in place; cached ones buffer the write
+    // until the next flush
+    shadow_header_t* shadow = shadow_header(ptr);
+    if (shadow->flags & SHADOW_SHARED) {
+        memmove((uint8_t*)ptr + offset, data, len);
+        future_finish(future, ETHER_OK);
+        return ETHER_OK;
+    }
+    if (shadow->pages) {
+        int ret = cache_write(conn, shadow, offset, data, len);
+        future_finish(future, ret);
+        return ret;
+    }
+
+    future->mirror = cache_mirror(ptr) ? (uint8_t*)ptr + offset : NULL;
+    future->data = data;
+    future->len = len;
+
+    // Large writes go out in chunks; the server lands each one in the block
+    if (len > ETHER_STREAM_CHUNK) {
+        return submit_stream(conn, future, ETHER_CMD_WRITE, handle, offset, data, len);
+    }
+
+    size_t prefix_len = offset > 0 ? ETHER_OFFSET_SIZE : 0;
+
+    // Header (+ offset) + user data go out in one sendmsg(), no staging copy
+    ether_msg_header_t header;
+    init_header(&header, ETHER_CMD_WRITE, handle, (uint32_t)(prefix_len + len));
+
+    uint8_t prefix[ETHER_OFFSET_SIZE];
+    if (prefix_len > 0) {
+        header.flags |= ETHER_FLAG_OFFSET;
+        ether_msg_serialize_offset(offset, prefix);
+    }
+
+    // Sent synchronously, so the compressed copy can go right after
+    uint8_t* packed;
+    size_t cap;
+    size_t n = pack_write(conn, data, len, &packed, &cap);
+    if (n > 0) {
+        header.flags |= ETHER_FLAG_COMPRESSED;
+        header.size = (uint32_t)(prefix_len + n);
+        int ret = submit(conn, future, &header, prefix, prefix_len, packed, n);
+        ether_buf_put(&conn->pool, packed, cap);
+        return ret;
+    }
+    return submit(conn, future, &header, prefix, prefix_len, data, len);
+}
+
+/**
+ * Validate and send a READ; the payload lands in buffer on completion
+ */
+static int rread_submit(ether_conn_t* conn, ether_future_t* future, void* ptr,
+                        size_t offset, void* buffer, size_t len) {
+    memset(future, 0, sizeof(*future));
+
+    if (!conn || !conn->connected || !ptr || !buffer) {
+        future_finish(future, ETHER_ERR_INVALID);
+        return ETHER_ERR_INVALID;
+    }
+
+    // Look up remote handle
+    size_t block_size;
+    uint64_t handle = cache_lookup(conn, ptr, &block_size);
+    if (handle == 0) {
+        future_finish(future, ETHER_ERR_NOTFOUND);
+        return ETHER_ERR_NOTFOUND;
+    }
+
+    if (offset > block_size) {
+        future_finish(future, ETHER_ERR_OVERFLOW);
+        return ETHER_ERR_OVERFLOW;
+    }
+
+    // Cap length to what is left of the block
+    if (len > block_size - offset) {
+        len = block_size - offset;
+    }
+
+    // Shared blocks are read in place; cached ones only go to the server
+    // for pages not cached yet
+    shadow_header_t* shadow = shadow_header(ptr);
+    if (shadow->flags & SHADOW_SHARED) {
+        memmove(buffer, (uint8_t*)ptr + offset, len);
+        future->received = len;
+        future_finish(future, ETHER_OK);
+        return ETHER_OK;
+    }
+    if (shadow->pages) {
+        int ret = cache_read(conn, shadow, offset, buffer, len);
+        future->received = (ret == ETHER_OK) ? len : 0;
+        future_finish(future, ret);
+        return ret;
+    }
+
+    return remote_read(conn, future, handle, offset, buffer, len);
+}
+
+int ether_rwrite(ether_conn_t* conn, void* ptr, const void* data, size_t len) {
+    return ether_rwrite_at(conn, ptr, 0, data, len);
+}
+
+int ether_rread(ether_conn_t* conn, void* ptr, void* buffer, size_t len) {
+    return ether_rread_at(conn, ptr, 0, buffer, len);
+}
+
+int ether_rwrite_at(ether_conn_t* conn, void* ptr, size_t offset, const void* data, size_t len) {
+    ether_future_t future;
+    rwrite_submit(conn, &future, ptr, offset, data, len);
+    return future_wait(&future);
+}
+
+int ether_rread_at(ether_conn_t* conn, void* ptr, size_t offset, void* buffer, size_t len) {
+    ether_future_t future;
+    rread_submit(conn, &future, ptr, offset, buffer, len);
+    return future_wait(&future);
+}
+
+size_t ether_rsize(ether_conn_t* conn, void* ptr) {
+    if (!conn || !ptr) return 0;
+
+    size_t size;
+    if (cache_lookup(conn, ptr, &size) == 0) {
+        return 0;
+    }
+    return size;
+}
+
+int ether_rflush(ether_conn_t* conn, void* ptr) {
+    if (!conn || !conn->connected || !ptr) return ETHER_ERR_INVALID;
+    if (cache_lookup(conn, ptr, NULL) == 0) return ETHER_ERR_NOTFOUND;
+
+    shadow_header_t* header = shadow_header(ptr);
+    if (!header->dirty_slot) return ETHER_OK;  // Uncached or clean
+
+    int ret = cache_flush(conn, &header, 1);
+    dirty_prune(conn);
+    return ret;
+}
+
+int ether_rsync(ether_conn_t* conn) {
+    if (!conn || !conn->connected) return ETHER_ERR_INVALID;
+    if (conn->num_dirty == 0) return ETHER_OK;
+
+    int ret = cache_flush(conn, conn->dirty, conn->num_dirty);
+    dirty_prune(conn);
+    return ret;
+}
+
+int ether_rinvalidate(ether_conn_t* conn, void* ptr) {
+    if (!conn || !ptr) return ETHER_ERR_INVALID;
+    if (cache_lookup(conn, ptr, NULL) == 0) return ETHER_ERR_NOTFOUND;
+
+    // Clean pages are refetched on next access; dirty ones stay valid
+    shadow_header_t* header = shadow_header(ptr);
+    if (header->pages) {
+        uint64_t* valid = cache_valid(header);
+        const uint64_t* dirty = cache_dirty(header);
+        for (size_t w = 0; w < cache_words(header->size); w++) {
+            valid[w] = dirty[w];
+        }
+    }
+    return ETHER_OK;
+}
+
+// =============================================================================
+// PUBLIC API - BULK OPERATIONS
+// =============================================================================
+
+/**
+ * Resolve a block operand of a bulk operation and check its range
+ *
+ * Dirty cached pages are written back first: the server works on its
+ * own copy of the block.
+ */
+static int bulk_operand(ether_conn_t* conn, void* ptr, size_t offset, size_t len,
+                        uint64_t* handle) {
+    if (!ptr) return ETHER_ERR_INVALID;
+
+    size_t block_size;
+    *handle = cache_lookup(conn, ptr, &block_size);
+    if (*handle == 0) return ETHER_ERR_NOTFOUND;
+
+    if (offset > block_size || len > block_size - offset) {
+        return ETHER_ERR_OVERFLOW;
+    }
+    return ether_rflush(conn, ptr);
+}
+
+/**
+ * Send a bulk request and wait for it
+ *
+ * @param tail   Bytes sent after the range record (FILL pattern)
+ * @param value  Output: the 8-byte value of a CMP / CHECKSUM reply (can be NULL)
+ */
+static int bulk_call(ether_conn_t* conn, ether_cmd_t cmd, uint64_t handle,
+                     const ether_bulk_record_t* op, const void* tail, size_t tail_len,
+                     uint64_t* value) {
+    uint8_t record[ETHER_BULK_RECORD_SIZE];
+    ether_bulk_record_serialize(op, record);
+
+    uint8_t reply[8];
+    ether_future_t future;
+    memset(&future, 0, sizeof(future));
+    if (value) {
+        future.buffer = reply;
+        future.len = sizeof(reply);
+    }
+
+    ether_msg_header_t header;
+    init_header(&header, cmd, handle, (uint32_t)(sizeof(record) + tail_len));
+    submit(conn, &future, &header, record, sizeof(record), tail, tail_len);
+
+    int ret = future_wait(&future);
+    if (ret == ETHER_OK && value) {
+        if (future.received != sizeof(reply)) return ETHER_ERR_INVALID;
+        *value = ether_msg_deserialize_offset(reply);
+    }
+    return ret;
+}
+
+/**
+ * Forget the cached pages overlapping [offset, offset + len), changed on
+ * the server behind the cache (they were just flushed, so none is dirty)
+ */
+static void cache_drop_range(shadow_header_t* header, size_t offset, size_t len) {
+    if (!header->pages || len == 0) return;
+
+    uint64_t* valid = cache_valid(header);
+    size_t last = (offset + len - 1) / CACHE_PAGE_SIZE;
+    for (size_t page = offset / CACHE_PAGE_SIZE; page <= last; page++) {
+        bit_clear(valid, page);
+    }
+}
+
+/**
+ * Repeat pattern over len bytes of dst, as FILL does on the server
+ */
+static void fill_pattern(uint8_t* dst, size_t len, const uint8_t* pattern, size_t pattern_len) {
+    if (pattern_len == 1) {
+        memset(dst, pattern[0], len);
+        return;
+    }
+
+    size_t filled = pattern_len < len ? pattern_len : len;
+    memcpy(dst, pattern, filled);
+    while (filled < len) {
+        size_t n = filled < len - filled ? filled : len - filled;
+        memcpy(dst + filled, dst, n);
+        filled += n;
+    }
+}
+
+int ether_rcopy(ether_conn_t* conn, void* dst, size_t dst_offset,
+                void* src, size_t src_offset, size_t len) {
+    if (!conn || !conn->connected) return ETHER_ERR_INVALID;
+
+    ether_bulk_record_t op = { .offset = dst_offset, .length = len, .offset2 = src_offset };
+    uint64_t dst_handle;
+    int ret = bulk_operand(conn, src, src_offset, len, &op.handle);
+    if (ret == ETHER_OK) ret = bulk_operand(conn, dst, dst_offset, len, &dst_handle);
+    if (ret != ETHER_OK) return ret;
+
+    ret = bulk_call(conn, ETHER_CMD_COPY, dst_handle, &op, NULL, 0, NULL);
+    if (ret != ETHER_OK) return ret;
+
+    // Keep the local side in step: cached pages are refetched, a plain
+    // mirror is copied like a write would have been. Only from a plain
+    // mirror of src: a page-cached one holds zeros where nothing was
+    // fetched yet, a lazy token holds nothing at all.
+    shadow_header_t* header = shadow_header(dst);
+    if (header->pages) {
+        cache_drop_range(header, dst_offset, len);
+    } else if (cache_mirror(dst) && cache_mirror(src) && !shadow_header(src)->pages) {
+        memmove((uint8_t*)dst + dst_offset, (uint8_t*)src + src_offset, len);
+    }
+    return ETHER_OK;
+}
+
+int ether_rfill(ether_conn_t* conn, void* ptr, size_t offset, size_t len,
+                const void* pattern, size_t pattern_len) {
+    if (!conn || !conn->connected || !pattern ||
+        pattern_len == 0 || pattern_len > ETHER_FILL_PATTERN_MAX) {
+        return ETHER_ERR_INVALID;
+    }
+
+    ether_bulk_record_t op = { .offset = offset, .length = len };
+    uint64_t handle;
+    int ret = bulk_operand(conn, ptr, offset, len, &handle);
+    if (ret != ETHER_OK) return ret;
+
+    ret = bulk_call(conn, ETHER_CMD_FILL, handle, &op, pattern, pattern_len, NULL);
+    if (ret != ETHER_OK) return ret;
+
+    shadow_header_t* header = shadow_header(ptr);
+    if (header->pages) {
+        cache_drop_range(header, offset, len);
+    } else if (cache_mirror(ptr)) {
+        fill_pattern((uint8_t*)ptr + offset, len, pattern, pattern_len);
+    }
+    return ETHER_OK;
+}
+
+int ether_rcmp(ether_conn_t* conn, void* a, size_t a_offset, void* b, size_t b_offset,
+               size_t len, int* order, size_t* mismatch) {
+    if (!conn || !conn->connected || !order) return ETHER_ERR_INVALID;
+
+    ether_bulk_record_t op = { .offset = a_offset, .length = len, .offset2 = b_offset };
+    uint64_t a_handle;
+    int ret = bulk_operand(conn, a, a_offset, len, &a_handle);
+    if (ret == ETHER_OK) ret = bulk_operand(conn, b, b_offset, len, &op.handle);
+    if (ret != ETHER_OK) return ret;
+
+    uint64_t value;
+    ret = bulk_call(conn, ETHER_CMD_CMP, a_handle, &op, NULL, 0, &value);
+    if (ret != ETHER_OK) return ret;
+
+    // 0, or +/-(1 + offset of the first differing byte)
+    int64_t result = (int64_t)value;
+    *order = result < 0 ? -1 : result > 0;
+    if (mismatch) {
+        *mismatch = result == 0 ? len : (size_t)(result < 0 ? -result : result) - 1;
+    }
+    return ETHER_OK;
+}
+
+int ether_rchecksum(ether_conn_t* conn, void* ptr, size_t offset, size_t len, uint64_t* sum) {
+    if (!conn || !conn->connected || !sum) return ETHER_ERR_INVALID;
+
+    ether_bulk_record_t op = { .offset = offset, .length = len };
+    uint64_t handle;
+    int ret = bulk_operand(conn, ptr, offset, len, &handle);
+    if (ret != ETHER_OK) return ret;
+
+    return bulk_call(conn, ETHER_CMD_CHECKSUM, handle, &op, NULL, 0, sum);
+}
+
+// =============================================================================
+// PUBLIC API - ASYNC
+// =============================================================================
+
+ether_future_t* ether_rwrite_async(ether_conn_t* conn, void* ptr, const void* data, size_t len) {
+    return ether_rwrite_at_async(conn, ptr, 0, data, len);
+}
+
+ether_future_t* ether_rread_async(ether_conn_t* conn, void* ptr, void* buffer, size_t len) {
+    return ether_rread_at_async(conn, ptr, 0, buffer, len);
+}
+
+ether_future_t* ether_rwrite_at_async(ether_conn_t* conn, void* ptr, size_t offset,
+                                      const void* data, size_t len) {
+    ether_future_t* future = malloc(sizeof(ether_future_t));
+    if (!future) return NULL;
+
+    rwrite_submit(conn, future, ptr, offset, data, len);
+    return future;
+}
+
+ether_future_t* ether_rread_at_async(ether_conn_t* conn, void* ptr, size_t offset,
+                                     void* buffer, size_t len) {
+    ether_future_t* future = malloc(sizeof(ether_future_t));
+    if (!future) return NULL;
+
+    rread_submit(conn, future, ptr, offset, buffer, len);
+    return future;
+}
+
+int ether_poll(ether_future_t* future) {
+    if (!future) return -1;
+
+    // Only consume responses that have (at least partly) arrived already
+    while (!future->done) {
+        struct pollfd pfd = { .fd = future->conn->socket, .events = POLLIN };
+        int ready = poll(&pfd, 1, 0);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) break;
+
+        if (recv_response(future->conn) != 0) {
+            conn_fail(future->conn);
+        }
+    }
+
+    return future->done;
+}
+
+int ether_wait(ether_future_t* future) {
+    if (!future) return ETHER_ERR_INVALID;
+
+    int result = future_wait(future);
+    free(future);
+    return result;
+}
+
+// =============================================================================
+// PUBLIC API - MAPPING
+// =============================================================================
+
+void* ether_rmap(ether_conn_t* conn, void* ptr) {
+    if (!conn || !conn->connected || !ptr) return NULL;
 
     size_t size;
-    if (cache_lookup(ptr, &size) == 0) {
-        return 0;
+    uint64_t handle = cache_lookup(conn, ptr, &size);
+    if (handle == 0) return NULL;
+
+    rmapper_t* mapper = rmapper_get(conn);
+    if (!mapper) return NULL;
+
+    rmap_region_t* region = calloc(1, sizeof(rmap_region_t));
+    if (!region) return NULL;
+
+    size_t num_pages = (size + RMAP_PAGE_SIZE - 1) / RMAP_PAGE_SIZE;
+    region->map_len = num_pages * RMAP_PAGE_SIZE;
+    region->size = size;
+    region->handle = handle;
+    region->ptr = ptr;
+    region->populated = calloc((num_pages + 63) / 64, sizeof(uint64_t));
+    region->unsynced = calloc((num_pages + 63) / 64, sizeof(uint64_t));
+    region->addr = mmap(NULL, region->map_len, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    region->twins = mmap(NULL, region->map_len, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    struct uffdio_register reg = {
+        .range = { .start = (uintptr_t)region->addr, .len = region->map_len },
+        .mode = UFFDIO_REGISTER_MODE_MISSING,
+    };
+    if (!region->populated || !region->unsynced || region->addr == MAP_FAILED ||
+        region->twins == MAP_FAILED || ioctl(mapper->uffd, UFFDIO_REGISTER, &reg) != 0) {
+        if (region->addr != MAP_FAILED) munmap(region->addr, region->map_len);
+        if (region->twins != MAP_FAILED) munmap(region->twins, region->map_len);
+        free(region->populated);
+        free(region->unsynced);
+        free(region);
+        return NULL;
     }
-    return size;
-}
\ No newline at end of file
+
+    pthread_mutex_lock(&mapper->lock);
+    region->next = mapper->regions;
+    mapper->regions = region;
+    pthread_mutex_unlock(&mapper->lock);
+
+    return region->addr;
+}
+
+int ether_rmsync(ether_conn_t* conn, void* addr) {
+    if (!conn || !conn->connected || !conn->mapper || !addr) return ETHER_ERR_INVALID;
+
+    rmapper_t* mapper = conn->mapper;
+    pthread_mutex_lock(&mapper->lock);
+
+    rmap_region_t* region = rmap_find(mapper, addr);
+    int ret = region ? rmap_writeback(conn, region) : ETHER_ERR_NOTFOUND;
+
+    pthread_mutex_unlock(&mapper->lock);
+    return ret;
+}
+
+int ether_runmap(ether_conn_t* conn, void* addr) {
+    if (!conn || !conn->mapper || !addr) return ETHER_ERR_INVALID;
+
+    rmapper_t* mapper = conn->mapper;
+    pthread_mutex_lock(&mapper->lock);
+
+    rmap_region_t* region = rmap_find(mapper, addr);
+    int ret = region ? rmap_release(conn, mapper, region) : ETHER_ERR_NOTFOUND;
+
+    pthread_mutex_unlock(&mapper->lock);
+    return ret;
+}
+
+// =============================================================================
+// PUBLIC API - BATCH
+// =============================================================================
+
+/**
+ * One queued sub-operation
+ */
+typedef struct {
+    ether_batch_record_t op;       // Wire record (handle or op index)
+    uint64_t             offset;   // WRITE/READ: block offset (ETHER_BATCH_OFFSET)
+    void*                ptr;      // Local pointer the op targets (if any)
+    const void*          data;     // WRITE: source data
+    void*                buffer;   // READ: destination
+    void*                local;    // ALLOC: local pointer, once executed
+    uint64_t             orphan;   // ALLOC: server block to free (no local buffer)
+    int                  result;   // ETHER_OK or error, once executed
+} batch_op_t;
+
+struct ether_batch {
+    ether_conn_t* conn;
+    batch_op_t*   ops;
+    int           num_ops;
+    int           cap_ops;
+    size_t        payload_len;     // Encoded request size so far
+    size_t        response_max;    // Upper bound on the response size
+    int           executed;
+};
+
+ether_batch_t* ether_batch_create(ether_conn_t* conn) {
+    if (!conn) return NULL;
+
+    ether_batch_t* batch = calloc(1, sizeof(ether_batch_t));
+    if (!batch) return NULL;
+
+    batch->conn = conn;
+    return batch;
+}
+
+void ether_batch_destroy(ether_batch_t* batch) {
+    if (!batch) return;
+
+    free(batch->ops);
+    free(batch);
+}
+
+/**
+ * Append an op; returns its index or an error code
+ */
+static int batch_add(ether_batch_t* batch, const batch_op_t* op, size_t data_len,
+                     size_t read_len) {
+    if (batch->executed) return ETHER_ERR_INVALID;
+
+    if (batch->payload_len + ETHER_BATCH_RECORD_SIZE + data_len > ETHER_MAX_PAYLOAD) {
+        return ETHER_ERR_OVERFLOW;
+    }
+
+    if (batch->num_ops == batch->cap_ops) {
+        int cap = batch->cap_ops ? batch->cap_ops * 2 : 16;
+        batch_op_t* ops = realloc(batch->ops, (size_t)cap * sizeof(batch_op_t));
+        if (!ops) return ETHER_ERR_NOMEM;
+        batch->ops = ops;
+        batch->cap_ops = cap;
+    }
+
+    batch->ops[batch->num_ops] = *op;
+    batch->ops[batch->num_ops].result = ETHER_ERR_INVALID;  // Not executed yet
+    batch->payload_len += ETHER_BATCH_RECORD_SIZE + data_len;
+    batch->response_max += ETHER_BATCH_RECORD_SIZE + read_len;
+    return batch->num_ops++;
+}
+
+/**
+ * Resolve a local pointer for an op that targets an existing block
+ */
+static int batch_target(ether_batch_t* batch, batch_op_t* op, uint8_t cmd, void* ptr,
+                        size_t* block_size) {
+    if (!batch || !ptr) return ETHER_ERR_INVALID;
+
+    uint64_t handle = cache_lookup(batch->conn, ptr, block_size);
+    if (handle == 0) return ETHER_ERR_NOTFOUND;
+
+    memset(op, 0, sizeof(*op));
+    op->op.command = cmd;
+    op->op.handle = handle;
+    op->ptr = ptr;
+    return ETHER_OK;
+}
+
+int ether_batch_alloc(ether_batch_t* batch, size_t size) {
+    if (!batch || size == 0 || size > UINT32_MAX) return ETHER_ERR_INVALID;
+
+    batch_op_t op;
+    memset(&op, 0, sizeof(op));
+    op.op.command = ETHER_CMD_ALLOC;
+    op.op.size = (uint32_t)size;
+    return batch_add(batch, &op, 0, 0);
+}
+
+int ether_batch_free(ether_batch_t* batch, void* ptr) {
+    batch_op_t op;
+    int ret = batch_target(batch, &op, ETHER_CMD_FREE, ptr, NULL);
+    if (ret != ETHER_OK) return ret;
+
+    return batch_add(batch, &op, 0, 0);
+}
+
+/**
+ * Send the op's offset along with it (only needed when it is not 0)
+ *
+ * @return  Bytes the offset adds to the request
+ */
+static size_t batch_set_offset(batch_op_t* op, size_t offset) {
+    if (offset == 0) return 0;
+
+    op->op.flags |= ETHER_BATCH_OFFSET;
+    op->offset = offset;
+    return ETHER_OFFSET_SIZE;
+}
+
+int ether_batch_write(ether_batch_t* batch, void* ptr, const void* data, size_t len) {
+    return ether_batch_write_at(batch, ptr, 0, data, len);
+}
+
+int ether_batch_write_at(ether_batch_t* batch, void* ptr, size_t offset,
+                         const void* data, size_t len) {
+    if (!data) return ETHER_ERR_INVALID;
+
+    batch_op_t op;
+    size_t block_size;
+    int ret = batch_target(batch, &op, ETHER_CMD_WRITE, ptr, &block_size);
+    if (ret != ETHER_OK) return ret;
+    if (offset > block_size || len > block_size - offset) return ETHER_ERR_OVERFLOW;
+
+    op.op.size = (uint32_t)len;
+    op.data = data;
+    size_t extra = batch_set_offset(&op, offset);
+    return batch_add(batch, &op, extra + len, 0);
+}
+
+int ether_batch_write_new(ether_batch_t* batch, int alloc_op, const void* data, size_t len) {
+    if (!batch || !data || alloc_op < 0 || alloc_op >= batch->num_ops ||
+        batch->ops[alloc_op].op.command != ETHER_CMD_ALLOC) {
+        return ETHER_ERR_INVALID;
+    }
+    if (len > batch->ops[alloc_op].op.size) return ETHER_ERR_OVERFLOW;
+
+    batch_op_t op;
+    memset(&op, 0, sizeof(op));
+    op.op.command = ETHER_CMD_WRITE;
+    op.op.flags = ETHER_BATCH_REF;
+    op.op.handle = (uint64_t)alloc_op;
+    op.op.size = (uint32_t)len;
+    op.data = data;
+    return batch_add(batch, &op, len, 0);
+}
+
+int ether_batch_read(ether_batch_t* batch, void* ptr, void* buffer, size_t len) {
+    return ether_batch_read_at(batch, ptr, 0, buffer, len);
+}
+
+int ether_batch_read_at(ether_batch_t* batch, void* ptr, size_t offset,
+                        void* buffer, size_t len) {
+    if (!buffer) return ETHER_ERR_INVALID;
+
+    batch_op_t op;
+    size_t block_size;
+    int ret = batch_target(batch, &op, ETHER_CMD_READ, ptr, &block_size);
+    if (ret != ETHER_OK) return ret;
+    if (offset > block_size) return ETHER_ERR_OVERFLOW;
+
+    // Cap length to what is left of the block
+    if (len > block_size - offset) len = block_size - offset;
+
+    op.op.size = (uint32_t)len;
+    op.buffer = buffer;
+    size_t extra = batch_set_offset(&op, offset);
+    return batch_add(batch, &op, extra, len);
+}
+
+/**
+ * Apply one result record to its op (local buffers, handle cache)
+ */
+static void batch_apply(ether_batch_t* batch, batch_op_t* op, const ether_batch_record_t* res,
+                        const uint8_t* data) {
+    op->result = (res->command == ETHER_CMD_OK) ? ETHER_OK : ETHER_ERR_INVALID;
+
+    switch (op->op.command) {
+        case ETHER_CMD_ALLOC:
+            if (op->result != ETHER_OK) break;
+
+            // Same as ether_rmalloc(): local buffer + hidden mapping
+            op->local = cache_store(batch->conn, res->handle, op->op.size);
+            if (!op->local) {
+                op->orphan = res->handle;   // Freed once the batch is done
+                op->result = ETHER_ERR_NOMEM;
+            }
+            break;
+
+        case ETHER_CMD_WRITE: {
+            // Update local cache with written data
+            void* mirror = (op->op.flags & ETHER_BATCH_REF)
+                               ? batch->ops[op->op.handle].local : op->ptr;
+            if (mirror) {
+                mirror = cache_mirror(mirror);
+            }
+            if (mirror) {
+                mirror = (uint8_t*)mirror + op->offset;
+            }
+            if (op->result == ETHER_OK && mirror && mirror != op->data) {
+                memmove(mirror, op->data, op->op.size);
+            }
+            break;
+        }
+
+        case ETHER_CMD_READ:
+            // The buffer holds op.size bytes: never trust the server with more
+            if (op->result == ETHER_OK && res->size > op->op.size) {
+                op->result = ETHER_ERR_CORRUPT;
+            } else if (op->result == ETHER_OK) {
+                memcpy(op->buffer, data, res->size);
+            }
+            break;
+
+        case ETHER_CMD_FREE:
+            // Like ether_rfree(), the local side goes away regardless
+            cache_remove(op->ptr);
+            break;
+    }
+}
+
+int ether_batch_exec(ether_batch_t* batch) {
+    if (!batch || batch->executed || batch->num_ops == 0) return ETHER_ERR_INVALID;
+    if (!batch->conn->connected) return ETHER_ERR_NETWORK;
+
+    batch->executed = 1;
+
+    // 1. Encode ops + write data
+    ether_buf_pool_t* pool = &batch->conn->pool;
+    uint8_t* payload = ether_buf_get(pool, batch->payload_len);
+    size_t response_cap = batch->response_max < ETHER_MAX_PAYLOAD
+                              ? batch->response_max : ETHER_MAX_PAYLOAD;
+    uint8_t* response = ether_buf_get(pool, response_cap);
+    if (!payload || !response) {
+        ether_buf_put(pool, payload, batch->payload_len);
+        ether_buf_put(pool, response, response_cap);
+        return ETHER_ERR_NOMEM;
+    }
+
+    size_t pos = 0;
+    for (int i = 0; i < batch->num_ops; i++) {
+        batch_op_t* op = &batch->ops[i];
+        ether_batch_record_serialize(&op->op, payload + pos);
+        pos += ETHER_BATCH_RECORD_SIZE;
+
+        if (op->op.flags & ETHER_BATCH_OFFSET) {
+            ether_msg_serialize_offset(op->offset, payload + pos);
+            pos += ETHER_OFFSET_SIZE;
+        }
+
+        if (op->op.command == ETHER_CMD_WRITE) {
+            memcpy(payload + pos, op->data, op->op.size);
+            pos += op->op.size;
+        }
+    }
+
+    // 2. One request, one response
+    ether_future_t future;
+    memset(&future, 0, sizeof(future));
+    future.buffer = response;
+    future.len = response_cap;
+
+    ether_msg_header_t header;
+    init_header(&header, ETHER_CMD_BATCH, (uint64_t)batch->num_ops, (uint32_t)pos);
+    submit(batch->conn, &future, &header, NULL, 0, payload, pos);
+    int ret = future_wait(&future);
+    ether_buf_put(pool, payload, batch->payload_len);
+
+    // 3. Walk the result vector
+    if (ret == ETHER_OK) {
+        pos = 0;
+        for (int i = 0; i < batch->num_ops; i++) {
+            if (future.received - pos < ETHER_BATCH_RECORD_SIZE) {
+                ret = ETHER_ERR_CORRUPT;
+                break;
+            }
+
+            ether_batch_record_t res;
+            ether_batch_record_deserialize(response + pos, &res);
+            pos += ETHER_BATCH_RECORD_SIZE;
+
+            if (future.received - pos < res.size) {
+                ret = ETHER_ERR_CORRUPT;
+                break;
+            }
+
+            batch_apply(batch, &batch->ops[i], &res, response + pos);
+            pos += res.size;
+        }
+    }
+
+    ether_buf_put(pool, response, response_cap);
+
+    // 4. Give back blocks allocated for ops that could not keep them
+    for (int i = 0; i < batch->num_ops; i++) {
+        batch_op_t* op = &batch->ops[i];
+        if (op->orphan) {
+            call(batch->conn, &future, ETHER_CMD_FREE, op->orphan, 0);
+            op->orphan = 0;
+        }
+    }
+    return ret;
+}
+
+int ether_batch_result(const ether_batch_t* batch, int op) {
+    if (!batch || op < 0 || op >= batch->num_ops) return ETHER_ERR_INVALID;
+    return batch->ops[op].result;
+}
+
+void* ether_batch_ptr(const ether_batch_t* batch, int op) {
+    if (!batch || op < 0 || op >= batch->num_ops) return NULL;
+    return batch->ops[op].local;
+}
+
+// =============================================================================
+// PUBLIC API - CLUSTER
+// =============================================================================
+
+/**
+ * Blocks are spread over the nodes by the client alone: there is no
+ * coordinator and no node knows about the others. A block's node is
+ * recorded where its handle is, in the shadow header (header->conn, whose
+ * slot is the node ID), so every call on it goes straight to that node.
+ *
+ * Placement:
+ *   - Unkeyed: the node with the most available memory, from MEMINFO.
+ *     Figures are refreshed at most every CLUSTER_REFRESH_NS and lowered
+ *     locally by every allocation in between.
+ *   - Keyed: a consistent-hash ring with CLUSTER_VNODES points per node,
+ *     hashed from the node's endpoint. The same key always lands on the
+ *     same node, whatever the node order, and adding or removing a node
+ *     only moves the keys next to its points. A dead node's keys go to
+ *     the next live node on the ring.
+ */
+#define CLUSTER_MAX_NODES   256
+#define CLUSTER_VNODES      128
+#define CLUSTER_REFRESH_NS  1000000000ull   // 1 s
+
+typedef struct {
+    uint64_t hash;
+    uint32_t node;
+} ring_point_t;
+
+struct ether_cluster {
+    ether_conn_t** nodes;
+    uint64_t*      available;     // Estimated available bytes per node
+    size_t         num_nodes;
+    ring_point_t*  ring;          // Sorted by hash
+    size_t         ring_len;
+    uint64_t       refreshed_ns;  // Last MEMINFO round (CLOCK_MONOTONIC)
+};
+
+/**
+ * 64-bit FNV-1a with a final avalanche, so that keys differing only in
+ * their last bytes still land far apart on the ring
+ */
+static uint64_t ring_hash(const void* data, size_t len, uint64_t seed) {
+    const uint8_t* bytes = data;
+    uint64_t hash = 0xCBF29CE484222325ull ^ seed;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static int ring_cmp(const void* a, const void* b) {
+    uint64_t x = ((const ring_point_t*) a)->hash;
+    uint64_t y = ((const ring_point_t*) b)->hash;
+    return (x > y) - (x < y);
+}
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * Node a key maps to: the first live point at or after its hash
+ *
+ * @return  Node ID, or -1 if every node is down
+ */
+static int ring_lookup(ether_cluster_t* cluster, const void* key, size_t len) {
+    uint64_t hash = ring_hash(key, len, 0);
+
+    size_t lo = 0, hi = cluster->ring_len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (cluster->ring[mid].hash < hash) lo = mid + 1;
+        else hi = mid;
+    }
+
+    for (size_t i = 0; i < cluster->ring_len; i++) {
+        uint32_t node = cluster->ring[(lo + i) % cluster->ring_len].node;
+        if (cluster->nodes[node]->connected) return (int) node;
+    }
+    return -1;
+}
+
+/**
+ * Live node with the most available memory
+ *
+ * @return  Node ID, or -1 if every node is down
+ */
+static int least_loaded(ether_cluster_t* cluster) {
+    if (monotonic_ns() - cluster->refreshed_ns >= CLUSTER_REFRESH_NS) {
+        ether_cluster_refresh(cluster, NULL);
+    }
+
+    int best = -1;
+    for (size_t i = 0; i < cluster->num_nodes; i++) {
+        if (!cluster->nodes[i]->connected) continue;
+        if (best < 0 || cluster->available[i] > cluster->available[best]) {
+            best = (int) i;
+        }
+    }
+    return best;
+}
+
+/**
+ * Allocate on the node picked for key (least loaded if key is NULL). A
+ * node is only known to be down once a call on it fails: then the block
+ * is placed again, on another node.
+ */
+static void* cluster_alloc(ether_cluster_t* cluster, const void* key, size_t key_len,
+                           size_t size) {
+    for (size_t attempt = 0; attempt < cluster->num_nodes; attempt++) {
+        int node = key ? ring_lookup(cluster, key, key_len) : least_loaded(cluster);
+        if (node < 0) return NULL;
+
+        void* ptr = ether_rmalloc(cluster->nodes[node], size);
+        if (ptr) {
+            uint64_t* available = &cluster->available[node];
+            *available = *available > size ? *available - size : 0;
+            return ptr;
+        }
+        if (cluster->nodes[node]->connected) return NULL;   // Node is up but refused
+    }
+    return NULL;
+}
+
+ether_cluster_t* ether_cluster_create(const char* const* hosts, const int* ports, size_t count) {
+    if (!hosts || !ports || count == 0 || count > CLUSTER_MAX_NODES) return NULL;
+
+    ether_cluster_t* cluster = calloc(1, sizeof(ether_cluster_t));
+    if (!cluster) return NULL;
+    cluster->nodes = calloc(count, sizeof(ether_conn_t*));
+    cluster->available = calloc(count, sizeof(uint64_t));
+    cluster->ring = calloc(count * CLUSTER_VNODES, sizeof(ring_point_t));
+    if (!cluster->nodes || !cluster->available || !cluster->ring) {
+        ether_cluster_destroy(cluster);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        ether_conn_t* conn = ether_connect(hosts[i], ports[i]);
+        if (!conn) {
+            ether_cluster_destroy(cluster);
+            return NULL;
+        }
+        conn->cluster = cluster;
+        conn->slot = i;
+        cluster->nodes[cluster->num_nodes++] = conn;
+
+        // Points depend on the endpoint only, not on the node's position
+        char endpoint[sizeof(conn->host) + 16];
+        int len = snprintf(endpoint, sizeof(endpoint), "%s:%d", hosts[i], ports[i]);
+        for (uint64_t v = 0; v < CLUSTER_VNODES; v++) {
+            ring_point_t* point = &cluster->ring[cluster->ring_len++];
+            point->hash = ring_hash(endpoint, (size_t) len, v + 1);
+            point->node = (uint32_t) i;
+        }
+    }
+    qsort(cluster->ring, cluster->ring_len, sizeof(ring_point_t), ring_cmp);
+
+    ether_cluster_refresh(cluster, NULL);
+    return cluster;
+}
+
+void ether_cluster_destroy(ether_cluster_t* cluster) {
+    if (!cluster) return;
+
+    for (size_t i = 0; i < cluster->num_nodes; i++) {
+        ether_disconnect(cluster->nodes[i]);
+    }
+    free(cluster->nodes);
+    free(cluster->available);
+    free(cluster->ring);
+    free(cluster);
+}
+
+int ether_cluster_refresh(ether_cluster_t* cluster, ether_server_meminfo_t* total) {
+    if (!cluster) return ETHER_ERR_INVALID;
+
+    if (total) memset(total, 0, sizeof(*total));
+    int live = 0;
+    for (size_t i = 0; i < cluster->num_nodes; i++) {
+        ether_server_meminfo_t info;
+        if (ether_server_meminfo(cluster->nodes[i], &info) != ETHER_OK) {
+            cluster->available[i] = 0;
+            continue;
+        }
+        cluster->available[i] = info.available;
+        live++;
+
+        if (total) {
+            total->used += info.used;
+            total->peak += info.peak;
+            total->available += info.available;
+            total->blocks += info.blocks;
+        }
+    }
+    cluster->refreshed_ns = monotonic_ns();
+    return live;
+}
+
+size_t ether_cluster_size(const ether_cluster_t* cluster) {
+    return cluster ? cluster->num_nodes : 0;
+}
+
+ether_conn_t* ether_cluster_conn(ether_cluster_t* cluster, size_t node) {
+    if (!cluster || node >= cluster->num_nodes) return NULL;
+    return cluster->nodes[node];
+}
+
+ether_conn_t* ether_cluster_node(ether_cluster_t* cluster, void* ptr) {
+    if (!cluster || !ptr) return NULL;
+
+    shadow_header_t* header = shadow_header(ptr);
+    if (header->magic != SHADOW_MAGIC || !header->conn || header->conn->cluster != cluster) {
+        return NULL;
+    }
+    return header->conn;
+}
+
+void* ether_cluster_rmalloc(ether_cluster_t* cluster, size_t size) {
+    if (!cluster || size == 0) return NULL;
+    return cluster_alloc(cluster, NULL, 0, size);
+}
+
+void* ether_cluster_rmalloc_key(ether_cluster_t* cluster, const void* key, size_t key_len,
+                                size_t size) {
+    if (!cluster || !key || size == 0) return NULL;
+    return cluster_alloc(cluster, key, key_len, size);
+}
+
+/**
+ * A striped block is laid out RAID-0 style: stripe unit k of the block
+ * lives in column k % width, at offset (k / width) * unit of that
+ * column. Each column is on its own node and is made of extents, plain
+ * remote blocks of at most STRIPE_EXTENT_MAX bytes (a block is limited
+ * to 4 GB), behind lazy local pointers on the node's connection:
+ *
+ *   block:    | u0 | u1 | u2 | u3 | u4 | u5 | u6 |
+ *   column 0: | u0 | u3 | u6 |      (node A)
+ *   column 1: | u1 | u4 |           (node B)
+ *   column 2: | u2 | u5 |           (node C)
+ *
+ * The pointer handed out is a lazy reservation of the block's size, like
+ * an ETHER_SHADOW_LAZY buffer, whose header carries STRIPE_MAGIC and
+ * points at the stripe_t instead of naming a connection. A transfer is
+ * cut at unit boundaries, and up to STRIPE_WINDOW pieces are in flight at
+ * once; consecutive units go to different nodes, so every node's link
+ * is busy at the same time.
+ */
+#define STRIPE_MAGIC       0x2C82FDD0   // CRC32("STRIPED") - striped block
+#define STRIPE_UNIT_MAX    (64u * 1024 * 1024)
+#define STRIPE_EXTENT_MAX  (1ull << 30)
+#define STRIPE_WINDOW      64
+
+typedef struct {
+    size_t    size;        // Block size
+    size_t    unit;        // Stripe unit
+    size_t    extent;      // Bytes per extent (a multiple of unit)
+    size_t    width;       // Columns
+    size_t    per_column;  // Extent slots per column
+    uint32_t* nodes;       // Node ID of each column
+    void**    extents;     // [column * per_column + i] (NULL past a column's end)
+} stripe_t;
+
+/**
+ * Striped block behind ptr, NULL if ptr is not one
+ */
+static stripe_t* stripe_lookup(void* ptr) {
+    shadow_header_t* header = shadow_header(ptr);
+    if (header->magic != STRIPE_MAGIC) return NULL;
+    return (stripe_t*)(uintptr_t)header->remote_handle;
+}
+
+/**
+ * Allocate an extent with no local copy, whatever the node's modes
+ */
+static void* stripe_extent_alloc(ether_conn_t* conn, size_t size) {
+    ether_shadow_mode_t shadow = conn->shadow_mode;
+    ether_cache_mode_t cache = conn->cache_mode;
+    conn->shadow_mode = ETHER_SHADOW_LAZY;
+    conn->cache_mode = ETHER_CACHE_NONE;
+
+    void* ptr = ether_rmalloc(conn, size);
+
+    conn->shadow_mode = shadow;
+    conn->cache_mode = cache;
+    return ptr;
+}
+
+static void stripe_free(ether_cluster_t* cluster, void* ptr, stripe_t* stripe) {
+    for (size_t c = 0; c < stripe->width; c++) {
+        ether_conn_t* conn = cluster->nodes[stripe->nodes[c]];
+        for (size_t i = 0; i < stripe->per_column; i++) {
+            void* extent = stripe->extents[c * stripe->per_column + i];
+            if (extent) ether_rfree(conn, extent);
+        }
+    }
+    free(stripe->nodes);
+    free(stripe->extents);
+    free(stripe);
+    if (ptr) cache_remove(ptr);
+}
+
+/**
+ * Move [offset, offset + len) of a striped block to or from buf
+ */
+static int stripe_io(ether_cluster_t* cluster, stripe_t* stripe, size_t offset,
+                     uint8_t* buf, size_t len, int write) {
+    if (offset > stripe->size || len > stripe->size - offset) return ETHER_ERR_OVERFLOW;
+
+    ether_future_t window[STRIPE_WINDOW];
+    size_t head = 0, count = 0;
+    int ret = ETHER_OK;
+
+    while (len > 0 || count > 0) {
+        // Window full or nothing left to send: retire the oldest piece
+        if (count == STRIPE_WINDOW || len == 0) {
+            int r = future_wait(&window[head]);
+            if (ret == ETHER_OK) ret = r;
+            head = (head + 1) % STRIPE_WINDOW;
+            count--;
+            continue;
+        }
+
+        size_t k = offset / stripe->unit;
+        size_t within = offset % stripe->unit;
+        size_t piece = stripe->unit - within < len ? stripe->unit - within : len;
+        size_t column = k % stripe->width;
+        size_t column_offset = (k / stripe->width) * stripe->unit + within;
+
+        ether_conn_t* conn = cluster->nodes[stripe->nodes[column]];
+        void* extent = stripe->extents[column * stripe->per_column +
+                                       column_offset / stripe->extent];
+        size_t extent_offset = column_offset % stripe->extent;
+
+        ether_future_t* future = &window[(head + count) % STRIPE_WINDOW];
+        if (write) {
+            rwrite_submit(conn, future, extent, extent_offset, buf, piece);
+        } else {
+            rread_submit(conn, future, extent, extent_offset, buf, piece);
+        }
+        count++;
+
+        offset += piece;
+        buf += piece;
+        len -= piece;
+    }
+    return ret;
+}
+
+void* ether_cluster_rmalloc_striped(ether_cluster_t* cluster, size_t size, size_t unit) {
+    if (!cluster || size == 0) return NULL;
+    if (unit == 0) unit = ETHER_STRIPE_UNIT;
+    if (unit > STRIPE_UNIT_MAX) return NULL;
+
+    // Stripe over every live node, but not wider than the block
+    size_t units = (size + unit - 1) / unit;
+    size_t width = 0;
+    for (size_t i = 0; i < cluster->num_nodes; i++) {
+        width += cluster->nodes[i]->connected;
+    }
+    if (width == 0) return NULL;
+    if (width > units) width = units;
+
+    stripe_t* stripe = calloc(1, sizeof(stripe_t));
+    if (!stripe) return NULL;
+    stripe->size = size;
+    stripe->unit = unit;
+    stripe->extent = (STRIPE_EXTENT_MAX / unit) * unit;
+    stripe->width = width;
+    stripe->per_column = ((units + width - 1) / width * unit + stripe->extent - 1) / stripe->extent;
+    stripe->nodes = calloc(width, sizeof(uint32_t));
+    stripe->extents = calloc(width * stripe->per_column, sizeof(void*));
+    if (!stripe->nodes || !stripe->extents) {
+        stripe_free(cluster, NULL, stripe);
+        return NULL;
+    }
+
+    // Column c holds units c, c + width, ... (the last one is allocated whole)
+    size_t column = 0;
+    for (size_t n = 0; n < cluster->num_nodes && column < width; n++) {
+        ether_conn_t* conn = cluster->nodes[n];
+        if (!conn->connected) continue;
+
+        stripe->nodes[column] = (uint32_t) n;
+        size_t bytes = (units - column + width - 1) / width * unit;
+        for (size_t i = 0; bytes > 0; i++) {
+            size_t len = bytes < stripe->extent ? bytes : stripe->extent;
+            void* extent = stripe_extent_alloc(conn, len);
+            if (!extent) {
+                stripe_free(cluster, NULL, stripe);
+                return NULL;
+            }
+            stripe->extents[column * stripe->per_column + i] = extent;
+            bytes -= len;
+        }
+
+        uint64_t* available = &cluster->available[n];
+        *available = *available > size / width ? *available - size / width : 0;
+        column++;
+    }
+
+    shadow_header_t* header = lazy_reserve(size);
+    if (!header) {
+        stripe_free(cluster, NULL, stripe);
+        return NULL;
+    }
+    header->magic = STRIPE_MAGIC;
+    header->conn = NULL;
+    header->remote_handle = (uint64_t)(uintptr_t)stripe;
+    header->size = size;
+    header->pages = NULL;
+    header->dirty_slot = 0;
+    return header + 1;
+}
+
+size_t ether_cluster_rsize(ether_cluster_t* cluster, void* ptr) {
+    if (!cluster || !ptr) return 0;
+
+    stripe_t* stripe = stripe_lookup(ptr);
+    if (stripe) return stripe->size;
+
+    ether_conn_t* conn = ether_cluster_node(cluster, ptr);
+    return conn ? ether_rsize(conn, ptr) : 0;
+}
+
+void ether_cluster_rfree(ether_cluster_t* cluster, void* ptr) {
+    if (!cluster || !ptr) return;
+
+    stripe_t* stripe = stripe_lookup(ptr);
+    if (stripe) {
+        stripe_free(cluster, ptr, stripe);
+        return;
+    }
+
+    ether_conn_t* conn = ether_cluster_node(cluster, ptr);
+    if (conn) ether_rfree(conn, ptr);
+}
+
+int ether_cluster_rwrite(ether_cluster_t* cluster, void* ptr, const void* data, size_t len) {
+    return ether_cluster_rwrite_at(cluster, ptr, 0, data, len);
+}
+
+int ether_cluster_rread(ether_cluster_t* cluster, void* ptr, void* buffer, size_t len) {
+    return ether_cluster_rread_at(cluster, ptr, 0, buffer, len);
+}
+
+int ether_cluster_rwrite_at(ether_cluster_t* cluster, void* ptr, size_t offset,
+                            const void* data, size_t len) {
+    if (!cluster || !ptr || !data) return ETHER_ERR_INVALID;
+
+    stripe_t* stripe = stripe_lookup(ptr);
+    if (stripe) return stripe_io(cluster, stripe, offset, (uint8_t*)data, len, 1);
+
+    ether_conn_t* conn = ether_cluster_node(cluster, ptr);
+    return conn ? ether_rwrite_at(conn, ptr, offset, data, len) : ETHER_ERR_NOTFOUND;
+}
+
+int ether_cluster_rread_at(ether_cluster_t* cluster, void* ptr, size_t offset,
+                           void* buffer, size_t len) {
+    if (!cluster || !ptr || !buffer) return ETHER_ERR_INVALID;
+
+    stripe_t* stripe = stripe_lookup(ptr);
+    if (stripe) return stripe_io(cluster, stripe, offset, buffer, len, 0);
+
+    ether_conn_t* conn = ether_cluster_node(cluster, ptr);
+    return conn ? ether_rread_at(conn, ptr, offset, buffer, len) : ETHER_ERR_NOTFOUND;
+}
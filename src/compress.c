@@ -0,0 +1,310 @@
+/**
+ * Ether Payload Compression Implementation
+ *
+ * LZ4 block format: a sequence is a token (literal length : 4, match
+ * length - 4 : 4), extra literal length bytes, the literals, a 2-byte
+ * little-endian match offset and extra match length bytes. A 4-bit field
+ * of 15 continues in bytes of 255 until a smaller one. The last sequence
+ * has literals only; the last 5 bytes are always literals and no match
+ * starts in the last 12.
+ *
+ * Copyright (C) 2024 - Licensed under GPL-3.0
+ */
+
+#include "ether/compress.h"
+#include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>  // htonl, ntohl
+
+// =============================================================================
+// CONFIGURATION
+// =============================================================================
+
+#define LZ4_HASH_BITS      12
+#define LZ4_MIN_MATCH      4
+#define LZ4_MFLIMIT        12      // No match starts in the last 12 bytes
+#define LZ4_LAST_LITERALS  5       // ...or covers the last 5
+#define LZ4_MAX_OFFSET     65535
+#define LZ4_SKIP_TRIGGER   6       // Search step grows every 2^6 misses
+
+// =============================================================================
+// HELPERS
+// =============================================================================
+
+static inline uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t read64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t lz4_hash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+/**
+ * Bytes p and m have in common, up to limit (p < limit)
+ */
+static inline size_t match_length(const uint8_t *p, const uint8_t *m, const uint8_t *limit) {
+    const uint8_t *start = p;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (p + 8 <= limit) {
+        uint64_t diff = read64(p) ^ read64(m);
+        if (diff) {
+            return (size_t) (p - start) + (size_t) (__builtin_ctzll(diff) >> 3);
+        }
+        p += 8;
+        m += 8;
+    }
+#endif
+    while (p < limit && *p == *m) {
+        p++;
+        m++;
+    }
+    return (size_t) (p - start);
+}
+
+/**
+ * Emit the 255-byte continuation of a length field that overflowed 15
+ *
+ * @return  Output position, NULL if out of room
+ */
+static inline uint8_t *put_length(uint8_t *op, const uint8_t *oend, size_t len) {
+    for (; len >= 255; len -= 255) {
+        if (op >= oend) return NULL;
+        *op++ = 255;
+    }
+    if (op >= oend) return NULL;
+    *op++ = (uint8_t) len;
+    return op;
+}
+
+/**
+ * Emit one sequence; match_len 0 = final literals-only sequence
+ *
+ * @return  Output position, NULL if out of room
+ */
+static uint8_t *put_sequence(uint8_t *op, const uint8_t *oend, const uint8_t *literals,
+                             size_t lit_len, size_t offset, size_t match_len) {
+    if (op >= oend) return NULL;
+    uint8_t *token = op++;
+    size_t ml = match_len ? match_len - LZ4_MIN_MATCH : 0;
+
+    *token = (uint8_t) ((lit_len < 15 ? lit_len : 15) << 4);
+    if (lit_len >= 15 && !(op = put_length(op, oend, lit_len - 15))) return NULL;
+
+    if ((size_t) (oend - op) < lit_len) return NULL;
+    memcpy(op, literals, lit_len);
+    op += lit_len;
+
+    if (match_len == 0) {
+        return op;
+    }
+
+    if (oend - op < 2) return NULL;
+    *op++ = (uint8_t) (offset & 0xFF);
+    *op++ = (uint8_t) (offset >> 8);
+
+    *token |= (uint8_t) (ml < 15 ? ml : 15);
+    if (ml >= 15 && !(op = put_length(op, oend, ml - 15))) return NULL;
+    return op;
+}
+
+// =============================================================================
+// LZ4 BLOCK CODEC
+// =============================================================================
+
+size_t ether_lz4_compress(const void *src, size_t len, void *dst, size_t cap) {
+    const uint8_t *base = (const uint8_t *) src;
+    const uint8_t *ip = base;
+    const uint8_t *anchor = base;
+    const uint8_t *iend = base + len;
+    uint8_t *op = (uint8_t *) dst;
+    const uint8_t *oend = op + cap;
+
+    if (!dst || (!src && len > 0)) {
+        return 0;
+    }
+
+    if (len > LZ4_MFLIMIT) {
+        const uint8_t *mflimit = iend - LZ4_MFLIMIT;
+        const uint8_t *matchlimit = iend - LZ4_LAST_LITERALS;
+        uint32_t table[1 << LZ4_HASH_BITS];
+        memset(table, 0, sizeof(table));   // Every entry points at byte 0
+        unsigned misses = 0;
+
+        ip++;
+        while (ip < mflimit) {
+            uint32_t sequence = read32(ip);
+            uint32_t h = lz4_hash(sequence);
+            const uint8_t *ref = base + table[h];
+            table[h] = (uint32_t) (ip - base);
+
+            if (ref >= ip || ip - ref > LZ4_MAX_OFFSET || read32(ref) != sequence) {
+                ip += 1 + (misses++ >> LZ4_SKIP_TRIGGER);
+                continue;
+            }
+
+            // Extend backwards over literals that also match
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+
+            size_t match_len = LZ4_MIN_MATCH +
+                               match_length(ip + LZ4_MIN_MATCH, ref + LZ4_MIN_MATCH, matchlimit);
+
+            op = put_sequence(op, oend, anchor, (size_t) (ip - anchor),
+                              (size_t) (ip - ref), match_len);
+            if (!op) {
+                return 0;
+            }
+
+            ip += match_len;
+            anchor = ip;
+            misses = 0;
+
+            // Index a position inside the match so the next one is found sooner
+            if (ip < mflimit) {
+                table[lz4_hash(read32(ip - 2))] = (uint32_t) (ip - 2 - base);
+            }
+        }
+    }
+
+    op = put_sequence(op, oend, anchor, (size_t) (iend - anchor), 0, 0);
+    return op ? (size_t) (op - (uint8_t *) dst) : 0;
+}
+
+ssize_t ether_lz4_decompress(const void *src, size_t len, void *dst, size_t cap) {
+    const uint8_t *ip = (const uint8_t *) src;
+    const uint8_t *iend = ip + len;
+    uint8_t *op = (uint8_t *) dst;
+    uint8_t *ostart = op;
+    const uint8_t *oend = op + cap;
+
+    if (!src || (!dst && cap > 0) || len == 0) {
+        return -1;
+    }
+
+    for (;;) {
+        unsigned token = *ip++;
+
+        size_t lit_len = token >> 4;
+        if (lit_len == 15) {
+            unsigned b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                lit_len += b;
+            } while (b == 255);
+        }
+        if (lit_len > (size_t) (iend - ip) || lit_len > (size_t) (oend - op)) {
+            return -1;
+        }
+        memcpy(op, ip, lit_len);
+        op += lit_len;
+        ip += lit_len;
+
+        if (ip == iend) {
+            break;   // Last sequence: literals only
+        }
+
+        if (iend - ip < 2) return -1;
+        size_t offset = (size_t) ip[0] | ((size_t) ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t) (op - ostart)) {
+            return -1;
+        }
+
+        size_t match_len = token & 15;
+        if (match_len == 15) {
+            unsigned b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                match_len += b;
+            } while (b == 255);
+        }
+        match_len += LZ4_MIN_MATCH;
+        if (match_len > (size_t) (oend - op)) {
+            return -1;
+        }
+
+        const uint8_t *match = op - offset;
+        if (offset >= match_len) {
+            memcpy(op, match, match_len);
+        } else {
+            // Overlapping match: repeats the last offset bytes
+            for (size_t i = 0; i < match_len; i++) {
+                op[i] = match[i];
+            }
+        }
+        op += match_len;
+
+        if (ip >= iend) {
+            return -1;   // A block always ends with literals
+        }
+    }
+
+    return (ssize_t) (op - ostart);
+}
+
+// =============================================================================
+// PAYLOAD FRAMING
+// =============================================================================
+
+size_t ether_compress_payload(const void *src, size_t len, void *dst, size_t cap) {
+    if (!dst || len > UINT32_MAX || cap <= ETHER_COMPRESS_HEADER) {
+        return 0;
+    }
+
+    // Not worth decoding unless it saves at least 1/16
+    size_t budget = len - len / 16;
+    if (budget <= ETHER_COMPRESS_HEADER) {
+        return 0;
+    }
+    budget -= ETHER_COMPRESS_HEADER;
+    if (budget > cap - ETHER_COMPRESS_HEADER) {
+        budget = cap - ETHER_COMPRESS_HEADER;
+    }
+
+    size_t n = ether_lz4_compress(src, len, (uint8_t *) dst + ETHER_COMPRESS_HEADER, budget);
+    if (n == 0) {
+        return 0;
+    }
+
+    uint32_t raw = htonl((uint32_t) len);
+    memcpy(dst, &raw, sizeof(raw));
+    return ETHER_COMPRESS_HEADER + n;
+}
+
+size_t ether_compressed_size(const void *src, size_t len) {
+    if (!src || len < ETHER_COMPRESS_HEADER) {
+        return 0;
+    }
+
+    uint32_t raw;
+    memcpy(&raw, src, sizeof(raw));
+    return ntohl(raw);
+}
+
+ssize_t ether_decompress_payload(const void *src, size_t len, void *dst, size_t cap) {
+    if (!src || len <= ETHER_COMPRESS_HEADER) {
+        return -1;
+    }
+
+    size_t raw = ether_compressed_size(src, len);
+    if (raw > cap) {
+        return -1;
+    }
+
+    ssize_t n = ether_lz4_decompress((const uint8_t *) src + ETHER_COMPRESS_HEADER,
+                                     len - ETHER_COMPRESS_HEADER, dst, raw);
+    return n == (ssize_t) raw ? n : -1;
+}
@@ -0,0 +1,380 @@
+/**
+ * Ether Handle Table Implementation
+ *
+ * Slot array + free list + per-slot generation counter.
+ * Insert, lookup and remove are all O(1); the slot array doubles
+ * when the free list runs dry.
+ *
+ * Copyright (C) 2024 - Licensed under GPL-3.0
+ */
+
+#include "handle_table.h"
+#include <stdlib.h>
+#include <string.h>
+
+// =============================================================================
+// HANDLE ENCODING
+// =============================================================================
+
+static inline uint64_t make_handle(const handle_table_t *table, uint32_t slot,
+                                   uint32_t generation) {
+    return ((uint64_t) table->shard << HANDLE_SHARD_SHIFT) |
+           ((uint64_t) generation << 32) | slot;
+}
+
+static inline uint32_t handle_slot(uint64_t handle) {
+    return (uint32_t) (handle & 0xFFFFFFFFu);
+}
+
+static inline uint32_t handle_generation(uint64_t handle) {
+    return (uint32_t) (handle >> 32) & HANDLE_GENERATION_MASK;
+}
+
+/**
+ * Resolve a handle to its slot, NULL if unknown or stale
+ */
+static inline handle_slot_t *find_slot(const handle_table_t *table, uint64_t handle) {
+    uint32_t index = handle_slot(handle);
+    if (handle_shard(handle) != table->shard || index >= table->used) {
+        return NULL;
+    }
+
+    handle_slot_t *slot = &table->slots[index];
+    if (!slot->ptr || slot->generation != handle_generation(handle)) {
+        return NULL;
+    }
+    return slot;
+}
+
+// =============================================================================
+// LIFECYCLE
+// =============================================================================
+
+int handle_table_init(handle_table_t *table, uint8_t shard, uint32_t capacity) {
+    if (!table) {
+        return -1;
+    }
+
+    if (capacity == 0) {
+        capacity = HANDLE_TABLE_INITIAL_CAPACITY;
+    }
+
+    memset(table, 0, sizeof(*table));
+    table->slots = calloc(capacity, sizeof(handle_slot_t));
+    if (!table->slots) {
+        return -1;
+    }
+
+    table->capacity = capacity;
+    table->free_head = HANDLE_SLOT_NONE;
+    table->shard = shard;
+    return 0;
+}
+
+void handle_table_destroy(handle_table_t *table) {
+    if (!table) return;
+
+    free(table->slots);
+    memset(table, 0, sizeof(*table));
+    table->free_head = HANDLE_SLOT_NONE;
+}
+
+/**
+ * Double the slot array. Slot index HANDLE_SLOT_NONE is never handed out.
+ */
+static int grow(handle_table_t *table) {
+    if (table->capacity >= HANDLE_SLOT_NONE / 2) {
+        return -1;
+    }
+
+    uint32_t new_capacity = table->capacity * 2;
+    handle_slot_t *slots = realloc(table->slots, (size_t) new_capacity * sizeof(handle_slot_t));
+    if (!slots) {
+        return -1;
+    }
+
+    memset(slots + table->capacity, 0,
+           (size_t) (new_capacity - table->capacity) * sizeof(handle_slot_t));
+    table->slots = slots;
+    table->capacity = new_capacity;
+    return 0;
+}
+
+// =============================================================================
+// OPERATIONS
+// =============================================================================
+
+uint64_t handle_table_insert(handle_table_t *table, void *ptr, size_t size) {
+    if (!table || !table->slots || !ptr) {
+        return 0;
+    }
+
+    uint32_t index;
+    if (table->free_head != HANDLE_SLOT_NONE) {
+        // Reuse a released slot (generation was already bumped on remove)
+        index = table->free_head;
+        table->free_head = table->slots[index].next_free;
+    } else {
+        if (table->used == table->capacity && grow(table) != 0) {
+            return 0;
+        }
+        index = table->used++;
+        table->slots[index].generation = 1;
+    }
+
+    handle_slot_t *slot = &table->slots[index];
+    slot->ptr = ptr;
+    slot->size = size;
+    slot->next_free = HANDLE_SLOT_NONE;
+    slot->pins = 0;
+    slot->released = 0;
+    slot->owner = NULL;
+    table->live++;
+
+    return make_handle(table, index, slot->generation);
+}
+
+void *handle_table_lookup(const handle_table_t *table, uint64_t handle, size_t *size) {
+    if (!table || !table->slots) {
+        return NULL;
+    }
+
+    handle_slot_t *slot = find_slot(table, handle);
+    if (!slot) {
+        return NULL;
+    }
+
+    if (size) *size = slot->size;
+    return slot->ptr;
+}
+
+void *handle_table_pin(handle_table_t *table, uint64_t handle, size_t *size) {
+    if (!table || !table->slots) {
+        return NULL;
+    }
+
+    handle_slot_t *slot = find_slot(table, handle);
+    if (!slot) {
+        return NULL;
+    }
+
+    slot->pins++;
+    if (size) *size = slot->size;
+    return slot->ptr;
+}
+
+int handle_table_update(handle_table_t *table, uint64_t handle, void *ptr, size_t size) {
+    if (!table || !table->slots || !ptr) {
+        return 0;
+    }
+
+    handle_slot_t *slot = find_slot(table, handle);
+    if (!slot) {
+        return 0;
+    }
+
+    slot->ptr = ptr;
+    slot->size = size;
+    return 1;
+}
+
+int handle_table_set_owner(handle_table_t *table, uint64_t handle, void *owner) {
+    if (!table || !table->slots) {
+        return 0;
+    }
+
+    handle_slot_t *slot = find_slot(table, handle);
+    if (!slot) {
+        return 0;
+    }
+
+    slot->owner = owner;
+    return 1;
+}
+
+void *handle_table_owner(const handle_table_t *table, uint64_t handle) {
+    if (!table || !table->slots) {
+        return NULL;
+    }
+
+    handle_slot_t *slot = find_slot(table, handle);
+    return slot ? slot->owner : NULL;
+}
+
+int handle_table_pinned(const handle_table_t *table, uint64_t handle) {
+    if (!table || !table->slots) {
+        return 0;
+    }
+
+    handle_slot_t *slot = find_slot(table, handle);
+    return slot && slot->pins > 0;
+}
+
+/**
+ * Put a slot back on the free list
+ */
+static void recycle_slot(handle_table_t *table, uint32_t index) {
+    handle_slot_t *slot = &table->slots[index];
+
+    slot->ptr = NULL;
+    slot->size = 0;
+    slot->released = 0;
+    slot->owner = NULL;
+    slot->next_free = table->free_head;
+    table->free_head = index;
+}
+
+void *handle_table_unpin(handle_table_t *table, uint64_t handle) {
+    if (!table || !table->slots) {
+        return NULL;
+    }
+
+    // The generation may already have moved on (removed while pinned),
+    // so only the slot index is trusted here.
+    uint32_t index = handle_slot(handle);
+    if (handle_shard(handle) != table->shard || index >= table->used) {
+        return NULL;
+    }
+
+    handle_slot_t *slot = &table->slots[index];
+    if (slot->pins == 0) {
+        return NULL;
+    }
+
+    slot->pins--;
+    if (slot->pins > 0 || !slot->released) {
+        return NULL;
+    }
+
+    void *ptr = slot->ptr;
+    recycle_slot(table, index);
+    return ptr;
+}
+
+int handle_table_remove(handle_table_t *table, uint64_t handle, void **to_free) {
+    if (to_free) *to_free = NULL;
+
+    if (!table || !table->slots) {
+        return 0;
+    }
+
+    handle_slot_t *slot = find_slot(table, handle);
+    if (!slot) {
+        return 0;
+    }
+
+    if (slot->generation > table->retired) {
+        table->retired = slot->generation;
+    }
+
+    // Invalidate every outstanding copy of this handle. Generation 0 is
+    // skipped so that a handle can never be 0 (the protocol's "no handle").
+    slot->generation = (slot->generation + 1) & HANDLE_GENERATION_MASK;
+    if (slot->generation == 0) {
+        slot->generation = 1;
+    }
+    table->live--;
+
+    if (slot->pins > 0) {
+        // I/O still uses the block: keep it (and the slot) until the last unpin
+        slot->released = 1;
+        return 1;
+    }
+
+    if (to_free) *to_free = slot->ptr;
+    recycle_slot(table, handle_slot(handle));
+    return 1;
+}
+
+size_t handle_table_reclaim(handle_table_t *table, const void *owner,
+                            handle_reclaim_fn release, void *arg) {
+    if (!table || !table->slots || !owner) {
+        return 0;
+    }
+
+    size_t removed = 0;
+    for (uint32_t i = 0; i < table->used; i++) {
+        handle_slot_t *slot = &table->slots[i];
+        if (!slot->ptr || slot->released || slot->owner != owner) {
+            continue;
+        }
+
+        size_t size = slot->size;
+        void *to_free;
+        handle_table_remove(table, make_handle(table, i, slot->generation), &to_free);
+        if (release) release(to_free, size, arg);
+        removed++;
+    }
+    return removed;
+}
+
+// =============================================================================
+// RECOVERY
+// =============================================================================
+
+int handle_table_restore(handle_table_t *table, uint64_t handle, void *ptr, size_t size) {
+    if (!table || !table->slots || !ptr) {
+        return 0;
+    }
+
+    uint32_t index = handle_slot(handle);
+    uint32_t generation = handle_generation(handle);
+    if (handle_shard(handle) != table->shard || generation == 0 || index == HANDLE_SLOT_NONE) {
+        return 0;
+    }
+
+    while (index >= table->capacity) {
+        if (grow(table) != 0) {
+            return 0;
+        }
+    }
+
+    handle_slot_t *slot = &table->slots[index];
+    if (slot->ptr) {
+        return 0;
+    }
+
+    slot->ptr = ptr;
+    slot->size = size;
+    slot->generation = generation;
+    slot->next_free = HANDLE_SLOT_NONE;
+    slot->pins = 0;
+    slot->released = 0;
+    slot->owner = NULL;
+    if (index >= table->used) {
+        table->used = index + 1;
+    }
+    table->live++;
+    return 1;
+}
+
+void handle_table_rebuild(handle_table_t *table, uint32_t retired) {
+    if (!table || !table->slots) {
+        return;
+    }
+
+    retired &= HANDLE_GENERATION_MASK;
+    if (retired > table->retired) {
+        table->retired = retired;
+    }
+
+    uint32_t highest = table->retired;
+    for (uint32_t i = 0; i < table->used; i++) {
+        if (table->slots[i].ptr && table->slots[i].generation > highest) {
+            highest = table->slots[i].generation;
+        }
+    }
+    uint32_t generation = (highest + 1) & HANDLE_GENERATION_MASK;
+    if (generation == 0) {
+        generation = 1;
+    }
+
+    // Pushed from the top so the lowest slots are reused first
+    table->free_head = HANDLE_SLOT_NONE;
+    for (uint32_t i = table->used; i-- > 0; ) {
+        if (!table->slots[i].ptr) {
+            table->slots[i].generation = generation;
+            recycle_slot(table, i);
+        }
+    }
+}
@@ -0,0 +1,230 @@
+/**
+ * Ether Handle Table (server-internal)
+ *
+ * Maps client-visible 64-bit handles to block pointers in O(1).
+ *
+ * Handle layout:
+ *   [63..56] shard       - table that issued the handle (one per worker)
+ *   [55..32] generation  - bumped every time the slot is released
+ *   [31..0]  slot index  - position in the slot array
+ *
+ * A handle is only valid while the generation stored in its slot matches
+ * the one encoded in the handle, so stale handles (freed, then the slot
+ * reused) are rejected instead of aliasing a newer block.
+ *
+ * Blocks can be pinned while I/O runs directly against their memory
+ * (recv into / send from the block). Removing a pinned handle invalidates
+ * it immediately, but the block is only handed back for freeing once the
+ * last pin is dropped.
+ *
+ * Each block may have an owner (the server's per-client account, opaque
+ * here), so that all the blocks of one owner can be reclaimed at once.
+ *
+ * Copyright (C) 2024 - Licensed under GPL-3.0
+ */
+
+#ifndef ETHER_HANDLE_TABLE_H
+#define ETHER_HANDLE_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HANDLE_TABLE_INITIAL_CAPACITY  1024
+#define HANDLE_SLOT_NONE               UINT32_MAX   // End of free list
+
+#define HANDLE_SHARD_SHIFT       56
+#define HANDLE_MAX_SHARDS        256
+#define HANDLE_GENERATION_MASK   0x00FFFFFFu        // 24-bit generation
+
+/**
+ * One slot of the table. While free, next_free links the free list.
+ */
+typedef struct {
+    void*    ptr;          // Block pointer (NULL if slot is free)
+    size_t   size;         // Block size
+    uint32_t generation;   // Current generation of this slot (never 0)
+    uint32_t next_free;    // Next free slot (only meaningful when free)
+    uint32_t pins;         // In-flight I/O referencing ptr
+    uint32_t released;     // Handle removed while pinned; free on last unpin
+    void*    owner;        // Account charged for the block (NULL = none)
+} handle_slot_t;
+
+typedef struct {
+    handle_slot_t* slots;      // Slot array (grows geometrically)
+    uint32_t       capacity;   // Allocated slots
+    uint32_t       used;       // Slots ever handed out (high-water mark)
+    uint32_t       live;       // Slots currently holding a block
+    uint32_t       free_head;  // Head of the free list
+    uint32_t       retired;    // Highest generation of a removed handle
+    uint8_t        shard;      // Shard ID stamped into every handle
+} handle_table_t;
+
+/**
+ * Shard that issued a handle (no table access needed)
+ */
+static inline uint32_t handle_shard(uint64_t handle) {
+    return (uint32_t) (handle >> HANDLE_SHARD_SHIFT);
+}
+
+/**
+ * Initialize an empty table
+ *
+ * @param table     Table to initialize
+ * @param shard     Shard ID encoded into the handles this table issues
+ * @param capacity  Initial slot count (0 = HANDLE_TABLE_INITIAL_CAPACITY)
+ * @return          0 on success, -1 on allocation failure
+ */
+int handle_table_init(handle_table_t* table, uint8_t shard, uint32_t capacity);
+
+/**
+ * Release the slot array (blocks themselves are not freed)
+ *
+ * @param table  Table to destroy (can be NULL)
+ */
+void handle_table_destroy(handle_table_t* table);
+
+/**
+ * Reclaim callback: a block whose handle was removed
+ *
+ * @param to_free  Block the caller must free now, or NULL if it is still
+ *                 pinned (the last unpin returns it)
+ * @param size     Block size
+ * @param arg      Caller context
+ */
+typedef void (*handle_reclaim_fn)(void* to_free, size_t size, void* arg);
+
+/**
+ * Store a block and return its handle (with no owner)
+ *
+ * @param table  Handle table
+ * @param ptr    Block pointer (must not be NULL)
+ * @param size   Block size
+ * @return       New handle, 0 on failure
+ */
+uint64_t handle_table_insert(handle_table_t* table, void* ptr, size_t size);
+
+/**
+ * Resolve a handle
+ *
+ * @param table  Handle table
+ * @param handle Handle to look up
+ * @param size   Output: block size (can be NULL)
+ * @return       Block pointer, NULL if handle is unknown or stale
+ */
+void* handle_table_lookup(const handle_table_t* table, uint64_t handle, size_t* size);
+
+/**
+ * Resolve a handle and pin its block so it outlives a later remove
+ *
+ * @param table  Handle table
+ * @param handle Handle to pin
+ * @param size   Output: block size (can be NULL)
+ * @return       Block pointer, NULL if handle is unknown or stale
+ */
+void* handle_table_pin(handle_table_t* table, uint64_t handle, size_t* size);
+
+/**
+ * Drop a pin taken with handle_table_pin()
+ *
+ * @param table  Handle table
+ * @param handle The handle that was pinned (may have been removed since)
+ * @return       The block if it was removed while pinned and this was the
+ *               last pin (caller must free it), NULL otherwise
+ */
+void* handle_table_unpin(handle_table_t* table, uint64_t handle);
+
+/**
+ * Point a live handle at its block's new address and size (realloc).
+ * The handle itself stays valid.
+ *
+ * @param table  Handle table
+ * @param handle Handle to update
+ * @param ptr    Block pointer (must not be NULL)
+ * @param size   Block size
+ * @return       1 if updated, 0 if handle is unknown or stale
+ */
+int handle_table_update(handle_table_t* table, uint64_t handle, void* ptr, size_t size);
+
+/**
+ * Whether I/O is in flight on a handle's block (so it must not move)
+ *
+ * @param table  Handle table
+ * @param handle Handle to check
+ * @return       1 if pinned, 0 if not (or unknown)
+ */
+int handle_table_pinned(const handle_table_t* table, uint64_t handle);
+
+/**
+ * Set the owner of a live handle
+ *
+ * @param table  Handle table
+ * @param handle Handle to update
+ * @param owner  New owner (NULL = none)
+ * @return       1 if updated, 0 if handle is unknown or stale
+ */
+int handle_table_set_owner(handle_table_t* table, uint64_t handle, void* owner);
+
+/**
+ * Owner of a live handle
+ *
+ * @return  Owner, NULL if none or if handle is unknown or stale
+ */
+void* handle_table_owner(const handle_table_t* table, uint64_t handle);
+
+/**
+ * Release a handle; its slot is recycled with a new generation
+ *
+ * @param table   Handle table
+ * @param handle  Handle to remove
+ * @param to_free Output: block the caller must free now, or NULL if the
+ *                block is still pinned (the last unpin returns it)
+ * @return        1 if removed, 0 if handle is unknown or stale
+ */
+int handle_table_remove(handle_table_t* table, uint64_t handle, void** to_free);
+
+/**
+ * Remove every live handle of one owner, as handle_table_remove() does.
+ * O(slots): meant for the rare case of an owner going away.
+ *
+ * @param table    Handle table
+ * @param owner    Owner whose handles to remove (not NULL)
+ * @param release  Called for each removed block
+ * @param arg      Passed to release
+ * @return         Handles removed
+ */
+size_t handle_table_reclaim(handle_table_t* table, const void* owner,
+                            handle_reclaim_fn release, void* arg);
+
+/**
+ * Put a block back under a handle issued by an earlier run (persistent
+ * store recovery). Only for a table nothing was inserted into yet; call
+ * handle_table_rebuild() once every handle is restored.
+ *
+ * @param table   Handle table
+ * @param handle  Handle to restore (shard must match the table's)
+ * @param ptr     Block pointer (must not be NULL)
+ * @param size    Block size
+ * @return        1 if restored, 0 if the handle is invalid, for another
+ *                shard, or its slot is already taken
+ */
+int handle_table_restore(handle_table_t* table, uint64_t handle, void* ptr, size_t size);
+
+/**
+ * Finish handle_table_restore(): put every slot left empty on the free
+ * list. Their old generations are lost, so each starts past both the
+ * highest generation restored and retired, the highest generation any
+ * handle removed in earlier runs had (table->retired, kept by the caller).
+ *
+ * @param table    Handle table
+ * @param retired  Highest generation of a handle removed before (0 = none)
+ */
+void handle_table_rebuild(handle_table_t* table, uint32_t retired);
+
+/**
+ * Number of live handles
+ */
+static inline uint32_t handle_table_count(const handle_table_t* table) {
+    return table->live;
+}
+
+#endif // ETHER_HANDLE_TABLE_H
@@ -0,0 +1,306 @@
+/**
+ * Ether Logging Implementation
+ *
+ * One single-producer/single-consumer ring per logging thread, all drained
+ * by one writer thread. Producers only touch their own ring (a relaxed load
+ * of head, an acquire load of tail, a release store of head), so logging
+ * threads never contend with each other or wait for stderr.
+ *
+ * Copyright (C) 2024 - Licensed under GPL-3.0
+ */
+
+#include "ether/log.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// =============================================================================
+// CONFIGURATION
+// =============================================================================
+
+#define LOG_RING_SLOTS  512                 // Per thread, power of two
+#define LOG_OUT_BUFFER  (64 * 1024)         // Writer batches lines up to this size
+#define LOG_IDLE_US     10000               // Writer sleep when every ring is empty
+#define LOG_LINE_MAX    (ETHER_LOG_MSG_MAX + 64)
+
+int g_ether_log_level = ETHER_LOG_INFO;
+
+static const char *const g_level_names[] = { "DEBUG", "INFO", "WARN", "ERROR", "OFF" };
+
+// =============================================================================
+// RING BUFFERS
+// =============================================================================
+
+typedef struct {
+    int64_t     sec;                        // CLOCK_REALTIME at the log call
+    uint32_t    nsec;
+    uint8_t     level;
+    uint16_t    len;
+    const char *tag;
+    char        msg[ETHER_LOG_MSG_MAX];
+} log_entry_t;
+
+typedef struct log_ring {
+    _Alignas(64) atomic_size_t head;        // Next slot to fill (producer)
+    _Alignas(64) atomic_size_t tail;        // Next slot to write out (writer)
+    atomic_int       orphaned;              // Producer thread has exited
+    struct log_ring *next;                  // Registry link (under g_log_lock)
+    log_entry_t      slots[LOG_RING_SLOTS];
+} log_ring_t;
+
+static pthread_mutex_t g_log_lock = PTHREAD_MUTEX_INITIALIZER;
+static log_ring_t     *g_rings = NULL;      // Every registered ring
+static pthread_once_t  g_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t   g_ring_key;
+static __thread log_ring_t *t_ring = NULL;
+
+static atomic_int    g_log_running = 0;
+static pthread_t     g_log_thread;
+static atomic_size_t g_dropped = 0;
+static size_t        g_dropped_reported = 0;   // Writer only
+
+/**
+ * Thread exit: the writer frees the ring once it is drained
+ */
+static void ring_release(void *arg) {
+    log_ring_t *ring = arg;
+    atomic_store_explicit(&ring->orphaned, 1, memory_order_release);
+}
+
+static void make_key(void) {
+    pthread_key_create(&g_ring_key, ring_release);
+}
+
+static log_ring_t *ring_create(void) {
+    pthread_once(&g_key_once, make_key);
+
+    log_ring_t *ring = calloc(1, sizeof(log_ring_t));
+    if (!ring) return NULL;
+
+    pthread_mutex_lock(&g_log_lock);
+    ring->next = g_rings;
+    g_rings = ring;
+    pthread_mutex_unlock(&g_log_lock);
+
+    pthread_setspecific(g_ring_key, ring);
+    t_ring = ring;
+    return ring;
+}
+
+// =============================================================================
+// FORMATTING
+// =============================================================================
+
+/**
+ * "2024-05-01T12:34:56.123456Z INFO  [etherd] message\n"
+ */
+static size_t format_line(char *out, size_t cap, int64_t sec, uint32_t nsec,
+                          ether_log_level_t level, const char *tag,
+                          const char *msg, size_t len) {
+    struct tm tm;
+    time_t t = (time_t) sec;
+    gmtime_r(&t, &tm);
+
+    int n = snprintf(out, cap, "%04d-%02d-%02dT%02d:%02d:%02d.%06uZ %-5s [%s] %.*s\n",
+                     tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                     tm.tm_hour, tm.tm_min, tm.tm_sec, nsec / 1000,
+                     g_level_names[level], tag ? tag : "-", (int) len, msg);
+    if (n < 0) return 0;
+    return (size_t) n < cap ? (size_t) n : cap - 1;
+}
+
+static void write_all(const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(STDERR_FILENO, data, len);
+        if (n <= 0) return;
+        data += n;
+        len -= (size_t) n;
+    }
+}
+
+// =============================================================================
+// WRITER
+// =============================================================================
+
+typedef struct {
+    char   data[LOG_OUT_BUFFER];
+    size_t len;
+} log_out_t;
+
+static void out_line(log_out_t *out, int64_t sec, uint32_t nsec, ether_log_level_t level,
+                     const char *tag, const char *msg, size_t len) {
+    if (sizeof(out->data) - out->len < LOG_LINE_MAX) {
+        write_all(out->data, out->len);
+        out->len = 0;
+    }
+    out->len += format_line(out->data + out->len, sizeof(out->data) - out->len,
+                            sec, nsec, level, tag, msg, len);
+}
+
+/**
+ * Write out every queued message (single consumer: the writer thread,
+ * or ether_log_stop() once the writer is gone)
+ *
+ * @return  Number of messages written
+ */
+static size_t drain(log_out_t *out) {
+    size_t total = 0;
+
+    pthread_mutex_lock(&g_log_lock);
+    log_ring_t **link = &g_rings;
+    while (*link) {
+        log_ring_t *ring = *link;
+        int orphaned = atomic_load_explicit(&ring->orphaned, memory_order_acquire);
+
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        for (; tail != head; tail++) {
+            const log_entry_t *e = &ring->slots[tail & (LOG_RING_SLOTS - 1)];
+            out_line(out, e->sec, e->nsec, (ether_log_level_t) e->level, e->tag, e->msg, e->len);
+            total++;
+        }
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+
+        if (orphaned) {
+            *link = ring->next;
+            free(ring);
+        } else {
+            link = &ring->next;
+        }
+    }
+    pthread_mutex_unlock(&g_log_lock);
+
+    size_t dropped = atomic_load_explicit(&g_dropped, memory_order_relaxed);
+    if (dropped != g_dropped_reported) {
+        char msg[64];
+        int len = snprintf(msg, sizeof(msg), "%zu messages dropped (ring full)",
+                           dropped - g_dropped_reported);
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        out_line(out, ts.tv_sec, (uint32_t) ts.tv_nsec, ETHER_LOG_WARN, "log", msg, (size_t) len);
+        g_dropped_reported = dropped;
+    }
+
+    write_all(out->data, out->len);
+    out->len = 0;
+    return total;
+}
+
+static void *log_main(void *arg) {
+    log_out_t *out = arg;
+
+    for (;;) {
+        int running = atomic_load_explicit(&g_log_running, memory_order_acquire);
+        if (drain(out) == 0) {
+            if (!running) break;
+            usleep(LOG_IDLE_US);
+        }
+    }
+
+    return NULL;
+}
+
+// =============================================================================
+// API
+// =============================================================================
+
+void ether_log_set_level(ether_log_level_t level) {
+    if (level > ETHER_LOG_OFF) level = ETHER_LOG_OFF;
+    __atomic_store_n(&g_ether_log_level, (int) level, __ATOMIC_RELAXED);
+}
+
+ether_log_level_t ether_log_get_level(void) {
+    return (ether_log_level_t) __atomic_load_n(&g_ether_log_level, __ATOMIC_RELAXED);
+}
+
+int ether_log_parse_level(const char *name) {
+    static const char *const names[] = { "debug", "info", "warn", "error", "off" };
+    if (!name) return -1;
+
+    for (int i = 0; i <= ETHER_LOG_OFF; i++) {
+        if (strcmp(name, names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+void ether_log_write(ether_log_level_t level, const char *tag, const char *fmt, ...) {
+    if (level >= ETHER_LOG_OFF) return;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    log_ring_t *ring = NULL;
+    if (atomic_load_explicit(&g_log_running, memory_order_acquire)) {
+        ring = t_ring ? t_ring : ring_create();
+    }
+
+    va_list args;
+    va_start(args, fmt);
+
+    if (!ring) {
+        // No writer thread: one write(2) per line, never interleaved mid-line
+        char msg[ETHER_LOG_MSG_MAX];
+        char line[LOG_LINE_MAX];
+        int n = vsnprintf(msg, sizeof(msg), fmt, args);
+        va_end(args);
+        if (n < 0) return;
+
+        size_t len = (size_t) n < sizeof(msg) ? (size_t) n : sizeof(msg) - 1;
+        write_all(line, format_line(line, sizeof(line), ts.tv_sec, (uint32_t) ts.tv_nsec,
+                                    level, tag, msg, len));
+        return;
+    }
+
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail >= LOG_RING_SLOTS) {
+        va_end(args);
+        atomic_fetch_add_explicit(&g_dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    log_entry_t *e = &ring->slots[head & (LOG_RING_SLOTS - 1)];
+    int n = vsnprintf(e->msg, sizeof(e->msg), fmt, args);
+    va_end(args);
+    if (n < 0) return;
+
+    e->sec = ts.tv_sec;
+    e->nsec = (uint32_t) ts.tv_nsec;
+    e->level = (uint8_t) level;
+    e->len = (uint16_t) ((size_t) n < sizeof(e->msg) ? (size_t) n : sizeof(e->msg) - 1);
+    e->tag = tag;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+int ether_log_start(void) {
+    if (atomic_load(&g_log_running)) {
+        return 0;
+    }
+
+    static log_out_t out;
+    atomic_store(&g_log_running, 1);
+    if (pthread_create(&g_log_thread, NULL, log_main, &out) != 0) {
+        atomic_store(&g_log_running, 0);
+        return -1;
+    }
+    return 0;
+}
+
+void ether_log_stop(void) {
+    if (!atomic_exchange(&g_log_running, 0)) {
+        return;
+    }
+
+    // The writer drains until it finds every ring empty
+    pthread_join(g_log_thread, NULL);
+}
+
+size_t ether_log_dropped(void) {
+    return atomic_load_explicit(&g_dropped, memory_order_relaxed);
+}
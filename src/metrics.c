@@ -0,0 +1,191 @@
+/**
+ * Ether Request Metrics Implementation
+ *
+ * Log-linear latency histograms and per-command counters.
+ *
+ * Copyright (C) 2024 - Licensed under GPL-3.0
+ */
+
+#include "metrics.h"
+#include "ether/protocol.h"
+#include <string.h>
+
+// =============================================================================
+// COMMAND CLASSES
+// =============================================================================
+
+metric_cmd_t metric_cmd(uint8_t command) {
+    switch (command) {
+        case ETHER_CMD_PING:      return METRIC_PING;
+        case ETHER_CMD_ALLOC:     return METRIC_ALLOC;
+        case ETHER_CMD_FREE:      return METRIC_FREE;
+        case ETHER_CMD_REALLOC:   return METRIC_REALLOC;
+        case ETHER_CMD_SHARE:     return METRIC_SHARE;
+        case ETHER_CMD_WRITE:     return METRIC_WRITE;
+        case ETHER_CMD_READ:      return METRIC_READ;
+        case ETHER_CMD_COPY:      return METRIC_COPY;
+        case ETHER_CMD_FILL:      return METRIC_FILL;
+        case ETHER_CMD_CMP:       return METRIC_CMP;
+        case ETHER_CMD_CHECKSUM:  return METRIC_CHECKSUM;
+        case ETHER_CMD_BATCH:     return METRIC_BATCH;
+        case ETHER_CMD_STATS:     return METRIC_STATS;
+        case ETHER_CMD_MEMINFO:   return METRIC_MEMINFO;
+        default:                  return METRIC_OTHER;
+    }
+}
+
+uint8_t metric_wire_cmd(metric_cmd_t cmd) {
+    static const uint8_t wire[METRIC_NUM_CMDS] = {
+        [METRIC_PING]     = ETHER_CMD_PING,
+        [METRIC_ALLOC]    = ETHER_CMD_ALLOC,
+        [METRIC_FREE]     = ETHER_CMD_FREE,
+        [METRIC_REALLOC]  = ETHER_CMD_REALLOC,
+        [METRIC_SHARE]    = ETHER_CMD_SHARE,
+        [METRIC_WRITE]    = ETHER_CMD_WRITE,
+        [METRIC_READ]     = ETHER_CMD_READ,
+        [METRIC_COPY]     = ETHER_CMD_COPY,
+        [METRIC_FILL]     = ETHER_CMD_FILL,
+        [METRIC_CMP]      = ETHER_CMD_CMP,
+        [METRIC_CHECKSUM] = ETHER_CMD_CHECKSUM,
+        [METRIC_BATCH]    = ETHER_CMD_BATCH,
+        [METRIC_STATS]    = ETHER_CMD_STATS,
+        [METRIC_MEMINFO]  = ETHER_CMD_MEMINFO,
+        [METRIC_OTHER]    = 0,
+    };
+    return cmd < METRIC_NUM_CMDS ? wire[cmd] : 0;
+}
+
+const char *metric_name(metric_cmd_t cmd) {
+    static const char *const names[METRIC_NUM_CMDS] = {
+        [METRIC_PING]     = "ping",
+        [METRIC_ALLOC]    = "alloc",
+        [METRIC_FREE]     = "free",
+        [METRIC_REALLOC]  = "realloc",
+        [METRIC_SHARE]    = "share",
+        [METRIC_WRITE]    = "write",
+        [METRIC_READ]     = "read",
+        [METRIC_COPY]     = "copy",
+        [METRIC_FILL]     = "fill",
+        [METRIC_CMP]      = "cmp",
+        [METRIC_CHECKSUM] = "checksum",
+        [METRIC_BATCH]    = "batch",
+        [METRIC_STATS]    = "stats",
+        [METRIC_MEMINFO]  = "meminfo",
+        [METRIC_OTHER]    = "other",
+    };
+    return cmd < METRIC_NUM_CMDS ? names[cmd] : "other";
+}
+
+// =============================================================================
+// HISTOGRAM
+// =============================================================================
+
+/**
+ * Values below METRICS_SUB_BUCKETS get one bucket each; above, the range
+ * [2^lg, 2^(lg+1)) is split into METRICS_SUB_BUCKETS equal steps.
+ */
+unsigned metrics_bucket(uint64_t ns) {
+    if (ns < METRICS_SUB_BUCKETS) {
+        return (unsigned) ns;
+    }
+
+    unsigned lg = 63 - (unsigned) __builtin_clzll(ns);
+    if (lg > METRICS_MAX_LOG2) {
+        return METRICS_BUCKETS - 1;
+    }
+
+    unsigned sub = (unsigned) (ns >> (lg - METRICS_SUB_BITS)) & (METRICS_SUB_BUCKETS - 1);
+    return (lg - METRICS_SUB_BITS + 1) * METRICS_SUB_BUCKETS + sub;
+}
+
+uint64_t metrics_bucket_max(unsigned bucket) {
+    if (bucket < METRICS_SUB_BUCKETS) {
+        return bucket;
+    }
+    if (bucket >= METRICS_BUCKETS - 1) {
+        return UINT64_MAX;
+    }
+
+    unsigned lg = bucket / METRICS_SUB_BUCKETS + METRICS_SUB_BITS - 1;
+    uint64_t sub = bucket % METRICS_SUB_BUCKETS;
+    return ((METRICS_SUB_BUCKETS + sub + 1) << (lg - METRICS_SUB_BITS)) - 1;
+}
+
+// =============================================================================
+// RECORDING
+// =============================================================================
+
+// Single writer per metrics_t: a plain load + store is enough
+static inline void counter_add(atomic_uint_fast64_t *counter, uint64_t n) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n,
+                          memory_order_relaxed);
+}
+
+static inline uint64_t counter_load(const atomic_uint_fast64_t *counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+void metrics_record(metrics_t *metrics, metric_cmd_t cmd, uint64_t latency_ns,
+                    size_t bytes_in, size_t bytes_out, int failed) {
+    if (!metrics || cmd >= METRIC_NUM_CMDS) {
+        return;
+    }
+
+    cmd_metrics_t *m = &metrics->cmds[cmd];
+    counter_add(&m->count, 1);
+    if (failed) counter_add(&m->errors, 1);
+    counter_add(&m->bytes_in, bytes_in);
+    counter_add(&m->bytes_out, bytes_out);
+    counter_add(&m->latency_sum, latency_ns);
+    counter_add(&m->buckets[metrics_bucket(latency_ns)], 1);
+}
+
+void metrics_merge(metrics_snapshot_t *out, const metrics_t *metrics) {
+    if (!out || !metrics) {
+        return;
+    }
+
+    for (int c = 0; c < METRIC_NUM_CMDS; c++) {
+        const cmd_metrics_t *m = &metrics->cmds[c];
+        metrics_snapshot_t *s = &out[c];
+
+        s->count += counter_load(&m->count);
+        s->errors += counter_load(&m->errors);
+        s->bytes_in += counter_load(&m->bytes_in);
+        s->bytes_out += counter_load(&m->bytes_out);
+        s->latency_sum += counter_load(&m->latency_sum);
+        for (int b = 0; b < METRICS_BUCKETS; b++) {
+            s->buckets[b] += counter_load(&m->buckets[b]);
+        }
+    }
+}
+
+uint64_t metrics_percentile(const metrics_snapshot_t *snap, double q) {
+    if (!snap) {
+        return 0;
+    }
+
+    // Buckets are read one by one, so their sum may differ slightly
+    // from snap->count; rank against the buckets themselves
+    uint64_t total = 0;
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+        total += snap->buckets[b];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    if (q < 0) q = 0;
+    if (q > 1) q = 1;
+    uint64_t rank = (uint64_t) (q * (double) total + 0.5);
+    if (rank == 0) rank = 1;
+
+    uint64_t seen = 0;
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+        seen += snap->buckets[b];
+        if (seen >= rank) {
+            return metrics_bucket_max((unsigned) b);
+        }
+    }
+    return metrics_bucket_max(METRICS_BUCKETS - 1);
+}
@@ -0,0 +1,129 @@
+/**
+ * Ether Request Metrics (server-internal)
+ *
+ * Per-command counters and latency histograms for etherd.
+ *
+ * Every worker owns one metrics_t and is the only thread that records
+ * into it (relaxed load + store, no locked RMW). Readers (STATS requests
+ * served by any worker, the /metrics listener) merge all workers into a
+ * snapshot, so a reading may be a few requests behind but never blocks
+ * the request path.
+ *
+ * Latencies go into log-linear buckets: every power of two is split into
+ * METRICS_SUB_BUCKETS linear steps, so a percentile read from the
+ * histogram is within 1/METRICS_SUB_BUCKETS (12.5%) of the true value.
+ *
+ * Copyright (C) 2024 - Licensed under GPL-3.0
+ */
+
+#ifndef ETHER_METRICS_H
+#define ETHER_METRICS_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define METRICS_SUB_BITS     3
+#define METRICS_SUB_BUCKETS  (1 << METRICS_SUB_BITS)
+#define METRICS_MAX_LOG2     40    // Latencies clamp at 2^40 ns (~18 minutes)
+#define METRICS_BUCKETS      ((METRICS_MAX_LOG2 - METRICS_SUB_BITS + 2) * METRICS_SUB_BUCKETS)
+
+/**
+ * Command classes tracked separately
+ */
+typedef enum {
+    METRIC_PING,
+    METRIC_ALLOC,
+    METRIC_FREE,
+    METRIC_REALLOC,
+    METRIC_SHARE,
+    METRIC_WRITE,
+    METRIC_READ,
+    METRIC_COPY,
+    METRIC_FILL,
+    METRIC_CMP,
+    METRIC_CHECKSUM,
+    METRIC_BATCH,
+    METRIC_STATS,
+    METRIC_MEMINFO,
+    METRIC_OTHER,      // Unknown commands
+    METRIC_NUM_CMDS,
+} metric_cmd_t;
+
+typedef struct {
+    atomic_uint_fast64_t count;
+    atomic_uint_fast64_t errors;
+    atomic_uint_fast64_t bytes_in;
+    atomic_uint_fast64_t bytes_out;
+    atomic_uint_fast64_t latency_sum;           // ns
+    atomic_uint_fast64_t buckets[METRICS_BUCKETS];
+} cmd_metrics_t;
+
+/**
+ * One worker's metrics (written by that worker only)
+ */
+typedef struct {
+    cmd_metrics_t cmds[METRIC_NUM_CMDS];
+} metrics_t;
+
+/**
+ * Merged, plain copy of one command's metrics
+ */
+typedef struct {
+    uint64_t count;
+    uint64_t errors;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t latency_sum;
+    uint64_t buckets[METRICS_BUCKETS];
+} metrics_snapshot_t;
+
+/**
+ * Class of a wire command (ether_cmd_t)
+ */
+metric_cmd_t metric_cmd(uint8_t command);
+
+/**
+ * Wire command of a class (0 for METRIC_OTHER)
+ */
+uint8_t metric_wire_cmd(metric_cmd_t cmd);
+
+/**
+ * Lower-case class name ("alloc", ...), used as a Prometheus label
+ */
+const char* metric_name(metric_cmd_t cmd);
+
+/**
+ * Histogram bucket holding a latency, and the largest latency it holds
+ */
+unsigned metrics_bucket(uint64_t ns);
+uint64_t metrics_bucket_max(unsigned bucket);
+
+/**
+ * Record one finished request (owning worker only)
+ *
+ * @param metrics     Worker's metrics
+ * @param cmd         Command class
+ * @param latency_ns  Header received -> response queued
+ * @param bytes_in    Request payload bytes
+ * @param bytes_out   Response payload bytes
+ * @param failed      Answered with ERROR
+ */
+void metrics_record(metrics_t* metrics, metric_cmd_t cmd, uint64_t latency_ns,
+                    size_t bytes_in, size_t bytes_out, int failed);
+
+/**
+ * Add a worker's metrics to a snapshot (METRIC_NUM_CMDS entries)
+ */
+void metrics_merge(metrics_snapshot_t* out, const metrics_t* metrics);
+
+/**
+ * Latency below which a fraction q of the requests completed
+ *
+ * @param snap  Snapshot of one command
+ * @param q     Quantile in [0, 1], e.g. 0.99
+ * @return      Upper bound of the matching bucket in ns, 0 if no requests
+ */
+uint64_t metrics_percentile(const metrics_snapshot_t* snap, double q);
+
+#endif // ETHER_METRICS_H
@@ -58,13 +58,32 @@ int ether_msg_validate(const ether_msg_header_t *header) {
         return 0;
     }
 
-    if (header->size > ETHER_MAX_PAYLOAD) {
+    // Only bytes that actually follow the header are limited; ALLOC and
+    // READ sizes are parameters and may describe larger blocks
+    if (ether_msg_payload_size(header) > ETHER_MAX_PAYLOAD) {
         return 0;
     }
 
     return 1;
 }
 
+size_t ether_msg_payload_size(const ether_msg_header_t *header) {
+    if (!header) {
+        return 0;
+    }
+
+    switch (header->command) {
+        // size carries a parameter (bytes to allocate / read), not a payload
+        case ETHER_CMD_ALLOC:
+        case ETHER_CMD_REALLOC:
+            return 0;
+        case ETHER_CMD_READ:
+            return (header->flags & ETHER_FLAG_OFFSET) ? ETHER_OFFSET_SIZE : 0;
+        default:
+            return header->size;
+    }
+}
+
 size_t ether_msg_total_size(const ether_msg_t *msg) {
     if (!msg) {
         return 0;
@@ -134,19 +153,298 @@ void ether_msg_deserialize_header(const uint8_t *buffer, ether_msg_header_t *hea
     header->reserved = ntohl(buf32[1]);
 }
 
+void ether_msg_serialize_offset(uint64_t offset, uint8_t *buffer) {
+    if (!buffer) {
+        return;
+    }
+
+    for (int i = 0; i < 8; i++) {
+        buffer[i] = (offset >> (56 - 8 * i)) & 0xFF;
+    }
+}
+
+uint64_t ether_msg_deserialize_offset(const uint8_t *buffer) {
+    if (!buffer) {
+        return 0;
+    }
+
+    uint64_t offset = 0;
+    for (int i = 0; i < 8; i++) {
+        offset = (offset << 8) | buffer[i];
+    }
+    return offset;
+}
+
+void ether_batch_record_serialize(const ether_batch_record_t *record, uint8_t *buffer) {
+    if (!record || !buffer) {
+        return;
+    }
+
+    buffer[0] = record->command;
+    buffer[1] = record->flags;
+    buffer[2] = 0;
+    buffer[3] = 0;
+
+    uint32_t size = htonl(record->size);
+    memcpy(buffer + 4, &size, sizeof(size));
+
+    for (int i = 0; i < 8; i++) {
+        buffer[8 + i] = (record->handle >> (56 - 8 * i)) & 0xFF;
+    }
+}
+
+void ether_batch_record_deserialize(const uint8_t *buffer, ether_batch_record_t *record) {
+    if (!buffer || !record) {
+        return;
+    }
+
+    record->command = buffer[0];
+    record->flags = buffer[1];
+
+    uint32_t size;
+    memcpy(&size, buffer + 4, sizeof(size));
+    record->size = ntohl(size);
+
+    record->handle = 0;
+    for (int i = 0; i < 8; i++) {
+        record->handle = (record->handle << 8) | buffer[8 + i];
+    }
+}
+
+static void put_u64(uint8_t *buffer, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        buffer[i] = (value >> (56 - 8 * i)) & 0xFF;
+    }
+}
+
+static uint64_t get_u64(const uint8_t *buffer) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value = (value << 8) | buffer[i];
+    }
+    return value;
+}
+
+void ether_stats_record_serialize(const ether_stats_record_t *record, uint8_t *buffer) {
+    if (!record || !buffer) {
+        return;
+    }
+
+    memset(buffer, 0, 8);
+    buffer[0] = record->command;
+    put_u64(buffer + 8, record->count);
+    put_u64(buffer + 16, record->errors);
+    put_u64(buffer + 24, record->bytes_in);
+    put_u64(buffer + 32, record->bytes_out);
+    put_u64(buffer + 40, record->p50_ns);
+    put_u64(buffer + 48, record->p99_ns);
+    put_u64(buffer + 56, record->p999_ns);
+}
+
+void ether_stats_record_deserialize(const uint8_t *buffer, ether_stats_record_t *record) {
+    if (!buffer || !record) {
+        return;
+    }
+
+    record->command = buffer[0];
+    record->count = get_u64(buffer + 8);
+    record->errors = get_u64(buffer + 16);
+    record->bytes_in = get_u64(buffer + 24);
+    record->bytes_out = get_u64(buffer + 32);
+    record->p50_ns = get_u64(buffer + 40);
+    record->p99_ns = get_u64(buffer + 48);
+    record->p999_ns = get_u64(buffer + 56);
+}
+
+void ether_meminfo_record_serialize(const ether_meminfo_record_t *record, uint8_t *buffer) {
+    if (!record || !buffer) {
+        return;
+    }
+
+    put_u64(buffer, record->used);
+    put_u64(buffer + 8, record->peak);
+    put_u64(buffer + 16, record->available);
+    put_u64(buffer + 24, record->blocks);
+}
+
+void ether_meminfo_record_deserialize(const uint8_t *buffer, ether_meminfo_record_t *record) {
+    if (!buffer || !record) {
+        return;
+    }
+
+    record->used = get_u64(buffer);
+    record->peak = get_u64(buffer + 8);
+    record->available = get_u64(buffer + 16);
+    record->blocks = get_u64(buffer + 24);
+}
+
+void ether_bulk_record_serialize(const ether_bulk_record_t *record, uint8_t *buffer) {
+    if (!record || !buffer) {
+        return;
+    }
+
+    put_u64(buffer, record->offset);
+    put_u64(buffer + 8, record->length);
+    put_u64(buffer + 16, record->handle);
+    put_u64(buffer + 24, record->offset2);
+}
+
+void ether_bulk_record_deserialize(const uint8_t *buffer, ether_bulk_record_t *record) {
+    if (!buffer || !record) {
+        return;
+    }
+
+    record->offset = get_u64(buffer);
+    record->length = get_u64(buffer + 8);
+    record->handle = get_u64(buffer + 16);
+    record->offset2 = get_u64(buffer + 24);
+}
+
+// =============================================================================
+// CHECKSUM
+// =============================================================================
+
+#define CHECKSUM_PRIME1  0x9E3779B185EBCA87ULL
+#define CHECKSUM_PRIME2  0xC2B2AE3D27D4EB4FULL
+#define CHECKSUM_PRIME3  0x165667B19E3779F9ULL
+
+static inline uint64_t load_le64(const uint8_t *p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static inline uint64_t checksum_round(uint64_t acc, uint64_t word) {
+    acc += word * CHECKSUM_PRIME2;
+    acc = (acc << 31) | (acc >> 33);
+    return acc * CHECKSUM_PRIME1;
+}
+
+/**
+ * Four independent lanes over 32-byte stripes keep the multiplies
+ * pipelined; words are read little-endian so every host agrees.
+ */
+uint64_t ether_checksum(const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *) data;
+    uint64_t lane[4] = {
+        CHECKSUM_PRIME1 + CHECKSUM_PRIME2, CHECKSUM_PRIME2, 0, -CHECKSUM_PRIME1
+    };
+    size_t n = len;
+
+    while (n >= 32) {
+        for (int i = 0; i < 4; i++) {
+            lane[i] = checksum_round(lane[i], load_le64(p + 8 * i));
+        }
+        p += 32;
+        n -= 32;
+    }
+
+    uint64_t acc = ((lane[0] << 1) | (lane[0] >> 63)) ^ ((lane[1] << 7) | (lane[1] >> 57)) ^
+                   ((lane[2] << 12) | (lane[2] >> 52)) ^ ((lane[3] << 18) | (lane[3] >> 46));
+    acc += (uint64_t) len;
+
+    while (n >= 8) {
+        acc = checksum_round(acc, load_le64(p)) ^ CHECKSUM_PRIME3;
+        p += 8;
+        n -= 8;
+    }
+    while (n > 0) {
+        acc = (acc ^ (*p++ * CHECKSUM_PRIME3)) * CHECKSUM_PRIME1;
+        n--;
+    }
+
+    acc ^= acc >> 33;
+    acc *= CHECKSUM_PRIME2;
+    acc ^= acc >> 29;
+    acc *= CHECKSUM_PRIME3;
+    acc ^= acc >> 32;
+    return acc;
+}
+
+// =============================================================================
+// BUFFER POOL
+// =============================================================================
+
+/**
+ * Class of a size, ETHER_POOL_CLASSES if it is too large to pool
+ */
+static inline unsigned buf_class(size_t size) {
+    if (size <= ETHER_POOL_MIN_BUFFER) {
+        return 0;
+    }
+    if (size > ETHER_POOL_MAX_BUFFER) {
+        return ETHER_POOL_CLASSES;
+    }
+    unsigned shift = 64 - (unsigned) __builtin_clzll((unsigned long long) size - 1);
+    return shift - ETHER_POOL_MIN_SHIFT;
+}
+
+void ether_buf_pool_init(ether_buf_pool_t* pool) {
+    if (!pool) return;
+    memset(pool, 0, sizeof(*pool));
+}
+
+void ether_buf_pool_destroy(ether_buf_pool_t* pool) {
+    if (!pool) return;
+
+    for (unsigned c = 0; c < ETHER_POOL_CLASSES; c++) {
+        while (pool->count[c] > 0) {
+            free(pool->free[c][--pool->count[c]]);
+        }
+    }
+    memset(pool, 0, sizeof(*pool));
+}
+
+size_t ether_buf_capacity(size_t size) {
+    unsigned c = buf_class(size);
+    return c < ETHER_POOL_CLASSES ? ETHER_POOL_MIN_BUFFER << c : size;
+}
+
+void* ether_buf_get(ether_buf_pool_t* pool, size_t size) {
+    unsigned c = buf_class(size);
+    if (pool && c < ETHER_POOL_CLASSES && pool->count[c] > 0) {
+        pool->hits++;
+        return pool->free[c][--pool->count[c]];
+    }
+
+    if (pool) pool->misses++;
+    return malloc(ether_buf_capacity(size));
+}
+
+void ether_buf_put(ether_buf_pool_t* pool, void* buf, size_t size) {
+    if (!buf) return;
+
+    unsigned c = buf_class(size);
+    if (pool && c < ETHER_POOL_CLASSES && pool->count[c] < ETHER_POOL_DEPTH) {
+        pool->free[c][pool->count[c]++] = buf;
+        return;
+    }
+    free(buf);
+}
+
 // =============================================================================
 // DEBUG
 // =============================================================================
 
-static const char *cmd_to_string(uint8_t cmd) {
+const char *ether_cmd_to_string(ether_cmd_t cmd) {
     switch (cmd) {
         case ETHER_CMD_PING: return "PING";
         case ETHER_CMD_PONG: return "PONG";
         case ETHER_CMD_ALLOC: return "ALLOC";
         case ETHER_CMD_FREE: return "FREE";
         case ETHER_CMD_REALLOC: return "REALLOC";
+        case ETHER_CMD_SHARE: return "SHARE";
         case ETHER_CMD_WRITE: return "WRITE";
         case ETHER_CMD_READ: return "READ";
+        case ETHER_CMD_COPY: return "COPY";
+        case ETHER_CMD_FILL: return "FILL";
+        case ETHER_CMD_CMP: return "CMP";
+        case ETHER_CMD_CHECKSUM: return "CHECKSUM";
+        case ETHER_CMD_BATCH: return "BATCH";
+        case ETHER_CMD_STATS: return "STATS";
+        case ETHER_CMD_MEMINFO: return "MEMINFO";
         case ETHER_CMD_OK: return "OK";
         case ETHER_CMD_ERROR: return "ERROR";
         default: return "UNKNOWN";
@@ -164,7 +462,7 @@ void ether_msg_dump(const ether_msg_t *msg) {
            msg->header.magic == ETHER_MAGIC ? "(valid)" : "(INVALID!)");
     printf("Version:  %d\n", msg->header.version);
     printf("Command:  0x%02X (%s)\n", msg->header.command,
-           cmd_to_string(msg->header.command));
+           ether_cmd_to_string(msg->header.command));
     printf("Flags:    0x%04X\n", msg->header.flags);
     printf("Handle:   0x%016lX\n", (unsigned long) msg->header.handle);
     printf("Size:     %u bytes\n", msg->header.size);
@@ -1,14 +1,50 @@
 /**
  * Ether Daemon (etherd) - Server MVP
  *
- * Per ora: semplice TCP server che accetta connessioni
- * e risponde ai comandi del protocollo Ether.
+ * TCP server che risponde ai comandi del protocollo Ether.
  *
- * TODO: Migrare a libuv per async I/O
+ * N worker threads (--threads N), each running its own edge-triggered
+ * epoll reactor on its own SO_REUSEPORT listener: the kernel spreads
+ * incoming connections across workers. Every socket is non-blocking and
+ * each connection carries its own parse state (header -> payload ->
+ * dispatch), so many clients can interleave requests without blocking
+ * each other.
+ *
+ * Each worker owns one shard of the handle table; the shard ID is encoded
+ * in the handle, so any worker can route a request to the right shard
+ * without a global lock.
+ *
+ * Every request is timed from header to queued response into the worker's
+ * metrics, served by STATS and, with --metrics-port, by an HTTP /metrics
+ * endpoint in Prometheus text format.
+ *
+ * With --unix PATH, co-located clients can also connect over a Unix domain
+ * socket, where SHARE hands them the memfd of a shared block to map.
+ *
+ * With --store PATH, blocks live in a persistent file or DAX device, each
+ * tagged with its handle: a restarted etherd puts them back under the same
+ * handles and serves them without copying anything in.
+ *
+ * With --quota-bytes / --quota-handles / --memory-limit, every block is
+ * charged to the account of the host that allocated it and ALLOCs over a
+ * limit are refused with a distinct error code; with --reclaim, a host's
+ * blocks are freed when its last connection closes.
+ *
+ * With --io uring, each worker runs an io_uring reactor instead: accepts,
+ * receives and sends are queued on the worker's ring and one
+ * io_uring_enter() submits them and collects completions for all of its
+ * connections at once.
  */
 
+#define _GNU_SOURCE   // accept4()
+
 #include "ether/ether.h"
 #include "ether/protocol.h"
+#include "ether/compress.h"
+#include "ether/log.h"
+#include "handle_table.h"
+#include "metrics.h"
+#include "uring.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -16,8 +52,20 @@
 #include <unistd.h>
 #include <signal.h>
 #include <errno.h>
-
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
@@ -25,365 +73,3070 @@
 // CONFIGURATION
 // =============================================================================
 
-#define MAX_CLIENTS     64
-#define BUFFER_SIZE     4096
+#define MAX_CLIENTS     64                  // listen() backlog
+#define BUFFER_SIZE     4096                // Per-connection input buffer
+#define MAX_EVENTS      256                 // epoll_wait batch size
+#define OUT_HIGH_WATER  (4 * 1024 * 1024)   // Stop parsing while this much output is queued
+#define MAX_WORKERS     HANDLE_MAX_SHARDS   // One handle table shard per worker
+#define IOV_BATCH       64                  // Output segments per sendmsg()
+#define METRICS_TIMEOUT 2                   // Seconds a /metrics client may take to send its request
+#define URING_ENTRIES   256                 // Submission queue size per worker (--io uring)
+#define URING_MAX_RECV  (1u << 30)          // Largest single receive queued on the ring
 
 // =============================================================================
 // HANDLE MAPPING
 // =============================================================================
 
-// Semplice mapping handle → pointer (per MVP)
+// Slot + generation table: O(1) store/lookup/remove, grows on demand.
+// Stale handles (already freed) fail the generation check -> NOTFOUND.
+//
+// One table per worker. The owning worker is the only one that inserts,
+// but a client may reach a block through a connection served by another
+// worker, so each shard has a mutex. It is uncontended in the common case.
 typedef struct {
-    uint64_t handle;
-    void *ptr;
-    size_t size;
-    int in_use;
-} handle_entry_t;
+    handle_table_t  table;
+    pthread_mutex_t lock;
+} shard_t;
 
-static handle_entry_t g_handles[1024];
-static uint64_t g_next_handle = 1;
+static shard_t g_shards[MAX_WORKERS];
+static int g_num_shards = 0;
 
-static uint64_t store_handle(void *ptr, size_t size) {
-    for (int i = 0; i < 1024; i++) {
-        if (!g_handles[i].in_use) {
-            g_handles[i].handle = g_next_handle++;
-            g_handles[i].ptr = ptr;
-            g_handles[i].size = size;
-            g_handles[i].in_use = 1;
-            return g_handles[i].handle;
-        }
-    }
-    return 0; // No space
+struct account;
+
+static uint64_t store_handle(shard_t *shard, void *ptr, size_t size, struct account *owner) {
+    pthread_mutex_lock(&shard->lock);
+    uint64_t handle = handle_table_insert(&shard->table, ptr, size);
+    if (handle) handle_table_set_owner(&shard->table, handle, owner);
+    pthread_mutex_unlock(&shard->lock);
+
+    // With --store, the handle is what finds the block after a restart
+    if (handle) ether_store_tag(ptr, handle);
+    return handle;
 }
 
-static void *lookup_handle(uint64_t handle, size_t *size) {
-    for (int i = 0; i < 1024; i++) {
-        if (g_handles[i].in_use && g_handles[i].handle == handle) {
-            if (size) *size = g_handles[i].size;
-            return g_handles[i].ptr;
-        }
+/**
+ * Resolve a handle and lock the shard it belongs to
+ *
+ * On success the shard stays locked (so the block cannot be freed under
+ * the caller) and must be released with release_shard().
+ */
+static void *lookup_handle(uint64_t handle, size_t *size, shard_t **locked) {
+    uint32_t id = handle_shard(handle);
+    if (id >= (uint32_t) g_num_shards) {
+        return NULL;
     }
-    return NULL;
+
+    shard_t *shard = &g_shards[id];
+    pthread_mutex_lock(&shard->lock);
+
+    void *ptr = handle_table_lookup(&shard->table, handle, size);
+    if (!ptr) {
+        pthread_mutex_unlock(&shard->lock);
+        return NULL;
+    }
+
+    *locked = shard;
+    return ptr;
 }
 
-static int remove_handle(uint64_t handle) {
-    for (int i = 0; i < 1024; i++) {
-        if (g_handles[i].in_use && g_handles[i].handle == handle) {
-            g_handles[i].in_use = 0;
-            g_handles[i].ptr = NULL;
-            return 1;
-        }
+// With --store, the highest generation removed goes to the store, so the
+// next run never reissues a handle freed in this one
+static void retire_generations(shard_t *shard) {
+    ether_store_raise_mark(shard->table.retired);
+}
+
+// Caller holds shard->lock (from lookup_handle)
+static int remove_handle(shard_t *shard, uint64_t handle, void **to_free) {
+    int removed = handle_table_remove(&shard->table, handle, to_free);
+    retire_generations(shard);
+    return removed;
+}
+
+static void release_shard(shard_t *shard) {
+    pthread_mutex_unlock(&shard->lock);
+}
+
+/**
+ * Resolve a handle and pin its block for zero-copy I/O that spans several
+ * events. The shard is not kept locked; a concurrent FREE only invalidates
+ * the handle and the block is freed by the last unpin_handle().
+ */
+static void *pin_handle(uint64_t handle, size_t *size, shard_t **owner) {
+    uint32_t id = handle_shard(handle);
+    if (id >= (uint32_t) g_num_shards) {
+        return NULL;
     }
-    return 0;
+
+    shard_t *shard = &g_shards[id];
+    pthread_mutex_lock(&shard->lock);
+    void *ptr = handle_table_pin(&shard->table, handle, size);
+    pthread_mutex_unlock(&shard->lock);
+
+    if (ptr) *owner = shard;
+    return ptr;
+}
+
+static void unpin_handle(shard_t *shard, uint64_t handle) {
+    pthread_mutex_lock(&shard->lock);
+    void *to_free = handle_table_unpin(&shard->table, handle);
+    pthread_mutex_unlock(&shard->lock);
+
+    ether_free(to_free);
 }
 
 // =============================================================================
 // GLOBAL STATE
 // =============================================================================
 
-static volatile int g_running = 1;
-static int g_server_fd = -1;
+static atomic_int g_running = 1;
+static int g_compress = 1;     // Accept ETHER_FLAG_COMPRESSED offers (--compression)
+static int g_wake_fd = -1;     // eventfd: written once at shutdown, wakes every worker
+static int g_unix_fd = -1;     // Unix domain socket listener (--unix), shared by the workers
+static int g_io_uring = 0;     // Workers run io_uring reactors (--io uring)
 
-static void signal_handler(int sig) {
-    (void) sig;
-    printf("\n[etherd] Shutting down...\n");
-    g_running = 0;
-}
+// epoll data.ptr markers for the fds that are not connections
+static char g_listen_tag;
+static char g_unix_tag;
+static char g_wake_tag;
 
 // =============================================================================
-// REQUEST HANDLERS
+// ACCOUNTS
 // =============================================================================
 
-static void send_response(int client_fd, ether_cmd_t cmd, uint64_t handle,
-                          const void *data, size_t data_len) {
-    ether_msg_t *response = ether_msg_create(cmd, data_len);
-    if (!response) return;
+// Every block is charged to the account of the host that allocated it
+// (IPv4 address, or uid on the Unix socket), shared by all of its
+// connections. A charge is a couple of atomic adds checked against the
+// account's quota and, for the sum over all blocks, against the memory
+// watermark; a refused charge is rolled back and the ALLOC gets ERROR with
+// ETHER_ERR_QUOTA or ETHER_ERR_BUSY instead of running the node dry.
+//
+// A block's owner is only read and uncharged under its shard lock, and
+// an account is swept once no connection can allocate for it, so once a
+// reclaim has gone through every shard nothing is charged to it any more.
+//
+// An account is kept while it has connections or blocks, so a host that
+// reconnects finds its usage where it left it. One left with neither
+// (its last blocks freed by another host) is dropped by the next
+// account_join(), which walks the list anyway.
+
+typedef struct account {
+    char            name[INET_ADDRSTRLEN];      // "10.0.0.7", "uid 1000"
+    atomic_size_t   bytes;                      // Sum of its blocks' sizes
+    atomic_size_t   handles;                    // Its live blocks
+    unsigned        conns;                      // Open connections (g_accounts_lock)
+    struct account *next;
+} account_t;
+
+static size_t g_quota_bytes = 0;        // Per account, 0 = none (--quota-bytes)
+static size_t g_quota_handles = 0;      // Per account, 0 = none (--quota-handles)
+static size_t g_memory_limit = 0;       // Watermark for all blocks, 0 = none (--memory-limit)
+static int g_reclaim = 0;               // Last connection of a host frees its blocks (--reclaim)
+static atomic_size_t g_charged;         // Bytes in all blocks, owned or not
+static atomic_size_t g_refused_quota;   // ALLOC/REALLOC refused: account quota
+static atomic_size_t g_refused_busy;    // ...memory watermark
+
+static account_t *g_accounts = NULL;
+static pthread_mutex_t g_accounts_lock = PTHREAD_MUTEX_INITIALIZER;
 
-    response->header.handle = handle;
-    if (data && data_len > 0) {
-        memcpy(response->payload, data, data_len);
+/**
+ * Charge bytes and handles to an account (NULL = only to the total)
+ *
+ * @return  ETHER_OK, ETHER_ERR_BUSY past the memory watermark, or
+ *          ETHER_ERR_QUOTA past the account's quota
+ */
+static int account_charge(account_t *account, size_t bytes, size_t handles) {
+    size_t total = atomic_fetch_add(&g_charged, bytes) + bytes;
+    if (g_memory_limit && bytes > 0 && total > g_memory_limit) {
+        atomic_fetch_sub(&g_charged, bytes);
+        atomic_fetch_add(&g_refused_busy, 1);
+        return ETHER_ERR_BUSY;
     }
+    if (!account) return ETHER_OK;
+
+    size_t used = atomic_fetch_add(&account->bytes, bytes) + bytes;
+    size_t count = atomic_fetch_add(&account->handles, handles) + handles;
+    if ((g_quota_bytes && bytes > 0 && used > g_quota_bytes) ||
+        (g_quota_handles && handles > 0 && count > g_quota_handles)) {
+        atomic_fetch_sub(&account->handles, handles);
+        atomic_fetch_sub(&account->bytes, bytes);
+        atomic_fetch_sub(&g_charged, bytes);
+        atomic_fetch_add(&g_refused_quota, 1);
+        return ETHER_ERR_QUOTA;
+    }
+    return ETHER_OK;
+}
 
-    // Serialize header
-    uint8_t header_buf[ETHER_HEADER_SIZE];
-    ether_msg_serialize_header(&response->header, header_buf);
+static void account_uncharge(account_t *account, size_t bytes, size_t handles) {
+    atomic_fetch_sub(&g_charged, bytes);
+    if (account) {
+        atomic_fetch_sub(&account->bytes, bytes);
+        atomic_fetch_sub(&account->handles, handles);   // Last access: may be freed next
+    }
+}
 
-    // Send header + payload
-    send(client_fd, header_buf, ETHER_HEADER_SIZE, 0);
-    if (data_len > 0) {
-        send(client_fd, response->payload, data_len, 0);
+/**
+ * Account of a host, created on its first connection
+ *
+ * @return  Account with this connection counted, NULL if out of memory
+ */
+static account_t *account_join(const char *name) {
+    pthread_mutex_lock(&g_accounts_lock);
+    account_t *account = NULL;
+    account_t **link = &g_accounts;
+    while (*link) {
+        account_t *entry = *link;
+        if (!account && strcmp(entry->name, name) == 0) {
+            account = entry;
+        } else if (entry->conns == 0 && atomic_load(&entry->handles) == 0) {
+            // Unused: no connection to charge it, no block to uncharge it
+            *link = entry->next;
+            free(entry);
+            continue;
+        }
+        link = &entry->next;
     }
+    if (!account && (account = calloc(1, sizeof(*account))) != NULL) {
+        snprintf(account->name, sizeof(account->name), "%s", name);
+        account->next = g_accounts;
+        g_accounts = account;
+    }
+    if (account) account->conns++;
+    pthread_mutex_unlock(&g_accounts_lock);
+    return account;
+}
 
-    ether_msg_free(response);
+typedef struct {
+    account_t *account;
+    size_t     bytes;
+} reclaim_t;
+
+// Under the block's shard lock
+static void reclaim_block(void *to_free, size_t size, void *arg) {
+    reclaim_t *reclaim = arg;
+    account_uncharge(reclaim->account, size, 1);
+    reclaim->bytes += size;
+    ether_free(to_free);   // NULL if pinned: the last unpin frees it
 }
 
-static void handle_ping(int client_fd) {
-    printf("[etherd] PING received\n");
-    send_response(client_fd, ETHER_CMD_PONG, 0, NULL, 0);
+/**
+ * A connection of this account closed. With --reclaim, the host's last
+ * connection frees its blocks, wherever they are. Not at shutdown: with
+ * --store they are kept for the next run.
+ */
+static void account_leave(account_t *account) {
+    if (!account) return;
+
+    pthread_mutex_lock(&g_accounts_lock);
+    int sweep = --account->conns == 0 && g_reclaim && g_running;
+    int unused = account->conns == 0 && (sweep || atomic_load(&account->handles) == 0);
+    if (unused) {
+        account_t **link = &g_accounts;
+        while (*link != account) link = &(*link)->next;
+        *link = account->next;
+    }
+    pthread_mutex_unlock(&g_accounts_lock);
+    if (!unused) return;
+
+    // Unlinked: the host's next connection starts a new account, so only
+    // blocks of this one are swept
+    if (sweep) {
+        reclaim_t reclaim = { .account = account };
+        size_t blocks = 0;
+        for (int i = 0; i < g_num_shards; i++) {
+            pthread_mutex_lock(&g_shards[i].lock);
+            blocks += handle_table_reclaim(&g_shards[i].table, account, reclaim_block, &reclaim);
+            retire_generations(&g_shards[i]);
+            pthread_mutex_unlock(&g_shards[i].lock);
+        }
+        if (blocks > 0) {
+            ether_log_info("etherd", "Reclaimed %zu blocks (%zu bytes) of %s",
+                           blocks, reclaim.bytes, account->name);
+        }
+    }
+    free(account);
 }
 
-static void handle_alloc(int client_fd, ether_msg_header_t *header) {
-    size_t size = header->size; // Size richiesta nel campo size
+// =============================================================================
+// CONNECTION STATE
+// =============================================================================
 
-    printf("[etherd] ALLOC request: %zu bytes\n", size);
+typedef enum {
+    CONN_READ_HEADER,    // Collecting the 24-byte header
+    CONN_READ_OFFSET,    // Collecting the 8-byte offset prefix (ETHER_FLAG_OFFSET)
+    CONN_READ_PAYLOAD,   // Collecting the remaining payload bytes
+} conn_state_t;
 
-    void *ptr = ether_alloc(size);
-    if (!ptr) {
-        printf("[etherd] ALLOC failed!\n");
-        send_response(client_fd, ETHER_CMD_ERROR, 0, NULL, 0);
-        return;
-    }
+/**
+ * Where the payload of the request being parsed is received
+ */
+typedef enum {
+    PAYLOAD_BUFFER,      // Worker pool buffer handed to the handler
+    PAYLOAD_BLOCK,       // Straight into a pinned block (WRITE)
+    PAYLOAD_DISCARD,     // Request already failed: drain and drop
+} payload_dst_t;
 
-    uint64_t handle = store_handle(ptr, size);
-    if (handle == 0) {
-        ether_free(ptr);
-        send_response(client_fd, ETHER_CMD_ERROR, 0, NULL, 0);
-        return;
+/**
+ * One entry of the output queue: either a range of out_buf (headers,
+ * small replies) or a block borrowed zero-copy for a READ response.
+ */
+typedef struct {
+    const uint8_t  *block;      // Pinned block memory, NULL = range of out_buf
+    size_t          offset;     // Start in out_buf (block == NULL)
+    size_t          len;
+    shard_t        *shard;      // Owner of the pinned block
+    uint64_t        handle;     // Pinned handle
+    int             fd;         // Passed with the first byte (SCM_RIGHTS), -1 = none
+} out_seg_t;
+
+/**
+ * Control message buffer passing one descriptor (SCM_RIGHTS)
+ */
+typedef union {
+    size_t align;                      // struct cmsghdr alignment
+    char   buf[CMSG_SPACE(sizeof(int))];
+} fd_control_t;
+
+/**
+ * Per-connection parse state and output queue.
+ *
+ * Input is read in BUFFER_SIZE chunks and parsed out of in_buf; payload
+ * bytes beyond what is already buffered are received straight into their
+ * destination (for WRITE, the target block itself). Responses are queued
+ * as segments and flushed with sendmsg() whenever the socket is writable.
+ *
+ * Under the io_uring reactor the same receives and sendmsg() calls are
+ * queued on the worker's ring instead, at most one of each in flight.
+ */
+typedef struct connection {
+    int          fd;
+    conn_state_t state;
+    char         peer[INET_ADDRSTRLEN + 8];
+
+    // Input
+    uint8_t            in_buf[BUFFER_SIZE];
+    size_t             in_len;         // Valid bytes in in_buf
+    size_t             in_pos;         // Parse position in in_buf
+    ether_msg_header_t header;         // Header of the request being parsed
+    uint64_t           offset;         // Block offset of a ranged WRITE/READ
+    payload_dst_t      payload_dst;
+    uint8_t           *payload;        // Payload destination (NULL if discarding)
+    size_t             payload_len;
+    size_t             payload_got;
+    shard_t           *payload_shard;  // Owner of the pinned block (PAYLOAD_BLOCK,
+                                       // or a compressed WRITE)
+    uint8_t           *inflate_dst;    // Compressed WRITE: target range in the block
+    size_t             inflate_room;   // ...and bytes left in the block from there
+    int                stream_failed;  // A chunk of the current WRITE stream failed
+    int                rx_payload;     // Next input goes to the payload, not in_buf
+    int                compress;       // Compression negotiated (PING/PONG)
+    int                local;          // Unix domain socket: may SHARE blocks
+    account_t         *account;        // Charged for the blocks it allocates
+
+    // Metrics of the request being served
+    uint64_t           started_ns;     // Header received
+    size_t             reply_bytes;    // Response payload queued
+    int                reply_failed;   // Answered (or would be) with ERROR
+
+    // Output
+    uint8_t   *out_buf;                // Bytes owned by the queue
+    size_t     out_len;
+    size_t     out_cap;
+    out_seg_t *segs;                   // Queued segments, in send order
+    size_t     num_segs;
+    size_t     seg_cap;
+    size_t     seg_head;               // First segment not fully sent
+    size_t     seg_head_sent;          // Bytes of segs[seg_head] already sent
+    size_t     out_pending;            // Total unsent bytes
+    size_t     out_borrowed;           // Queued segments pinning a block
+    int        want_write;             // EPOLLOUT currently armed
+
+    // io_uring reactor: operations in flight and what they point into
+    int           rx_busy;             // Receive queued on the ring
+    size_t        rx_room;             // ...for that many bytes
+    int           rx_drained;          // Last receive came back short: poll first
+    int           tx_busy;             // sendmsg() queued on the ring
+    struct msghdr tx_msg;
+    struct iovec  tx_iov[IOV_BATCH];
+    fd_control_t  tx_control;
+    uint8_t      *out_retired;         // Old out_buf the queued send still reads
+    int           closing;             // Closed, waiting for its operations to finish
+
+    struct worker     *worker;         // Worker serving this connection
+    struct connection *prev, *next;    // Worker's live connection list
+} connection_t;
+
+/**
+ * One event loop thread with its own listener, epoll set (or io_uring
+ * ring) and handle shard
+ */
+typedef struct worker {
+    int           id;
+    pthread_t     thread;
+    int           listen_fd;
+    int           epoll_fd;
+    uring_t       ring;                // --io uring, set up by the worker thread
+    int           accepts;             // Accept operations armed on the ring
+    int           accept_multishot;    // Kernel takes IORING_ACCEPT_MULTISHOT
+    uint64_t      requests;            // Served (io_uring_enter() per request report)
+    shard_t      *shard;
+    connection_t *connections;         // Live connections (for shutdown cleanup)
+    size_t        num_connections;
+    metrics_t     metrics;             // Written by this worker only
+    ether_buf_pool_t pool;             // Request payloads, BATCH scratch
+} worker_t;
+
+static worker_t g_workers[MAX_WORKERS];
+static int g_num_workers = 0;
+
+// =============================================================================
+// OUTPUT QUEUE
+// =============================================================================
+
+static out_seg_t *conn_new_seg(connection_t *conn) {
+    if (conn->num_segs == conn->seg_cap) {
+        size_t new_cap = conn->seg_cap ? conn->seg_cap * 2 : 16;
+        out_seg_t *segs = realloc(conn->segs, new_cap * sizeof(out_seg_t));
+        if (!segs) return NULL;
+
+        conn->segs = segs;
+        conn->seg_cap = new_cap;
     }
 
-    printf("[etherd] ALLOC OK: handle=0x%lX ptr=%p\n", (unsigned long) handle, ptr);
-    send_response(client_fd, ETHER_CMD_OK, handle, NULL, 0);
+    out_seg_t *seg = &conn->segs[conn->num_segs++];
+    memset(seg, 0, sizeof(*seg));
+    seg->fd = -1;
+    return seg;
 }
 
-static void handle_free(int client_fd, ether_msg_header_t *header) {
-    uint64_t handle = header->handle;
+/**
+ * Queue a copy of data (headers, small replies)
+ */
+static int conn_queue(connection_t *conn, const void *data, size_t len) {
+    if (len == 0) return 0;
 
-    printf("[etherd] FREE request: handle=0x%lX\n", (unsigned long) handle);
+    if (conn->out_len + len > conn->out_cap) {
+        size_t new_cap = conn->out_cap ? conn->out_cap : BUFFER_SIZE;
+        while (new_cap < conn->out_len + len) {
+            new_cap *= 2;
+        }
 
-    void *ptr = lookup_handle(handle, NULL);
-    if (!ptr) {
-        printf("[etherd] FREE failed: handle not found\n");
-        send_response(client_fd, ETHER_CMD_ERROR, handle, NULL, 0);
-        return;
+        uint8_t *buf;
+        if (conn->tx_busy) {
+            // A send on the ring still reads out_buf: move the bytes,
+            // keep the old buffer until the send completes
+            buf = malloc(new_cap);
+            if (!buf) return -1;
+            memcpy(buf, conn->out_buf, conn->out_len);
+            if (conn->out_retired) {
+                free(conn->out_buf);   // Grown since the send was queued
+            } else {
+                conn->out_retired = conn->out_buf;
+            }
+        } else {
+            buf = realloc(conn->out_buf, new_cap);
+            if (!buf) return -1;
+        }
+
+        conn->out_buf = buf;
+        conn->out_cap = new_cap;
     }
 
-    ether_free(ptr);
-    remove_handle(handle);
+    // Extend the previous segment when it ends where this data starts
+    out_seg_t *last = conn->num_segs > conn->seg_head ? &conn->segs[conn->num_segs - 1] : NULL;
+    if (last && !last->block && last->offset + last->len == conn->out_len) {
+        last->len += len;
+    } else {
+        out_seg_t *seg = conn_new_seg(conn);
+        if (!seg) return -1;
+        seg->offset = conn->out_len;
+        seg->len = len;
+    }
 
-    printf("[etherd] FREE OK\n");
-    send_response(client_fd, ETHER_CMD_OK, handle, NULL, 0);
+    memcpy(conn->out_buf + conn->out_len, data, len);
+    conn->out_len += len;
+    conn->out_pending += len;
+    return 0;
 }
 
-static void handle_write(int client_fd, ether_msg_header_t *header,
-                         const uint8_t *payload) {
-    uint64_t handle = header->handle;
-    size_t len = header->size;
-
-    printf("[etherd] WRITE request: handle=0x%lX len=%zu\n",
-           (unsigned long) handle, len);
-
-    size_t block_size;
-    void *ptr = lookup_handle(handle, &block_size);
-    if (!ptr) {
-        send_response(client_fd, ETHER_CMD_ERROR, handle, NULL, 0);
-        return;
+/**
+ * Queue a copy of data whose first byte carries a file descriptor
+ * (SCM_RIGHTS). The queue owns fd from here on: it is closed once passed,
+ * or with the connection.
+ */
+static int conn_queue_fd(connection_t *conn, const void *data, size_t len, int fd) {
+    out_seg_t *seg = len > 0 ? conn_new_seg(conn) : NULL;
+    if (!seg) {
+        close(fd);
+        return -1;
     }
 
-    if (len > block_size) {
-        printf("[etherd] WRITE failed: overflow\n");
-        send_response(client_fd, ETHER_CMD_ERROR, handle, NULL, 0);
-        return;
+    // An empty segment at the end of out_buf: conn_queue() extends it
+    seg->offset = conn->out_len;
+    seg->fd = fd;
+    if (conn_queue(conn, data, len) != 0) {
+        conn->num_segs--;
+        close(fd);
+        return -1;
     }
+    return 0;
+}
 
-    int ret = ether_write(ptr, payload, len);
-    if (ret != ETHER_OK) {
-        send_response(client_fd, ETHER_CMD_ERROR, handle, NULL, 0);
-        return;
+/**
+ * Queue block memory without copying. The caller has pinned the block;
+ * the pin is dropped once the segment is sent (or the connection closes).
+ */
+static int conn_queue_block(connection_t *conn, shard_t *shard, uint64_t handle,
+                            const void *block, size_t len) {
+    out_seg_t *seg = conn_new_seg(conn);
+    if (!seg) return -1;
+
+    seg->block = block;
+    seg->len = len;
+    seg->shard = shard;
+    seg->handle = handle;
+    conn->out_pending += len;
+    conn->out_borrowed++;
+    return 0;
+}
+
+static inline size_t conn_pending(const connection_t *conn) {
+    return conn->out_pending;
+}
+
+static void conn_seg_done(connection_t *conn, out_seg_t *seg) {
+    if (seg->fd >= 0) {
+        close(seg->fd);
+        seg->fd = -1;
     }
+    if (seg->block) {
+        unpin_handle(seg->shard, seg->handle);
+        seg->block = NULL;
+        conn->out_borrowed--;
+    }
+}
 
-    printf("[etherd] WRITE OK\n");
-    send_response(client_fd, ETHER_CMD_OK, handle, NULL, 0);
+/**
+ * Arm or disarm EPOLLOUT depending on whether output is still queued
+ */
+static void conn_update_events(connection_t *conn) {
+    int want_write = conn_pending(conn) > 0;
+    if (want_write == conn->want_write) return;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | (want_write ? EPOLLOUT : 0);
+    ev.data.ptr = conn;
+    if (epoll_ctl(conn->worker->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev) == 0) {
+        conn->want_write = want_write;
+    }
 }
 
-static void handle_read(int client_fd, ether_msg_header_t *header) {
-    uint64_t handle = header->handle;
-    size_t len = header->size; // Quanti bytes leggere
+/**
+ * Describe the head of the output queue as one sendmsg(): up to IOV_BATCH
+ * segments. A segment carrying a descriptor starts a sendmsg() of its
+ * own, so the fd rides on its first byte.
+ */
+static void conn_gather(connection_t *conn, struct msghdr *msg, struct iovec *iov,
+                        fd_control_t *control) {
+    int iovcnt = 0;
+    for (size_t i = conn->seg_head; i < conn->num_segs && iovcnt < IOV_BATCH; i++) {
+        const out_seg_t *seg = &conn->segs[i];
+        if (seg->fd >= 0 && i > conn->seg_head) break;
+        size_t skip = (i == conn->seg_head) ? conn->seg_head_sent : 0;
+        const uint8_t *base = seg->block ? seg->block : conn->out_buf + seg->offset;
+
+        iov[iovcnt].iov_base = (void *) (base + skip);
+        iov[iovcnt].iov_len = seg->len - skip;
+        iovcnt++;
+    }
 
-    printf("[etherd] READ request: handle=0x%lX len=%zu\n",
-           (unsigned long) handle, len);
+    memset(msg, 0, sizeof(*msg));
+    msg->msg_iov = iov;
+    msg->msg_iovlen = iovcnt;
+
+    // Only ever set on a segment nothing of which was sent yet
+    const out_seg_t *head = &conn->segs[conn->seg_head];
+    if (head->fd >= 0) {
+        memset(control, 0, sizeof(*control));
+        msg->msg_control = control->buf;
+        msg->msg_controllen = sizeof(control->buf);
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &head->fd, sizeof(int));
+    }
+}
 
-    size_t block_size;
-    void *ptr = lookup_handle(handle, &block_size);
-    if (!ptr) {
-        send_response(client_fd, ETHER_CMD_ERROR, handle, NULL, 0);
-        return;
+/**
+ * Account for a sendmsg() of what conn_gather() described
+ *
+ * @param sent  Bytes the socket took
+ */
+static void conn_sent(connection_t *conn, size_t sent) {
+    // The peer holds its own copy now
+    out_seg_t *head = &conn->segs[conn->seg_head];
+    if (head->fd >= 0) {
+        close(head->fd);
+        head->fd = -1;
     }
 
-    if (len > block_size) {
-        len = block_size; // Cap to available
+    conn->out_pending -= sent;
+    while (conn->seg_head < conn->num_segs) {
+        out_seg_t *seg = &conn->segs[conn->seg_head];
+        size_t left = seg->len - conn->seg_head_sent;
+        if (sent < left) {
+            conn->seg_head_sent += sent;
+            break;
+        }
+
+        sent -= left;
+        conn_seg_done(conn, seg);
+        conn->seg_head++;
+        conn->seg_head_sent = 0;
     }
 
-    uint8_t *buffer = malloc(len);
-    if (!buffer) {
-        send_response(client_fd, ETHER_CMD_ERROR, handle, NULL, 0);
-        return;
+    if (conn->seg_head == conn->num_segs) {
+        conn->num_segs = 0;
+        conn->seg_head = 0;
+        conn->seg_head_sent = 0;
+        conn->out_len = 0;
     }
+}
 
-    int ret = ether_read(ptr, buffer, len);
-    if (ret != ETHER_OK) {
-        free(buffer);
-        send_response(client_fd, ETHER_CMD_ERROR, handle, NULL, 0);
-        return;
+/**
+ * Write as much queued output as the socket accepts
+ *
+ * @return 0 on success (possibly with output still pending), -1 on error
+ */
+static int conn_flush(connection_t *conn) {
+    while (conn->seg_head < conn->num_segs) {
+        struct iovec iov[IOV_BATCH];
+        struct msghdr msg;
+        fd_control_t control;
+        conn_gather(conn, &msg, iov, &control);
+
+        ssize_t n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return -1;
+        }
+        conn_sent(conn, (size_t) n);
     }
 
-    printf("[etherd] READ OK: sending %zu bytes\n", len);
-    send_response(client_fd, ETHER_CMD_OK, handle, buffer, len);
-    free(buffer);
+    conn_update_events(conn);
+    return 0;
 }
 
 // =============================================================================
-// CLIENT HANDLING
+// REQUEST HANDLERS
 // =============================================================================
 
-static void handle_client(int client_fd) {
-    uint8_t header_buf[ETHER_HEADER_SIZE];
-    uint8_t *payload = NULL;
+/**
+ * Serialize the header of a response to the current request
+ */
+static void reply_header(const connection_t *conn, ether_cmd_t cmd, uint64_t handle,
+                         uint16_t flags, size_t len, uint8_t *buffer) {
+    ether_msg_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = ETHER_MAGIC;
+    header.version = ETHER_PROTOCOL_VER;
+    header.command = cmd;
+    header.handle = handle;
+    header.size = (uint32_t) len;
+    header.flags = (conn->header.flags & ETHER_FLAG_MORE) | flags;
+    header.reserved = conn->header.reserved;  // Echo request ID
+
+    ether_msg_serialize_header(&header, buffer);
+}
 
-    while (g_running) {
-        // 1. Read header
-        ssize_t n = recv(client_fd, header_buf, ETHER_HEADER_SIZE, MSG_WAITALL);
-        if (n <= 0) {
-            if (n < 0) perror("[etherd] recv header");
-            break;
-        }
+/**
+ * Queue a response with extra header flags: the header is serialized on
+ * the stack and both parts are copied straight into the output queue
+ * (flushed by the event loop)
+ */
+static void send_response_flags(connection_t *conn, ether_cmd_t cmd, uint64_t handle,
+                                uint16_t flags, const void *data, size_t data_len) {
+    if (cmd == ETHER_CMD_ERROR) conn->reply_failed = 1;
+    conn->reply_bytes += data_len;
 
-        // 2. Deserialize header
-        ether_msg_header_t header;
-        ether_msg_deserialize_header(header_buf, &header);
+    uint8_t header_buf[ETHER_HEADER_SIZE];
+    reply_header(conn, cmd, handle, flags, data_len, header_buf);
 
-        // 3. Validate
-        if (!ether_msg_validate(&header)) {
-            printf("[etherd] Invalid message received\n");
-            continue;
-        }
+    conn_queue(conn, header_buf, ETHER_HEADER_SIZE);
+    if (data && data_len > 0) {
+        conn_queue(conn, data, data_len);
+    }
+}
 
-        // 4. Read payload if any
-        if (header.size > 0) {
-            payload = malloc(header.size);
-            if (!payload) {
-                printf("[etherd] Out of memory for payload\n");
-                break;
-            }
+static void send_response(connection_t *conn, ether_cmd_t cmd, uint64_t handle,
+                          const void *data, size_t data_len) {
+    send_response_flags(conn, cmd, handle, 0, data, data_len);
+}
 
-            n = recv(client_fd, payload, header.size, MSG_WAITALL);
-            if (n <= 0) {
-                free(payload);
-                break;
-            }
-        }
+/**
+ * Queue an OK response whose payload is sent straight from a pinned block
+ */
+static void send_block_response(connection_t *conn, shard_t *shard, uint64_t handle,
+                                const void *block, size_t len) {
+    conn->reply_bytes += len;
 
-        // 5. Handle command
-        switch (header.command) {
-            case ETHER_CMD_PING:
-                handle_ping(client_fd);
-                break;
-            case ETHER_CMD_ALLOC:
-                handle_alloc(client_fd, &header);
-                break;
-            case ETHER_CMD_FREE:
-                handle_free(client_fd, &header);
-                break;
-            case ETHER_CMD_WRITE:
-                handle_write(client_fd, &header, payload);
-                break;
-            case ETHER_CMD_READ:
-                handle_read(client_fd, &header);
-                break;
-            default:
-                printf("[etherd] Unknown command: 0x%02X\n", header.command);
-                send_response(client_fd, ETHER_CMD_ERROR, 0, NULL, 0);
-        }
+    uint8_t header_buf[ETHER_HEADER_SIZE];
+    reply_header(conn, ETHER_CMD_OK, handle, 0, len, header_buf);
 
-        if (payload) {
-            free(payload);
-            payload = NULL;
-        }
+    if (conn_queue(conn, header_buf, ETHER_HEADER_SIZE) != 0 ||
+        len == 0 ||
+        conn_queue_block(conn, shard, handle, block, len) != 0) {
+        unpin_handle(shard, handle);
     }
-
-    close(client_fd);
-    printf("[etherd] Client disconnected\n");
 }
 
-// =============================================================================
-// MAIN
-// =============================================================================
+static void handle_ping(connection_t *conn, ether_msg_header_t *header) {
+    ether_log_debug("etherd", "PING received");
 
-int main(int argc, char **argv) {
-    int port = ETHER_DEFAULT_PORT;
+    // Compression is (re)negotiated by every PING
+    conn->compress = g_compress && (header->flags & ETHER_FLAG_COMPRESSED);
+    send_response_flags(conn, ETHER_CMD_PONG, 0, conn->compress ? ETHER_FLAG_COMPRESSED : 0,
+                        NULL, 0);
+}
 
-    // Parse arguments
-    if (argc > 1) {
-        port = atoi(argv[1]);
+/**
+ * Allocate a block and register it in the worker's shard
+ *
+ * @param placement  ETHER_ALLOC_HUGE and/or ETHER_ALLOC_SHARED, from the
+ *                   client's flags (ETHER_FLAG_HUGE / ETHER_BATCH_HUGE,
+ *                   ETHER_FLAG_SHARED)
+ * @param error      Set on failure: ETHER_ERR_QUOTA, ETHER_ERR_BUSY or
+ *                   ETHER_ERR_NOMEM
+ * @return           New handle, 0 on failure
+ */
+static uint64_t alloc_block(connection_t *conn, size_t size, unsigned placement, int *error) {
+    // Admission first: a refused ALLOC never touches the allocator
+    *error = account_charge(conn->account, size, 1);
+    if (*error != ETHER_OK) {
+        return 0;
     }
 
-    // Setup signal handlers
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    // Runs on the owning worker, so huge pages land on its NUMA node
+    void *ptr = ether_alloc_ex(size, (unsigned) ether_get_wipe() | placement);
+    uint64_t handle = ptr ? store_handle(conn->worker->shard, ptr, size, conn->account) : 0;
+    if (handle == 0) {
+        ether_free(ptr);
+        account_uncharge(conn->account, size, 1);
+        *error = ETHER_ERR_NOMEM;
+        return 0;
+    }
+    return handle;
+}
 
-    // Create socket
-    g_server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (g_server_fd < 0) {
-        perror("socket");
-        return 1;
+/**
+ * Release a handle; if I/O is still in flight on the block, the last
+ * unpin frees it
+ *
+ * @return  0 on success, -1 if the handle is unknown
+ */
+static int free_block(uint64_t handle) {
+    shard_t *shard;
+    size_t size;
+    if (!lookup_handle(handle, &size, &shard)) {
+        return -1;
     }
 
-    // Allow reuse
-    int opt = 1;
-    setsockopt(g_server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    void *to_free;
+    account_t *owner = handle_table_owner(&shard->table, handle);
+    remove_handle(shard, handle, &to_free);
+    account_uncharge(owner, size, 1);
+    release_shard(shard);
+    ether_free(to_free);
+    return 0;
+}
 
-    // Bind
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port = htons(port);
+/**
+ * Resize a block, keeping its handle. The shard stays locked throughout,
+ * so no FREE or pin can race with the block moving. A pinned block is
+ * referenced by address (zero-copy I/O in flight) and may only be resized
+ * in place. Growing charges the difference to the block's owner.
+ *
+ * @return  ETHER_OK, ETHER_ERR_NOTFOUND, ETHER_ERR_NOMEM, ETHER_ERR_QUOTA
+ *          or ETHER_ERR_BUSY
+ */
+static int realloc_block(uint64_t handle, size_t size) {
+    shard_t *shard;
+    size_t old_size;
+    void *ptr = lookup_handle(handle, &old_size, &shard);
+    if (!ptr) {
+        return ETHER_ERR_NOTFOUND;
+    }
 
-    if (bind(g_server_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
-        perror("bind");
-        close(g_server_fd);
-        return 1;
+    account_t *owner = handle_table_owner(&shard->table, handle);
+    size_t grown = size > old_size ? size - old_size : 0;
+    int result = account_charge(owner, grown, 0);
+    if (result != ETHER_OK) {
+        release_shard(shard);
+        return result;
     }
 
-    // Listen
-    if (listen(g_server_fd, MAX_CLIENTS) < 0) {
-        perror("listen");
-        close(g_server_fd);
-        return 1;
+    if (handle_table_pinned(&shard->table, handle)) {
+        result = ether_resize(ptr, size) == ETHER_OK ? ETHER_OK : ETHER_ERR_NOMEM;
+    } else {
+        void *moved = ether_realloc(ptr, size);
+        result = moved ? ETHER_OK : ETHER_ERR_NOMEM;
+        if (moved) ptr = moved;
     }
 
-    printf("===========================================\n");
-    printf("  Ether Daemon v%s\n", ETHER_VERSION);
-    printf("  Privacy-First Memory-as-a-Service\n");
-    printf("===========================================\n");
-    printf("Listening on 0.0.0.0:%d\n", port);
-    printf("Press Ctrl+C to stop\n\n");
+    if (result == ETHER_OK) {
+        handle_table_update(&shard->table, handle, ptr, size);
+        if (size < old_size) account_uncharge(owner, old_size - size, 0);
+    } else {
+        account_uncharge(owner, grown, 0);
+    }
+    release_shard(shard);
+    return result;
+}
 
-    // Accept loop
-    while (g_running) {
-        struct sockaddr_in client_addr;
-        socklen_t client_len = sizeof(client_addr);
+/**
+ * Queue an ERROR whose payload is the reason, as a big-endian
+ * ether_error_t (ALLOC, REALLOC). Older clients just drain it.
+ */
+static void send_error(connection_t *conn, uint64_t handle, int error) {
+    uint32_t code = htonl((uint32_t) error);
+    send_response(conn, ETHER_CMD_ERROR, handle, &code, sizeof(code));
+}
 
-        int client_fd = accept(g_server_fd, (struct sockaddr *) &client_addr, &client_len);
-        if (client_fd < 0) {
-            if (errno == EINTR) continue; // Signal interrupted
-            perror("accept");
-            continue;
-        }
+static void handle_alloc(connection_t *conn, ether_msg_header_t *header) {
+    size_t size = header->size; // Size richiesta nel campo size
 
-        char client_ip[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, sizeof(client_ip));
-        printf("[etherd] Client connected from %s:%d\n",
-               client_ip, ntohs(client_addr.sin_port));
+    ether_log_debug("etherd", "ALLOC request: %zu bytes", size);
 
-        // Handle client (blocking, single-threaded per ora)
-        // TODO: fork() o threads per multi-client
-        handle_client(client_fd);
+    // A memfd is of no use to a client that cannot receive it
+    if ((header->flags & ETHER_FLAG_SHARED) && !conn->local) {
+        ether_log_debug("etherd", "ALLOC failed: shared block over TCP");
+        send_error(conn, 0, ETHER_ERR_INVALID);
+        return;
     }
 
-    // Cleanup
-    close(g_server_fd);
-    ether_dump_state();
-
-    printf("[etherd] Goodbye!\n");
-    return 0;
-}
\ No newline at end of file
+    unsigned placement = ((header->flags & ETHER_FLAG_HUGE) ? ETHER_ALLOC_HUGE : 0) |
+                         ((header->flags & ETHER_FLAG_SHARED) ? ETHER_ALLOC_SHARED : 0);
+    int error;
+    uint64_t handle = alloc_block(conn, size, placement, &error);
+    if (handle == 0) {
+        if (error == ETHER_ERR_NOMEM) {
+            ether_log_warn("etherd", "ALLOC failed: out of memory");
+        } else {
+            ether_log_debug("etherd", "ALLOC refused for %s: %s",
+                            conn->account ? conn->account->name : "?", ether_strerror(error));
+        }
+        send_error(conn, 0, error);
+        return;
+    }
+
+    ether_log_debug("etherd", "ALLOC OK: handle=0x%lX", (unsigned long) handle);
+    send_response(conn, ETHER_CMD_OK, handle, NULL, 0);
+}
+
+static void handle_free(connection_t *conn, ether_msg_header_t *header) {
+    uint64_t handle = header->handle;
+
+    ether_log_debug("etherd", "FREE request: handle=0x%lX", (unsigned long) handle);
+
+    if (free_block(handle) != 0) {
+        ether_log_debug("etherd", "FREE failed: handle not found");
+        send_response(conn, ETHER_CMD_ERROR, handle, NULL, 0);
+        return;
+    }
+
+    ether_log_debug("etherd", "FREE OK");
+    send_response(conn, ETHER_CMD_OK, handle, NULL, 0);
+}
+
+static void handle_realloc(connection_t *conn, ether_msg_header_t *header) {
+    uint64_t handle = header->handle;
+    size_t size = header->size;
+
+    ether_log_debug("etherd", "REALLOC request: handle=0x%lX, %zu bytes",
+                    (unsigned long) handle, size);
+
+    // Shrinking to nothing is a FREE
+    int result = size == 0 ? ETHER_ERR_INVALID : realloc_block(handle, size);
+    if (result != ETHER_OK) {
+        if (result == ETHER_ERR_NOMEM) {
+            ether_log_warn("etherd", "REALLOC failed: out of memory");
+        } else {
+            ether_log_debug("etherd", "REALLOC failed: %s", ether_strerror(result));
+        }
+        send_error(conn, handle, result);
+        return;
+    }
+
+    ether_log_debug("etherd", "REALLOC OK");
+    send_response(conn, ETHER_CMD_OK, handle, NULL, 0);
+}
+
+/**
+ * Pass the memfd of a shared block to a local client, which maps it and
+ * then reads and writes the block without a round trip. The handle table
+ * stays the authority: FREE and REALLOC still go through it.
+ */
+static void handle_share(connection_t *conn, ether_msg_header_t *header) {
+    uint64_t handle = header->handle;
+
+    ether_log_debug("etherd", "SHARE request: handle=0x%lX", (unsigned long) handle);
+
+    // Duplicated under the shard lock: a FREE racing with the send closes
+    // the block's fd, not the one queued
+    int fd = -1;
+    shard_t *shard;
+    void *ptr = conn->local ? lookup_handle(handle, NULL, &shard) : NULL;
+    if (ptr) {
+        int block_fd = ether_block_fd(ptr);
+        if (block_fd >= 0) {
+            fd = fcntl(block_fd, F_DUPFD_CLOEXEC, 0);
+        }
+        release_shard(shard);
+    }
+
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        ether_log_debug("etherd", "SHARE failed: %s", ptr ? "not a shared block" : "handle not found");
+        if (fd >= 0) close(fd);
+        send_response(conn, ETHER_CMD_ERROR, handle, NULL, 0);
+        return;
+    }
+
+    uint8_t reply[ETHER_HEADER_SIZE + ETHER_SHARE_SIZE];
+    reply_header(conn, ETHER_CMD_OK, handle, 0, ETHER_SHARE_SIZE, reply);
+    ether_msg_serialize_offset((uint64_t) st.st_size, reply + ETHER_HEADER_SIZE);
+    conn->reply_bytes += ETHER_SHARE_SIZE;
+    conn_queue_fd(conn, reply, sizeof(reply), fd);
+
+    ether_log_debug("etherd", "SHARE OK: %ld bytes", (long) st.st_size);
+}
+
+/**
+ * Validate a WRITE as soon as its header arrives, so the payload can be
+ * received straight into the target block
+ */
+static void begin_write(connection_t *conn, ether_msg_header_t *header) {
+    uint64_t handle = header->handle;
+    size_t len = conn->payload_len;
+    uint64_t offset = conn->offset;
+
+    ether_log_debug("etherd", "WRITE request: handle=0x%lX offset=%lu len=%zu",
+           (unsigned long) handle, (unsigned long) offset, len);
+
+    conn->payload_dst = PAYLOAD_DISCARD;
+    conn->payload = NULL;
+    conn->inflate_dst = NULL;
+
+    size_t block_size;
+    shard_t *shard;
+    void *ptr = pin_handle(handle, &block_size, &shard);
+    if (!ptr) {
+        return;
+    }
+
+    // Compressed data is received into a pool buffer and inflated into the
+    // block by handle_write(), once its raw size is known
+    if (header->flags & ETHER_FLAG_COMPRESSED) {
+        uint8_t *buffer = offset <= block_size && len > 0
+                              ? ether_buf_get(&conn->worker->pool, len) : NULL;
+        if (!buffer) {
+            unpin_handle(shard, handle);
+            ether_log_debug("etherd", "WRITE failed: bad compressed payload");
+            return;
+        }
+        conn->payload_dst = PAYLOAD_BUFFER;
+        conn->payload = buffer;
+        conn->payload_shard = shard;
+        conn->inflate_dst = (uint8_t *) ptr + offset;
+        conn->inflate_room = block_size - offset;
+        return;
+    }
+
+    if (offset > block_size || len > block_size - offset) {
+        unpin_handle(shard, handle);
+        ether_log_debug("etherd", "WRITE failed: overflow");
+        return;
+    }
+
+    conn->payload_dst = PAYLOAD_BLOCK;
+    conn->payload = (uint8_t *) ptr + offset;
+    conn->payload_shard = shard;
+}
+
+static void handle_write(connection_t *conn, ether_msg_header_t *header) {
+    uint64_t handle = header->handle;
+
+    // Payload already landed in the block (see begin_write)
+    int ok = (conn->payload_dst == PAYLOAD_BLOCK);
+    if (conn->inflate_dst) {
+        ok = ether_decompress_payload(conn->payload, conn->payload_len,
+                                      conn->inflate_dst, conn->inflate_room) >= 0;
+        if (!ok) {
+            ether_log_debug("etherd", "WRITE failed: bad compressed payload");
+        }
+        conn->inflate_dst = NULL;
+        unpin_handle(conn->payload_shard, handle);
+        conn->payload_shard = NULL;
+    } else if (ok) {
+        unpin_handle(conn->payload_shard, handle);
+        conn->payload_shard = NULL;
+    }
+
+    // Streamed write: only the last chunk is answered, for the whole stream
+    if (header->flags & ETHER_FLAG_MORE) {
+        if (!ok) {
+            conn->stream_failed = 1;
+            conn->reply_failed = 1;
+        }
+        return;
+    }
+    if (conn->stream_failed) {
+        conn->stream_failed = 0;
+        ok = 0;
+    }
+
+    if (!ok) {
+        send_response(conn, ETHER_CMD_ERROR, handle, NULL, 0);
+        return;
+    }
+
+    ether_log_debug("etherd", "WRITE OK");
+    send_response(conn, ETHER_CMD_OK, handle, NULL, 0);
+}
+
+/**
+ * Answer a READ with a compressed copy of the range, if it shrinks
+ *
+ * @return  1 if the response was queued, 0 to send the data raw
+ */
+static int send_compressed(connection_t *conn, uint64_t handle, const uint8_t *data, size_t len) {
+    ether_buf_pool_t *pool = &conn->worker->pool;
+    size_t cap = ether_compress_bound(len);
+    uint8_t *buffer = ether_buf_get(pool, cap);
+    if (!buffer) {
+        return 0;
+    }
+
+    size_t n = ether_compress_payload(data, len, buffer, cap);
+    if (n > 0) {
+        ether_log_debug("etherd", "READ OK: sending %zu bytes as %zu", len, n);
+        send_response_flags(conn, ETHER_CMD_OK, handle, ETHER_FLAG_COMPRESSED, buffer, n);
+    }
+    ether_buf_put(pool, buffer, cap);
+    return n > 0;
+}
+
+static void handle_read(connection_t *conn, ether_msg_header_t *header) {
+    uint64_t handle = header->handle;
+    size_t len = header->size; // Quanti bytes leggere
+    uint64_t offset = conn->offset;
+
+    ether_log_debug("etherd", "READ request: handle=0x%lX offset=%lu len=%zu",
+           (unsigned long) handle, (unsigned long) offset, len);
+
+    size_t block_size;
+    shard_t *shard;
+    void *ptr = pin_handle(handle, &block_size, &shard);
+    if (!ptr) {
+        send_response(conn, ETHER_CMD_ERROR, handle, NULL, 0);
+        return;
+    }
+
+    if (offset > block_size) {
+        unpin_handle(shard, handle);
+        ether_log_debug("etherd", "READ failed: offset past end of block");
+        send_response(conn, ETHER_CMD_ERROR, handle, NULL, 0);
+        return;
+    }
+
+    if (len > block_size - offset) {
+        len = block_size - offset; // Cap to available
+    }
+    if (len > ETHER_MAX_PAYLOAD) {
+        len = ETHER_MAX_PAYLOAD;   // Larger reads must be streamed
+    }
+
+    if (conn->compress && len >= ETHER_COMPRESS_MIN &&
+        send_compressed(conn, handle, (uint8_t *) ptr + offset, len)) {
+        unpin_handle(shard, handle);
+        return;
+    }
+
+    // Sent from the block itself; the pin is dropped once it is on the wire
+    ether_log_debug("etherd", "READ OK: sending %zu bytes", len);
+    send_block_response(conn, shard, handle, (uint8_t *) ptr + offset, len);
+}
+
+/**
+ * Growable buffer the BATCH response is assembled in (worker pool)
+ */
+typedef struct {
+    ether_buf_pool_t *pool;
+    uint8_t          *data;
+    size_t            len;
+    size_t            cap;
+} batch_out_t;
+
+static uint8_t *batch_out_reserve(batch_out_t *out, size_t n) {
+    if (out->len + n > out->cap) {
+        size_t cap = out->cap ? out->cap * 2 : 256;
+        while (cap < out->len + n) cap *= 2;
+
+        uint8_t *data = ether_buf_get(out->pool, cap);
+        if (!data) return NULL;
+        if (out->len > 0) memcpy(data, out->data, out->len);
+        ether_buf_put(out->pool, out->data, out->cap);
+        out->data = data;
+        out->cap = cap;
+    }
+
+    uint8_t *p = out->data + out->len;
+    out->len += n;
+    return p;
+}
+
+/**
+ * Whether a sub-operation record is followed by a block offset
+ */
+static inline int batch_has_offset(const ether_batch_record_t *op) {
+    return (op->flags & ETHER_BATCH_OFFSET) &&
+           (op->command == ETHER_CMD_WRITE || op->command == ETHER_CMD_READ);
+}
+
+/**
+ * Check that a BATCH payload is a well-formed sequence of count ops
+ * before running any of them, so a malformed batch has no side effects
+ */
+static int batch_validate(const uint8_t *in, size_t in_len, uint64_t count) {
+    size_t pos = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        if (in_len - pos < ETHER_BATCH_RECORD_SIZE) {
+            return -1;
+        }
+
+        ether_batch_record_t op;
+        ether_batch_record_deserialize(in + pos, &op);
+        pos += ETHER_BATCH_RECORD_SIZE;
+
+        if ((op.flags & ETHER_BATCH_REF) && op.handle >= i) {
+            return -1;  // May only refer to an earlier op
+        }
+
+        if (batch_has_offset(&op)) {
+            if (in_len - pos < ETHER_OFFSET_SIZE) {
+                return -1;
+            }
+            pos += ETHER_OFFSET_SIZE;
+        }
+
+        if (op.command == ETHER_CMD_WRITE) {
+            if (in_len - pos < op.size) {
+                return -1;
+            }
+            pos += op.size;
+        }
+    }
+    return pos == in_len ? 0 : -1;
+}
+
+/**
+ * Run one sub-operation and append its result record (+ READ data)
+ */
+static int batch_run_op(connection_t *conn, const ether_batch_record_t *op,
+                        uint64_t offset, const uint8_t *data, uint64_t handle,
+                        batch_out_t *out, uint64_t *result_handle) {
+    ether_batch_record_t result = { .command = ETHER_CMD_ERROR, .handle = handle };
+    size_t block_size;
+    shard_t *shard;
+    void *ptr;
+
+    switch (op->command) {
+        case ETHER_CMD_ALLOC: {
+            int error;
+            result.handle = alloc_block(conn, op->size,
+                                        (op->flags & ETHER_BATCH_HUGE) ? ETHER_ALLOC_HUGE : 0,
+                                        &error);
+            if (result.handle != 0) result.command = ETHER_CMD_OK;
+            break;
+        }
+
+        case ETHER_CMD_FREE:
+            if (free_block(handle) == 0) result.command = ETHER_CMD_OK;
+            break;
+
+        case ETHER_CMD_WRITE:
+            ptr = pin_handle(handle, &block_size, &shard);
+            if (!ptr) break;
+            if (offset <= block_size && op->size <= block_size - offset) {
+                memcpy((uint8_t *) ptr + offset, data, op->size);
+                result.command = ETHER_CMD_OK;
+            }
+            unpin_handle(shard, handle);
+            break;
+
+        case ETHER_CMD_READ:
+            ptr = pin_handle(handle, &block_size, &shard);
+            if (!ptr) break;
+
+            size_t avail = offset <= block_size ? block_size - offset : 0;
+            size_t len = op->size < avail ? op->size : avail;
+            if (offset <= block_size &&
+                out->len + ETHER_BATCH_RECORD_SIZE + len <= ETHER_MAX_PAYLOAD) {
+                result.command = ETHER_CMD_OK;
+                result.size = (uint32_t) len;
+            }
+
+            uint8_t *rec = batch_out_reserve(out, ETHER_BATCH_RECORD_SIZE + result.size);
+            if (rec) {
+                memcpy(rec + ETHER_BATCH_RECORD_SIZE, (uint8_t *) ptr + offset, result.size);
+                ether_batch_record_serialize(&result, rec);
+            }
+            unpin_handle(shard, handle);
+
+            *result_handle = (result.command == ETHER_CMD_OK) ? handle : 0;
+            return rec ? 0 : -1;
+
+        default:
+            break;
+    }
+
+    uint8_t *rec = batch_out_reserve(out, ETHER_BATCH_RECORD_SIZE);
+    if (!rec) return -1;
+    ether_batch_record_serialize(&result, rec);
+
+    *result_handle = (result.command == ETHER_CMD_OK) ? result.handle : 0;
+    return 0;
+}
+
+/**
+ * Run every sub-operation of a BATCH in order and answer with their
+ * results in a single response
+ */
+static void handle_batch(connection_t *conn, ether_msg_header_t *header) {
+    const uint8_t *in = conn->payload;
+    size_t in_len = conn->payload_len;
+    uint64_t count = header->handle;
+
+    ether_log_debug("etherd", "BATCH request: %lu ops, %zu bytes", (unsigned long) count, in_len);
+
+    if (count == 0 || count > in_len / ETHER_BATCH_RECORD_SIZE ||
+        batch_validate(in, in_len, count) != 0) {
+        ether_log_debug("etherd", "BATCH failed: malformed");
+        send_response(conn, ETHER_CMD_ERROR, 0, NULL, 0);
+        return;
+    }
+
+    // Result handle of every op, for ops that refer to an earlier one
+    ether_buf_pool_t *pool = &conn->worker->pool;
+    size_t handles_size = count * sizeof(uint64_t);
+    uint64_t *handles = ether_buf_get(pool, handles_size);
+    batch_out_t out = { .pool = pool };
+    if (!handles || !batch_out_reserve(&out, count * ETHER_BATCH_RECORD_SIZE)) {
+        ether_buf_put(pool, handles, handles_size);
+        ether_buf_put(pool, out.data, out.cap);
+        send_response(conn, ETHER_CMD_ERROR, 0, NULL, 0);
+        return;
+    }
+    memset(handles, 0, handles_size);
+    out.len = 0;
+
+    size_t pos = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        ether_batch_record_t op;
+        ether_batch_record_deserialize(in + pos, &op);
+        pos += ETHER_BATCH_RECORD_SIZE;
+
+        uint64_t offset = 0;
+        if (batch_has_offset(&op)) {
+            offset = ether_msg_deserialize_offset(in + pos);
+            pos += ETHER_OFFSET_SIZE;
+        }
+
+        const uint8_t *data = in + pos;
+        if (op.command == ETHER_CMD_WRITE) {
+            pos += op.size;
+        }
+
+        uint64_t handle = (op.flags & ETHER_BATCH_REF) ? handles[op.handle] : op.handle;
+        if (batch_run_op(conn, &op, offset, data, handle, &out, &handles[i]) != 0) {
+            ether_buf_put(pool, handles, handles_size);
+            ether_buf_put(pool, out.data, out.cap);
+            send_response(conn, ETHER_CMD_ERROR, 0, NULL, 0);
+            return;
+        }
+    }
+
+    // Header + result vector
+    send_response(conn, ETHER_CMD_OK, count, out.data, out.len);
+
+    ether_log_debug("etherd", "BATCH OK");
+    ether_buf_put(pool, handles, handles_size);
+    ether_buf_put(pool, out.data, out.cap);
+}
+
+// =============================================================================
+// BULK OPERATIONS
+// =============================================================================
+
+#define CMP_CHUNK 4096   // memcmp() granularity when locating a mismatch
+
+/**
+ * Pin a block and check that [offset, offset + len) lies inside it
+ *
+ * @return  Start of the range, NULL if the handle is unknown or the range
+ *          does not fit (then nothing stays pinned)
+ */
+static uint8_t *pin_range(uint64_t handle, uint64_t offset, uint64_t len, shard_t **owner) {
+    size_t block_size;
+    uint8_t *ptr = pin_handle(handle, &block_size, owner);
+    if (!ptr) {
+        return NULL;
+    }
+
+    if (offset > block_size || len > block_size - offset) {
+        unpin_handle(*owner, handle);
+        return NULL;
+    }
+    return ptr + offset;
+}
+
+/**
+ * Decode the range record of a bulk request
+ *
+ * @return  0 on success, -1 if the payload is too short
+ */
+static int bulk_parse(const connection_t *conn, ether_bulk_record_t *record) {
+    if (conn->payload_len < ETHER_BULK_RECORD_SIZE) {
+        return -1;
+    }
+    ether_bulk_record_deserialize(conn->payload, record);
+    return 0;
+}
+
+/**
+ * Offset of the first byte that differs (len if none), comparing a chunk
+ * at a time so the bulk of the work stays in memcmp()
+ */
+static size_t first_mismatch(const uint8_t *a, const uint8_t *b, size_t len, int *order) {
+    size_t pos = 0;
+    while (pos < len) {
+        size_t n = len - pos < CMP_CHUNK ? len - pos : CMP_CHUNK;
+        if (memcmp(a + pos, b + pos, n) != 0) {
+            while (a[pos] == b[pos]) pos++;
+            *order = a[pos] < b[pos] ? -1 : 1;
+            return pos;
+        }
+        pos += n;
+    }
+    *order = 0;
+    return len;
+}
+
+static void handle_copy(connection_t *conn, ether_msg_header_t *header) {
+    uint64_t handle = header->handle;
+    ether_bulk_record_t op;
+
+    if (bulk_parse(conn, &op) != 0) {
+        send_response(conn, ETHER_CMD_ERROR, handle, NULL, 0);
+        return;
+    }
+
+    ether_log_debug("etherd", "COPY request: 0x%lX+%lu <- 0x%lX+%lu, %lu bytes",
+                    (unsigned long) handle, (unsigned long) op.offset,
+                    (unsigned long) op.handle, (unsigned long) op.offset2,
+                    (unsigned long) op.length);
+
+    shard_t *dst_shard, *src_shard;
+    uint8_t *dst = pin_range(handle, op.offset, op.length, &dst_shard);
+    if (!dst) {
+        ether_log_debug("etherd", "COPY failed: bad destination range");
+        send_response(conn, ETHER_CMD_ERROR, handle, NULL, 0);
+        return;
+    }
+    uint8_t *src = pin_range(op.handle, op.offset2, op.length, &src_shard);
+    if (!src) {
+        unpin_handle(dst_shard, handle);
+        ether_log_debug("etherd", "COPY failed: bad source range");
+        send_response(conn, ETHER_CMD_ERROR, handle, NULL, 0);
+        return;
+    }
+
+    // Both ranges may be in the same block
+    memmove(dst, src, op.length);
+
+    unpin_handle(src_shard, op.handle);
+    unpin_handle(dst_shard, handle);
+
+    ether_log_debug("etherd", "COPY OK");
+    send_response(conn, ETHER_CMD_OK, handle, NULL, 0);
+}
+
+static void handle_fill(connection_t *conn, ether_msg_header_t *header) {
+    uint64_t handle = header->handle;
+    ether_bulk_record_t op;
+    size_t pattern_len = conn->payload_len - ETHER_BULK_RECORD_SIZE;
+
+    if (bulk_parse(conn, &op) != 0 || pattern_len == 0 || pattern_len > ETHER_FILL_PATTERN_MAX) {
+        ether_log_debug("etherd", "FILL failed: malformed");
+        send_response(conn, ETHER_CMD_ERROR, handle, NULL, 0);
+        return;
+    }
+    const uint8_t *pattern = conn->payload + ETHER_BULK_RECORD_SIZE;
+
+    ether_log_debug("etherd", "FILL request: handle=0x%lX offset=%lu len=%lu pattern=%zu",
+                    (unsigned long) handle, (unsigned long) op.offset,
+                    (unsigned long) op.length, pattern_len);
+
+    shard_t *shard;
+    uint8_t *dst = pin_range(handle, op.offset, op.length, &shard);
+    if (!dst) {
+        ether_log_debug("etherd", "FILL failed: bad range");
+        send_response(conn, ETHER_CMD_ERROR, handle, NULL, 0);
+        return;
+    }
+
+    if (pattern_len == 1) {
+        memset(dst, pattern[0], op.length);
+    } else {
+        // Lay the pattern down once, then keep doubling the filled prefix
+        size_t filled = pattern_len < op.length ? pattern_len : op.length;
+        memcpy(dst, pattern, filled);
+        while (filled < op.length) {
+            size_t n = filled < op.length - filled ? filled : op.length - filled;
+            memcpy(dst + filled, dst, n);
+            filled += n;
+        }
+    }
+
+    unpin_handle(shard, handle);
+
+    ether_log_debug("etherd", "FILL OK");
+    send_response(conn, ETHER_CMD_OK, handle, NULL, 0);
+}
+
+static void handle_cmp(connection_t *conn, ether_msg_header_t *header) {
+    uint64_t handle = header->handle;
+    ether_bulk_record_t op;
+
+    if (bulk_parse(conn, &op) != 0) {
+        send_response(conn, ETHER_CMD_ERROR, handle, NULL, 0);
+        return;
+    }
+
+    ether_log_debug("etherd", "CMP request: 0x%lX+%lu vs 0x%lX+%lu, %lu bytes",
+                    (unsigned long) handle, (unsigned long) op.offset,
+                    (unsigned long) op.handle, (unsigned long) op.offset2,
+                    (unsigned long) op.length);
+
+    shard_t *a_shard, *b_shard;
+    const uint8_t *a = pin_range(handle, op.offset, op.length, &a_shard);
+    if (!a) {
+        send_response(conn, ETHER_CMD_ERROR, handle, NULL, 0);
+        return;
+    }
+    const uint8_t *b = pin_range(op.handle, op.offset2, op.length, &b_shard);
+    if (!b) {
+        unpin_handle(a_shard, handle);
+        send_response(conn, ETHER_CMD_ERROR, handle, NULL, 0);
+        return;
+    }
+
+    int order;
+    size_t pos = first_mismatch(a, b, op.length, &order);
+
+    unpin_handle(b_shard, op.handle);
+    unpin_handle(a_shard, handle);
+
+    int64_t result = order == 0 ? 0 : order * (int64_t) (pos + 1);
+    uint8_t reply[8];
+    ether_msg_serialize_offset((uint64_t) result, reply);
+
+    ether_log_debug("etherd", "CMP OK: %ld", (long) result);
+    send_response(conn, ETHER_CMD_OK, handle, reply, sizeof(reply));
+}
+
+static void handle_checksum(connection_t *conn, ether_msg_header_t *header) {
+    uint64_t handle = header->handle;
+    ether_bulk_record_t op;
+
+    if (bulk_parse(conn, &op) != 0) {
+        send_response(conn, ETHER_CMD_ERROR, handle, NULL, 0);
+        return;
+    }
+
+    ether_log_debug("etherd", "CHECKSUM request: handle=0x%lX offset=%lu len=%lu",
+                    (unsigned long) handle, (unsigned long) op.offset,
+                    (unsigned long) op.length);
+
+    shard_t *shard;
+    const uint8_t *data = pin_range(handle, op.offset, op.length, &shard);
+    if (!data) {
+        send_response(conn, ETHER_CMD_ERROR, handle, NULL, 0);
+        return;
+    }
+
+    uint64_t sum = ether_checksum(data, op.length);
+    unpin_handle(shard, handle);
+
+    uint8_t reply[8];
+    ether_msg_serialize_offset(sum, reply);
+
+    ether_log_debug("etherd", "CHECKSUM OK: 0x%016lX", (unsigned long) sum);
+    send_response(conn, ETHER_CMD_OK, handle, reply, sizeof(reply));
+}
+
+// =============================================================================
+// METRICS
+// =============================================================================
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+#define SNAPSHOT_SIZE (METRIC_NUM_CMDS * sizeof(metrics_snapshot_t))
+
+/**
+ * Merge every worker's metrics (METRIC_NUM_CMDS entries; the caller
+ * returns them with ether_buf_put(pool, snap, SNAPSHOT_SIZE))
+ */
+static metrics_snapshot_t *metrics_collect(ether_buf_pool_t *pool) {
+    metrics_snapshot_t *snap = ether_buf_get(pool, SNAPSHOT_SIZE);
+    if (!snap) return NULL;
+    memset(snap, 0, SNAPSHOT_SIZE);
+
+    // Workers are initialized (one per shard) before any of them runs
+    for (int i = 0; i < g_num_shards; i++) {
+        metrics_merge(snap, &g_workers[i].metrics);
+    }
+    return snap;
+}
+
+static void handle_stats(connection_t *conn) {
+    metrics_snapshot_t *snap = metrics_collect(&conn->worker->pool);
+    if (!snap) {
+        send_response(conn, ETHER_CMD_ERROR, 0, NULL, 0);
+        return;
+    }
+
+    uint8_t records[METRIC_NUM_CMDS * ETHER_STATS_RECORD_SIZE];
+    for (int c = 0; c < METRIC_NUM_CMDS; c++) {
+        ether_stats_record_t rec = {
+            .command = metric_wire_cmd((metric_cmd_t) c),
+            .count = snap[c].count,
+            .errors = snap[c].errors,
+            .bytes_in = snap[c].bytes_in,
+            .bytes_out = snap[c].bytes_out,
+            .p50_ns = metrics_percentile(&snap[c], 0.50),
+            .p99_ns = metrics_percentile(&snap[c], 0.99),
+            .p999_ns = metrics_percentile(&snap[c], 0.999),
+        };
+        ether_stats_record_serialize(&rec, records + c * ETHER_STATS_RECORD_SIZE);
+    }
+    ether_buf_put(&conn->worker->pool, snap, SNAPSHOT_SIZE);
+
+    send_response(conn, ETHER_CMD_OK, METRIC_NUM_CMDS, records, sizeof(records));
+}
+
+/**
+ * Host memory available for new blocks: MemAvailable, which counts the
+ * page cache the kernel can drop (free pages if it is missing)
+ */
+static uint64_t available_memory(void) {
+    uint64_t kb = 0;
+    FILE *f = fopen("/proc/meminfo", "r");
+    if (f) {
+        char line[128];
+        while (fgets(line, sizeof(line), f)) {
+            unsigned long long value;
+            if (sscanf(line, "MemAvailable: %llu kB", &value) == 1) {
+                kb = value;
+                break;
+            }
+        }
+        fclose(f);
+    }
+    if (kb > 0) {
+        return kb * 1024;
+    }
+
+    long pages = sysconf(_SC_AVPHYS_PAGES);
+    return pages > 0 ? (uint64_t) pages * (uint64_t) sysconf(_SC_PAGESIZE) : 0;
+}
+
+static void handle_meminfo(connection_t *conn) {
+    ether_stats_t stats = ether_get_stats();
+    ether_meminfo_record_t rec = {
+        .used = stats.current_usage,
+        .peak = stats.peak_usage,
+        .available = available_memory(),
+        .blocks = stats.num_allocs - stats.num_frees,
+    };
+
+    uint8_t record[ETHER_MEMINFO_RECORD_SIZE];
+    ether_meminfo_record_serialize(&rec, record);
+    send_response(conn, ETHER_CMD_OK, 0, record, sizeof(record));
+}
+
+/**
+ * Growable text buffer for the /metrics page
+ */
+typedef struct {
+    char  *data;
+    size_t len;
+    size_t cap;
+} text_t;
+
+static void text_printf(text_t *text, const char *fmt, ...) {
+    for (;;) {
+        size_t room = text->cap - text->len;
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(text->data ? text->data + text->len : NULL, room, fmt, args);
+        va_end(args);
+        if (n < 0) return;
+
+        if ((size_t) n < room) {
+            text->len += (size_t) n;
+            return;
+        }
+
+        size_t cap = text->cap ? text->cap * 2 : 4096;
+        while (cap - text->len <= (size_t) n) cap *= 2;
+        char *data = realloc(text->data, cap);
+        if (!data) return;
+        text->data = data;
+        text->cap = cap;
+    }
+}
+
+/**
+ * Render every metric in Prometheus text exposition format
+ */
+static void metrics_render(text_t *text) {
+    metrics_snapshot_t *snap = metrics_collect(NULL);
+    if (!snap) return;
+
+    static const struct {
+        const char *name;
+        const char *help;
+        size_t      field;
+    } counters[] = {
+        { "ether_requests_total", "Requests handled, by command",
+          offsetof(metrics_snapshot_t, count) },
+        { "ether_request_errors_total", "Requests answered with ERROR, by command",
+          offsetof(metrics_snapshot_t, errors) },
+        { "ether_request_bytes_in_total", "Request payload bytes, by command",
+          offsetof(metrics_snapshot_t, bytes_in) },
+        { "ether_request_bytes_out_total", "Response payload bytes, by command",
+          offsetof(metrics_snapshot_t, bytes_out) },
+    };
+
+    for (size_t i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+        text_printf(text, "# HELP %s %s.\n# TYPE %s counter\n",
+                    counters[i].name, counters[i].help, counters[i].name);
+        for (int c = 0; c < METRIC_NUM_CMDS; c++) {
+            uint64_t value = *(const uint64_t *) ((const uint8_t *) &snap[c] + counters[i].field);
+            text_printf(text, "%s{command=\"%s\"} %llu\n", counters[i].name,
+                        metric_name((metric_cmd_t) c), (unsigned long long) value);
+        }
+    }
+
+    static const double quantiles[] = { 0.5, 0.99, 0.999 };
+    text_printf(text, "# HELP ether_request_duration_seconds Time from request header to "
+                      "queued response.\n# TYPE ether_request_duration_seconds summary\n");
+    for (int c = 0; c < METRIC_NUM_CMDS; c++) {
+        const char *name = metric_name((metric_cmd_t) c);
+        for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++) {
+            text_printf(text, "ether_request_duration_seconds{command=\"%s\",quantile=\"%g\"} %.9f\n",
+                        name, quantiles[q], metrics_percentile(&snap[c], quantiles[q]) / 1e9);
+        }
+        text_printf(text, "ether_request_duration_seconds_sum{command=\"%s\"} %.9f\n",
+                    name, snap[c].latency_sum / 1e9);
+        text_printf(text, "ether_request_duration_seconds_count{command=\"%s\"} %llu\n",
+                    name, (unsigned long long) snap[c].count);
+    }
+    ether_buf_put(NULL, snap, SNAPSHOT_SIZE);
+
+    uint64_t handles = 0;
+    for (int i = 0; i < g_num_shards; i++) {
+        pthread_mutex_lock(&g_shards[i].lock);
+        handles += handle_table_count(&g_shards[i].table);
+        pthread_mutex_unlock(&g_shards[i].lock);
+    }
+
+    ether_stats_t stats = ether_get_stats();
+    text_printf(text, "# HELP ether_handles Live block handles.\n# TYPE ether_handles gauge\n"
+                      "ether_handles %llu\n", (unsigned long long) handles);
+    text_printf(text, "# HELP ether_memory_used_bytes Bytes in live blocks.\n"
+                      "# TYPE ether_memory_used_bytes gauge\nether_memory_used_bytes %zu\n",
+                stats.current_usage);
+    text_printf(text, "# HELP ether_memory_peak_bytes Peak bytes in live blocks.\n"
+                      "# TYPE ether_memory_peak_bytes gauge\nether_memory_peak_bytes %zu\n",
+                stats.peak_usage);
+    text_printf(text, "# HELP ether_resident_bytes Resident set size of etherd.\n"
+                      "# TYPE ether_resident_bytes gauge\nether_resident_bytes %zu\n",
+                stats.resident);
+    text_printf(text, "# HELP ether_allocations_total Blocks allocated.\n"
+                      "# TYPE ether_allocations_total counter\nether_allocations_total %zu\n",
+                stats.num_allocs);
+    text_printf(text, "# HELP ether_frees_total Blocks freed.\n"
+                      "# TYPE ether_frees_total counter\nether_frees_total %zu\n",
+                stats.num_frees);
+    text_printf(text, "# HELP ether_admission_refused_total ALLOC/REALLOC refused by admission control.\n"
+                      "# TYPE ether_admission_refused_total counter\n"
+                      "ether_admission_refused_total{reason=\"quota\"} %zu\n"
+                      "ether_admission_refused_total{reason=\"watermark\"} %zu\n",
+                atomic_load(&g_refused_quota), atomic_load(&g_refused_busy));
+}
+
+static int send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t) n;
+    }
+    return 0;
+}
+
+/**
+ * Answer one HTTP request: GET /metrics, anything else is a 404
+ */
+static void metrics_serve(int fd) {
+    // Blocking, with a timeout so a silent client cannot stall the listener
+    int flags = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+    struct timeval timeout = { .tv_sec = METRICS_TIMEOUT };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // Only the request line matters
+    char request[1024];
+    size_t len = 0;
+    while (len < sizeof(request) - 1 && !memchr(request, '\n', len)) {
+        ssize_t n = recv(fd, request + len, sizeof(request) - 1 - len, 0);
+        if (n <= 0) return;
+        len += (size_t) n;
+    }
+    request[len] = '\0';
+
+    int found = strncmp(request, "GET /metrics ", 13) == 0 ||
+                strncmp(request, "GET /metrics?", 13) == 0;
+    text_t body = { 0 };
+    if (found) {
+        metrics_render(&body);
+    } else {
+        text_printf(&body, "Not found\n");
+    }
+
+    char head[256];
+    int head_len = snprintf(head, sizeof(head),
+                            "HTTP/1.0 %s\r\n"
+                            "Content-Type: %s\r\n"
+                            "Content-Length: %zu\r\n"
+                            "Connection: close\r\n\r\n",
+                            found ? "200 OK" : "404 Not Found",
+                            found ? "text/plain; version=0.0.4" : "text/plain",
+                            body.len);
+
+    if (send_all(fd, head, (size_t) head_len) == 0 && body.len > 0) {
+        send_all(fd, body.data, body.len);
+    }
+    free(body.data);
+}
+
+/**
+ * /metrics listener thread: one request at a time, off the worker loops
+ */
+static void *metrics_main(void *arg) {
+    int listen_fd = (int) (intptr_t) arg;
+
+    while (g_running) {
+        struct pollfd fds[2] = {
+            { .fd = listen_fd, .events = POLLIN },
+            { .fd = g_wake_fd, .events = POLLIN },
+        };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            ether_log_error("etherd", "poll: %s", strerror(errno));
+            break;
+        }
+        if (fds[1].revents) {
+            break;  // Shutdown
+        }
+
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) continue;
+        metrics_serve(fd);
+        close(fd);
+    }
+
+    return NULL;
+}
+
+// =============================================================================
+// CLIENT HANDLING
+// =============================================================================
+
+static void dispatch(connection_t *conn, ether_msg_header_t *header) {
+    switch (header->command) {
+        case ETHER_CMD_PING:
+            handle_ping(conn, header);
+            break;
+        case ETHER_CMD_ALLOC:
+            handle_alloc(conn, header);
+            break;
+        case ETHER_CMD_FREE:
+            handle_free(conn, header);
+            break;
+        case ETHER_CMD_REALLOC:
+            handle_realloc(conn, header);
+            break;
+        case ETHER_CMD_SHARE:
+            handle_share(conn, header);
+            break;
+        case ETHER_CMD_WRITE:
+            handle_write(conn, header);
+            break;
+        case ETHER_CMD_READ:
+            handle_read(conn, header);
+            break;
+        case ETHER_CMD_COPY:
+            handle_copy(conn, header);
+            break;
+        case ETHER_CMD_FILL:
+            handle_fill(conn, header);
+            break;
+        case ETHER_CMD_CMP:
+            handle_cmp(conn, header);
+            break;
+        case ETHER_CMD_CHECKSUM:
+            handle_checksum(conn, header);
+            break;
+        case ETHER_CMD_BATCH:
+            handle_batch(conn, header);
+            break;
+        case ETHER_CMD_STATS:
+            handle_stats(conn);
+            break;
+        case ETHER_CMD_MEMINFO:
+            handle_meminfo(conn);
+            break;
+        default:
+            ether_log_warn("etherd", "Unknown command: 0x%02X", header->command);
+            send_response(conn, ETHER_CMD_ERROR, 0, NULL, 0);
+    }
+}
+
+/**
+ * Finish the current request and go back to waiting for a header
+ */
+static void conn_complete_request(connection_t *conn) {
+    dispatch(conn, &conn->header);
+
+    metrics_record(&conn->worker->metrics, metric_cmd(conn->header.command),
+                   now_ns() - conn->started_ns, ether_msg_payload_size(&conn->header),
+                   conn->reply_bytes, conn->reply_failed);
+    conn->worker->requests++;
+
+    if (conn->payload_dst == PAYLOAD_BUFFER) {
+        ether_buf_put(&conn->worker->pool, conn->payload, conn->payload_len);
+    }
+    conn->payload = NULL;
+    conn->payload_len = 0;
+    conn->payload_got = 0;
+    conn->state = CONN_READ_HEADER;
+}
+
+/**
+ * Header (and offset) parsed: pick where the payload goes, or run the
+ * request right away if it has none
+ *
+ * @return  0 on success, -1 if the connection must be closed
+ */
+static int conn_begin_payload(connection_t *conn) {
+    conn->payload_got = 0;
+
+    // WRITE is validated even when empty, so handle_write() always sees
+    // the outcome of this request's begin_write()
+    if (conn->header.command == ETHER_CMD_WRITE) {
+        begin_write(conn, &conn->header);
+    } else if (conn->payload_len > 0) {
+        conn->payload_dst = PAYLOAD_BUFFER;
+        conn->payload = ether_buf_get(&conn->worker->pool, conn->payload_len);
+        if (!conn->payload) {
+            ether_log_warn("etherd", "Out of memory for payload");
+            return -1;
+        }
+    } else {
+        conn->payload_dst = PAYLOAD_DISCARD;
+        conn->payload = NULL;
+    }
+
+    if (conn->payload_len == 0) {
+        conn_complete_request(conn);
+        return 0;
+    }
+
+    conn->state = CONN_READ_PAYLOAD;
+    return 0;
+}
+
+/**
+ * Run every complete request already buffered, then say where the next
+ * input goes
+ *
+ * @param dst   Set to where the next receive should land
+ * @param room  Set to how many bytes it may take
+ * @return  0 if more input is needed, 1 if parsing paused because too much
+ *          output is queued, -1 if the connection must be closed
+ */
+static int conn_parse(connection_t *conn, uint8_t **dst, size_t *room) {
+    for (;;) {
+        // Backpressure: let the client consume responses first. Also wait
+        // while a READ response still borrows block memory, so a later
+        // WRITE on this connection cannot change data already "read".
+        if (conn_pending(conn) > OUT_HIGH_WATER || conn->out_borrowed > 0) {
+            return 1;
+        }
+
+        size_t buffered = conn->in_len - conn->in_pos;
+
+        if (conn->state == CONN_READ_PAYLOAD) {
+            size_t need = conn->payload_len - conn->payload_got;
+
+            if (buffered == 0) {
+                // Large payloads bypass in_buf entirely; discarded ones are
+                // drained through it
+                *dst = conn->payload ? conn->payload + conn->payload_got : conn->in_buf;
+                *room = conn->payload ? need : (need < sizeof(conn->in_buf) ? need : sizeof(conn->in_buf));
+                conn->rx_payload = 1;
+                return 0;
+            }
+
+            size_t take = buffered < need ? buffered : need;
+            if (conn->payload) {
+                memcpy(conn->payload + conn->payload_got, conn->in_buf + conn->in_pos, take);
+            }
+            conn->payload_got += take;
+            conn->in_pos += take;
+
+            if (conn->payload_got == conn->payload_len) {
+                conn_complete_request(conn);
+            }
+            continue;
+        }
+
+        if (conn->state == CONN_READ_OFFSET) {
+            if (buffered >= ETHER_OFFSET_SIZE) {
+                conn->offset = ether_msg_deserialize_offset(conn->in_buf + conn->in_pos);
+                conn->in_pos += ETHER_OFFSET_SIZE;
+                conn->payload_len -= ETHER_OFFSET_SIZE;
+                if (conn_begin_payload(conn) != 0) {
+                    return -1;
+                }
+                continue;
+            }
+        } else if (buffered >= ETHER_HEADER_SIZE) {
+            // CONN_READ_HEADER
+            ether_msg_deserialize_header(conn->in_buf + conn->in_pos, &conn->header);
+            conn->in_pos += ETHER_HEADER_SIZE;
+
+            // A bad header means the stream is out of sync: drop the client
+            if (!ether_msg_validate(&conn->header)) {
+                ether_log_warn("etherd", "Invalid message received");
+                return -1;
+            }
+
+            conn->offset = 0;
+            conn->payload_len = ether_msg_payload_size(&conn->header);
+            conn->started_ns = now_ns();
+            conn->reply_bytes = 0;
+            conn->reply_failed = 0;
+
+            // Ranged WRITE/READ: the offset comes first
+            if ((conn->header.flags & ETHER_FLAG_OFFSET) &&
+                (conn->header.command == ETHER_CMD_WRITE ||
+                 conn->header.command == ETHER_CMD_READ)) {
+                if (conn->payload_len < ETHER_OFFSET_SIZE) {
+                    ether_log_warn("etherd", "Invalid message received");
+                    return -1;
+                }
+                conn->state = CONN_READ_OFFSET;
+                continue;
+            }
+
+            if (conn_begin_payload(conn) != 0) {
+                return -1;
+            }
+            continue;
+        }
+
+        // Need more input: compact the buffer and refill it
+        if (conn->in_pos > 0) {
+            memmove(conn->in_buf, conn->in_buf + conn->in_pos, buffered);
+            conn->in_len = buffered;
+            conn->in_pos = 0;
+        }
+
+        *dst = conn->in_buf + conn->in_len;
+        *room = sizeof(conn->in_buf) - conn->in_len;
+        conn->rx_payload = 0;
+        return 0;
+    }
+}
+
+/**
+ * Account for n bytes received where conn_parse() asked for them
+ */
+static void conn_received(connection_t *conn, size_t n) {
+    if (!conn->rx_payload) {
+        conn->in_len += n;
+        return;
+    }
+
+    conn->payload_got += n;
+    if (conn->payload_got == conn->payload_len) {
+        conn_complete_request(conn);
+    }
+}
+
+/**
+ * Drain the socket and run every complete request found in it
+ *
+ * @return  0 if the socket is drained, 1 if parsing paused because too much
+ *          output is queued, -1 if the connection must be closed
+ */
+static int conn_read(connection_t *conn) {
+    for (;;) {
+        uint8_t *dst;
+        size_t room;
+        int ret = conn_parse(conn, &dst, &room);
+        if (ret != 0) return ret;
+
+        ssize_t n = recv(conn->fd, dst, room, 0);
+        if (n > 0) {
+            conn_received(conn, (size_t) n);
+        } else if (n == 0) {
+            return -1;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+}
+
+/**
+ * React to readiness on a client socket
+ *
+ * @return 0 to keep the connection, -1 to close it
+ */
+static int conn_service(connection_t *conn) {
+    for (;;) {
+        int ret = conn_read(conn);
+        if (ret < 0) return -1;
+
+        if (conn_flush(conn) != 0) return -1;
+
+        // Parsing was paused for backpressure and the socket took all the
+        // output: no new edge will arrive for data already queued in the
+        // kernel, so resume parsing now.
+        if (ret == 1 && conn_pending(conn) == 0) continue;
+        return 0;
+    }
+}
+
+static void ring_close(connection_t *conn);
+
+/**
+ * Unlink a closed connection from its worker and release what it holds.
+ * Nothing may still be receiving into or sending from its buffers.
+ */
+static void conn_release(connection_t *conn) {
+    worker_t *worker = conn->worker;
+
+    close(conn->fd);
+
+    if (conn->prev) conn->prev->next = conn->next;
+    else worker->connections = conn->next;
+    if (conn->next) conn->next->prev = conn->prev;
+    worker->num_connections--;
+
+    ether_log_info("etherd", "Client %s disconnected", conn->peer);
+
+    // Drop pins held by a half-received WRITE and by unsent READ responses
+    if (conn->state == CONN_READ_PAYLOAD && conn->payload_dst == PAYLOAD_BLOCK) {
+        unpin_handle(conn->payload_shard, conn->header.handle);
+    } else if (conn->state == CONN_READ_PAYLOAD && conn->payload_dst == PAYLOAD_BUFFER) {
+        if (conn->inflate_dst) {
+            unpin_handle(conn->payload_shard, conn->header.handle);
+        }
+        ether_buf_put(&conn->worker->pool, conn->payload, conn->payload_len);
+    }
+    for (size_t i = conn->seg_head; i < conn->num_segs; i++) {
+        conn_seg_done(conn, &conn->segs[i]);
+    }
+
+    free(conn->segs);
+    free(conn->out_buf);
+    free(conn->out_retired);
+    account_leave(conn->account);
+    free(conn);
+}
+
+static void conn_close(connection_t *conn) {
+    if (g_io_uring) {
+        ring_close(conn);
+        return;
+    }
+
+    epoll_ctl(conn->worker->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    conn_release(conn);
+}
+
+/**
+ * State for a freshly accepted socket (not yet linked into the worker)
+ *
+ * @param addr   Peer address from accept(), NULL to look it up
+ * @param local  Unix domain socket (else TCP)
+ */
+static connection_t *conn_create(worker_t *worker, int fd, const struct sockaddr_in *addr,
+                                 int local) {
+    connection_t *conn = calloc(1, sizeof(connection_t));
+    if (!conn) return NULL;
+
+    conn->fd = fd;
+    conn->state = CONN_READ_HEADER;
+    conn->worker = worker;
+    conn->local = local;
+
+    // Peer for the log, and the host whose account it is charged to
+    char host[INET_ADDRSTRLEN] = "?";
+    struct sockaddr_in peer;
+    socklen_t peer_len = sizeof(peer);
+    struct ucred cred;
+    socklen_t cred_len = sizeof(cred);
+    if (local && getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) == 0) {
+        snprintf(conn->peer, sizeof(conn->peer), "unix pid %d", (int) cred.pid);
+        snprintf(host, sizeof(host), "uid %u", (unsigned) cred.uid);
+    } else if (local) {
+        snprintf(conn->peer, sizeof(conn->peer), "unix");
+        snprintf(host, sizeof(host), "unix");
+    } else if (addr || getpeername(fd, (struct sockaddr *) &peer, &peer_len) == 0) {
+        if (!addr) addr = &peer;
+        inet_ntop(AF_INET, &addr->sin_addr, host, sizeof(host));
+        snprintf(conn->peer, sizeof(conn->peer), "%s:%d", host, ntohs(addr->sin_port));
+    } else {
+        snprintf(conn->peer, sizeof(conn->peer), "?");
+    }
+
+    conn->account = account_join(host);
+    if (!conn->account) {
+        free(conn);
+        return NULL;
+    }
+    return conn;
+}
+
+static void conn_attach(worker_t *worker, connection_t *conn) {
+    conn->next = worker->connections;
+    if (worker->connections) worker->connections->prev = conn;
+    worker->connections = conn;
+    worker->num_connections++;
+
+    ether_log_info("etherd", "Client connected from %s (worker %d, %zu active)",
+           conn->peer, worker->id, worker->num_connections);
+}
+
+/**
+ * Accept every pending connection of a listener
+ *
+ * @param local  Unix domain socket listener (else TCP)
+ */
+static void accept_clients(worker_t *worker, int listen_fd, int local) {
+    for (;;) {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+
+        int client_fd = accept4(listen_fd, (struct sockaddr *) &client_addr,
+                                &client_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                ether_log_error("etherd", "accept: %s", strerror(errno));
+            }
+            return;
+        }
+
+        connection_t *conn = conn_create(worker, client_fd, local ? NULL : &client_addr, local);
+        if (!conn) {
+            close(client_fd);
+            continue;
+        }
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = conn;
+        if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
+            ether_log_error("etherd", "epoll_ctl: %s", strerror(errno));
+            close(client_fd);
+            account_leave(conn->account);
+            free(conn);
+            continue;
+        }
+
+        conn_attach(worker, conn);
+
+        // Data may have arrived before the socket was registered
+        if (conn_service(conn) != 0) {
+            conn_close(conn);
+        }
+    }
+}
+
+// =============================================================================
+// IO_URING REACTOR
+// =============================================================================
+
+// A worker's ring carries, per connection, at most one receive (into in_buf
+// or straight into the payload destination, as conn_parse() picks) and one
+// sendmsg() of the gathered output queue. Every loop iteration is a single
+// io_uring_enter() that submits what the previous completions queued and
+// waits for the next ones, so under load each request costs a fraction of
+// a syscall instead of a recv() and a sendmsg() (plus an epoll_wait()).
+//
+// user_data is the connection pointer tagged with the operation in its low
+// bits (connections are malloc-aligned), or one of the markers below.
+
+#define UOP_RECV        1
+#define UOP_SEND        2
+#define UOP_MASK        7
+#define UD_ACCEPT       0x10   // TCP listener
+#define UD_ACCEPT_UNIX  0x20   // Unix domain socket listener
+#define UD_WAKE         0x30   // g_wake_fd readable: shutting down
+#define UD_CANCEL       0x40   // Outcome of an ASYNC_CANCEL, nothing to do
+#define UD_MARKERS      0x100  // user_data below this is not a connection
+
+static struct io_uring_sqe *ring_sqe(worker_t *worker) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&worker->ring);
+    if (!sqe) {
+        ether_log_error("etherd", "worker %d: io_uring submission queue stuck", worker->id);
+    }
+    return sqe;
+}
+
+static void ring_arm_accept(worker_t *worker, int listen_fd, uint64_t tag) {
+    struct io_uring_sqe *sqe = ring_sqe(worker);
+    if (!sqe) return;
+
+    // Blocking sockets: the ring waits for readiness itself
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_fd;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->ioprio = worker->accept_multishot ? IORING_ACCEPT_MULTISHOT : 0;
+    sqe->user_data = tag;
+    worker->accepts++;
+}
+
+/**
+ * Queue a cancel of every operation of this ring on fd
+ */
+static void ring_cancel_fd(worker_t *worker, int fd) {
+    struct io_uring_sqe *sqe = ring_sqe(worker);
+    if (!sqe) return;
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = UD_CANCEL;
+}
+
+static int ring_recv(connection_t *conn, uint8_t *dst, size_t room) {
+    struct io_uring_sqe *sqe = ring_sqe(conn->worker);
+    if (!sqe) return -1;
+
+    conn->rx_room = room < URING_MAX_RECV ? room : URING_MAX_RECV;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->fd;
+    sqe->addr = (uintptr_t) dst;
+    sqe->len = (uint32_t) conn->rx_room;
+    // The socket was just drained: skip the receive attempt bound to fail
+    sqe->ioprio = conn->rx_drained ? IORING_RECVSEND_POLL_FIRST : 0;
+    sqe->user_data = (uintptr_t) conn | UOP_RECV;
+    conn->rx_busy = 1;
+    return 0;
+}
+
+static int ring_send(connection_t *conn) {
+    struct io_uring_sqe *sqe = ring_sqe(conn->worker);
+    if (!sqe) return -1;
+
+    conn_gather(conn, &conn->tx_msg, conn->tx_iov, &conn->tx_control);
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = conn->fd;
+    sqe->addr = (uintptr_t) &conn->tx_msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uintptr_t) conn | UOP_SEND;
+    conn->tx_busy = 1;
+    return 0;
+}
+
+/**
+ * Keep a connection moving: run what has arrived, queue the next receive
+ * and send what is queued. Parsing paused for backpressure resumes from
+ * the completion of the send that drains the output.
+ */
+static void ring_progress(connection_t *conn) {
+    if (!conn->rx_busy) {
+        uint8_t *dst;
+        size_t room;
+        int ret = conn_parse(conn, &dst, &room);
+        if (ret < 0 || (ret == 0 && ring_recv(conn, dst, room) != 0)) {
+            conn_close(conn);
+            return;
+        }
+    }
+
+    if (!conn->tx_busy && conn->seg_head < conn->num_segs && ring_send(conn) != 0) {
+        conn_close(conn);
+    }
+}
+
+/**
+ * Close a connection whose operations may still be on the ring: cancel
+ * them, release it once the last one completes
+ */
+static void ring_close(connection_t *conn) {
+    if (conn->closing) return;
+    conn->closing = 1;
+
+    if (!conn->rx_busy && !conn->tx_busy) {
+        conn_release(conn);
+        return;
+    }
+
+    // Also wakes the operations on kernels without fd cancellation
+    shutdown(conn->fd, SHUT_RDWR);
+    ring_cancel_fd(conn->worker, conn->fd);
+}
+
+static void ring_accepted(worker_t *worker, uint64_t tag, int res, unsigned flags) {
+    int local = tag == UD_ACCEPT_UNIX;
+
+    if (!(flags & IORING_CQE_F_MORE)) {
+        worker->accepts--;
+    }
+
+    if (res >= 0 && !g_running) {
+        close(res);
+    } else if (res >= 0) {
+        connection_t *conn = conn_create(worker, res, NULL, local);
+        if (conn) {
+            conn_attach(worker, conn);
+            ring_progress(conn);
+        } else {
+            close(res);
+        }
+    } else if (res == -EINVAL && worker->accept_multishot) {
+        worker->accept_multishot = 0;   // Kernel before 5.19: one accept at a time
+    } else if (res != -EAGAIN && res != -EINTR && res != -ECANCELED) {
+        ether_log_error("etherd", "accept: %s", strerror(-res));
+    }
+
+    if (!(flags & IORING_CQE_F_MORE) && g_running) {
+        ring_arm_accept(worker, local ? g_unix_fd : worker->listen_fd, tag);
+    }
+}
+
+static void ring_complete(worker_t *worker, uint64_t user_data, int res, unsigned flags) {
+    if (user_data < UD_MARKERS) {
+        if (user_data == UD_ACCEPT || user_data == UD_ACCEPT_UNIX) {
+            ring_accepted(worker, user_data, res, flags);
+        }
+        return;   // UD_WAKE: the loop condition is re-checked; UD_CANCEL
+    }
+
+    connection_t *conn = (connection_t *) (uintptr_t) (user_data & ~(uint64_t) UOP_MASK);
+    int failed = 0;
+
+    if ((user_data & UOP_MASK) == UOP_RECV) {
+        conn->rx_busy = 0;
+        if (res > 0 && !conn->closing) {
+            conn->rx_drained = (size_t) res < conn->rx_room;
+            conn_received(conn, (size_t) res);
+        } else if (res == -EAGAIN || res == -EINTR) {
+            conn->rx_drained = 1;
+        } else {
+            failed = 1;   // Peer closed (0), error, or cancelled
+        }
+    } else {
+        conn->tx_busy = 0;
+        free(conn->out_retired);
+        conn->out_retired = NULL;
+        if (res >= 0 && !conn->closing) {
+            conn_sent(conn, (size_t) res);
+        } else if (res != -EAGAIN && res != -EINTR) {
+            failed = 1;
+        }
+    }
+
+    if (conn->closing) {
+        if (!conn->rx_busy && !conn->tx_busy) conn_release(conn);
+        return;
+    }
+    if (failed) {
+        conn_close(conn);
+        return;
+    }
+    ring_progress(conn);
+}
+
+static void ring_reap(worker_t *worker) {
+    struct io_uring_cqe *cqe;
+    while ((cqe = uring_peek(&worker->ring)) != NULL) {
+        uint64_t user_data = cqe->user_data;
+        int res = cqe->res;
+        unsigned flags = cqe->flags;
+        uring_seen(&worker->ring);
+
+        ring_complete(worker, user_data, res, flags);
+    }
+}
+
+/**
+ * Submit what is queued and wait for at least one completion
+ *
+ * @return  0 on success, -1 if the ring failed
+ */
+static int ring_wait(worker_t *worker) {
+    int ret = uring_submit(&worker->ring, 1);
+    if (ret < 0 && ret != -EINTR && ret != -EBUSY) {
+        ether_log_error("etherd", "io_uring_enter: %s", strerror(-ret));
+        return -1;
+    }
+    ring_reap(worker);
+    return 0;
+}
+
+static void *ring_worker_main(void *arg) {
+    worker_t *worker = arg;
+
+    // The ring belongs to the thread that sets it up (single issuer)
+    int err = uring_init(&worker->ring, URING_ENTRIES);
+    if (err < 0) {
+        ether_log_error("etherd", "worker %d: io_uring setup: %s", worker->id, strerror(-err));
+        kill(getpid(), SIGTERM);
+        return NULL;
+    }
+
+    worker->accept_multishot = 1;
+    ring_arm_accept(worker, worker->listen_fd, UD_ACCEPT);
+    if (g_unix_fd >= 0) {
+        ring_arm_accept(worker, g_unix_fd, UD_ACCEPT_UNIX);
+    }
+
+    struct io_uring_sqe *sqe = ring_sqe(worker);
+    if (sqe) {
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = g_wake_fd;
+        sqe->poll32_events = POLLIN;
+        sqe->user_data = UD_WAKE;
+    }
+
+    while (g_running) {
+        if (ring_wait(worker) != 0) break;
+    }
+
+    // Nothing may be freed while the kernel can still write into it:
+    // cancel every operation and wait until all of them are back
+    for (connection_t *conn = worker->connections, *next; conn; conn = next) {
+        next = conn->next;
+        conn_close(conn);
+    }
+    ring_cancel_fd(worker, worker->listen_fd);
+    if (g_unix_fd >= 0) {
+        ring_cancel_fd(worker, g_unix_fd);
+    }
+    while (worker->connections || worker->accepts > 0) {
+        if (ring_wait(worker) != 0) break;
+    }
+
+    ether_log_info("etherd", "Worker %d: %llu requests, %llu io_uring_enter() calls",
+                   worker->id, (unsigned long long) worker->requests,
+                   (unsigned long long) worker->ring.enters);
+    uring_destroy(&worker->ring);
+    return NULL;
+}
+
+// =============================================================================
+// WORKERS
+// =============================================================================
+
+static void *worker_main(void *arg) {
+    worker_t *worker = arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (g_running) {
+        int n = epoll_wait(worker->epoll_fd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ether_log_error("etherd", "epoll_wait: %s", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            void *tag = events[i].data.ptr;
+            if (tag == &g_wake_tag) {
+                continue;   // Shutdown: loop condition re-checked below
+            }
+            if (tag == &g_listen_tag) {
+                accept_clients(worker, worker->listen_fd, 0);
+                continue;
+            }
+            if (tag == &g_unix_tag) {
+                accept_clients(worker, g_unix_fd, 1);
+                continue;
+            }
+
+            connection_t *conn = tag;
+            if ((events[i].events & EPOLLERR) || conn_service(conn) != 0) {
+                conn_close(conn);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Create a non-blocking listener on port. SO_REUSEPORT lets every worker
+ * bind its own socket to the same port; the kernel load-balances accepts.
+ */
+static int create_listener(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    // Allow reuse
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        perror("setsockopt(SO_REUSEPORT)");
+        close(fd);
+        return -1;
+    }
+
+    // Bind
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+
+    // Listen
+    if (listen(fd, MAX_CLIENTS) < 0) {
+        perror("listen");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * Create the non-blocking Unix domain socket listener at path, replacing
+ * a stale socket file left by a previous run
+ */
+static int create_unix_listener(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "[etherd] --unix path too long\n");
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path);
+    }
+
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+
+    if (listen(fd, MAX_CLIENTS) < 0) {
+        perror("listen");
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int epoll_add(int epoll_fd, int fd, void *tag) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = tag;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static int worker_init(worker_t *worker, int id, int port) {
+    memset(worker, 0, sizeof(*worker));
+    worker->id = id;
+    worker->shard = &g_shards[id];
+    worker->epoll_fd = -1;
+    worker->ring.fd = -1;
+    ether_buf_pool_init(&worker->pool);
+
+    worker->listen_fd = create_listener(port);
+    if (worker->listen_fd < 0) {
+        return -1;
+    }
+
+    // The io_uring reactor sets up its ring in the worker thread
+    if (g_io_uring) {
+        return 0;
+    }
+
+    worker->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (worker->epoll_fd < 0) {
+        perror("epoll_create1");
+        return -1;
+    }
+
+    if (epoll_add(worker->epoll_fd, worker->listen_fd, &g_listen_tag) < 0 ||
+        epoll_add(worker->epoll_fd, g_wake_fd, &g_wake_tag) < 0) {
+        perror("epoll_ctl");
+        return -1;
+    }
+
+    // Every worker watches the one Unix listener; EPOLLEXCLUSIVE wakes a
+    // single worker per connection, which accepts whatever is pending
+    if (g_unix_fd >= 0) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+        ev.data.ptr = &g_unix_tag;
+        if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, g_unix_fd, &ev) < 0) {
+            perror("epoll_ctl");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void worker_destroy(worker_t *worker) {
+    // io_uring workers drain their connections before they exit; what is
+    // left (a ring that failed) has nothing in flight any more
+    while (worker->connections) {
+        if (g_io_uring) conn_release(worker->connections);
+        else conn_close(worker->connections);
+    }
+    ether_buf_pool_destroy(&worker->pool);
+    if (worker->epoll_fd >= 0) close(worker->epoll_fd);
+    if (worker->listen_fd >= 0) close(worker->listen_fd);
+}
+
+// =============================================================================
+// PERSISTENT STORE RECOVERY
+// =============================================================================
+
+typedef struct {
+    uint32_t shards;   // Shards the handles found need
+    size_t   blocks;   // Restored
+    size_t   bytes;
+} restore_t;
+
+static void restore_count(void *ptr, size_t size, uint64_t handle, void *arg) {
+    (void) ptr;
+    (void) size;
+    restore_t *restore = arg;
+    uint32_t id = handle_shard(handle);
+    if (id < MAX_WORKERS && id >= restore->shards) {
+        restore->shards = id + 1;
+    }
+}
+
+/**
+ * Put a recovered block back under its handle. One no shard takes (a
+ * duplicate left by a realloc that was cut short) is freed.
+ */
+static void restore_block(void *ptr, size_t size, uint64_t handle, void *arg) {
+    restore_t *restore = arg;
+    uint32_t id = handle_shard(handle);
+
+    if (id < (uint32_t) g_num_shards &&
+        handle_table_restore(&g_shards[id].table, handle, ptr, size)) {
+        atomic_fetch_add(&g_charged, size);   // Towards the watermark, no account
+        restore->blocks++;
+        restore->bytes += size;
+        return;
+    }
+
+    ether_log_warn("etherd", "store: dropping block with handle 0x%llx",
+                   (unsigned long long) handle);
+    ether_free(ptr);
+}
+
+// =============================================================================
+// MAIN
+// =============================================================================
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [port] [--threads N] [--allocator malloc|slab]"
+                    " [--wipe full|free|lazy|none] [--huge-threshold BYTES[K|M|G]]"
+                    " [--metrics-port N] [--log-level debug|info|warn|error|off]"
+                    " [--compression on|off] [--unix PATH]"
+                    " [--store PATH] [--store-size BYTES[K|M|G]] [--io epoll|uring]"
+                    " [--quota-bytes BYTES[K|M|G]] [--quota-handles N]"
+                    " [--memory-limit BYTES[K|M|G]] [--reclaim]\n", prog);
+}
+
+/**
+ * Parse a byte count with an optional K, M or G suffix
+ *
+ * @return  0 on success, -1 if text is not one
+ */
+static int parse_bytes(const char *text, size_t *bytes) {
+    char *end;
+    unsigned long long value = strtoull(text, &end, 10);
+    switch (*end) {
+        case 'G': case 'g': value <<= 10; // fall through
+        case 'M': case 'm': value <<= 10; // fall through
+        case 'K': case 'k': value <<= 10; end++; break;
+        default: break;
+    }
+    if (end == text || *end != '\0') {
+        return -1;
+    }
+
+    *bytes = (size_t) value;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int port = ETHER_DEFAULT_PORT;
+    int threads = 1;
+    int metrics_port = 0;
+    const char *unix_path = NULL;
+    const char *store_path = NULL;
+    size_t store_size = 0;
+
+    // Parse arguments
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "--threads") == 0 || strcmp(argv[i], "-t") == 0) && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--allocator") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "slab") == 0) {
+                ether_set_backend(ETHER_BACKEND_SLAB);
+            } else if (strcmp(name, "malloc") == 0) {
+                ether_set_backend(ETHER_BACKEND_MALLOC);
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--wipe") == 0 && i + 1 < argc) {
+            static const char *const policies[] = { "full", "free", "lazy", "none" };
+            const char *name = argv[++i];
+            int policy = -1;
+            for (int p = 0; p < 4; p++) {
+                if (strcmp(name, policies[p]) == 0) policy = p;
+            }
+            if (policy < 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            ether_set_wipe((ether_wipe_t) policy);
+        } else if (strcmp(argv[i], "--huge-threshold") == 0 && i + 1 < argc) {
+            size_t bytes;
+            if (parse_bytes(argv[++i], &bytes) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            ether_set_huge_threshold(bytes);
+        } else if (strcmp(argv[i], "--store") == 0 && i + 1 < argc) {
+            store_path = argv[++i];
+        } else if (strcmp(argv[i], "--store-size") == 0 && i + 1 < argc) {
+            if (parse_bytes(argv[++i], &store_size) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--metrics-port") == 0 && i + 1 < argc) {
+            metrics_port = atoi(argv[++i]);
+            if (metrics_port <= 0 || metrics_port > 65535) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            int level = ether_log_parse_level(argv[++i]);
+            if (level < 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            ether_log_set_level((ether_log_level_t) level);
+        } else if (strcmp(argv[i], "--compression") == 0 && i + 1 < argc) {
+            const char *mode = argv[++i];
+            if (strcmp(mode, "on") == 0) {
+                g_compress = 1;
+            } else if (strcmp(mode, "off") == 0) {
+                g_compress = 0;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--unix") == 0 && i + 1 < argc) {
+            unix_path = argv[++i];
+        } else if (strcmp(argv[i], "--io") == 0 && i + 1 < argc) {
+            const char *mode = argv[++i];
+            if (strcmp(mode, "uring") == 0) {
+                g_io_uring = 1;
+            } else if (strcmp(mode, "epoll") == 0) {
+                g_io_uring = 0;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--quota-bytes") == 0 && i + 1 < argc) {
+            if (parse_bytes(argv[++i], &g_quota_bytes) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--quota-handles") == 0 && i + 1 < argc) {
+            char *end;
+            g_quota_handles = strtoull(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0') {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--memory-limit") == 0 && i + 1 < argc) {
+            if (parse_bytes(argv[++i], &g_memory_limit) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--reclaim") == 0) {
+            g_reclaim = 1;
+        } else if (argv[i][0] != '-') {
+            port = atoi(argv[i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (threads < 1 || threads > MAX_WORKERS) {
+        fprintf(stderr, "[etherd] --threads must be between 1 and %d\n", MAX_WORKERS);
+        return 1;
+    }
+    if (metrics_port == port) {
+        fprintf(stderr, "[etherd] --metrics-port must differ from the service port\n");
+        return 1;
+    }
+
+    // Signals are handled synchronously by the main thread (sigwait below);
+    // workers inherit the blocked mask and never see them.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    // io_uring may be missing or disabled (io_uring_disabled sysctl, seccomp)
+    if (g_io_uring) {
+        uring_t probe;
+        int err = uring_init(&probe, URING_ENTRIES);
+        if (err < 0) {
+            fprintf(stderr, "[etherd] io_uring unavailable (%s), using epoll\n", strerror(-err));
+            g_io_uring = 0;
+        }
+        uring_destroy(&probe);
+    }
+
+    g_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (g_wake_fd < 0) {
+        perror("eventfd");
+        return 1;
+    }
+
+    // Workers log through per-thread rings; this thread writes them out
+    if (ether_log_start() != 0) {
+        fprintf(stderr, "[etherd] Failed to start the log writer, logging synchronously\n");
+    }
+
+    // Blocks kept by the previous run may carry handles of more shards
+    // than there are workers now: those go on serving, just issue no new
+    // handles
+    restore_t restore = { .shards = (uint32_t) threads };
+    uint64_t restore_start = now_ns();
+    if (store_path) {
+        if (ether_store_open(store_path, store_size) != ETHER_OK) {
+            fprintf(stderr, "[etherd] Cannot open store %s\n", store_path);
+            return 1;
+        }
+        ether_store_recover(restore_count, &restore);
+    }
+
+    // One handle table shard per worker
+    for (uint32_t i = 0; i < restore.shards; i++) {
+        if (handle_table_init(&g_shards[i].table, (uint8_t) i, 0) != 0) {
+            fprintf(stderr, "[etherd] Failed to allocate handle table\n");
+            return 1;
+        }
+        pthread_mutex_init(&g_shards[i].lock, NULL);
+        g_num_shards++;
+    }
+
+    if (store_path) {
+        ether_store_recover(restore_block, &restore);
+        for (int i = 0; i < g_num_shards; i++) {
+            handle_table_rebuild(&g_shards[i].table, (uint32_t) ether_store_mark());
+        }
+    }
+
+    if (unix_path) {
+        g_unix_fd = create_unix_listener(unix_path);
+        if (g_unix_fd < 0) {
+            return 1;
+        }
+    }
+
+    for (int i = 0; i < threads; i++) {
+        if (worker_init(&g_workers[i], i, port) != 0) {
+            worker_destroy(&g_workers[i]);
+            for (int j = 0; j < i; j++) worker_destroy(&g_workers[j]);
+            if (unix_path) unlink(unix_path);
+            return 1;
+        }
+    }
+
+    printf("===========================================\n");
+    printf("  Ether Daemon v%s\n", ETHER_VERSION);
+    printf("  Privacy-First Memory-as-a-Service\n");
+    printf("===========================================\n");
+    static const char *const backends[] = { "malloc", "slab", "store" };
+    printf("Listening on 0.0.0.0:%d (%d %s worker%s, %s allocator)\n", port, threads,
+           g_io_uring ? "io_uring" : "epoll", threads > 1 ? "s" : "",
+           backends[ether_get_backend()]);
+    if (store_path) {
+        printf("Store %s: %zu blocks (%zu bytes) restored in %.1f ms\n", store_path,
+               restore.blocks, restore.bytes, (double) (now_ns() - restore_start) / 1e6);
+    }
+    if (unix_path) {
+        printf("Listening on unix:%s\n", unix_path);
+    }
+    if (metrics_port > 0) {
+        printf("Metrics on http://0.0.0.0:%d/metrics\n", metrics_port);
+    }
+    if (g_quota_bytes || g_quota_handles || g_memory_limit || g_reclaim) {
+        printf("Per-host quota: %zu bytes, %zu handles; memory limit %zu bytes (0 = none)%s\n",
+               g_quota_bytes, g_quota_handles, g_memory_limit,
+               g_reclaim ? "; reclaim on disconnect" : "");
+    }
+    printf("Press Ctrl+C to stop\n\n");
+
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&g_workers[i].thread, NULL,
+                           g_io_uring ? ring_worker_main : worker_main, &g_workers[i]) != 0) {
+            perror("pthread_create");
+            g_running = 0;
+            break;
+        }
+        g_num_workers++;
+    }
+
+    // /metrics listener (the workers' metrics are live from here on)
+    int metrics_fd = -1;
+    pthread_t metrics_thread;
+    if (g_running && metrics_port > 0) {
+        metrics_fd = create_listener(metrics_port);
+        if (metrics_fd < 0 ||
+            pthread_create(&metrics_thread, NULL, metrics_main, (void *) (intptr_t) metrics_fd) != 0) {
+            fprintf(stderr, "[etherd] Failed to start the metrics listener\n");
+            if (metrics_fd >= 0) close(metrics_fd);
+            metrics_fd = -1;
+            g_running = 0;
+        }
+    }
+
+    // Wait for SIGINT/SIGTERM
+    if (g_running) {
+        int sig;
+        sigwait(&signals, &sig);
+        printf("\n[etherd] Shutting down...\n");
+    }
+
+    g_running = 0;
+    uint64_t one = 1;
+    if (write(g_wake_fd, &one, sizeof(one)) < 0) {
+        perror("eventfd write");
+    }
+
+    for (int i = 0; i < g_num_workers; i++) {
+        pthread_join(g_workers[i].thread, NULL);
+    }
+    if (metrics_fd >= 0) {
+        pthread_join(metrics_thread, NULL);
+        close(metrics_fd);
+    }
+
+    // Cleanup
+    for (int i = 0; i < threads; i++) {
+        worker_destroy(&g_workers[i]);
+    }
+    if (g_unix_fd >= 0) {
+        close(g_unix_fd);
+        unlink(unix_path);
+    }
+    close(g_wake_fd);
+    ether_log_stop();
+    ether_dump_state();
+    ether_store_close();   // Blocks stay in it for the next run
+
+    for (int i = 0; i < g_num_shards; i++) {
+        handle_table_destroy(&g_shards[i].table);
+        pthread_mutex_destroy(&g_shards[i].lock);
+    }
+    while (g_accounts) {   // Hosts that left blocks behind
+        account_t *next = g_accounts->next;
+        free(g_accounts);
+        g_accounts = next;
+    }
+
+    printf("[etherd] Goodbye!\n");
+    return 0;
+}
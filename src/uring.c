@@ -0,0 +1,184 @@
+/**
+ * Ether io_uring Ring Implementation
+ *
+ * io_uring_setup() returns the offsets of the ring fields, which are
+ * mapped from the ring fd: the SQ and CQ rings (one mapping if the kernel
+ * has IORING_FEAT_SINGLE_MMAP) and the SQE array. Indices only ever grow;
+ * the kernel owns sq_head and cq_tail, this side sq_tail and cq_head.
+ * Tail stores are releases and the other side's loads acquires, so an
+ * entry is complete before its index is seen.
+ *
+ * Copyright (C) 2024 - Licensed under GPL-3.0
+ */
+
+#include "uring.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// =============================================================================
+// SYSCALLS
+// =============================================================================
+
+static int sys_setup(unsigned entries, struct io_uring_params *params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_enter(int fd, unsigned submit, unsigned wait, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, submit, wait, flags, NULL, 0);
+}
+
+// =============================================================================
+// LIFECYCLE
+// =============================================================================
+
+/**
+ * Setup flags to try, best first; later kernels reject unknown ones
+ */
+static const unsigned g_setup_flags[] = {
+#ifdef IORING_SETUP_DEFER_TASKRUN
+    IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_SUBMIT_ALL,
+#endif
+#ifdef IORING_SETUP_COOP_TASKRUN
+    IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SUBMIT_ALL,
+#endif
+    0,
+};
+
+static void *map_ring(int fd, size_t size, off_t offset) {
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+int uring_init(uring_t *ring, unsigned entries) {
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+
+    struct io_uring_params params;
+    int fd = -1;
+    for (size_t i = 0; i < sizeof(g_setup_flags) / sizeof(g_setup_flags[0]) && fd < 0; i++) {
+        memset(&params, 0, sizeof(params));
+        params.flags = g_setup_flags[i] | IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * 4;
+        fd = sys_setup(entries, &params);
+        if (fd < 0 && errno != EINVAL) {
+            return -errno;   // ENOSYS, EPERM (disabled): no point retrying
+        }
+    }
+    if (fd < 0) {
+        return -errno;
+    }
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->sq_ring = map_ring(fd, ring->sq_ring_size, IORING_OFF_SQ_RING);
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->sq_ring = map_ring(fd, ring->sq_ring_size, IORING_OFF_SQ_RING);
+        ring->cq_ring = map_ring(fd, ring->cq_ring_size, IORING_OFF_CQ_RING);
+    }
+    ring->sqes = map_ring(fd, ring->sqes_size, IORING_OFF_SQES);
+    ring->fd = fd;
+
+    if (!ring->sq_ring || !ring->cq_ring || !ring->sqes) {
+        int err = errno;
+        uring_destroy(ring);
+        return -err;
+    }
+
+    uint8_t *sq = ring->sq_ring;
+    uint8_t *cq = ring->cq_ring;
+    ring->sq_head = (unsigned *) (sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+    ring->sq_flags = (unsigned *) (sq + params.sq_off.flags);
+    ring->sq_entries = params.sq_entries;
+    ring->cq_head = (unsigned *) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+    ring->features = params.features;
+
+    // SQEs are used in ring order, so the indirection array is the identity
+    unsigned *array = (unsigned *) (sq + params.sq_off.array);
+    for (unsigned i = 0; i < params.sq_entries; i++) {
+        array[i] = i;
+    }
+    return 0;
+}
+
+void uring_destroy(uring_t *ring) {
+    if (ring->fd < 0) return;
+
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring) munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+// =============================================================================
+// SUBMISSION
+// =============================================================================
+
+struct io_uring_sqe *uring_get_sqe(uring_t *ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *ring->sq_tail + ring->sq_pending;
+
+    if (tail - head >= ring->sq_entries) {
+        if (uring_submit(ring, 0) < 0) {
+            return NULL;
+        }
+        head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        tail = *ring->sq_tail + ring->sq_pending;
+        if (tail - head >= ring->sq_entries) {
+            return NULL;
+        }
+    }
+
+    struct io_uring_sqe *sqe = &ring->sqes[tail & *ring->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_pending++;
+    return sqe;
+}
+
+int uring_submit(uring_t *ring, unsigned wait) {
+    unsigned submit = ring->sq_pending;
+    if (submit) {
+        __atomic_store_n(ring->sq_tail, *ring->sq_tail + submit, __ATOMIC_RELEASE);
+        ring->sq_pending = 0;
+    }
+    if (submit == 0 && wait == 0) {
+        return 0;
+    }
+
+    ring->enters++;
+    int ret = sys_enter(ring->fd, submit, wait, wait ? IORING_ENTER_GETEVENTS : 0);
+    return ret < 0 ? -errno : ret;
+}
+
+// =============================================================================
+// COMPLETION
+// =============================================================================
+
+struct io_uring_cqe *uring_peek(uring_t *ring) {
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    return &ring->cqes[head & *ring->cq_mask];
+}
+
+void uring_seen(uring_t *ring) {
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
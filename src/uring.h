@@ -0,0 +1,101 @@
+/**
+ * Ether io_uring Ring (server-internal)
+ *
+ * Minimal io_uring wrapper over the raw syscalls, for the --io uring
+ * reactor of etherd (no liburing dependency).
+ *
+ * Every worker owns one ring and is the only thread that touches it.
+ * SQEs are filled in place and published together by uring_submit(),
+ * which also waits for completions: a busy worker makes one syscall per
+ * loop iteration for all the receives and sends of all its connections.
+ *
+ * Copyright (C) 2024 - Licensed under GPL-3.0
+ */
+
+#ifndef ETHER_URING_H
+#define ETHER_URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/io_uring.h>
+
+typedef struct {
+    int       fd;              // -1 if not set up
+    unsigned  features;        // IORING_FEAT_* the kernel reported
+
+    // Submission queue (shared with the kernel)
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_flags;
+    unsigned  sq_entries;
+    unsigned  sq_pending;      // SQEs handed out, not yet published
+    struct io_uring_sqe *sqes;
+
+    // Completion queue (shared with the kernel)
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    // Mappings
+    void     *sq_ring;
+    size_t    sq_ring_size;
+    void     *cq_ring;         // == sq_ring with IORING_FEAT_SINGLE_MMAP
+    size_t    cq_ring_size;
+    size_t    sqes_size;
+
+    uint64_t  enters;          // io_uring_enter() calls so far
+} uring_t;
+
+/**
+ * Set up a ring for the calling thread
+ *
+ * Asks for deferred task work on a single issuer (completions are only
+ * run when the owner waits for them), falling back to cooperative task
+ * work and then to the defaults on older kernels. The completion queue
+ * is four times the submission queue.
+ *
+ * @param ring     Ring to initialize
+ * @param entries  Submission queue size (rounded up to a power of two)
+ * @return         0 on success, -errno on failure (ring->fd stays -1)
+ */
+int uring_init(uring_t* ring, unsigned entries);
+
+/**
+ * Unmap and close a ring. Operations still in flight are cancelled by the
+ * kernel, so their buffers must not be freed before they complete.
+ *
+ * @param ring  Ring to destroy (fd -1 is a no-op)
+ */
+void uring_destroy(uring_t* ring);
+
+/**
+ * Next free submission entry, zeroed. When the queue is full, what is
+ * queued is submitted first.
+ *
+ * @return  SQE to fill in, NULL if the queue cannot be drained
+ */
+struct io_uring_sqe* uring_get_sqe(uring_t* ring);
+
+/**
+ * Publish the queued SQEs and optionally wait for completions, in one
+ * io_uring_enter()
+ *
+ * @param ring  Ring
+ * @param wait  Completions to wait for (0 = just submit)
+ * @return      SQEs consumed, or -errno (-EINTR if a signal interrupted the wait)
+ */
+int uring_submit(uring_t* ring, unsigned wait);
+
+/**
+ * Oldest unseen completion, NULL if there is none
+ */
+struct io_uring_cqe* uring_peek(uring_t* ring);
+
+/**
+ * Hand the completion returned by uring_peek() back to the kernel
+ */
+void uring_seen(uring_t* ring);
+
+#endif // ETHER_URING_H
@@ -7,9 +7,13 @@
  */
 
 #include "ether/ether.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 
 // =============================================================================
 // TEST UTILITIES
@@ -160,6 +164,72 @@ void test_realloc_zero(void) {
     ASSERT(ptr == NULL);
 }
 
+void test_realloc_geometric(void) {
+    // Growing one byte at a time only moves the block O(log n) times
+    uint8_t* ptr = ether_alloc(1);
+    ASSERT(ptr != NULL);
+    ptr[0] = 0;
+
+    int moves = 0;
+    for (size_t size = 2; size <= 64 * 1024; size++) {
+        uint8_t* grown = ether_realloc(ptr, size);
+        ASSERT(grown != NULL);
+        if (grown != ptr) moves++;
+        ptr = grown;
+        ptr[size - 1] = (uint8_t) size;
+    }
+    ASSERT(moves <= 20);
+    ASSERT(ptr[99] == 100 && ptr[65535] == 0);
+
+    // Stats follow the size, not the spare capacity
+    size_t usage = ether_get_stats().current_usage;
+    ptr = ether_realloc(ptr, 65537);
+    ASSERT(ptr != NULL);
+    ASSERT(ether_get_stats().current_usage == usage + 1);
+    ptr = ether_realloc(ptr, 1000);
+    ASSERT(ether_get_stats().current_usage == usage + 1000 - 65536);
+    ether_free(ptr);
+    ASSERT(ether_get_stats().current_usage == usage - 65536);
+}
+
+void test_realloc_mremap(void) {
+    size_t size = 1024 * 1024;
+    uint8_t* ptr = ether_alloc_ex(size, ETHER_WIPE_LAZY);
+    ASSERT(ptr != NULL);
+    memset(ptr, 0x5A, size);
+
+    // Own mapping: extended by the kernel, contents kept, new pages zero
+    for (int i = 0; i < 4; i++) {
+        size *= 2;
+        ptr = ether_realloc(ptr, size);
+        ASSERT(ptr != NULL);
+        ASSERT(ether_size(ptr) == size);
+    }
+    ASSERT(ptr[0] == 0x5A && ptr[1024 * 1024 - 1] == 0x5A);
+    ASSERT(ptr[1024 * 1024] == 0 && ptr[size - 1] == 0);
+    ether_free(ptr);
+}
+
+void test_resize_in_place(void) {
+    uint8_t* ptr = ether_alloc(100);
+    ASSERT(ptr != NULL);
+    memset(ptr, 0x11, 100);
+
+    // Within capacity: never moves
+    ASSERT(ether_resize(ptr, 10) == ETHER_OK);
+    ASSERT(ether_size(ptr) == 10);
+    ASSERT(ether_resize(ptr, 100) == ETHER_OK);
+    ASSERT(ptr[9] == 0x11 && ptr[10] == 0);
+
+    // A heap block cannot grow past its capacity without moving
+    ASSERT(ether_resize(ptr, 1024 * 1024) == ETHER_ERR_NOMEM);
+    ASSERT(ether_size(ptr) == 100);
+
+    ASSERT(ether_resize(ptr, 0) == ETHER_ERR_INVALID);
+    ASSERT(ether_resize(NULL, 10) == ETHER_ERR_INVALID);
+    ether_free(ptr);
+}
+
 void test_large_alloc(void) {
     // 1 MB allocation
     size_t size = 1024 * 1024;
@@ -222,6 +292,412 @@ void test_memory_zero_init(void) {
     ether_free(ptr);
 }
 
+void test_slab_alloc_free(void) {
+    ASSERT(ether_set_backend(ETHER_BACKEND_SLAB) == ETHER_OK);
+    ASSERT(ether_get_backend() == ETHER_BACKEND_SLAB);
+
+    // Every size up to the largest class, zeroed and writable
+    for (size_t size = 1; size <= ETHER_SLAB_MAX_BLOCK; size = size * 3 / 2 + 1) {
+        uint8_t* ptr = ether_alloc(size);
+        ASSERT(ptr != NULL);
+        ASSERT(ether_size(ptr) == size);
+        for (size_t i = 0; i < size; i++) {
+            ASSERT(ptr[i] == 0);
+        }
+        memset(ptr, 0xCD, size);
+        ether_free(ptr);
+    }
+
+    // Beyond the largest class falls back to malloc
+    void* big = ether_alloc(ETHER_SLAB_MAX_BLOCK * 2);
+    ASSERT(big != NULL);
+    ether_free(big);
+
+    ether_set_backend(ETHER_BACKEND_MALLOC);
+}
+
+void test_slab_reuse_wiped(void) {
+    ether_set_backend(ETHER_BACKEND_SLAB);
+
+    uint8_t* ptr = ether_alloc(100);
+    ASSERT(ptr != NULL);
+    memset(ptr, 0xAB, 100);
+    ether_free(ptr);
+
+    // Same class: the freed block comes back, wiped
+    uint8_t* again = ether_alloc(90);
+    ASSERT(again == ptr);
+    for (size_t i = 0; i < 90; i++) {
+        ASSERT(again[i] == 0);
+    }
+
+    // Shrink leaves stale bytes past size; they must not survive a free
+    memset(again, 0xEF, 90);
+    ASSERT(ether_realloc(again, 10) == again);
+    ether_free(again);
+
+    uint8_t* third = ether_alloc(100);
+    ASSERT(third == ptr);
+    for (size_t i = 0; i < 100; i++) {
+        ASSERT(third[i] == 0);
+    }
+    ether_free(third);
+
+    ether_set_backend(ETHER_BACKEND_MALLOC);
+}
+
+void test_slab_realloc(void) {
+    ether_set_backend(ETHER_BACKEND_SLAB);
+
+    uint8_t* ptr = ether_alloc(50);
+    ASSERT(ptr != NULL);
+    memset(ptr, 0x11, 50);
+
+    // Grow past the class, then past the slab limit
+    ptr = ether_realloc(ptr, 5000);
+    ASSERT(ptr != NULL);
+    ASSERT(ptr[49] == 0x11 && ptr[50] == 0);
+
+    ptr = ether_realloc(ptr, ETHER_SLAB_MAX_BLOCK * 4);
+    ASSERT(ptr != NULL);
+    ASSERT(ptr[0] == 0x11 && ptr[4999] == 0);
+
+    ether_free(ptr);
+    ether_set_backend(ETHER_BACKEND_MALLOC);
+}
+
+void test_backend_switch(void) {
+    // Blocks remember their backend, so frees after a switch are safe
+    ether_set_backend(ETHER_BACKEND_SLAB);
+    void* slab = ether_alloc(64);
+    ether_set_backend(ETHER_BACKEND_MALLOC);
+    void* heap = ether_alloc(64);
+    ASSERT(slab != NULL && heap != NULL);
+
+    ether_set_backend(ETHER_BACKEND_SLAB);
+    ether_free(heap);
+    ether_set_backend(ETHER_BACKEND_MALLOC);
+    ether_free(slab);
+
+    ASSERT(ether_set_backend((ether_backend_t) 42) == ETHER_ERR_INVALID);
+    ASSERT(ether_get_backend() == ETHER_BACKEND_MALLOC);
+}
+
+void test_slab_stats(void) {
+    ether_reset_stats();
+    ether_set_backend(ETHER_BACKEND_SLAB);
+
+    void* ptr = ether_alloc(1000);
+    ether_stats_t stats = ether_get_stats();
+    ASSERT(stats.current_usage == 1000);
+    ASSERT(stats.arena_mapped > 0);
+    ASSERT(stats.resident > 0);
+
+    ether_free(ptr);
+    stats = ether_get_stats();
+    ASSERT(stats.current_usage == 0);
+    ASSERT(stats.num_frees == 1);
+
+    ether_set_backend(ETHER_BACKEND_MALLOC);
+}
+
+void test_wipe_policies(void) {
+    ASSERT(ether_get_wipe() == ETHER_WIPE_FULL);
+    ASSERT(ether_set_wipe((ether_wipe_t) 7) == ETHER_ERR_INVALID);
+    ASSERT(ether_alloc_ex(16, 0x100) == NULL);
+
+    for (unsigned policy = ETHER_WIPE_FULL; policy <= ETHER_WIPE_NONE; policy++) {
+        uint8_t* ptr = ether_alloc_ex(1000, policy);
+        ASSERT(ptr != NULL);
+        ASSERT(ether_size(ptr) == 1000);
+        memset(ptr, 0x5A, 1000);
+
+        // Grows keep the data and the policy
+        ptr = ether_realloc(ptr, 300000);
+        ASSERT(ptr != NULL);
+        ASSERT(ptr[999] == 0x5A);
+        ether_free(ptr);
+    }
+
+    // The default policy applies to ether_alloc()
+    ASSERT(ether_set_wipe(ETHER_WIPE_NONE) == ETHER_OK);
+    void* ptr = ether_alloc(64);
+    ASSERT(ptr != NULL);
+    ether_free(ptr);
+    ether_set_wipe(ETHER_WIPE_FULL);
+}
+
+void test_wipe_lazy_large(void) {
+    size_t size = 4 * 1024 * 1024;
+    uint8_t* ptr = ether_alloc_ex(size, ETHER_WIPE_LAZY);
+    ASSERT(ptr != NULL);
+
+    // Fresh pages: zero without a memset
+    for (size_t i = 0; i < size; i += 4096) {
+        ASSERT(ptr[i] == 0);
+    }
+    memset(ptr, 0x77, size);
+
+    // Shrink then grow in place: the stale tail is zeroed again
+    ASSERT(ether_realloc(ptr, 100) == ptr);
+    ASSERT(ether_realloc(ptr, 200) == ptr);
+    ASSERT(ptr[99] == 0x77 && ptr[100] == 0 && ptr[199] == 0);
+    ether_free(ptr);
+
+    // Large FULL blocks go through the streaming wipe on free
+    ptr = ether_alloc_ex(size, ETHER_WIPE_FULL);
+    ASSERT(ptr != NULL);
+    ASSERT(ptr[size - 1] == 0);
+    memset(ptr, 0x77, size);
+    ether_free(ptr);
+}
+
+void test_slab_dirty_rezeroed(void) {
+    ether_set_backend(ETHER_BACKEND_SLAB);
+
+    // Freed without a wipe...
+    uint8_t* ptr = ether_alloc_ex(100, ETHER_WIPE_NONE);
+    ASSERT(ptr != NULL);
+    memset(ptr, 0xAB, 100);
+    ether_free(ptr);
+
+    // ...so a zeroing allocation of the same block must clear it
+    uint8_t* again = ether_alloc_ex(100, ETHER_WIPE_FULL);
+    ASSERT(again == ptr);
+    for (size_t i = 0; i < 100; i++) {
+        ASSERT(again[i] == 0);
+    }
+    ether_free(again);
+
+    ether_set_backend(ETHER_BACKEND_MALLOC);
+}
+
+void test_huge_alloc(void) {
+    ASSERT(ether_alloc_ex(16, 0x10) == NULL);
+
+    // Explicit hint: own mapping, rounded up to whole huge pages
+    uint8_t* ptr = ether_alloc_ex(1000, ETHER_WIPE_FULL | ETHER_ALLOC_HUGE);
+    ASSERT(ptr != NULL);
+    ASSERT(ether_size(ptr) == 1000);
+    ASSERT(ptr[0] == 0 && ptr[999] == 0);
+    memset(ptr, 0x3C, 1000);
+
+    // Grows in place up to the mapping, then keeps the placement
+    ASSERT(ether_realloc(ptr, 100000) == ptr);
+    ASSERT(ptr[999] == 0x3C && ptr[1000] == 0);
+    ptr = ether_realloc(ptr, ETHER_HUGE_PAGE_SIZE * 2);
+    ASSERT(ptr != NULL);
+    ASSERT(ptr[999] == 0x3C && ptr[ETHER_HUGE_PAGE_SIZE * 2 - 1] == 0);
+    ether_free(ptr);
+
+    // Threshold: large plain allocations take the same path
+    ether_set_huge_threshold(1024 * 1024);
+    ASSERT(ether_get_huge_threshold() == 1024 * 1024);
+    ptr = ether_alloc(3 * 1024 * 1024);
+    ASSERT(ptr != NULL);
+    ASSERT(ptr[3 * 1024 * 1024 - 1] == 0);
+    ether_free(ptr);
+    ether_set_huge_threshold(0);
+}
+
+void test_shared_alloc(void) {
+    ASSERT(ether_block_fd(NULL) == -1);
+    uint8_t* plain = ether_alloc(64);
+    ASSERT(ether_block_fd(plain) == -1);
+    ether_free(plain);
+
+    uint8_t* ptr = ether_alloc_ex(10000, ETHER_WIPE_FULL | ETHER_ALLOC_SHARED);
+    ASSERT(ptr != NULL);
+    ASSERT(ether_size(ptr) == 10000);
+    ASSERT(ptr[0] == 0 && ptr[9999] == 0);
+
+    // A second mapping of the fd sees the same pages, both ways
+    int fd = ether_block_fd(ptr);
+    ASSERT(fd >= 0);
+    uint8_t* view = mmap(NULL, 10000, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ASSERT(view != MAP_FAILED);
+    memset(ptr, 0x5A, 10000);
+    ASSERT(view[0] == 0x5A && view[9999] == 0x5A);
+    view[42] = 0x01;
+    ASSERT(ptr[42] == 0x01);
+
+    // Sealed: nobody holding the fd can shrink it
+    ASSERT(ftruncate(fd, 0) != 0);
+
+    // Grows in place when it can, else moves to a new memfd with the data
+    uint8_t* grown = ether_realloc(ptr, 1024 * 1024);
+    ASSERT(grown != NULL);
+    ASSERT(ether_block_fd(grown) >= 0);
+    ASSERT(grown[42] == 0x01 && grown[9999] == 0x5A && grown[10000] == 0);
+    ASSERT(grown[1024 * 1024 - 1] == 0);
+
+    // Free punches the pages out (a move frees the old file): the view
+    // outlives the block but no longer sees its data
+    ether_free(grown);
+    ASSERT(view[0] == 0 && view[42] == 0);
+    munmap(view, 10000);
+}
+
+static void store_visit(void* ptr, size_t size, uint64_t tag, void* arg) {
+    uint8_t** found = arg;
+    ASSERT(tag >= 1000 && tag < 1064 && found[tag - 1000] == NULL);
+    ASSERT(ether_size(ptr) == size);
+    found[tag - 1000] = ptr;
+}
+
+void test_store(void) {
+    char path[] = "/tmp/ether_store_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0);
+    close(fd);
+
+    ASSERT(ether_store_open(NULL, 0) == ETHER_ERR_INVALID);
+    ASSERT(ether_store_open(path, 0) == ETHER_ERR_INVALID);   // New file needs a size
+    ASSERT(ether_set_backend(ETHER_BACKEND_STORE) == ETHER_ERR_INVALID);
+    ASSERT(ether_store_open(path, 16 * 1024 * 1024) == ETHER_OK);
+    ASSERT(ether_store_is_open() && ether_get_backend() == ETHER_BACKEND_STORE);
+    ASSERT(ether_store_open(path, 0) == ETHER_ERR_INVALID);   // Already open
+
+    // Tagged blocks survive a reopen
+    uint8_t* kept[64];
+    for (int i = 0; i < 64; i++) {
+        size_t size = 100 + (size_t) i * 1000;
+        kept[i] = ether_alloc(size);
+        ASSERT(kept[i] != NULL && kept[i][0] == 0 && kept[i][size - 1] == 0);
+        memset(kept[i], i, size);
+        ASSERT(ether_store_tag(kept[i], 1000 + (uint64_t) i) == ETHER_OK);
+    }
+
+    // ...untagged ones do not, and neither do blocks outside the store
+    uint8_t* temp = ether_alloc(5000);
+    ASSERT(temp != NULL);
+    memset(temp, 0xAA, 5000);
+    void* shared = ether_alloc_ex(100, ETHER_WIPE_FULL | ETHER_ALLOC_SHARED);
+    ASSERT(ether_store_tag(shared, 1) == ETHER_ERR_INVALID);
+    ether_free(shared);
+
+    // The mark only ever goes up, and is kept with the blocks
+    ASSERT(ether_store_mark() == 0);
+    ether_store_raise_mark(42);
+    ether_store_raise_mark(7);
+    ASSERT(ether_store_mark() == 42);
+
+    // Freed blocks are gone, moved ones keep their tag
+    ether_free(kept[10]);
+    kept[20] = ether_realloc(kept[20], 1024 * 1024);
+    ASSERT(kept[20] != NULL);
+    ether_store_close();
+    ASSERT(!ether_store_is_open() && ether_get_backend() == ETHER_BACKEND_MALLOC);
+
+    ASSERT(ether_store_open(path, 0) == ETHER_OK);
+    uint8_t* found[64] = { 0 };
+    ASSERT(ether_store_recover(store_visit, found) == 63);
+    ASSERT(found[10] == NULL);
+    ASSERT(ether_store_mark() == 42);
+    for (int i = 0; i < 64; i++) {
+        if (i == 10) continue;
+        size_t written = 100 + (size_t) i * 1000;
+        ASSERT(ether_size(found[i]) == (i == 20 ? 1024 * 1024 : written));
+        for (size_t j = 0; j < written; j++) {
+            ASSERT(found[i][j] == (uint8_t) i);
+        }
+    }
+    ASSERT(found[20][1024 * 1024 - 1] == 0);
+
+    // Reclaimed space is zeroed again before it is handed out
+    uint8_t* reused = ether_alloc(5000);
+    ASSERT(reused != NULL);
+    for (size_t j = 0; j < 5000; j++) {
+        ASSERT(reused[j] == 0);
+    }
+    ether_free(reused);
+
+    for (int i = 0; i < 64; i++) {
+        ether_free(found[i]);
+    }
+    ASSERT(ether_store_recover(NULL, NULL) == 0);
+    ether_store_close();
+
+    // Anything but a store is refused
+    fd = open(path, O_WRONLY | O_TRUNC);
+    ASSERT(fd >= 0 && write(fd, "not a store", 11) == 11);
+    close(fd);
+    ASSERT(ether_store_open(path, 1024 * 1024) == ETHER_ERR_CORRUPT);
+    ASSERT(!ether_store_is_open());
+    unlink(path);
+}
+
+static void* stats_thread(void* arg) {
+    (void) arg;
+    for (int i = 0; i < 1000; i++) {
+        ether_free(ether_alloc(64));
+    }
+    return ether_alloc(4096);
+}
+
+void test_stats_threads(void) {
+    ether_reset_stats();
+
+    // Counts of exited threads survive, blocks may be freed elsewhere
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++) {
+        ASSERT(pthread_create(&threads[i], NULL, stats_thread, NULL) == 0);
+    }
+    void* leftovers[4];
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], &leftovers[i]);
+    }
+
+    ether_stats_t stats = ether_get_stats();
+    ASSERT(stats.num_allocs == 4 * 1001);
+    ASSERT(stats.num_frees == 4 * 1000);
+    ASSERT(stats.current_usage == 4 * 4096);
+    ASSERT(stats.peak_usage >= stats.current_usage);
+
+    for (int i = 0; i < 4; i++) {
+        ether_free(leftovers[i]);
+    }
+    stats = ether_get_stats();
+    ASSERT(stats.current_usage == 0);
+    ASSERT(stats.num_frees == 4 * 1001);
+}
+
+void test_stats_histograms(void) {
+    ether_reset_stats();
+    ether_free(ether_alloc(1));
+    ether_free(ether_alloc(100));      // [64, 128)
+    ether_free(ether_alloc(127));
+    ether_free(ether_alloc(5000));     // [4096, 8192)
+
+    ether_stats_t stats = ether_get_stats();
+    ASSERT(stats.alloc_sizes[0] == 1);
+    ASSERT(stats.alloc_sizes[6] == 2);
+    ASSERT(stats.alloc_sizes[12] == 1);
+
+    size_t allocs = 0, frees = 0;
+    for (int i = 0; i < ETHER_STATS_LATENCY_BUCKETS; i++) {
+        allocs += stats.alloc_latency[i];
+        frees += stats.free_latency[i];
+    }
+    ASSERT(allocs == 4 && frees == 4);
+
+    // Without timing only the size histogram moves
+    ether_set_latency_stats(false);
+    ether_free(ether_alloc(100));
+    stats = ether_get_stats();
+    ASSERT(stats.alloc_sizes[6] == 3);
+    allocs = 0;
+    for (int i = 0; i < ETHER_STATS_LATENCY_BUCKETS; i++) {
+        allocs += stats.alloc_latency[i];
+    }
+    ASSERT(allocs == 4);
+    ether_set_latency_stats(true);
+
+    ether_reset_stats();
+    stats = ether_get_stats();
+    ASSERT(stats.alloc_sizes[6] == 0 && stats.num_allocs == 0 && stats.peak_usage == 0);
+}
+
 void test_error_strings(void) {
     // Test that error strings are not NULL
     ASSERT(ether_strerror(ETHER_OK) != NULL);
@@ -229,6 +705,8 @@ void test_error_strings(void) {
     ASSERT(ether_strerror(ETHER_ERR_INVALID) != NULL);
     ASSERT(ether_strerror(ETHER_ERR_CORRUPT) != NULL);
     ASSERT(ether_strerror(ETHER_ERR_OVERFLOW) != NULL);
+    ASSERT(strcmp(ether_strerror(ETHER_ERR_QUOTA), "Unknown error") != 0);
+    ASSERT(strcmp(ether_strerror(ETHER_ERR_BUSY), "Unknown error") != 0);
 }
 
 // =============================================================================
@@ -251,9 +729,25 @@ int main(void) {
     TEST(test_realloc_shrink);
     TEST(test_realloc_null);
     TEST(test_realloc_zero);
+    TEST(test_realloc_geometric);
+    TEST(test_realloc_mremap);
+    TEST(test_resize_in_place);
     TEST(test_large_alloc);
     TEST(test_stats);
     TEST(test_memory_zero_init);
+    TEST(test_slab_alloc_free);
+    TEST(test_slab_reuse_wiped);
+    TEST(test_slab_realloc);
+    TEST(test_backend_switch);
+    TEST(test_slab_stats);
+    TEST(test_wipe_policies);
+    TEST(test_wipe_lazy_large);
+    TEST(test_slab_dirty_rezeroed);
+    TEST(test_huge_alloc);
+    TEST(test_shared_alloc);
+    TEST(test_store);
+    TEST(test_stats_threads);
+    TEST(test_stats_histograms);
     TEST(test_error_strings);
 
     printf("\n");
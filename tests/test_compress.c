@@ -0,0 +1,249 @@
+/**
+ * Ether Compression Test Suite
+ *
+ * Tests for the LZ4 block codec and compressed payload framing.
+ *
+ * Copyright (C) 2024 - Licensed under GPL-3.0
+ */
+
+#include "ether/compress.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =============================================================================
+// TEST UTILITIES
+// =============================================================================
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %-30s ", #name); \
+        fflush(stdout); \
+        tests_run++; \
+        name(); \
+        tests_passed++; \
+        printf("✓ PASSED\n"); \
+    } while(0)
+
+#define ASSERT(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("✗ FAILED\n"); \
+            printf("    Assertion failed: %s\n", #cond); \
+            printf("    At %s:%d\n", __FILE__, __LINE__); \
+            exit(1); \
+        } \
+    } while(0)
+
+static uint64_t g_rng = 0x9E3779B97F4A7C15ull;
+
+static uint8_t random_byte(void) {
+    g_rng ^= g_rng >> 12;
+    g_rng ^= g_rng << 25;
+    g_rng ^= g_rng >> 27;
+    return (uint8_t) ((g_rng * 0x2545F4914F6CDD1Dull) >> 56);
+}
+
+/**
+ * Compress and decompress len bytes, check they come back intact
+ *
+ * @return  Compressed block length
+ */
+static size_t roundtrip(const uint8_t *data, size_t len) {
+    size_t cap = ether_lz4_bound(len);
+    uint8_t *block = malloc(cap);
+    uint8_t *out = malloc(len + 1);
+    ASSERT(block && out);
+
+    size_t n = ether_lz4_compress(data, len, block, cap);
+    ASSERT(n > 0 && n <= cap);
+    ASSERT(ether_lz4_decompress(block, n, out, len) == (ssize_t) len);
+    ASSERT(len == 0 || memcmp(out, data, len) == 0);
+
+    free(block);
+    free(out);
+    return n;
+}
+
+// =============================================================================
+// TESTS
+// =============================================================================
+
+void test_roundtrip_sizes(void) {
+    uint8_t data[70000];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t) ((i % 97) < 40 ? i % 7 : random_byte());
+    }
+
+    // Around the no-match limits, and past the 64 KB offset window
+    size_t sizes[] = { 0, 1, 5, 12, 13, 17, 100, 4096, 65535, 65536, sizeof(data) };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        roundtrip(data, sizes[i]);
+    }
+}
+
+void test_compressible(void) {
+    size_t len = 1 << 20;
+    uint8_t *data = calloc(1, len);
+    ASSERT(data);
+
+    // Sparse block: a few records in a sea of zeros
+    for (size_t i = 0; i < len; i += 8192) {
+        memcpy(data + i, "record", 6);
+        data[i + 6] = (uint8_t) (i >> 13);
+    }
+
+    size_t n = roundtrip(data, len);
+    ASSERT(n < len / 50);
+    free(data);
+}
+
+void test_incompressible(void) {
+    size_t len = 256 * 1024;
+    uint8_t *data = malloc(len);
+    ASSERT(data);
+    for (size_t i = 0; i < len; i++) data[i] = random_byte();
+
+    // Random data costs at most the bound
+    size_t n = roundtrip(data, len);
+    ASSERT(n <= ether_lz4_bound(len));
+
+    // ...and the framing refuses to send it compressed
+    uint8_t *out = malloc(ether_compress_bound(len));
+    ASSERT(out);
+    ASSERT(ether_compress_payload(data, len, out, ether_compress_bound(len)) == 0);
+
+    free(out);
+    free(data);
+}
+
+void test_long_lengths(void) {
+    // Runs far over 15 + 255 exercise every continuation byte path
+    size_t len = 300000;
+    uint8_t *data = malloc(len);
+    ASSERT(data);
+    for (size_t i = 0; i < 1000; i++) data[i] = random_byte();    // Long literal run
+    memset(data + 1000, 'x', len - 1000);                         // Long match
+    roundtrip(data, len);
+    free(data);
+}
+
+void test_reference_block(void) {
+    // Hand-built block: "abc" + a 9-byte match at offset 3, then 5 literals
+    const uint8_t block[] = {
+        0x35, 'a', 'b', 'c', 0x03, 0x00,
+        0x50, 'X', 'Y', 'Z', 'W', 'V',
+    };
+    const char *expected = "abcabcabcabcXYZWV";
+
+    uint8_t out[32];
+    ASSERT(ether_lz4_decompress(block, sizeof(block), out, sizeof(out)) == 17);
+    ASSERT(memcmp(out, expected, 17) == 0);
+
+    // Output that does not fit is an error, not a truncation
+    ASSERT(ether_lz4_decompress(block, sizeof(block), out, 16) == -1);
+}
+
+void test_malformed(void) {
+    uint8_t out[64];
+
+    // Offset before the start of the output
+    const uint8_t far[] = { 0x11, 'a', 0x05, 0x00, 0x00 };
+    ASSERT(ether_lz4_decompress(far, sizeof(far), out, sizeof(out)) == -1);
+
+    // Zero offset
+    const uint8_t zero[] = { 0x11, 'a', 0x00, 0x00, 0x00 };
+    ASSERT(ether_lz4_decompress(zero, sizeof(zero), out, sizeof(out)) == -1);
+
+    // Literal run longer than the input
+    const uint8_t lits[] = { 0x90, 'a', 'b' };
+    ASSERT(ether_lz4_decompress(lits, sizeof(lits), out, sizeof(out)) == -1);
+
+    // Truncated offset, unterminated length, empty input
+    const uint8_t cut[] = { 0x14, 'a', 0x01 };
+    ASSERT(ether_lz4_decompress(cut, sizeof(cut), out, sizeof(out)) == -1);
+    const uint8_t ext[] = { 0xF0, 0xFF, 0xFF };
+    ASSERT(ether_lz4_decompress(ext, sizeof(ext), out, sizeof(out)) == -1);
+    ASSERT(ether_lz4_decompress(lits, 0, out, sizeof(out)) == -1);
+
+    // Random garbage never writes past cap (ASan checks the rest)
+    uint8_t junk[256];
+    for (int round = 0; round < 1000; round++) {
+        for (size_t i = 0; i < sizeof(junk); i++) junk[i] = random_byte();
+        ssize_t n = ether_lz4_decompress(junk, 1 + round % sizeof(junk), out, sizeof(out));
+        ASSERT(n >= -1 && n <= (ssize_t) sizeof(out));
+    }
+}
+
+void test_payload_framing(void) {
+    size_t len = 64 * 1024;
+    uint8_t *data = malloc(len);
+    uint8_t *payload = malloc(ether_compress_bound(len));
+    uint8_t *out = malloc(len);
+    ASSERT(data && payload && out);
+    for (size_t i = 0; i < len; i++) data[i] = (uint8_t) (i / 64);
+
+    size_t n = ether_compress_payload(data, len, payload, ether_compress_bound(len));
+    ASSERT(n > ETHER_COMPRESS_HEADER && n < len);
+
+    // raw_size is big-endian
+    ASSERT(payload[0] == 0x00 && payload[1] == 0x01 && payload[2] == 0x00 && payload[3] == 0x00);
+    ASSERT(ether_compressed_size(payload, n) == len);
+
+    ASSERT(ether_decompress_payload(payload, n, out, len) == (ssize_t) len);
+    ASSERT(memcmp(out, data, len) == 0);
+
+    // Destination too small, truncated payload, lying raw_size
+    ASSERT(ether_decompress_payload(payload, n, out, len - 1) == -1);
+    ASSERT(ether_decompress_payload(payload, n - 1, out, len) == -1);
+    payload[3] = 0x01;
+    ASSERT(ether_decompress_payload(payload, n, out, len) == -1);
+
+    // Tiny inputs are never worth it
+    ASSERT(ether_compress_payload(data, 4, payload, ether_compress_bound(4)) == 0);
+
+    free(out);
+    free(payload);
+    free(data);
+}
+
+void test_null_handling(void) {
+    uint8_t buf[16];
+    ASSERT(ether_lz4_compress(NULL, 10, buf, sizeof(buf)) == 0);
+    ASSERT(ether_lz4_compress(buf, sizeof(buf), NULL, 64) == 0);
+    ASSERT(ether_lz4_decompress(NULL, 10, buf, sizeof(buf)) == -1);
+    ASSERT(ether_compress_payload(buf, sizeof(buf), NULL, 64) == 0);
+    ASSERT(ether_compressed_size(NULL, 8) == 0);
+    ASSERT(ether_decompress_payload(NULL, 8, buf, sizeof(buf)) == -1);
+}
+
+// =============================================================================
+// MAIN
+// =============================================================================
+
+int main(void) {
+    printf("\n");
+    printf("===========================================\n");
+    printf("  Ether Compression Test Suite\n");
+    printf("===========================================\n\n");
+
+    TEST(test_roundtrip_sizes);
+    TEST(test_compressible);
+    TEST(test_incompressible);
+    TEST(test_long_lengths);
+    TEST(test_reference_block);
+    TEST(test_malformed);
+    TEST(test_payload_framing);
+    TEST(test_null_handling);
+
+    printf("\n");
+    printf("===========================================\n");
+    printf("  Results: %d/%d tests passed\n", tests_passed, tests_run);
+    printf("===========================================\n\n");
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
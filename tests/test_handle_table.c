@@ -0,0 +1,448 @@
+/**
+ * Ether Handle Table Test Suite
+ *
+ * Tests for the server-side handle -> block mapping.
+ *
+ * Copyright (C) 2024 - Licensed under GPL-3.0
+ */
+
+#include "handle_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =============================================================================
+// TEST UTILITIES
+// =============================================================================
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %-30s ", #name); \
+        fflush(stdout); \
+        tests_run++; \
+        name(); \
+        tests_passed++; \
+        printf("✓ PASSED\n"); \
+    } while(0)
+
+#define ASSERT(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("✗ FAILED\n"); \
+            printf("    Assertion failed: %s\n", #cond); \
+            printf("    At %s:%d\n", __FILE__, __LINE__); \
+            exit(1); \
+        } \
+    } while(0)
+
+// Any unique non-NULL address will do, the table never dereferences it
+static char g_blocks[16];
+
+// =============================================================================
+// TESTS
+// =============================================================================
+
+void test_insert_lookup(void) {
+    handle_table_t table;
+    ASSERT(handle_table_init(&table, 0, 0) == 0);
+
+    uint64_t h = handle_table_insert(&table, &g_blocks[0], 100);
+    ASSERT(h != 0);
+
+    size_t size = 0;
+    ASSERT(handle_table_lookup(&table, h, &size) == &g_blocks[0]);
+    ASSERT(size == 100);
+    ASSERT(handle_table_count(&table) == 1);
+
+    handle_table_destroy(&table);
+}
+
+void test_lookup_unknown(void) {
+    handle_table_t table;
+    ASSERT(handle_table_init(&table, 0, 0) == 0);
+
+    ASSERT(handle_table_lookup(&table, 0, NULL) == NULL);
+    ASSERT(handle_table_lookup(&table, 12345, NULL) == NULL);
+    ASSERT(handle_table_lookup(&table, 0xFFFFFFFFFFFFFFFFull, NULL) == NULL);
+    ASSERT(handle_table_remove(&table, 12345, NULL) == 0);
+
+    handle_table_destroy(&table);
+}
+
+void test_remove(void) {
+    handle_table_t table;
+    ASSERT(handle_table_init(&table, 0, 0) == 0);
+
+    uint64_t h = handle_table_insert(&table, &g_blocks[0], 10);
+    ASSERT(handle_table_remove(&table, h, NULL) == 1);
+    ASSERT(handle_table_lookup(&table, h, NULL) == NULL);
+    ASSERT(handle_table_count(&table) == 0);
+
+    // Double remove must fail
+    ASSERT(handle_table_remove(&table, h, NULL) == 0);
+
+    handle_table_destroy(&table);
+}
+
+void test_stale_handle(void) {
+    handle_table_t table;
+    ASSERT(handle_table_init(&table, 0, 0) == 0);
+
+    uint64_t old_h = handle_table_insert(&table, &g_blocks[0], 10);
+    handle_table_remove(&table, old_h, NULL);
+
+    // Slot is reused, but the old handle must not resolve to the new block
+    uint64_t new_h = handle_table_insert(&table, &g_blocks[1], 20);
+    ASSERT(new_h != old_h);
+    ASSERT(handle_table_lookup(&table, old_h, NULL) == NULL);
+    ASSERT(handle_table_remove(&table, old_h, NULL) == 0);
+    ASSERT(handle_table_lookup(&table, new_h, NULL) == &g_blocks[1]);
+
+    handle_table_destroy(&table);
+}
+
+void test_growth(void) {
+    handle_table_t table;
+    ASSERT(handle_table_init(&table, 0, 4) == 0);
+
+    enum { COUNT = 100000 };
+    uint64_t* handles = malloc(COUNT * sizeof(uint64_t));
+    ASSERT(handles != NULL);
+
+    for (int i = 0; i < COUNT; i++) {
+        handles[i] = handle_table_insert(&table, &g_blocks[i % 16], (size_t) i);
+        ASSERT(handles[i] != 0);
+    }
+    ASSERT(handle_table_count(&table) == COUNT);
+    ASSERT(table.capacity >= COUNT);
+
+    for (int i = 0; i < COUNT; i++) {
+        size_t size;
+        ASSERT(handle_table_lookup(&table, handles[i], &size) == &g_blocks[i % 16]);
+        ASSERT(size == (size_t) i);
+    }
+
+    for (int i = 0; i < COUNT; i += 2) {
+        ASSERT(handle_table_remove(&table, handles[i], NULL) == 1);
+    }
+    ASSERT(handle_table_count(&table) == COUNT / 2);
+
+    // Freed slots are recycled before the table grows again
+    uint32_t capacity = table.capacity;
+    for (int i = 0; i < COUNT / 2; i++) {
+        ASSERT(handle_table_insert(&table, &g_blocks[0], 1) != 0);
+    }
+    ASSERT(table.capacity == capacity);
+
+    free(handles);
+    handle_table_destroy(&table);
+}
+
+void test_remove_returns_block(void) {
+    handle_table_t table;
+    ASSERT(handle_table_init(&table, 0, 0) == 0);
+
+    uint64_t h = handle_table_insert(&table, &g_blocks[3], 10);
+    void* to_free = NULL;
+    ASSERT(handle_table_remove(&table, h, &to_free) == 1);
+    ASSERT(to_free == &g_blocks[3]);
+
+    handle_table_destroy(&table);
+}
+
+void test_pin_defers_free(void) {
+    handle_table_t table;
+    ASSERT(handle_table_init(&table, 0, 0) == 0);
+
+    uint64_t h = handle_table_insert(&table, &g_blocks[2], 10);
+    size_t size = 0;
+    ASSERT(handle_table_pin(&table, h, &size) == &g_blocks[2]);
+    ASSERT(size == 10);
+
+    // Removing a pinned handle invalidates it but keeps the block
+    void* to_free = &g_blocks[0];
+    ASSERT(handle_table_remove(&table, h, &to_free) == 1);
+    ASSERT(to_free == NULL);
+    ASSERT(handle_table_lookup(&table, h, NULL) == NULL);
+    ASSERT(handle_table_pin(&table, h, NULL) == NULL);
+    ASSERT(handle_table_count(&table) == 0);
+
+    // The slot is not recycled while pinned
+    uint64_t other = handle_table_insert(&table, &g_blocks[3], 1);
+    ASSERT((other & 0xFFFFFFFFu) != (h & 0xFFFFFFFFu));
+
+    // Last unpin hands the block back
+    ASSERT(handle_table_unpin(&table, h) == &g_blocks[2]);
+    ASSERT(handle_table_unpin(&table, h) == NULL);
+
+    handle_table_destroy(&table);
+}
+
+void test_pin_unpin_live(void) {
+    handle_table_t table;
+    ASSERT(handle_table_init(&table, 0, 0) == 0);
+
+    uint64_t h = handle_table_insert(&table, &g_blocks[1], 10);
+    ASSERT(handle_table_pin(&table, h, NULL) == &g_blocks[1]);
+    ASSERT(handle_table_pin(&table, h, NULL) == &g_blocks[1]);
+
+    // Unpinning a live handle never returns the block
+    ASSERT(handle_table_unpin(&table, h) == NULL);
+    ASSERT(handle_table_unpin(&table, h) == NULL);
+    ASSERT(handle_table_lookup(&table, h, NULL) == &g_blocks[1]);
+
+    void* to_free = NULL;
+    ASSERT(handle_table_remove(&table, h, &to_free) == 1);
+    ASSERT(to_free == &g_blocks[1]);
+
+    handle_table_destroy(&table);
+}
+
+void test_update(void) {
+    handle_table_t table;
+    ASSERT(handle_table_init(&table, 0, 0) == 0);
+
+    uint64_t h = handle_table_insert(&table, &g_blocks[0], 10);
+    ASSERT(handle_table_pinned(&table, h) == 0);
+
+    // Same handle, new block and size
+    ASSERT(handle_table_update(&table, h, &g_blocks[1], 20) == 1);
+    size_t size = 0;
+    ASSERT(handle_table_lookup(&table, h, &size) == &g_blocks[1]);
+    ASSERT(size == 20);
+    ASSERT(handle_table_count(&table) == 1);
+
+    ASSERT(handle_table_pin(&table, h, NULL) == &g_blocks[1]);
+    ASSERT(handle_table_pinned(&table, h) == 1);
+    ASSERT(handle_table_unpin(&table, h) == NULL);
+    ASSERT(handle_table_pinned(&table, h) == 0);
+
+    // Stale handles are neither updated nor reported pinned
+    void* to_free = NULL;
+    ASSERT(handle_table_remove(&table, h, &to_free) == 1);
+    ASSERT(handle_table_update(&table, h, &g_blocks[2], 30) == 0);
+    ASSERT(handle_table_pinned(&table, h) == 0);
+    ASSERT(handle_table_update(&table, 0, &g_blocks[2], 30) == 0);
+
+    handle_table_destroy(&table);
+}
+
+void test_shards(void) {
+    handle_table_t a, b;
+    ASSERT(handle_table_init(&a, 1, 0) == 0);
+    ASSERT(handle_table_init(&b, 200, 0) == 0);
+
+    uint64_t ha = handle_table_insert(&a, &g_blocks[0], 10);
+    uint64_t hb = handle_table_insert(&b, &g_blocks[1], 20);
+    ASSERT(handle_shard(ha) == 1);
+    ASSERT(handle_shard(hb) == 200);
+
+    // Same slot/generation, different shard: each table only accepts its own
+    ASSERT(handle_table_lookup(&a, hb, NULL) == NULL);
+    ASSERT(handle_table_lookup(&b, ha, NULL) == NULL);
+    ASSERT(handle_table_remove(&a, hb, NULL) == 0);
+    ASSERT(handle_table_lookup(&a, ha, NULL) == &g_blocks[0]);
+    ASSERT(handle_table_lookup(&b, hb, NULL) == &g_blocks[1]);
+
+    handle_table_destroy(&a);
+    handle_table_destroy(&b);
+}
+
+void test_null_handling(void) {
+    ASSERT(handle_table_init(NULL, 0, 0) == -1);
+    ASSERT(handle_table_insert(NULL, &g_blocks[0], 1) == 0);
+    ASSERT(handle_table_lookup(NULL, 1, NULL) == NULL);
+    ASSERT(handle_table_remove(NULL, 1, NULL) == 0);
+    ASSERT(handle_table_update(NULL, 1, &g_blocks[0], 1) == 0);
+    ASSERT(handle_table_pinned(NULL, 1) == 0);
+
+    handle_table_t table;
+    ASSERT(handle_table_init(&table, 0, 0) == 0);
+    ASSERT(handle_table_insert(&table, NULL, 1) == 0);
+    handle_table_destroy(&table);
+
+    // Should not crash
+    handle_table_destroy(NULL);
+}
+
+typedef struct {
+    size_t freed;   // Blocks handed back right away
+    size_t held;    // Still pinned
+    size_t bytes;
+} reclaim_t;
+
+static void reclaim_visit(void* to_free, size_t size, void* arg) {
+    reclaim_t* r = arg;
+    if (to_free) r->freed++;
+    else r->held++;
+    r->bytes += size;
+}
+
+void test_reclaim(void) {
+    handle_table_t table;
+    ASSERT(handle_table_init(&table, 0, 0) == 0);
+
+    int alice, bob;
+    uint64_t a1 = handle_table_insert(&table, &g_blocks[0], 10);
+    uint64_t b1 = handle_table_insert(&table, &g_blocks[1], 20);
+    uint64_t a2 = handle_table_insert(&table, &g_blocks[2], 30);
+    uint64_t none = handle_table_insert(&table, &g_blocks[3], 40);
+    ASSERT(handle_table_owner(&table, a1) == NULL);
+
+    ASSERT(handle_table_set_owner(&table, a1, &alice) == 1);
+    ASSERT(handle_table_set_owner(&table, a2, &alice) == 1);
+    ASSERT(handle_table_set_owner(&table, b1, &bob) == 1);
+    ASSERT(handle_table_owner(&table, a2) == &alice);
+    ASSERT(handle_table_owner(&table, b1) == &bob);
+
+    // A pinned block is removed too, but freed by its last unpin
+    ASSERT(handle_table_pin(&table, a2, NULL) == &g_blocks[2]);
+
+    reclaim_t r = { 0 };
+    ASSERT(handle_table_reclaim(&table, &alice, reclaim_visit, &r) == 2);
+    ASSERT(r.freed == 1 && r.held == 1 && r.bytes == 40);
+    ASSERT(handle_table_lookup(&table, a1, NULL) == NULL);
+    ASSERT(handle_table_lookup(&table, a2, NULL) == NULL);
+    ASSERT(handle_table_lookup(&table, b1, NULL) == &g_blocks[1]);
+    ASSERT(handle_table_lookup(&table, none, NULL) == &g_blocks[3]);
+    ASSERT(handle_table_count(&table) == 2);
+
+    // Nothing left of alice's; the pinned block comes back on unpin
+    ASSERT(handle_table_reclaim(&table, &alice, reclaim_visit, &r) == 0);
+    ASSERT(handle_table_unpin(&table, a2) == &g_blocks[2]);
+
+    // A recycled slot starts without an owner
+    uint64_t again = handle_table_insert(&table, &g_blocks[4], 1);
+    ASSERT(handle_table_owner(&table, again) == NULL);
+    ASSERT(handle_table_set_owner(&table, a1, &bob) == 0);   // Stale
+    ASSERT(handle_table_reclaim(&table, NULL, reclaim_visit, &r) == 0);
+
+    handle_table_destroy(&table);
+}
+
+void test_restore(void) {
+    handle_table_t old_table, table;
+    ASSERT(handle_table_init(&old_table, 3, 0) == 0);
+
+    // Handles of a previous run, a few slots freed and reused
+    uint64_t handles[2000];
+    for (int i = 0; i < 2000; i++) {
+        handles[i] = handle_table_insert(&old_table, &g_blocks[i % 16], (size_t) i);
+    }
+    for (int i = 0; i < 2000; i += 3) {
+        ASSERT(handle_table_remove(&old_table, handles[i], NULL) == 1);
+    }
+    uint64_t reused = handle_table_insert(&old_table, &g_blocks[0], 7);
+
+    // Restored out of order into a fresh table that has to grow
+    ASSERT(handle_table_init(&table, 3, 4) == 0);
+    for (int i = 1999; i >= 0; i--) {
+        if (i % 3 != 0) {
+            ASSERT(handle_table_restore(&table, handles[i], &g_blocks[i % 16], (size_t) i) == 1);
+        }
+    }
+    ASSERT(handle_table_restore(&table, reused, &g_blocks[0], 7) == 1);
+    handle_table_rebuild(&table, old_table.retired);
+
+    ASSERT(handle_table_count(&table) == handle_table_count(&old_table));
+    for (int i = 0; i < 2000; i++) {
+        size_t size;
+        if (i % 3 != 0) {
+            ASSERT(handle_table_lookup(&table, handles[i], &size) == &g_blocks[i % 16]);
+            ASSERT(size == (size_t) i);
+        } else if (handles[i] != reused) {
+            ASSERT(handle_table_lookup(&table, handles[i], NULL) == NULL);
+        }
+    }
+    ASSERT(handle_table_lookup(&table, reused, NULL) == &g_blocks[0]);
+
+    // Taken slots, other shards and generation 0 are refused
+    ASSERT(handle_table_restore(&table, handles[1], &g_blocks[1], 1) == 0);
+    ASSERT(handle_table_restore(&table, handles[1] ^ (1ull << HANDLE_SHARD_SHIFT), &g_blocks[1], 1) == 0);
+    ASSERT(handle_table_restore(&table, 5, &g_blocks[1], 1) == 0);
+
+    // Empty slots are reused, without reviving a stale handle
+    uint32_t used = table.used;
+    for (int i = 0; i < 2000 / 3; i++) {
+        uint64_t h = handle_table_insert(&table, &g_blocks[1], 1);
+        ASSERT(h != 0);
+        for (int j = 0; j < 2000; j += 3) {
+            ASSERT(h != handles[j]);
+        }
+    }
+    ASSERT(table.used == used);
+
+    handle_table_destroy(&old_table);
+    handle_table_destroy(&table);
+}
+
+void test_restore_retired(void) {
+    handle_table_t old_table, table;
+    ASSERT(handle_table_init(&old_table, 0, 0) == 0);
+
+    // Slot 0 went through several blocks, slot 1 kept its first one
+    uint64_t freed[5];
+    uint64_t live = 0;
+    for (int i = 0; i < 5; i++) {
+        freed[i] = handle_table_insert(&old_table, &g_blocks[0], 8);
+        if (i == 0) live = handle_table_insert(&old_table, &g_blocks[1], 8);
+        ASSERT(handle_table_remove(&old_table, freed[i], NULL) == 1);
+    }
+    ASSERT(live != 0 && old_table.retired == 5);
+
+    // Only slot 1's block survives: its generation (1) says nothing about
+    // how far slot 0 went, the retired mark does
+    ASSERT(handle_table_init(&table, 0, 0) == 0);
+    ASSERT(handle_table_restore(&table, live, &g_blocks[1], 8) == 1);
+    handle_table_rebuild(&table, old_table.retired);
+
+    for (int i = 0; i < 20; i++) {
+        uint64_t h = handle_table_insert(&table, &g_blocks[3], 8);
+        ASSERT(h != 0 && h != live);
+        for (int j = 0; j < 5; j++) {
+            ASSERT(h != freed[j]);
+        }
+    }
+    for (int j = 0; j < 5; j++) {
+        ASSERT(handle_table_lookup(&table, freed[j], NULL) == NULL);
+    }
+
+    handle_table_destroy(&old_table);
+    handle_table_destroy(&table);
+}
+
+// =============================================================================
+// MAIN
+// =============================================================================
+
+int main(void) {
+    printf("\n");
+    printf("===========================================\n");
+    printf("  Ether Handle Table Test Suite\n");
+    printf("===========================================\n\n");
+
+    TEST(test_insert_lookup);
+    TEST(test_lookup_unknown);
+    TEST(test_remove);
+    TEST(test_stale_handle);
+    TEST(test_growth);
+    TEST(test_remove_returns_block);
+    TEST(test_pin_defers_free);
+    TEST(test_pin_unpin_live);
+    TEST(test_update);
+    TEST(test_shards);
+    TEST(test_reclaim);
+    TEST(test_restore);
+    TEST(test_restore_retired);
+    TEST(test_null_handling);
+
+    printf("\n");
+    printf("===========================================\n");
+    printf("  Results: %d/%d tests passed\n", tests_passed, tests_run);
+    printf("===========================================\n\n");
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
@@ -0,0 +1,238 @@
+/**
+ * Ether Logging Test Suite
+ *
+ * Tests for levels, the synchronous fallback and the ring-buffer writer.
+ * stderr is redirected into a temporary file so output can be checked.
+ *
+ * Copyright (C) 2024 - Licensed under GPL-3.0
+ */
+
+#include "ether/log.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// =============================================================================
+// TEST UTILITIES
+// =============================================================================
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %-30s ", #name); \
+        fflush(stdout); \
+        tests_run++; \
+        name(); \
+        tests_passed++; \
+        printf("✓ PASSED\n"); \
+    } while(0)
+
+#define ASSERT(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("✗ FAILED\n"); \
+            printf("    Assertion failed: %s\n", #cond); \
+            printf("    At %s:%d\n", __FILE__, __LINE__); \
+            exit(1); \
+        } \
+    } while(0)
+
+static FILE *g_capture = NULL;   // Where stderr points during a test
+static int   g_saved_stderr = -1;
+
+/**
+ * Send stderr to a fresh temporary file
+ */
+static void capture_begin(void) {
+    g_capture = tmpfile();
+    ASSERT(g_capture != NULL);
+    g_saved_stderr = dup(STDERR_FILENO);
+    dup2(fileno(g_capture), STDERR_FILENO);
+}
+
+/**
+ * Restore stderr and return what was written (caller frees)
+ */
+static char *capture_end(void) {
+    dup2(g_saved_stderr, STDERR_FILENO);
+    close(g_saved_stderr);
+
+    off_t len = lseek(fileno(g_capture), 0, SEEK_END);
+    char *text = calloc(1, (size_t) len + 1);
+    ASSERT(text != NULL);
+    if (len > 0) {
+        ASSERT(pread(fileno(g_capture), text, (size_t) len, 0) == len);
+    }
+    fclose(g_capture);
+    return text;
+}
+
+static size_t count_lines(const char *text, const char *needle) {
+    size_t n = 0;
+    for (const char *p = strstr(text, needle); p; p = strstr(p + 1, needle)) {
+        n++;
+    }
+    return n;
+}
+
+// =============================================================================
+// TESTS
+// =============================================================================
+
+void test_parse_level(void) {
+    ASSERT(ether_log_parse_level("debug") == ETHER_LOG_DEBUG);
+    ASSERT(ether_log_parse_level("info") == ETHER_LOG_INFO);
+    ASSERT(ether_log_parse_level("warn") == ETHER_LOG_WARN);
+    ASSERT(ether_log_parse_level("error") == ETHER_LOG_ERROR);
+    ASSERT(ether_log_parse_level("off") == ETHER_LOG_OFF);
+    ASSERT(ether_log_parse_level("verbose") == -1);
+    ASSERT(ether_log_parse_level(NULL) == -1);
+}
+
+void test_default_level(void) {
+    // Per-request (DEBUG) events are silent by default
+    ASSERT(ether_log_get_level() == ETHER_LOG_INFO);
+    ASSERT(!ether_log_enabled(ETHER_LOG_DEBUG));
+    ASSERT(ether_log_enabled(ETHER_LOG_INFO));
+    ASSERT(ether_log_enabled(ETHER_LOG_ERROR));
+}
+
+void test_sync_filtering(void) {
+    capture_begin();
+    ether_log_debug("test", "hidden %d", 1);
+    ether_log_info("test", "shown %d", 2);
+    ether_log_set_level(ETHER_LOG_OFF);
+    ether_log_error("test", "hidden %d", 3);
+    ether_log_set_level(ETHER_LOG_DEBUG);
+    ether_log_debug("test", "shown %d", 4);
+    ether_log_set_level(ETHER_LOG_INFO);
+    char *text = capture_end();
+
+    ASSERT(count_lines(text, "hidden") == 0);
+    ASSERT(strstr(text, "INFO  [test] shown 2\n") != NULL);
+    ASSERT(strstr(text, "DEBUG [test] shown 4\n") != NULL);
+    ASSERT(count_lines(text, "\n") == 2);
+    free(text);
+}
+
+void test_truncation(void) {
+    char big[ETHER_LOG_MSG_MAX * 2];
+    memset(big, 'x', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+
+    capture_begin();
+    ether_log_warn("test", "%s", big);
+    char *text = capture_end();
+
+    // One line, message cut to ETHER_LOG_MSG_MAX - 1 characters + newline
+    ASSERT(count_lines(text, "\n") == 1);
+    const char *msg = strstr(text, "] ");
+    ASSERT(msg != NULL);
+    ASSERT(strlen(msg + 2) == ETHER_LOG_MSG_MAX);
+    free(text);
+}
+
+#define THREADS 4
+#define PER_THREAD 200
+
+static void *log_worker(void *arg) {
+    int id = (int) (long) arg;
+    for (int i = 0; i < PER_THREAD; i++) {
+        ether_log_info("worker", "thread=%d seq=%d", id, i);
+    }
+    return NULL;
+}
+
+void test_async_writer(void) {
+    capture_begin();
+    ASSERT(ether_log_start() == 0);
+    ASSERT(ether_log_start() == 0);   // Already running
+
+    pthread_t threads[THREADS];
+    for (long t = 0; t < THREADS; t++) {
+        ASSERT(pthread_create(&threads[t], NULL, log_worker, (void *) t) == 0);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    ether_log_stop();
+    char *text = capture_end();
+
+    // Nothing dropped at this rate: every line arrives exactly once, and
+    // each thread's lines stay in order
+    size_t dropped = ether_log_dropped();
+    ASSERT(count_lines(text, "[worker]") + dropped == THREADS * PER_THREAD);
+    if (dropped == 0) {
+        for (int t = 0; t < THREADS; t++) {
+            const char *prev = text;
+            for (int i = 0; i < PER_THREAD; i += 37) {
+                char needle[64];
+                snprintf(needle, sizeof(needle), "thread=%d seq=%d\n", t, i);
+                const char *at = strstr(text, needle);
+                ASSERT(at != NULL && at >= prev);
+                prev = at;
+            }
+        }
+    }
+    free(text);
+}
+
+static void *log_burst(void *arg) {
+    (void) arg;
+    for (int i = 0; i < 100000; i++) {
+        ether_log_info("burst", "%d", i);
+    }
+    return NULL;
+}
+
+void test_overflow_drops(void) {
+    capture_begin();
+    size_t before = ether_log_dropped();
+    ASSERT(ether_log_start() == 0);
+
+    // A burst far larger than one ring: the producer never blocks,
+    // the overflow is counted and reported
+    pthread_t thread;
+    ASSERT(pthread_create(&thread, NULL, log_burst, NULL) == 0);
+    pthread_join(thread, NULL);
+
+    ether_log_stop();
+    char *text = capture_end();
+
+    size_t dropped = ether_log_dropped() - before;
+    ASSERT(count_lines(text, "[burst]") + dropped == 100000);
+    if (dropped > 0) {
+        ASSERT(strstr(text, "messages dropped") != NULL);
+    }
+    free(text);
+}
+
+// =============================================================================
+// MAIN
+// =============================================================================
+
+int main(void) {
+    printf("\n");
+    printf("===========================================\n");
+    printf("  Ether Logging Test Suite\n");
+    printf("===========================================\n\n");
+
+    TEST(test_parse_level);
+    TEST(test_default_level);
+    TEST(test_sync_filtering);
+    TEST(test_truncation);
+    TEST(test_async_writer);
+    TEST(test_overflow_drops);
+
+    printf("\n");
+    printf("===========================================\n");
+    printf("  Results: %d/%d tests passed\n", tests_passed, tests_run);
+    printf("===========================================\n\n");
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+/**
+ * Ether Metrics Test Suite
+ *
+ * Tests for the server-side request histograms.
+ *
+ * Copyright (C) 2024 - Licensed under GPL-3.0
+ */
+
+#include "metrics.h"
+#include "ether/protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =============================================================================
+// TEST UTILITIES
+// =============================================================================
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %-30s ", #name); \
+        fflush(stdout); \
+        tests_run++; \
+        name(); \
+        tests_passed++; \
+        printf("✓ PASSED\n"); \
+    } while(0)
+
+#define ASSERT(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("✗ FAILED\n"); \
+            printf("    Assertion failed: %s\n", #cond); \
+            printf("    At %s:%d\n", __FILE__, __LINE__); \
+            exit(1); \
+        } \
+    } while(0)
+
+// =============================================================================
+// TESTS
+// =============================================================================
+
+void test_bucket_bounds(void) {
+    // Every value falls in a bucket whose range contains it, and buckets
+    // are ordered
+    uint64_t prev_max = 0;
+    for (unsigned b = 0; b < METRICS_BUCKETS - 1; b++) {
+        uint64_t max = metrics_bucket_max(b);
+        ASSERT(b == 0 || max > prev_max);
+        ASSERT(metrics_bucket(max) == b);
+        ASSERT(metrics_bucket(max + 1) == b + 1);
+        prev_max = max;
+    }
+
+    ASSERT(metrics_bucket(0) == 0);
+    ASSERT(metrics_bucket(7) == 7);
+    ASSERT(metrics_bucket(UINT64_MAX) == METRICS_BUCKETS - 1);
+}
+
+void test_bucket_precision(void) {
+    // Upper bound of a value's bucket is within 12.5% of the value
+    for (uint64_t v = 8; v < (1ull << 36); v = v * 5 / 4 + 3) {
+        uint64_t max = metrics_bucket_max(metrics_bucket(v));
+        ASSERT(max >= v);
+        ASSERT(max - v <= v / METRICS_SUB_BUCKETS);
+    }
+}
+
+void test_record_and_percentiles(void) {
+    metrics_t *m = calloc(1, sizeof(metrics_t));
+    ASSERT(m != NULL);
+
+    // 1..10000 ns, uniform
+    for (uint64_t ns = 1; ns <= 10000; ns++) {
+        metrics_record(m, METRIC_READ, ns, 8, 4096, ns % 100 == 0);
+    }
+
+    metrics_snapshot_t snap[METRIC_NUM_CMDS];
+    memset(snap, 0, sizeof(snap));
+    metrics_merge(snap, m);
+
+    const metrics_snapshot_t *r = &snap[METRIC_READ];
+    ASSERT(r->count == 10000);
+    ASSERT(r->errors == 100);
+    ASSERT(r->bytes_in == 80000);
+    ASSERT(r->bytes_out == 10000ull * 4096);
+    ASSERT(r->latency_sum == 10000ull * 10001 / 2);
+
+    uint64_t p50 = metrics_percentile(r, 0.50);
+    uint64_t p99 = metrics_percentile(r, 0.99);
+    uint64_t p999 = metrics_percentile(r, 0.999);
+    ASSERT(p50 >= 5000 && p50 <= 5000 + 5000 / 8);
+    ASSERT(p99 >= 9900 && p99 <= 9900 + 9900 / 8);
+    ASSERT(p999 >= 9990 && p999 <= 9990 + 9990 / 8);
+    ASSERT(p50 <= p99 && p99 <= p999);
+
+    // Untouched commands stay empty
+    ASSERT(snap[METRIC_ALLOC].count == 0);
+    ASSERT(metrics_percentile(&snap[METRIC_ALLOC], 0.99) == 0);
+
+    free(m);
+}
+
+void test_merge_workers(void) {
+    metrics_t *a = calloc(1, sizeof(metrics_t));
+    metrics_t *b = calloc(1, sizeof(metrics_t));
+    ASSERT(a != NULL && b != NULL);
+
+    for (int i = 0; i < 990; i++) metrics_record(a, METRIC_ALLOC, 100, 0, 0, 0);
+    for (int i = 0; i < 10; i++) metrics_record(b, METRIC_ALLOC, 1000000, 0, 0, 1);
+
+    metrics_snapshot_t snap[METRIC_NUM_CMDS];
+    memset(snap, 0, sizeof(snap));
+    metrics_merge(snap, a);
+    metrics_merge(snap, b);
+
+    // The slow 1% only shows from p99 up
+    ASSERT(snap[METRIC_ALLOC].count == 1000);
+    ASSERT(snap[METRIC_ALLOC].errors == 10);
+    ASSERT(metrics_percentile(&snap[METRIC_ALLOC], 0.50) < 128);
+    ASSERT(metrics_percentile(&snap[METRIC_ALLOC], 0.999) >= 1000000);
+
+    free(a);
+    free(b);
+}
+
+void test_command_classes(void) {
+    for (int c = 0; c < METRIC_NUM_CMDS; c++) {
+        ASSERT(metric_name((metric_cmd_t) c) != NULL);
+        if (c != METRIC_OTHER) {
+            ASSERT(metric_cmd(metric_wire_cmd((metric_cmd_t) c)) == (metric_cmd_t) c);
+        }
+    }
+    ASSERT(metric_cmd(ETHER_CMD_WRITE) == METRIC_WRITE);
+    ASSERT(metric_cmd(0xEE) == METRIC_OTHER);
+    ASSERT(strcmp(metric_name(METRIC_STATS), "stats") == 0);
+}
+
+void test_null_handling(void) {
+    metrics_record(NULL, METRIC_READ, 1, 0, 0, 0);
+    metrics_merge(NULL, NULL);
+    ASSERT(metrics_percentile(NULL, 0.5) == 0);
+}
+
+// =============================================================================
+// MAIN
+// =============================================================================
+
+int main(void) {
+    printf("\n");
+    printf("===========================================\n");
+    printf("  Ether Metrics Test Suite\n");
+    printf("===========================================\n\n");
+
+    TEST(test_bucket_bounds);
+    TEST(test_bucket_precision);
+    TEST(test_record_and_percentiles);
+    TEST(test_merge_workers);
+    TEST(test_command_classes);
+    TEST(test_null_handling);
+
+    printf("\n");
+    printf("===========================================\n");
+    printf("  Results: %d/%d tests passed\n", tests_passed, tests_run);
+    printf("===========================================\n\n");
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
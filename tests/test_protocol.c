@@ -71,6 +71,8 @@ void test_msg_validate(void) {
     // Valid header
     header.magic = ETHER_MAGIC;
     header.version = ETHER_PROTOCOL_VER;
+    header.command = ETHER_CMD_WRITE;
+    header.flags = 0;
     header.size = 0;
     ASSERT(ether_msg_validate(&header) == 1);
 
@@ -87,6 +89,12 @@ void test_msg_validate(void) {
     header.version = ETHER_PROTOCOL_VER;
     header.size = ETHER_MAX_PAYLOAD + 1;
     ASSERT(ether_msg_validate(&header) == 0);
+
+    // ALLOC/READ sizes are parameters, not payload: large blocks are fine
+    header.command = ETHER_CMD_ALLOC;
+    ASSERT(ether_msg_validate(&header) == 1);
+    header.command = ETHER_CMD_READ;
+    ASSERT(ether_msg_validate(&header) == 1);
 }
 
 void test_serialization_roundtrip(void) {
@@ -119,8 +127,10 @@ void test_serialization_roundtrip(void) {
 void test_all_commands(void) {
     ether_cmd_t cmds[] = {
         ETHER_CMD_PING, ETHER_CMD_PONG,
-        ETHER_CMD_ALLOC, ETHER_CMD_FREE, ETHER_CMD_REALLOC,
-        ETHER_CMD_WRITE, ETHER_CMD_READ,
+        ETHER_CMD_ALLOC, ETHER_CMD_FREE, ETHER_CMD_REALLOC, ETHER_CMD_SHARE,
+        ETHER_CMD_WRITE, ETHER_CMD_READ, ETHER_CMD_COPY, ETHER_CMD_FILL,
+        ETHER_CMD_CMP, ETHER_CMD_CHECKSUM, ETHER_CMD_BATCH, ETHER_CMD_STATS,
+        ETHER_CMD_MEMINFO,
         ETHER_CMD_OK, ETHER_CMD_ERROR
     };
 
@@ -150,6 +160,14 @@ void test_cmd_to_string(void) {
     ASSERT(ether_cmd_to_string(ETHER_CMD_FREE) != NULL);
     ASSERT(ether_cmd_to_string(ETHER_CMD_WRITE) != NULL);
     ASSERT(ether_cmd_to_string(ETHER_CMD_READ) != NULL);
+    ASSERT(strcmp(ether_cmd_to_string(ETHER_CMD_SHARE), "SHARE") == 0);
+    ASSERT(strcmp(ether_cmd_to_string(ETHER_CMD_COPY), "COPY") == 0);
+    ASSERT(strcmp(ether_cmd_to_string(ETHER_CMD_FILL), "FILL") == 0);
+    ASSERT(strcmp(ether_cmd_to_string(ETHER_CMD_CMP), "CMP") == 0);
+    ASSERT(strcmp(ether_cmd_to_string(ETHER_CMD_CHECKSUM), "CHECKSUM") == 0);
+    ASSERT(strcmp(ether_cmd_to_string(ETHER_CMD_BATCH), "BATCH") == 0);
+    ASSERT(strcmp(ether_cmd_to_string(ETHER_CMD_STATS), "STATS") == 0);
+    ASSERT(strcmp(ether_cmd_to_string(ETHER_CMD_MEMINFO), "MEMINFO") == 0);
     ASSERT(ether_cmd_to_string(ETHER_CMD_OK) != NULL);
     ASSERT(ether_cmd_to_string(ETHER_CMD_ERROR) != NULL);
 
@@ -157,6 +175,243 @@ void test_cmd_to_string(void) {
     ASSERT(ether_cmd_to_string(0x99) != NULL);
 }
 
+void test_payload_size(void) {
+    ether_msg_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.size = 4096;
+
+    // size is a parameter for these requests, nothing follows the header
+    header.command = ETHER_CMD_ALLOC;
+    ASSERT(ether_msg_payload_size(&header) == 0);
+    header.command = ETHER_CMD_READ;
+    ASSERT(ether_msg_payload_size(&header) == 0);
+    header.command = ETHER_CMD_REALLOC;
+    ASSERT(ether_msg_payload_size(&header) == 0);
+
+    // ...while for these it is the payload length
+    header.command = ETHER_CMD_WRITE;
+    ASSERT(ether_msg_payload_size(&header) == 4096);
+    header.command = ETHER_CMD_FILL;
+    ASSERT(ether_msg_payload_size(&header) == 4096);
+    header.command = ETHER_CMD_OK;
+    ASSERT(ether_msg_payload_size(&header) == 4096);
+
+    // Ranged READ: only the offset prefix follows
+    header.flags = ETHER_FLAG_OFFSET;
+    header.command = ETHER_CMD_READ;
+    ASSERT(ether_msg_payload_size(&header) == ETHER_OFFSET_SIZE);
+    header.command = ETHER_CMD_WRITE;
+    ASSERT(ether_msg_payload_size(&header) == 4096);
+
+    ASSERT(ether_msg_payload_size(NULL) == 0);
+}
+
+void test_offset_roundtrip(void) {
+    uint8_t buffer[ETHER_OFFSET_SIZE];
+    ether_msg_serialize_offset(0x0102030405060708ull, buffer);
+    ASSERT(buffer[0] == 0x01 && buffer[7] == 0x08);
+    ASSERT(ether_msg_deserialize_offset(buffer) == 0x0102030405060708ull);
+
+    ether_msg_serialize_offset(0, buffer);
+    ASSERT(ether_msg_deserialize_offset(buffer) == 0);
+}
+
+void test_batch_record_roundtrip(void) {
+    ether_batch_record_t original = {
+        .command = ETHER_CMD_WRITE,
+        .flags = ETHER_BATCH_REF,
+        .size = 0xCAFEBABE,
+        .handle = 0x0123456789ABCDEFull,
+    };
+
+    uint8_t buffer[ETHER_BATCH_RECORD_SIZE];
+    ether_batch_record_serialize(&original, buffer);
+
+    // Network byte order on the wire
+    ASSERT(buffer[0] == ETHER_CMD_WRITE);
+    ASSERT(buffer[1] == ETHER_BATCH_REF);
+    ASSERT(buffer[4] == 0xCA && buffer[7] == 0xBE);
+    ASSERT(buffer[8] == 0x01 && buffer[15] == 0xEF);
+
+    ether_batch_record_t decoded;
+    ether_batch_record_deserialize(buffer, &decoded);
+    ASSERT(decoded.command == original.command);
+    ASSERT(decoded.flags == original.flags);
+    ASSERT(decoded.size == original.size);
+    ASSERT(decoded.handle == original.handle);
+}
+
+void test_stats_record_roundtrip(void) {
+    ether_stats_record_t original = {
+        .command = ETHER_CMD_READ,
+        .count = 0x0102030405060708ull,
+        .errors = 7,
+        .bytes_in = 1ull << 40,
+        .bytes_out = 0xFFFFFFFFFFFFFFFFull,
+        .p50_ns = 1500,
+        .p99_ns = 80000,
+        .p999_ns = 2000000,
+    };
+
+    uint8_t buffer[ETHER_STATS_RECORD_SIZE];
+    memset(buffer, 0xAA, sizeof(buffer));
+    ether_stats_record_serialize(&original, buffer);
+
+    // Network byte order, reserved bytes zeroed
+    ASSERT(buffer[0] == ETHER_CMD_READ);
+    ASSERT(buffer[1] == 0 && buffer[7] == 0);
+    ASSERT(buffer[8] == 0x01 && buffer[15] == 0x08);
+
+    ether_stats_record_t decoded;
+    ether_stats_record_deserialize(buffer, &decoded);
+    ASSERT(decoded.count == original.count);
+    ASSERT(decoded.command == original.command);
+    ASSERT(decoded.errors == original.errors);
+    ASSERT(decoded.bytes_in == original.bytes_in);
+    ASSERT(decoded.bytes_out == original.bytes_out);
+    ASSERT(decoded.p50_ns == original.p50_ns);
+    ASSERT(decoded.p99_ns == original.p99_ns);
+    ASSERT(decoded.p999_ns == original.p999_ns);
+}
+
+void test_meminfo_record_roundtrip(void) {
+    ether_meminfo_record_t original = {
+        .used = 0x0102030405060708ull,
+        .peak = 1ull << 40,
+        .available = 0xFFFFFFFFFFFFFFFFull,
+        .blocks = 42,
+    };
+
+    uint8_t buffer[ETHER_MEMINFO_RECORD_SIZE];
+    ether_meminfo_record_serialize(&original, buffer);
+    ASSERT(buffer[0] == 0x01 && buffer[7] == 0x08);
+    ASSERT(buffer[31] == 42);
+
+    ether_meminfo_record_t decoded;
+    ether_meminfo_record_deserialize(buffer, &decoded);
+    ASSERT(decoded.used == original.used);
+    ASSERT(decoded.peak == original.peak);
+    ASSERT(decoded.available == original.available);
+    ASSERT(decoded.blocks == original.blocks);
+}
+
+void test_bulk_record_roundtrip(void) {
+    ether_bulk_record_t original = {
+        .offset = 0x0102030405060708ull,
+        .length = 1ull << 33,
+        .handle = 0xAB00000100000002ull,
+        .offset2 = 4096,
+    };
+
+    uint8_t buffer[ETHER_BULK_RECORD_SIZE];
+    ether_bulk_record_serialize(&original, buffer);
+
+    // Network byte order
+    ASSERT(buffer[0] == 0x01 && buffer[7] == 0x08);
+    ASSERT(buffer[16] == 0xAB && buffer[23] == 0x02);
+
+    ether_bulk_record_t decoded;
+    ether_bulk_record_deserialize(buffer, &decoded);
+    ASSERT(decoded.offset == original.offset);
+    ASSERT(decoded.length == original.length);
+    ASSERT(decoded.handle == original.handle);
+    ASSERT(decoded.offset2 == original.offset2);
+}
+
+void test_checksum(void) {
+    uint8_t data[1000];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t) (i * 7 + 3);
+    }
+
+    // Deterministic, and covers every length class (stripes, words, bytes)
+    uint64_t sum = ether_checksum(data, sizeof(data));
+    ASSERT(sum == ether_checksum(data, sizeof(data)));
+    ASSERT(ether_checksum(NULL, 0) == ether_checksum(data, 0));
+
+    // Any single changed byte changes the sum, wherever it is
+    size_t probes[] = { 0, 31, 32, 500, 995, 999 };
+    for (size_t i = 0; i < sizeof(probes) / sizeof(probes[0]); i++) {
+        data[probes[i]] ^= 0x01;
+        ASSERT(ether_checksum(data, sizeof(data)) != sum);
+        data[probes[i]] ^= 0x01;
+    }
+
+    // Length is part of the sum: trailing zeros are not ignored
+    uint8_t zeros[64] = {0};
+    ASSERT(ether_checksum(zeros, 63) != ether_checksum(zeros, 64));
+    ASSERT(ether_checksum(zeros, 7) != ether_checksum(zeros, 8));
+
+    // Same bytes at a different address give the same sum
+    uint8_t copy[sizeof(data) + 1];
+    memcpy(copy + 1, data, sizeof(data));
+    ASSERT(ether_checksum(copy + 1, sizeof(data)) == sum);
+}
+
+void test_buf_pool_reuse(void) {
+    ether_buf_pool_t pool;
+    ether_buf_pool_init(&pool);
+
+    // Sizes round up to a power of two, 64 bytes minimum
+    ASSERT(ether_buf_capacity(1) == ETHER_POOL_MIN_BUFFER);
+    ASSERT(ether_buf_capacity(65) == 128);
+    ASSERT(ether_buf_capacity(4096) == 4096);
+    ASSERT(ether_buf_capacity(ETHER_POOL_MAX_BUFFER) == ETHER_POOL_MAX_BUFFER);
+    ASSERT(ether_buf_capacity(ETHER_POOL_MAX_BUFFER + 1) == ETHER_POOL_MAX_BUFFER + 1);
+
+    uint8_t* a = ether_buf_get(&pool, 1000);
+    ASSERT(a != NULL);
+    memset(a, 0x5A, ether_buf_capacity(1000));
+    ether_buf_put(&pool, a, 1000);
+
+    // Any size of the same class gets the recycled buffer back
+    uint8_t* b = ether_buf_get(&pool, 600);
+    ASSERT(b == a);
+    ASSERT(pool.hits == 1 && pool.misses == 1);
+
+    // Other classes do not share it
+    uint8_t* c = ether_buf_get(&pool, 100);
+    ASSERT(c != NULL && c != a);
+    ether_buf_put(&pool, b, 600);
+    ether_buf_put(&pool, c, 100);
+
+    ether_buf_pool_destroy(&pool);
+}
+
+void test_buf_pool_limits(void) {
+    ether_buf_pool_t pool;
+    ether_buf_pool_init(&pool);
+
+    // Each class keeps at most ETHER_POOL_DEPTH buffers
+    void* bufs[ETHER_POOL_DEPTH + 2];
+    for (int i = 0; i < ETHER_POOL_DEPTH + 2; i++) {
+        bufs[i] = ether_buf_get(&pool, 256);
+        ASSERT(bufs[i] != NULL);
+    }
+    for (int i = 0; i < ETHER_POOL_DEPTH + 2; i++) {
+        ether_buf_put(&pool, bufs[i], 256);
+    }
+    ASSERT(pool.count[2] == ETHER_POOL_DEPTH);
+
+    // Oversized buffers are never kept
+    void* big = ether_buf_get(&pool, ETHER_POOL_MAX_BUFFER * 2);
+    ASSERT(big != NULL);
+    ether_buf_put(&pool, big, ETHER_POOL_MAX_BUFFER * 2);
+    uint64_t misses = pool.misses;
+    big = ether_buf_get(&pool, ETHER_POOL_MAX_BUFFER * 2);
+    ASSERT(pool.misses == misses + 1);
+    ether_buf_put(&pool, big, ETHER_POOL_MAX_BUFFER * 2);
+
+    ether_buf_pool_destroy(&pool);
+    ASSERT(pool.count[2] == 0);
+
+    // Without a pool: plain malloc/free
+    void* p = ether_buf_get(NULL, 10);
+    ASSERT(p != NULL);
+    ether_buf_put(NULL, p, 10);
+    ether_buf_put(&pool, NULL, 10);
+}
+
 void test_header_size(void) {
     // Header should be exactly 24 bytes
     ASSERT(ETHER_HEADER_SIZE == 24);
@@ -191,6 +446,15 @@ int main(void) {
     TEST(test_all_commands);
     TEST(test_total_size);
     TEST(test_cmd_to_string);
+    TEST(test_payload_size);
+    TEST(test_offset_roundtrip);
+    TEST(test_batch_record_roundtrip);
+    TEST(test_stats_record_roundtrip);
+    TEST(test_meminfo_record_roundtrip);
+    TEST(test_bulk_record_roundtrip);
+    TEST(test_checksum);
+    TEST(test_buf_pool_reuse);
+    TEST(test_buf_pool_limits);
     TEST(test_header_size);
     TEST(test_null_handling);
 
@@ -0,0 +1,246 @@
+/**
+ * Ether Remote Mapping Test Suite
+ *
+ * Tests for ether_rmap(): pages fetched on first touch, and modified
+ * pages found and written back by ether_rmsync() / ether_runmap().
+ * Runs against an etherd started by the suite (path given as argv[1]).
+ * Skipped (passing) where userfaultfd is not permitted.
+ *
+ * Copyright (C) 2024 - Licensed under GPL-3.0
+ */
+
+#include "ether/client.h"
+#include "ether/ether.h"
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+// =============================================================================
+// TEST UTILITIES
+// =============================================================================
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %-30s ", #name); \
+        fflush(stdout); \
+        tests_run++; \
+        name(); \
+        tests_passed++; \
+        printf("✓ PASSED\n"); \
+    } while(0)
+
+#define ASSERT(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("✗ FAILED\n"); \
+            printf("    Assertion failed: %s\n", #cond); \
+            printf("    At %s:%d\n", __FILE__, __LINE__); \
+            exit(1); \
+        } \
+    } while(0)
+
+#define PAGE      4096
+#define NUM_PAGES 4
+
+static ether_conn_t* g_conn;
+static pid_t g_server = -1;
+
+/**
+ * A port nothing listens on right now
+ */
+static int free_port(void) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        getsockname(fd, (struct sockaddr*)&addr, &len) != 0) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    close(fd);
+    return ntohs(addr.sin_port);
+}
+
+static void stop_server(void) {
+    if (g_server > 0) {
+        kill(g_server, SIGTERM);
+        waitpid(g_server, NULL, 0);
+        g_server = -1;
+    }
+}
+
+/**
+ * Start etherd and connect to it (retrying while it comes up)
+ */
+static ether_conn_t* start_server(const char* etherd) {
+    int port = free_port();
+    if (port < 0) return NULL;
+
+    g_server = fork();
+    if (g_server == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDOUT_FILENO);
+            dup2(null_fd, STDERR_FILENO);
+        }
+        char arg[16];
+        snprintf(arg, sizeof(arg), "%d", port);
+        execl(etherd, etherd, arg, (char*)NULL);
+        _exit(127);
+    }
+    if (g_server < 0) return NULL;
+    atexit(stop_server);   // Also when an ASSERT fails
+
+    for (int i = 0; i < 200; i++) {
+        ether_conn_t* conn = ether_connect("127.0.0.1", port);
+        if (conn) return conn;
+        usleep(10 * 1000);
+    }
+    return NULL;
+}
+
+/**
+ * Block of NUM_PAGES pages of doubles 0, 1, 2, ... on the server
+ */
+static double* new_block(void) {
+    double* block = ether_rmalloc(g_conn, NUM_PAGES * PAGE);
+    ASSERT(block != NULL);
+
+    double values[NUM_PAGES * PAGE / sizeof(double)];
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        values[i] = (double)i;
+    }
+    ASSERT(ether_rwrite(g_conn, block, values, sizeof(values)) == ETHER_OK);
+    return block;
+}
+
+static double remote_value(double* block, size_t index) {
+    double value;
+    ASSERT(ether_rread_at(g_conn, block, index * sizeof(double), &value,
+                          sizeof(value)) == ETHER_OK);
+    return value;
+}
+
+// =============================================================================
+// TESTS
+// =============================================================================
+
+void test_fetch_on_touch(void) {
+    double* block = new_block();
+    double* map = ether_rmap(g_conn, block);
+    ASSERT(map != NULL);
+
+    ASSERT(map[0] == 0.0);
+    ASSERT(map[NUM_PAGES * PAGE / sizeof(double) - 1] ==
+           (double)(NUM_PAGES * PAGE / sizeof(double) - 1));
+
+    // Nothing changed: write-back sends nothing and succeeds
+    ASSERT(ether_rmsync(g_conn, map) == ETHER_OK);
+    ASSERT(ether_runmap(g_conn, map) == ETHER_OK);
+    ether_rfree(g_conn, block);
+}
+
+void test_sign_bits(void) {
+    double* block = new_block();
+    double* map = ether_rmap(g_conn, block);
+    ASSERT(map != NULL);
+
+    // Two changes confined to bit 63 of two words of one page
+    size_t a = PAGE / sizeof(double) + 3;
+    size_t b = PAGE / sizeof(double) + 100;
+    ASSERT(map[a] == (double)a && map[b] == (double)b);
+    map[a] = -map[a];
+    map[b] = -map[b];
+    ASSERT(ether_rmsync(g_conn, map) == ETHER_OK);
+    ASSERT(remote_value(block, a) == -(double)a);
+    ASSERT(remote_value(block, b) == -(double)b);
+
+    // ...and back again: the page is compared with what was written back
+    map[a] = -map[a];
+    map[b] = -map[b];
+    ASSERT(ether_runmap(g_conn, map) == ETHER_OK);
+    ASSERT(remote_value(block, a) == (double)a);
+    ASSERT(remote_value(block, b) == (double)b);
+
+    ether_rfree(g_conn, block);
+}
+
+void test_untouched_pages(void) {
+    double* block = new_block();
+    double* map = ether_rmap(g_conn, block);
+    ASSERT(map != NULL);
+
+    // Changing the server behind the mapping: pages never fetched are
+    // never written back over it
+    size_t last = NUM_PAGES * PAGE / sizeof(double) - 1;
+    double value = 42.0;
+    ASSERT(ether_rwrite_at(g_conn, block, last * sizeof(double), &value,
+                           sizeof(value)) == ETHER_OK);
+
+    map[0] = 7.0;
+    ASSERT(ether_runmap(g_conn, map) == ETHER_OK);
+    ASSERT(remote_value(block, 0) == 7.0);
+    ASSERT(remote_value(block, last) == 42.0);
+
+    ether_rfree(g_conn, block);
+}
+
+// =============================================================================
+// MAIN
+// =============================================================================
+
+int main(int argc, char** argv) {
+    printf("\n");
+    printf("===========================================\n");
+    printf("  Ether Remote Mapping Test Suite\n");
+    printf("===========================================\n\n");
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s path/to/etherd\n", argv[0]);
+        return 1;
+    }
+
+    g_conn = start_server(argv[1]);
+    if (!g_conn) {
+        printf("  Cannot start %s\n", argv[1]);
+        stop_server();
+        return 1;
+    }
+
+    double* probe = ether_rmalloc(g_conn, PAGE);
+    void* map = probe ? ether_rmap(g_conn, probe) : NULL;
+    if (!map) {
+        printf("  userfaultfd unavailable, skipping\n\n");
+        ether_disconnect(g_conn);
+        stop_server();
+        return 0;
+    }
+    ether_runmap(g_conn, map);
+    ether_rfree(g_conn, probe);
+
+    TEST(test_fetch_on_touch);
+    TEST(test_sign_bits);
+    TEST(test_untouched_pages);
+
+    ether_disconnect(g_conn);
+    stop_server();
+
+    printf("\n");
+    printf("===========================================\n");
+    printf("  Results: %d/%d tests passed\n", tests_passed, tests_run);
+    printf("===========================================\n\n");
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+/**
+ * Ether io_uring Ring Test Suite
+ *
+ * Tests for the minimal io_uring wrapper behind etherd --io uring.
+ * Skipped (passing) where the kernel has io_uring missing or disabled.
+ *
+ * Copyright (C) 2024 - Licensed under GPL-3.0
+ */
+
+#include "uring.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// =============================================================================
+// TEST UTILITIES
+// =============================================================================
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) \
+    do { \
+        printf("  Testing: %-30s ", #name); \
+        fflush(stdout); \
+        tests_run++; \
+        name(); \
+        tests_passed++; \
+        printf("✓ PASSED\n"); \
+    } while(0)
+
+#define ASSERT(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("✗ FAILED\n"); \
+            printf("    Assertion failed: %s\n", #cond); \
+            printf("    At %s:%d\n", __FILE__, __LINE__); \
+            exit(1); \
+        } \
+    } while(0)
+
+/**
+ * Wait for the next completion and take it off the ring
+ */
+static struct io_uring_cqe next_cqe(uring_t *ring) {
+    struct io_uring_cqe *cqe;
+    while ((cqe = uring_peek(ring)) == NULL) {
+        int ret = uring_submit(ring, 1);
+        ASSERT(ret >= 0 || ret == -EINTR);
+    }
+
+    struct io_uring_cqe copy = *cqe;
+    uring_seen(ring);
+    return copy;
+}
+
+// =============================================================================
+// TESTS
+// =============================================================================
+
+void test_nop(void) {
+    uring_t ring;
+    ASSERT(uring_init(&ring, 8) == 0);
+    ASSERT(ring.fd >= 0 && ring.sq_entries == 8);
+
+    struct io_uring_sqe *sqe = uring_get_sqe(&ring);
+    ASSERT(sqe != NULL);
+    sqe->opcode = IORING_OP_NOP;
+    sqe->user_data = 42;
+
+    ASSERT(uring_peek(&ring) == NULL);
+    struct io_uring_cqe cqe = next_cqe(&ring);
+    ASSERT(cqe.user_data == 42 && cqe.res == 0);
+    ASSERT(uring_peek(&ring) == NULL);
+
+    uring_destroy(&ring);
+    ASSERT(ring.fd == -1);
+    uring_destroy(&ring);   // Second destroy is a no-op
+}
+
+void test_full_queue(void) {
+    uring_t ring;
+    ASSERT(uring_init(&ring, 4) == 0);
+
+    // More SQEs than the queue holds: the full queue is submitted first
+    for (uint64_t i = 0; i < 10; i++) {
+        struct io_uring_sqe *sqe = uring_get_sqe(&ring);
+        ASSERT(sqe != NULL);
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = i;
+    }
+
+    // Completions come back in submission order, each exactly once
+    for (uint64_t i = 0; i < 10; i++) {
+        struct io_uring_cqe cqe = next_cqe(&ring);
+        ASSERT(cqe.user_data == i);
+    }
+    ASSERT(uring_submit(&ring, 0) == 0);
+    ASSERT(uring_peek(&ring) == NULL);
+
+    uring_destroy(&ring);
+}
+
+void test_socket_io(void) {
+    uring_t ring;
+    ASSERT(uring_init(&ring, 8) == 0);
+
+    int fds[2];
+    ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    // The receive is queued before there is anything to read
+    char in[32];
+    memset(in, 0, sizeof(in));
+    struct io_uring_sqe *sqe = uring_get_sqe(&ring);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fds[1];
+    sqe->addr = (uintptr_t) in;
+    sqe->len = sizeof(in);
+    sqe->ioprio = IORING_RECVSEND_POLL_FIRST;
+    sqe->user_data = 1;
+    ASSERT(uring_submit(&ring, 0) == 1);
+    ASSERT(uring_peek(&ring) == NULL);
+
+    // One gathered sendmsg() of a header and a payload
+    char header[] = "head:";
+    char payload[] = "payload";
+    struct iovec iov[2] = {
+        { .iov_base = header, .iov_len = 5 },
+        { .iov_base = payload, .iov_len = 7 },
+    };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    sqe = uring_get_sqe(&ring);
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fds[0];
+    sqe->addr = (uintptr_t) &msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = 2;
+
+    int sent = 0, received = 0;
+    for (int i = 0; i < 2; i++) {
+        struct io_uring_cqe cqe = next_cqe(&ring);
+        if (cqe.user_data == 1) received = cqe.res;
+        if (cqe.user_data == 2) sent = cqe.res;
+    }
+    ASSERT(sent == 12 && received == 12);
+    ASSERT(memcmp(in, "head:payload", 12) == 0);
+
+    // Cancelling by fd completes the pending receive with -ECANCELED
+    sqe = uring_get_sqe(&ring);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fds[1];
+    sqe->addr = (uintptr_t) in;
+    sqe->len = sizeof(in);
+    sqe->user_data = 3;
+    ASSERT(uring_submit(&ring, 0) == 1);
+
+    sqe = uring_get_sqe(&ring);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = fds[1];
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = 4;
+
+    int cancelled = 0, cancels = 0;
+    for (int i = 0; i < 2; i++) {
+        struct io_uring_cqe cqe = next_cqe(&ring);
+        if (cqe.user_data == 3) cancelled = cqe.res;
+        if (cqe.user_data == 4) cancels = cqe.res;
+    }
+    if (cancels != -EINVAL) {   // Kernel before 5.19: no fd cancellation
+        ASSERT(cancelled == -ECANCELED && cancels == 1);
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+    uring_destroy(&ring);
+}
+
+// =============================================================================
+// MAIN
+// =============================================================================
+
+int main(void) {
+    printf("\n");
+    printf("===========================================\n");
+    printf("  Ether io_uring Ring Test Suite\n");
+    printf("===========================================\n\n");
+
+    uring_t probe;
+    int err = uring_init(&probe, 8);
+    if (err < 0) {
+        printf("  io_uring unavailable (%s), skipping\n\n", strerror(-err));
+        return 0;
+    }
+    uring_destroy(&probe);
+
+    TEST(test_nop);
+    TEST(test_full_queue);
+    TEST(test_socket_io);
+
+    printf("\n");
+    printf("===========================================\n");
+    printf("  Results: %d/%d tests passed\n", tests_passed, tests_run);
+    printf("===========================================\n\n");
+
+    return (tests_passed == tests_run) ? 0 : 1;
+}